@@ -0,0 +1,177 @@
+#!/bin/sh
+# ExplorIr driver footprint report
+#
+# Compiles the driver for a Cortex-M4 and reports flash, RAM and the largest
+# stack frame per feature, fails if any path links against the heap, and
+# compares the result against a budget file.
+#
+#   footprint/footprint.sh [budget file]
+#
+#   CROSS        toolchain prefix, default arm-none-eabi-
+#   ARCH_FLAGS   default -mcpu=cortex-m4 -mthumb
+#   BUILD_DIR    where objects go, default a temporary directory
+#
+# RAM is static data plus one instance of the feature's state (handler fields,
+# queue, framer, ...). Caller-provided buffers (explorir_data, async requests,
+# log blocks) are not included, they are sized by the application.
+# Exits 1 if a feature is over budget or a heap function is referenced.
+
+set -eu
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+BUDGET=${1:-$ROOT/footprint/budget.txt}
+CROSS=${CROSS-arm-none-eabi-}
+ARCH_FLAGS=${ARCH_FLAGS--mcpu=cortex-m4 -mthumb}
+CC="${CROSS}gcc"
+SIZE="${CROSS}size"
+NM="${CROSS}nm"
+CFLAGS="-std=c11 -Os -ffunction-sections -fdata-sections -fstack-usage -Wall -Werror=vla -Werror=alloca -I$ROOT/src"
+
+if [ -n "${BUILD_DIR:-}" ]; then
+    OUT=$BUILD_DIR
+    mkdir -p "$OUT"
+else
+    OUT=$(mktemp -d)
+    trap 'rm -rf "$OUT"' EXIT
+fi
+
+FEATURES="SAMPLE_HOOK TRAFFIC_HOOK RETRY ASYNC STATS FLEET"
+
+# @brief prints the flags that disable every optional feature except the one given
+only() {
+    for feature in $FEATURES; do
+	if [ "$feature" = "${1:-}" ]; then
+	    printf -- '-DEXPLORIR_FEATURE_%s=1 ' "$feature"
+	else
+	    printf -- '-DEXPLORIR_FEATURE_%s=0 ' "$feature"
+	fi
+    done
+}
+NO_FEATURES=$(only)
+
+# @brief compile <object name> <source> [flags]
+compile() {
+    name=$1
+    src=$2
+    shift 2
+    # shellcheck disable=SC2086
+    $CC $ARCH_FLAGS $CFLAGS "$@" -c "$ROOT/src/$src" -o "$OUT/$name.o"
+}
+
+# @brief prints "<flash> <ram>" of the sections of an object whose name matches a regex
+sections() {
+    $SIZE -A "$OUT/$1.o" | awk -v match_re="$2" -v skip_re="${3:-^$}" '
+	$1 ~ /^\.(text|rodata|data|bss)/ && $1 ~ match_re && $1 !~ skip_re {
+	    if($1 ~ /^\.(text|rodata)/) flash += $2
+	    if($1 ~ /^\.data/) { flash += $2; ram += $2 }
+	    if($1 ~ /^\.bss/) ram += $2
+	}
+	END { printf "%d %d\n", flash, ram }'
+}
+
+# @brief prints the largest stack frame of the functions of an object whose name matches a regex
+stack() {
+    awk -F '\t' -v match_re="$2" -v skip_re="${3:-^$}" '
+	{ n = split($1, f, ":"); fn = f[n] }
+	fn ~ match_re && fn !~ skip_re && $2 + 0 > max { max = $2 + 0 }
+	END { printf "%d\n", max }' "$OUT/$1.su"
+}
+
+# @brief prints sizeof(type) with the given headers and flags
+instance() {
+    type=$1
+    header=$2
+    shift 2
+    printf '#include "%s"\nconst unsigned char footprint_probe[sizeof(%s)] = {1};\n' "$header" "$type" > "$OUT/probe.c"
+    # shellcheck disable=SC2086
+    $CC $ARCH_FLAGS $CFLAGS "$@" -c "$OUT/probe.c" -o "$OUT/probe.o"
+    $NM -S -t d "$OUT/probe.o" | awk '$4 == "footprint_probe" { print $2 + 0 }'
+}
+
+# the core without optional features, the parser is split out by function
+compile core explorir.c $NO_FEATURES
+compile core_sample explorir.c $(only SAMPLE_HOOK)
+compile core_traffic explorir.c $(only TRAFFIC_HOOK)
+compile core_retry explorir.c $(only RETRY)
+compile core_async explorir.c $(only ASYNC)
+compile core_stats explorir.c $(only STATS)
+compile core_fleet explorir.c $(only FLEET)
+for module in async fleet framer watchdog filter aggregate log autozero stability pressure batch calibrate; do
+    compile "$module" "explorir_$module.c"
+done
+
+PARSER='explorir_(parse_|process_response|update_data|opcode|store)'
+RETRY='explorir_(retry_|command_is_idempotent)'
+STATS='explorir_stats_'
+ALL='.'
+
+handler=$(instance explorir_handler_t explorir.h $NO_FEATURES)
+
+# @brief prints the flash delta of a feature flag
+delta() {
+    set -- $(sections "$1" "$ALL") $(sections core "$ALL")
+    echo $(($1 - $3))
+}
+
+# @brief prints the handler size delta of a feature flag
+handler_delta() {
+    echo $(($(instance explorir_handler_t explorir.h $(only "$1")) - handler))
+}
+
+REPORT=$OUT/report.txt
+: > "$REPORT"
+
+# @brief row <feature> <flash> <static ram> <instance ram> <stack>
+row() {
+    echo "$1 $2 $(($3 + $4)) $5" >> "$REPORT"
+}
+
+set -- $(sections core "$PARSER")
+row parser "$1" "$2" "$handler" "$(stack core "$PARSER")"
+set -- $(sections core "$ALL" "$PARSER|$RETRY|$STATS")
+row encoder "$1" "$2" 0 "$(stack core "$ALL" "$PARSER|$RETRY|$STATS")"
+set -- $(sections core "$RETRY")
+row retry $(($1 + $(delta core_retry))) "$2" "$(handler_delta RETRY)" "$(stack core_retry "$RETRY|explorir_command")"
+row sample_hook "$(delta core_sample)" 0 "$(handler_delta SAMPLE_HOOK)" 0
+row tracing "$(delta core_traffic)" 0 "$(handler_delta TRAFFIC_HOOK)" 0
+set -- $(sections core "$STATS")
+row stats $(($1 + $(delta core_stats))) "$2" $(($(instance explorir_stats_t explorir.h) + $(handler_delta STATS))) "$(stack core_stats "$STATS")"
+set -- $(sections async "$ALL")
+row async_queue $(($1 + $(delta core_async))) "$2" \
+    $(($(instance explorir_async_t explorir_async.h) + $(instance explorir_async_request_t explorir_async.h) + $(handler_delta ASYNC))) \
+    "$(stack async "$ALL")"
+set -- $(sections fleet "$ALL")
+row fleet $(($1 + $(delta core_fleet))) "$2" $(($(instance explorir_fleet_t explorir.h) + $(handler_delta FLEET))) "$(stack fleet "$ALL")"
+for module in framer:framer watchdog:watchdog filter:filter aggregate:aggregate log:log_writer autozero:autozero stability:stability pressure:pressure batch:batch calibrate:calibrate; do
+    state=${module#*:}
+    module=${module%:*}
+    set -- $(sections "$module" "$ALL")
+    row "$state" "$1" "$2" "$(instance "explorir_${state}_t" "explorir_$module.h")" "$(stack "$module" "$ALL")"
+done
+
+status=0
+
+printf '%-12s %8s %8s %8s %10s\n' feature flash ram stack budget
+while read -r feature flash ram frame; do
+    limits=$(awk -v f="$feature" '$1 == f { print $2, $3, $4 }' "$BUDGET" 2>/dev/null || true)
+    verdict=-
+    if [ -n "$limits" ]; then
+	set -- $limits
+	verdict=ok
+	if [ "$flash" -gt "$1" ] || [ "$ram" -gt "$2" ] || { [ -n "${3:-}" ] && [ "$frame" -gt "$3" ]; }; then
+	    verdict=OVER
+	    status=1
+	fi
+    fi
+    printf '%-12s %8d %8d %8d %10s\n' "$feature" "$flash" "$ram" "$frame" "$verdict"
+done < "$REPORT"
+awk '{ flash += $2; ram += $3 } END { printf "%-12s %8d %8d\n", "total", flash, ram }' "$REPORT"
+
+# no driver path may touch the heap
+heap=$($NM -u "$OUT"/*.o | awk '$2 ~ /^(malloc|calloc|realloc|free|alloca|_sbrk|_malloc_r|_free_r)$/ { print $2 }' | sort -u)
+if [ -n "$heap" ]; then
+    echo "heap functions referenced:" $heap
+    status=1
+fi
+
+exit $status
@@ -0,0 +1,116 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_fuzz.c
+
+  @Summary
+    Fuzz target for the ExplorIr response parser
+
+  @Description
+    libFuzzer entry point, also usable with AFL or as a plain corpus runner
+    when built with -DEXPLORIR_FUZZ_STANDALONE. Build with the address and
+    undefined behaviour sanitizers, see the README.
+
+    Each input is fed through every entry point: the raw bytes go to
+    explorir_parse_response() with their exact length, so any read past the
+    end is caught by ASan, and the input is split on '\n' into lines that go
+    through explorir_update_data()/explorir_process_response() like UART
+    traffic would. Finally the raw bytes go through the CRLF framer and,
+    with a small output so it fills and stops early, the batch decoder.
+******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "explorir.h"
+#include "explorir_framer.h"
+#include "explorir_batch.h"
+
+volatile bool explorir_complete_uart_rx;
+
+static void fuzz_tx(unsigned char * tx, uint8_t size) {
+    (void)tx;
+    (void)size;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size) {
+    static explorir_handler_t explorir_handler;
+    static uint8_t rx[UART_RX_BUF_SIZE];
+    memset(&explorir_handler, 0, sizeof(explorir_handler));
+    explorir_handler.explorir_data = rx;
+    explorir_handler.explorir_data_size = sizeof(rx);
+    explorir_handler.explorir_tx = fuzz_tx;
+    explorir_handler.scaling_factor = 10;
+
+    // exact length copy so the sanitizer sees any over-read
+    uint16_t bounded = size > UINT16_MAX ? UINT16_MAX : (uint16_t)size;
+    uint8_t * copy = malloc(bounded ? bounded : 1);
+    if(copy == NULL)
+	return 0;
+    memcpy(copy, data, bounded);
+    explorir_parse_response(copy, bounded, &explorir_handler);
+    free(copy);
+
+    // line by line, the way the UART event handler delivers responses
+    size_t start = 0;
+    for(size_t i = 0; i < size; i++) {
+	if(data[i] == TERMINATE || i + 1 == size) {
+	    size_t line = i + 1 - start;
+	    explorir_update_data((uint8_t *)&data[start], line > UINT8_MAX ? UINT8_MAX : (uint8_t)line, &explorir_handler);
+	    explorir_process_response(&explorir_handler);
+	    start = i + 1;
+	}
+    }
+
+    // byte stream through the framer, as a noisy serial line would deliver it
+    static explorir_framer_t framer;
+    explorir_framer_init(&framer);
+    explorir_framer_process(&framer, data, bounded, &explorir_handler);
+
+    // many lines at once into arrays, resumed after every full batch like a backfill job would
+    static uint32_t timestamps_ms[8];
+    static uint16_t raw[8];
+    static uint8_t sensor_ids[8];
+    static uint8_t fields[8];
+    explorir_batch_t batch;
+    explorir_batch_init(&batch, timestamps_ms, sensor_ids, fields, raw, 8);
+    copy = malloc(size ? size : 1);
+    if(copy == NULL)
+	return 0;
+    memcpy(copy, data, size);
+    uint32_t used = 0;
+    uint32_t step;
+    do {
+	explorir_batch_clear(&batch);
+	step = explorir_parse_batch(&batch, &copy[used], size - used, 0, 0);
+	used += step;
+    } while(step > 0);
+    free(copy);
+    return 0;
+}
+
+#ifdef EXPLORIR_FUZZ_STANDALONE
+// runs each file given on the command line, or stdin for AFL
+int main(int argc, char ** argv) {
+    static uint8_t buf[1 << 16];
+    if(argc < 2) {
+	size_t n = fread(buf, 1, sizeof(buf), stdin);
+	return LLVMFuzzerTestOneInput(buf, n);
+    }
+    for(int a = 1; a < argc; a++) {
+	FILE * file = fopen(argv[a], "rb");
+	if(file == NULL) {
+	    perror(argv[a]);
+	    return 1;
+	}
+	size_t n = fread(buf, 1, sizeof(buf), file);
+	fclose(file);
+	LLVMFuzzerTestOneInput(buf, n);
+    }
+    return 0;
+}
+#endif
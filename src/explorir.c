@@ -12,14 +12,328 @@
 ******************************************************************************/
 
 #include <stdint.h>
-#include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
-#include <stdio.h>
 #include <stdbool.h>
 #include "explorir.h"
+#if EXPLORIR_FEATURE_ASYNC
+#include "explorir_async.h"
+#endif
 
 extern volatile bool explorir_complete_uart_rx;
 
+/*
+    @brief Function to transmit a command to the sensor, every command goes through here
+
+    @param[in] msg Command bytes, including the trailing "\r\n"
+
+    @param[in] size Size, in bytes, of the command
+
+    @note Calls explorir_on_traffic, if set, with the command
+
+    @note Records the register a 'P' command writes in reply_register, its reply is checked against it
+*/
+void explorir_transmit(const unsigned char * msg, uint8_t size, explorir_handler_t * explorir_handler) {
+    explorir_handler->reply_register = explorir_reply_register(msg);
+#if EXPLORIR_FEATURE_TRAFFIC_HOOK
+    if(explorir_handler->explorir_on_traffic) {
+	explorir_handler->explorir_on_traffic(EXPLORIR_TX, msg, size, explorir_handler->sensor_id, explorir_handler->traffic_context);
+    }
+#endif
+    explorir_handler->explorir_tx((unsigned char *)msg, size);
+}
+
+// upper bound of each latency bucket, the last one takes everything above 1 s
+const uint16_t explorir_stats_latency_bounds_ms[EXPLORIR_STATS_LATENCY_BUCKETS] = {10, 20, 50, 100, 200, 500, 1000, UINT16_MAX};
+
+#if EXPLORIR_FEATURE_STATS || EXPLORIR_FEATURE_FLEET
+// @brief time for command latencies and fleet timestamps, 0 without a clock
+static uint32_t explorir_clock(explorir_handler_t * explorir_handler) {
+#if EXPLORIR_FEATURE_SAMPLE_HOOK
+    if(explorir_handler->explorir_get_time_ms)
+	return explorir_handler->explorir_get_time_ms();
+#endif
+    (void)explorir_handler;
+    return 0;
+}
+#endif
+
+#if EXPLORIR_FEATURE_STATS
+
+// @brief counts a blocking command attempt once its response was processed
+static void explorir_stats_count_command(explorir_handler_t * explorir_handler, uint32_t sent_ms) {
+    explorir_stats_t * stats = explorir_handler->stats;
+    if(stats == NULL)
+	return;
+    stats->commands++;
+    if(explorir_handler->err_code == EXPLORIR_ERR_TIMEOUT) {
+	stats->timeouts++;
+	return;
+    }
+#if EXPLORIR_FEATURE_SAMPLE_HOOK
+    if(explorir_handler->explorir_get_time_ms)
+	explorir_stats_add_latency(stats, explorir_handler->explorir_get_time_ms() - sent_ms);
+#endif
+    (void)sent_ms;
+}
+#endif
+
+// @brief Function to write the decimal digits of value, returns how many were written
+static uint8_t explorir_encode_decimal(unsigned char * out, uint32_t value) {
+    unsigned char digits[10]; // 4294967295
+    uint8_t count = 0;
+    do {
+	digits[count++] = '0' + value % 10;
+	value /= 10;
+    } while(value);
+
+    for(uint8_t k = 0; k < count; k++) {
+	out[k] = digits[count - 1 - k];
+    }
+    return count;
+}
+
+/*
+    @brief Function to compile a command with decimal arguments, e.g. "A 16\r\n", "F 400 415\r\n" or "P 8 1\r\n"
+
+    @param[out] msg Command buffer, at least EXPLORIR_MAX_COMMAND bytes
+
+    @param[in] args Layout of the arguments, first and second are ignored where the layout has no use for them
+
+    @param[in] first Single argument, first of two, or the register of a split two-byte word
+
+    @param[in] second Second argument, or the two-byte word to split
+
+    @note Never allocates, the arguments of the dual and split layouts must not exceed 65535 and those of the tenths
+	    layout 9999 to fit EXPLORIR_MAX_COMMAND
+
+    @ret Size, in bytes, of the command, including the trailing "\r\n", or 0 without writing msg if an argument
+	    exceeds its limit
+*/
+uint8_t explorir_encode_command(unsigned char * msg, unsigned char identifier, explorir_args_t args, uint32_t first, uint32_t second) {
+    switch(args) {
+	case EXPLORIR_ARGS_DUAL:
+	case EXPLORIR_ARGS_MSB:
+	case EXPLORIR_ARGS_LSB:
+	    if(first > MAX_TWO_BYTE_VALUE || second > MAX_TWO_BYTE_VALUE)
+		return 0;
+	    break;
+	case EXPLORIR_ARGS_TENTHS:
+	    if(first > MAX_AUTO_ZERO_INTERVAL || second > MAX_AUTO_ZERO_INTERVAL)
+		return 0;
+	    break;
+	default:
+	    break;
+    }
+    if(args == EXPLORIR_ARGS_MSB)
+	second = second >> 8;
+    else if(args == EXPLORIR_ARGS_LSB)
+	second = second & 0xFF;
+
+    uint8_t size = 0;
+    msg[size++] = identifier;
+    if(args == EXPLORIR_ARGS_TENTHS) {
+	// "#.# #.#", both arguments in tenths
+	msg[size++] = SPACE;
+	size += explorir_encode_decimal(msg + size, first / 10);
+	msg[size++] = '.';
+	msg[size++] = '0' + first % 10;
+	msg[size++] = SPACE;
+	size += explorir_encode_decimal(msg + size, second / 10);
+	msg[size++] = '.';
+	msg[size++] = '0' + second % 10;
+    } else {
+	if(args != EXPLORIR_ARGS_NONE) {
+	    msg[size++] = SPACE;
+	    size += explorir_encode_decimal(msg + size, first);
+	}
+	if(args >= EXPLORIR_ARGS_DUAL) {
+	    msg[size++] = SPACE;
+	    size += explorir_encode_decimal(msg + size, second);
+	}
+    }
+    msg[size++] = '\r';
+    msg[size++] = TERMINATE;
+    return size;
+}
+
+/*
+    @brief Function to transmit a command and process its response, retrying as configured by retry_config
+
+    @param[in] msg Command bytes, including the trailing "\r\n"
+
+    @param[in] size Size, in bytes, of the command
+
+    @note Updates err_code with the result of the last attempt, or with the result of queueing the command
+	    when explorir_submit is set
+
+    @note Fails with EXPLORIR_ERR_INVALID_INPUT, without transmitting, on a handler without explorir_data,
+	    it would have no reply to wait for
+*/
+static void explorir_command(unsigned char * msg, uint8_t size, explorir_handler_t * explorir_handler) {
+    if(size == 0) {
+	// the encoder rejected an argument
+	explorir_handler->err_code = EXPLORIR_ERR_INVALID_INPUT;
+	return;
+    }
+#if EXPLORIR_FEATURE_ASYNC
+    if(explorir_handler->explorir_submit) {
+	// non-blocking, the queue transmits the command and handles its response and retries
+	explorir_handler->err_code = explorir_handler->explorir_submit(msg, size, explorir_handler->submit_context);
+	return;
+    }
+#endif
+    if(explorir_handler->explorir_data == NULL) {
+	explorir_handler->err_code = EXPLORIR_ERR_INVALID_INPUT;
+	return;
+    }
+
+#if EXPLORIR_FEATURE_RETRY
+    uint32_t delay_ms = 0;
+    for(uint8_t attempt = 1; ; attempt++) {
+#endif
+	explorir_handler->err_code = EXPLORIR_SUCCESS; // don't let an earlier command's error trigger a retry
+#if EXPLORIR_FEATURE_STATS
+	uint32_t sent_ms = explorir_clock(explorir_handler);
+#endif
+	explorir_transmit(msg, size, explorir_handler);
+
+	//explorir_wait_for_response(explorir_handler);
+	explorir_process_response(explorir_handler);
+#if EXPLORIR_FEATURE_STATS
+	explorir_stats_count_command(explorir_handler, sent_ms);
+#endif
+
+#if EXPLORIR_FEATURE_RETRY
+	if(!explorir_retry_should_retry(explorir_handler->retry_config, msg, attempt, explorir_handler->err_code, &delay_ms))
+	    break;
+#ifdef DEBUG_OUTPUT
+	NRF_LOG_INFO("Retrying %c, attempt %d ", msg[0], attempt + 1);
+	NRF_LOG_FLUSH();
+#endif
+	if(delay_ms && explorir_handler->explorir_delay_ms)
+	    explorir_handler->explorir_delay_ms(delay_ms);
+    }
+#endif
+}
+
+/*
+    @brief Function to count a command reply in the latency histogram
+
+    @param[in] latency_ms Time from transmitting the command to parsing its reply
+*/
+void explorir_stats_add_latency(explorir_stats_t * stats, uint32_t latency_ms) {
+    uint8_t bucket = 0;
+    while(bucket < EXPLORIR_STATS_LATENCY_BUCKETS - 1 && latency_ms > explorir_stats_latency_bounds_ms[bucket]) {
+	bucket++;
+    }
+    stats->latency_buckets[bucket]++;
+    stats->latency_count++;
+    stats->latency_sum_ms += latency_ms;
+}
+
+/*
+    @brief Function to get the identifier the reply to a command starts with
+
+    @param[in] cmd Command bytes as transmitted
+
+    @ret Reply identifier, or 0 if the reply has no fixed identifier (starting an auto-zero)
+*/
+uint8_t explorir_reply_identifier(const unsigned char * cmd) {
+    switch(cmd[0]) {
+	case SET_CO2_BGROUND_CONCENTRATION:
+	    return CO2_BGROUND_CONCENTRATION_REPLY;
+	case '6': // "65222", start auto-zero
+	    return 0;
+	default:
+	    return cmd[0];
+    }
+}
+
+/*
+    @brief Function to get the register a 'P' command writes, its reply "p # #" mirrors it
+
+    @param[in] cmd Command bytes as transmitted
+
+    @ret Register, or 0 if the command is not a 'P' command
+*/
+uint8_t explorir_reply_register(const unsigned char * cmd) {
+    if(cmd[0] != SET_CO2_BGROUND_CONCENTRATION)
+	return 0;
+    uint8_t reg = 0;
+    for(uint8_t k = 2; cmd[k] >= '0' && cmd[k] <= '9'; k++) {
+	reg = reg * 10 + (cmd[k] - '0');
+    }
+    return reg;
+}
+
+/*
+    @brief Function to check whether a command can be repeated without changing the outcome
+
+    @param[in] cmd Command bytes as transmitted
+
+    @ret false for commands that calibrate against the current gas (F, G, U, X) and for starting an auto-zero
+*/
+bool explorir_command_is_idempotent(const unsigned char * cmd) {
+    switch(cmd[0]) {
+	case FINE_TUNE_ZERO_POINT:
+	case SET_ZERO_POINT_USING_FRESH_AIR:
+	case SET_ZERO_POINT_USING_NITROGEN:
+	case SET_ZERO_POINT_USING_KNOWN_GAS:
+	case '6': // "65222", start auto-zero
+	    return false;
+	default:
+	    return true;
+    }
+}
+
+/*
+    @brief Function to decide whether a failed command should be sent again
+
+    @param[in] config Retry configuration, NULL disables retries
+
+    @param[in] cmd Command bytes as transmitted
+
+    @param[in] attempt Number of attempts made so far, starting at 1
+
+    @param[in] result Result of the last attempt
+
+    @param[out] delay_ms Time to wait before the next attempt
+
+    @note Only '?', timeout and malformed responses are retried, and commands that are not idempotent only
+	    when their policy sets retry_non_idempotent
+*/
+bool explorir_retry_should_retry(const explorir_retry_config_t * config, const unsigned char * cmd, uint8_t attempt,
+	explorir_retcode_t result, uint32_t * delay_ms) {
+    if(config == NULL)
+	return false;
+    if(result != EXPLORIR_ERR_UNRECOGNIZED_COMMAND && result != EXPLORIR_ERR_TIMEOUT && result != EXPLORIR_ERR_MALFORMED_RESPONSE)
+	return false;
+
+    const explorir_retry_policy_t * policy = &config->default_policy;
+    for(uint8_t r = 0; r < config->rule_count; r++) {
+	if(config->rules[r].command == cmd[0]) {
+	    policy = &config->rules[r].policy;
+	    break;
+	}
+    }
+    if(attempt >= policy->max_attempts)
+	return false;
+    if(!policy->retry_non_idempotent && !explorir_command_is_idempotent(cmd))
+	return false;
+
+    // exponential backoff: backoff_ms, then multiplied for every further attempt
+    uint32_t delay = policy->backoff_ms;
+    uint8_t multiplier = policy->backoff_multiplier ? policy->backoff_multiplier : 1;
+    for(uint8_t a = 1; a < attempt && multiplier > 1 && delay <= UINT32_MAX / multiplier; a++) {
+	delay *= multiplier;
+    }
+    if(policy->max_backoff_ms && delay > policy->max_backoff_ms)
+	delay = policy->max_backoff_ms;
+    *delay_ms = delay;
+    return true;
+}
+
 /*******************************[ High-Level Sensor Functions For General Use ]****************************************/
 
 /*
@@ -65,10 +379,7 @@ void explorir_init(explorir_handler_t * explorir_handler) {
 */
 explorir_retcode_t explorir_request_filtered_co2(explorir_handler_t * explorir_handler) {
     unsigned char msg[] = "Z\r\n";
-    explorir_handler->explorir_tx(msg, 3); // transmit message
-    
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
+    explorir_command(msg, 3, explorir_handler); // transmit message and process the response
     
     return explorir_handler->err_code;
 }
@@ -94,10 +405,7 @@ uint32_t explorir_get_filtered_co2(explorir_handler_t * explorir_handler) {
 */
 explorir_retcode_t explorir_request_unfiltered_co2(explorir_handler_t * explorir_handler) {
     unsigned char msg[] = "z\r\n";
-    explorir_handler->explorir_tx(msg, 3); // transmit message
-    
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
+    explorir_command(msg, 3, explorir_handler); // transmit message and process the response
     
     return explorir_handler->err_code;
 }
@@ -122,10 +430,7 @@ uint32_t explorir_get_unfiltered_co2(explorir_handler_t * explorir_handler) {
 */
 explorir_retcode_t explorir_request_scaling_factor(explorir_handler_t * explorir_handler) {
     unsigned char msg[] = ".\r\n";
-    explorir_handler->explorir_tx(msg, 3); // transmit message
-    
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
+    explorir_command(msg, 3, explorir_handler); // transmit message and process the response
     
     return explorir_handler->err_code;
 }
@@ -140,26 +445,14 @@ explorir_retcode_t explorir_request_scaling_factor(explorir_handler_t * explorir
     @ret ExplorIr return code, either SUCCESS or failure
 */
 explorir_retcode_t explorir_set_operation_mode(explorir_mode_t mode, explorir_handler_t * explorir_handler) {
-    char msg[] = "K x\r\n";
-    // set command to given mode
-    switch(mode) {
-	case EXPLORIR_MODE_STREAMING:
-	    msg[2] = '1';
-	    break;
-	case EXPLORIR_MODE_POLLING:
-	    msg[2] = '2';
-	    break;
-	case EXPLORIR_MODE_COMMAND:
-	    msg[2] = '0';
-	    break;
-	default:
-	    return EXPLORIR_ERR_INVALID_MODE;
-    }
+    // explorir_mode_t values are the sensor's mode numbers
+    if((unsigned)mode > EXPLORIR_MODE_POLLING)
+	return EXPLORIR_ERR_INVALID_MODE;
 
-    explorir_handler->explorir_tx(msg, 5); // transmit message
+    unsigned char msg[EXPLORIR_MAX_COMMAND];
+    uint8_t msg_size = explorir_encode_command(msg, OPERATION_MODE, EXPLORIR_ARGS_SINGLE, mode, 0);
 
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
+    explorir_command(msg, msg_size, explorir_handler); // transmit message and process the response
     
     return explorir_handler->err_code;
 }
@@ -176,28 +469,14 @@ explorir_retcode_t explorir_set_operation_mode(explorir_mode_t mode, explorir_ha
     @ret ExplorIr return code, either SUCCESS or failure
 */
 explorir_retcode_t explorir_set_digital_filter(uint16_t filter, explorir_handler_t * explorir_handler) {
-    if(filter > MAX_DIGITAL_FILTER || filter < MIN_DIGITAL_FILTER) {
+    if(filter > MAX_DIGITAL_FILTER) {
 	return EXPLORIR_ERR_INVALID_INPUT;
     }
     
-    char buf[8];
-    uint8_t str_size = sprintf(buf, "%d", filter);
+    unsigned char msg[EXPLORIR_MAX_COMMAND];
+    uint8_t msg_size = explorir_encode_command(msg, SET_DIGITAL_FILTER, EXPLORIR_ARGS_SINGLE, filter, 0);
 
-    // compile message
-    uint8_t msg_size = 4 + str_size;
-    unsigned char msg[msg_size];
-    msg[0] = 'A';
-    msg[1] = ' ';
-    for(uint8_t i = 0; i < str_size; i++) {
-	msg[i+2] = buf[i];
-    }
-    msg[msg_size-2] = '\r';
-    msg[msg_size-1] = '\n';
-
-    explorir_handler->explorir_tx(msg, msg_size); // transmit the message
-
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
+    explorir_command(msg, msg_size, explorir_handler); // transmit message and process the response
     
     return explorir_handler->err_code;
 }
@@ -211,10 +490,7 @@ explorir_retcode_t explorir_set_digital_filter(uint16_t filter, explorir_handler
 */
 explorir_retcode_t explorir_request_digital_filter(explorir_handler_t * explorir_handler) {
     unsigned char msg[] = "a\r\n";
-    explorir_handler->explorir_tx(msg, 3); // transmit message
-    
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
+    explorir_command(msg, 3, explorir_handler); // transmit message and process the response
     
     return explorir_handler->err_code;
 }
@@ -226,15 +502,20 @@ explorir_retcode_t explorir_request_digital_filter(explorir_handler_t * explorir
 
     @param[in] actual Actual gas concentration
 
+    @note Both values range 0 - 65535, scaled like the readings
+
     @note Response: "F #####\r\n"
 
     @ret ExplorIr return code, either SUCCESS or failure
 */
 explorir_retcode_t explorir_set_zero_point_using_known_reading(uint32_t reported, uint32_t actual, explorir_handler_t * explorir_handler) {
-    // TODO need to figure out how to turn inputs into string to send to sensor
-    
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
+    if(reported > MAX_TWO_BYTE_VALUE || actual > MAX_TWO_BYTE_VALUE)
+	return EXPLORIR_ERR_INVALID_INPUT;
+
+    unsigned char msg[EXPLORIR_MAX_COMMAND];
+    uint8_t msg_size = explorir_encode_command(msg, FINE_TUNE_ZERO_POINT, EXPLORIR_ARGS_DUAL, reported, actual);
+
+    explorir_command(msg, msg_size, explorir_handler); // transmit message and process the response
     
     return explorir_handler->err_code;
 }
@@ -250,10 +531,7 @@ explorir_retcode_t explorir_set_zero_point_using_known_reading(uint32_t reported
 */
 explorir_retcode_t explorir_set_zero_point_in_fresh_air(explorir_handler_t * explorir_handler) {
     unsigned char msg[] = "G\r\n";
-    explorir_handler->explorir_tx(msg, 3); // transmit message
-    
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
+    explorir_command(msg, 3, explorir_handler); // transmit message and process the response
     
     return explorir_handler->err_code;
 }
@@ -267,10 +545,7 @@ explorir_retcode_t explorir_set_zero_point_in_fresh_air(explorir_handler_t * exp
 */
 explorir_retcode_t explorir_set_zero_point_in_nitrogen(explorir_handler_t * explorir_handler) {
     unsigned char msg[] = "U\r\n";
-    explorir_handler->explorir_tx(msg, 3); // transmit message
-    
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
+    explorir_command(msg, 3, explorir_handler); // transmit message and process the response
     
     return explorir_handler->err_code;
 }
@@ -287,24 +562,10 @@ explorir_retcode_t explorir_set_zero_point_in_nitrogen(explorir_handler_t * expl
     @ret ExplorIr return code, either SUCCESS or failure
 */
 explorir_retcode_t explorir_set_zero_point_manually(uint32_t zero_point, explorir_handler_t * explorir_handler) {
-    char buf[8];
-    uint8_t str_size = sprintf(buf, "%d", zero_point);
-
-    // compile message
-    uint8_t msg_size = 4 + str_size;
-    unsigned char msg[msg_size];
-    msg[0] = 'u';
-    msg[1] = ' ';
-    for(uint8_t i = 0; i < str_size; i++) {
-	msg[i+2] = buf[i];
-    }
-    msg[msg_size-2] = '\r';
-    msg[msg_size-1] = '\n';
+    unsigned char msg[EXPLORIR_MAX_COMMAND];
+    uint8_t msg_size = explorir_encode_command(msg, MANUALLY_SET_ZERO_POINT, EXPLORIR_ARGS_SINGLE, zero_point, 0);
 
-    explorir_handler->explorir_tx(msg, msg_size); // transmit the message
-    
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
+    explorir_command(msg, msg_size, explorir_handler); // transmit message and process the response
     
     return explorir_handler->err_code;
 }
@@ -321,25 +582,47 @@ explorir_retcode_t explorir_set_zero_point_manually(uint32_t zero_point, explori
     @ret ExplorIr return code, either SUCCESS or failure
 */
 explorir_retcode_t explorir_set_zero_point_using_known_co2(uint32_t co2_concentration, explorir_handler_t * explorir_handler) {
-    char buf[8];
-    uint8_t str_size = sprintf(buf, "%d", co2_concentration);
+    unsigned char msg[EXPLORIR_MAX_COMMAND];
+    uint8_t msg_size = explorir_encode_command(msg, SET_ZERO_POINT_USING_KNOWN_GAS, EXPLORIR_ARGS_SINGLE, co2_concentration, 0);
+
+    explorir_command(msg, msg_size, explorir_handler); // transmit message and process the response
+    
+    return explorir_handler->err_code;
+}
+
+/*
+    @brief Function to set a two-byte 'P' parameter, MSB register first, then the LSB register that follows it
+
+    @param[in] msb_register Register of the most significant byte
 
-    // compile message
-    uint8_t msg_size = 4 + str_size;
-    unsigned char msg[msg_size];
-    msg[0] = 'X';
-    msg[1] = ' ';
-    for(uint8_t i = 0; i < str_size; i++) {
-	msg[i+2] = buf[i];
+    @param[in] value Two-byte word to set
+
+    @note Stops at the first command that fails, a failed LSB leaves the new MSB in place
+
+    @ret ExplorIr return code, either SUCCESS or failure
+*/
+static explorir_retcode_t explorir_set_two_byte_parameter(uint8_t msb_register, uint32_t value, explorir_handler_t * explorir_handler) {
+    if(value > MAX_TWO_BYTE_VALUE)
+	return EXPLORIR_ERR_INVALID_INPUT;
+
+    unsigned char msg[EXPLORIR_MAX_COMMAND];
+    uint8_t msg_size = explorir_encode_command(msg, SET_CO2_BGROUND_CONCENTRATION, EXPLORIR_ARGS_MSB, msb_register, value);
+#if EXPLORIR_FEATURE_ASYNC
+    explorir_async_t * async = explorir_async_of(explorir_handler);
+    if(async) {
+	// non-blocking, the queue sends the LSB once the MSB succeeded and completes the pair with one callback
+	unsigned char lsb[EXPLORIR_MAX_COMMAND];
+	uint8_t lsb_size = explorir_encode_command(lsb, SET_CO2_BGROUND_CONCENTRATION, EXPLORIR_ARGS_LSB, msb_register + 1, value);
+	explorir_handler->err_code = explorir_async_submit_pair(async, msg, msg_size, lsb, lsb_size);
+	return explorir_handler->err_code;
     }
-    msg[msg_size-2] = '\r';
-    msg[msg_size-1] = '\n';
+#endif
+    explorir_command(msg, msg_size, explorir_handler); // transmit message and process the response
+    if(explorir_handler->err_code != EXPLORIR_SUCCESS)
+	return explorir_handler->err_code;
 
-    explorir_handler->explorir_tx(msg, msg_size); // transmit the message
-    
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
-    
+    msg_size = explorir_encode_command(msg, SET_CO2_BGROUND_CONCENTRATION, EXPLORIR_ARGS_LSB, msb_register + 1, value);
+    explorir_command(msg, msg_size, explorir_handler);
     return explorir_handler->err_code;
 }
 
@@ -352,7 +635,9 @@ explorir_retcode_t explorir_set_zero_point_using_known_co2(uint32_t co2_concentr
 	    MSB = Integer (Concentration/256)
 	    LSB = Concentration – (256*MSB)
 
-    @param[in] co2_concentration CO2 value to set
+    @param[in] co2_concentration CO2 value to set, 0 - 65535
+
+    @note Sends "P 8 #" then "P 9 #", stops at the first one that fails
 
     @note Response: "p 8 #\r\n"
 		    "p 9 ##\r\n"
@@ -361,12 +646,7 @@ explorir_retcode_t explorir_set_zero_point_using_known_co2(uint32_t co2_concentr
     @ret ExplorIr return code, either SUCCESS or failure
 */
 explorir_retcode_t explorir_set_co2_for_auto_zeroing(uint32_t co2_concentration, explorir_handler_t * explorir_handler) {
-    // TODO need to figure out how to turn input into string to send to sensor
-    
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
-    
-    return explorir_handler->err_code;
+    return explorir_set_two_byte_parameter(AUTO_ZERO_CO2_MSB_REGISTER, co2_concentration, explorir_handler);
 }
 
 /*
@@ -378,7 +658,9 @@ explorir_retcode_t explorir_set_co2_for_auto_zeroing(uint32_t co2_concentration,
 	    MSB = Integer (Concentration/256)
 	    LSB = Concentration – (256*MSB)
 
-    @param[in] co2_concentration CO2 value to set
+    @param[in] co2_concentration CO2 value to set, 0 - 65535
+
+    @note Sends "P 10 #" then "P 11 #", stops at the first one that fails
 
     @note Response: "p 10 #\r\n"
 		    "p 11 ###\r\n"
@@ -387,12 +669,7 @@ explorir_retcode_t explorir_set_co2_for_auto_zeroing(uint32_t co2_concentration,
     @ret ExplorIr return code, either SUCCESS or failure
 */
 explorir_retcode_t explorir_set_co2_for_zero_point_in_fresh_air(uint32_t co2_concentration, explorir_handler_t * explorir_handler) {
-    // TODO need to figure out how to turn input into string to send to sensor
-    
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
-    
-    return explorir_handler->err_code;
+    return explorir_set_two_byte_parameter(FRESH_AIR_CO2_MSB_REGISTER, co2_concentration, explorir_handler);
 }
 
 /*
@@ -411,22 +688,28 @@ explorir_retcode_t explorir_set_co2_for_zero_point_in_fresh_air(uint32_t co2_con
     @ret ExplorIr return code, either SUCCESS or failure
 */
 explorir_retcode_t explorir_set_auto_zero_intervals(uint8_t initial, uint8_t regular, explorir_handler_t * explorir_handler) {
-    if(initial < 0 || initial > 9 || regular < 0 || regular > 9)
-	return EXPLORIR_ERR_INVALID_INPUT;
+    return explorir_set_auto_zero_intervals_tenths(initial * 10u, regular * 10u, explorir_handler);
+}
 
-    char initial_char;
-    char regular_char;
-    sprintf(&initial_char, "%d", initial);
-    sprintf(&regular_char, "%d", regular);
+/*
+    @brief Function to set the 'Initial Interval' and 'Regular Interval' for auto-zeroing events to a tenth of a day
 
-    unsigned char msg[] = "@ x.0 x.0\r\n";
-    msg[2] = initial_char;
-    msg[6] = regular_char;
+    @param[in] initial Initial interval in tenths of days, 0 - MAX_AUTO_ZERO_INTERVAL
 
-    explorir_handler->explorir_tx(msg, 10); // transmit the message
-    
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
+    @param[in] regular Regular interval in tenths of days, 0 - MAX_AUTO_ZERO_INTERVAL
+
+    @note Response: "@ #.# #.#\r\n", decoded into auto_zero_initial and auto_zero_regular
+
+    @ret ExplorIr return code, either SUCCESS or failure
+*/
+explorir_retcode_t explorir_set_auto_zero_intervals_tenths(uint16_t initial, uint16_t regular, explorir_handler_t * explorir_handler) {
+    if(initial > MAX_AUTO_ZERO_INTERVAL || regular > MAX_AUTO_ZERO_INTERVAL)
+	return EXPLORIR_ERR_INVALID_INPUT;
+
+    unsigned char msg[EXPLORIR_MAX_COMMAND];
+    uint8_t msg_size = explorir_encode_command(msg, AUTO_ZERO, EXPLORIR_ARGS_TENTHS, initial, regular);
+
+    explorir_command(msg, msg_size, explorir_handler); // transmit message and process the response
     
     return explorir_handler->err_code;
 }
@@ -439,11 +722,10 @@ explorir_retcode_t explorir_set_auto_zero_intervals(uint8_t initial, uint8_t reg
     @ret ExplorIr return code, either SUCCESS or failure
 */
 explorir_retcode_t explorir_disable_auto_zeroing(explorir_handler_t * explorir_handler) {
-    unsigned char msg[] = "@ 0\r\n";
-    explorir_handler->explorir_tx(msg, 5); // transmit message
-    
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
+    unsigned char msg[EXPLORIR_MAX_COMMAND];
+    uint8_t msg_size = explorir_encode_command(msg, AUTO_ZERO, EXPLORIR_ARGS_SINGLE, 0, 0);
+
+    explorir_command(msg, msg_size, explorir_handler); // transmit message and process the response
     
     return explorir_handler->err_code;
 }
@@ -457,10 +739,7 @@ explorir_retcode_t explorir_disable_auto_zeroing(explorir_handler_t * explorir_h
 */
 explorir_retcode_t explorir_start_auto_zero(explorir_handler_t * explorir_handler) {
     unsigned char msg[] = "65222\r\n";
-    explorir_handler->explorir_tx(msg, 7); // transmit message
-    
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
+    explorir_command(msg, 7, explorir_handler); // transmit message and process the response
     
     return explorir_handler->err_code;
 }
@@ -468,16 +747,13 @@ explorir_retcode_t explorir_start_auto_zero(explorir_handler_t * explorir_handle
 /*
     @brief Function to determine auto zero configuration
 
-    @note Response: "@ #.# #.#\r\n"
+    @note Response: "@ #.# #.#\r\n", or "@ 0\r\n" when disabled, decoded into auto_zero_initial and auto_zero_regular
 
     @ret ExplorIr return code, either SUCCESS or failure
 */
 explorir_retcode_t explorir_request_auto_zero_config(explorir_handler_t * explorir_handler) {
     unsigned char msg[] = "@\r\n";
-    explorir_handler->explorir_tx(msg, 3); // transmit message
-    
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
+    explorir_command(msg, 3, explorir_handler); // transmit message and process the response
     
     return explorir_handler->err_code;
 }
@@ -493,24 +769,10 @@ explorir_retcode_t explorir_request_auto_zero_config(explorir_handler_t * explor
     @ret ExplorIr return code, either SUCCESS or failure
 */
 explorir_retcode_t explorir_set_pressure_and_concentration_compensation(uint32_t value, explorir_handler_t * explorir_handler) {
-    char buf[8];
-    uint8_t str_size = sprintf(buf, "%d", value);
-
-    // compile message
-    uint8_t msg_size = 4 + str_size;
-    unsigned char msg[msg_size];
-    msg[0] = 'S';
-    msg[1] = ' ';
-    for(uint8_t i = 0; i < str_size; i++) {
-	msg[i+2] = buf[i];
-    }
-    msg[msg_size-2] = '\r';
-    msg[msg_size-1] = '\n';
+    unsigned char msg[EXPLORIR_MAX_COMMAND];
+    uint8_t msg_size = explorir_encode_command(msg, SET_PRESSURE_AND_CONCENTRATION_COMPENSATION, EXPLORIR_ARGS_SINGLE, value, 0);
 
-    explorir_handler->explorir_tx(msg, msg_size); // transmit the message
-    
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
+    explorir_command(msg, msg_size, explorir_handler); // transmit message and process the response
     
     return explorir_handler->err_code;
 }
@@ -524,10 +786,7 @@ explorir_retcode_t explorir_set_pressure_and_concentration_compensation(uint32_t
 */
 explorir_retcode_t explorir_request_pressure_and_concetration_compensation(explorir_handler_t * explorir_handler) {
     unsigned char msg[] = "s\r\n";
-    explorir_handler->explorir_tx(msg, 3); // transmit message
-    
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
+    explorir_command(msg, 3, explorir_handler); // transmit message and process the response
     
     return explorir_handler->err_code;
 }
@@ -544,11 +803,10 @@ explorir_retcode_t explorir_request_pressure_and_concetration_compensation(explo
     @ret ExplorIr return code, either SUCCESS or failure
 */
 explorir_retcode_t explorir_set_output_data_filtered(explorir_handler_t * explorir_handler) {
-    unsigned char msg[] = "M 00004\r\n";
-    explorir_handler->explorir_tx(msg, 9); // transmit message
-    
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
+    unsigned char msg[EXPLORIR_MAX_COMMAND];
+    uint8_t msg_size = explorir_encode_command(msg, SET_TYPE_AND_NUM_OF_DATA_OUTPUTS, EXPLORIR_ARGS_SINGLE, FILTERED_MASK, 0);
+
+    explorir_command(msg, msg_size, explorir_handler); // transmit message and process the response
     
     return explorir_handler->err_code;
 }
@@ -565,11 +823,10 @@ explorir_retcode_t explorir_set_output_data_filtered(explorir_handler_t * explor
     @ret ExplorIr return code, either SUCCESS or failure
 */
 explorir_retcode_t explorir_set_output_data_unfiltered(explorir_handler_t * explorir_handler) {
-    unsigned char msg[] = "M 00002\r\n";
-    explorir_handler->explorir_tx(msg, 9); // transmit message
-    
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
+    unsigned char msg[EXPLORIR_MAX_COMMAND];
+    uint8_t msg_size = explorir_encode_command(msg, SET_TYPE_AND_NUM_OF_DATA_OUTPUTS, EXPLORIR_ARGS_SINGLE, UNFILTERED_MASK, 0);
+
+    explorir_command(msg, msg_size, explorir_handler); // transmit message and process the response
     
     return explorir_handler->err_code;
 }
@@ -586,28 +843,24 @@ explorir_retcode_t explorir_set_output_data_unfiltered(explorir_handler_t * expl
     @ret ExplorIr return code, either SUCCESS or failure
 */
 explorir_retcode_t explorir_set_output_data_all(explorir_handler_t * explorir_handler) {
-    unsigned char msg[] = "M 00006\r\n";
-    explorir_handler->explorir_tx(msg, 9); // transmit message
+    unsigned char msg[EXPLORIR_MAX_COMMAND];
+    uint8_t msg_size = explorir_encode_command(msg, SET_TYPE_AND_NUM_OF_DATA_OUTPUTS, EXPLORIR_ARGS_SINGLE, FILTERED_MASK | UNFILTERED_MASK, 0);
 
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
+    explorir_command(msg, msg_size, explorir_handler); // transmit message and process the response
     
     return explorir_handler->err_code;
 }
 
 /*
-    @brief Function to request the number of output data fields
+    @brief Function to request the latest measurement of every output data field
     
-    @note Response: " Q #####\r\n"
+    @note Response: the fields set with 'M', e.g. " Z ##### z #####\\r\\n", decoded like a streamed line
 
     @ret ExplorIr return code, either SUCCESS or failure
 */
 explorir_retcode_t explorir_request_output_data_fields(explorir_handler_t * explorir_handler) {
     unsigned char msg[] = "Q\r\n";
-    explorir_handler->explorir_tx(msg, 3); // transmit message
-    
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
+    explorir_command(msg, 3, explorir_handler); // transmit message and process the response
     
     return explorir_handler->err_code;
 }
@@ -618,15 +871,17 @@ explorir_retcode_t explorir_request_output_data_fields(explorir_handler_t * expl
     @note This command returns two lines split by a carriage return line feed and terminated by a carriage
 	    return line feed. This command requires that the sensor has been stopped (see ‘K’ command)
 
+    @note Response: "Y,Jan 30 2013,10:45:03,AL17\r\n B 00233 00000\r\n", decoded into info
+
     @ret ExplorIr return code, either SUCCESS or failure
 */
 explorir_retcode_t explorir_request_sensor_info(explorir_handler_t * explorir_handler) {
     unsigned char msg[] = "Y\r\n";
-    explorir_handler->explorir_tx(msg, 3); // transmit message
-
-    // wait for firmware version
-    //explorir_wait_for_response(explorir_handler);
-    explorir_process_response(explorir_handler);
+    explorir_command(msg, 3, explorir_handler); // transmit message and process the firmware version
+#if EXPLORIR_FEATURE_ASYNC
+    if(explorir_handler->explorir_submit)
+	return explorir_handler->err_code; // the queue waits for both lines
+#endif
 
     // wait for serial number
     //explorir_wait_for_response(explorir_handler);
@@ -636,121 +891,456 @@ explorir_retcode_t explorir_request_sensor_info(explorir_handler_t * explorir_ha
 }
 
 /*
-    @brief Function for processing the response from the ExplorIr sensor
+    @brief Function to find a sensor of a fleet by its serial number, e.g. to look up metadata cached across restarts
 
-    @note The ExplorIr sensor responds in ASCII encoded messages
+    @param[in] handlers Handlers of the fleet, their info read with explorir_request_sensor_info()
 
-    @note Updates the current_x variables and err_code
+    @param[in] count Number of handlers
+
+    @ret Handler whose info.serial_number matches, NULL if none does
 */
-void explorir_process_response(explorir_handler_t * explorir_handler) {
+explorir_handler_t * explorir_find_by_serial_number(explorir_handler_t * const * handlers, uint16_t count, uint64_t serial_number) {
+    for(uint16_t k = 0; k < count; k++) {
+	if(handlers[k]->info.serial_number == serial_number)
+	    return handlers[k];
+    }
+    return NULL;
+}
+
+/*
+    @brief Function to read the numeric value of a response field, bounded by the end of the response
+
+    @param[in,out] i Index of the field identifier on entry, index of the first byte after the value on return
+
+    @param[out] value Decoded value, leading zeros are accepted
+
+    @ret true if the identifier was followed by a space and 1 - 5 digits, false for a longer number
+*/
+static bool explorir_parse_field(const uint8_t * data, uint16_t size, uint16_t * i, uint32_t * value) {
+    uint16_t j = *i + 1; // skip field identifier
+    if(j >= size || data[j] != SPACE)
+	return false;
+    while(j < size && data[j] == SPACE) {
+	j++;
+    }
+    uint32_t result = 0;
+    uint8_t digits = 0;
+    while(j < size && digits < 5 && data[j] >= '0' && data[j] <= '9') {
+	result = result * 10 + (data[j] - '0');
+	digits++;
+	j++;
+    }
+    *i = j;
+    if(digits == 0)
+	return false;
+    if(j < size && data[j] >= '0' && data[j] <= '9')
+	return false; // a sixth digit, the value doesn't fit the field
+    *value = result;
+    return true;
+}
+
+/*
+    @brief Function to read an interval in days with an optional tenth, " #.#", bounded by the end of the response
+
+    @param[in,out] i Index of the space in front of the value on entry, index of the first byte after it on return
+
+    @param[out] tenths Decoded interval in tenths of days
+
+    @ret true if the space was followed by 1 - 3 digits and, after a decimal point, one more
+*/
+static bool explorir_parse_tenths(const uint8_t * data, uint16_t size, uint16_t * i, uint16_t * tenths) {
+    uint16_t j = *i;
+    if(j >= size || data[j] != SPACE)
+	return false;
+    while(j < size && data[j] == SPACE) {
+	j++;
+    }
+    uint16_t days = 0;
+    uint8_t digits = 0;
+    while(j < size && digits < 3 && data[j] >= '0' && data[j] <= '9') {
+	days = days * 10 + (data[j] - '0');
+	digits++;
+	j++;
+    }
+    if(digits == 0)
+	return false;
+    uint16_t tenth = 0;
+    if(j < size && data[j] == SCALING_FACTOR) { // decimal point
+	j++;
+	if(j >= size || data[j] < '0' || data[j] > '9')
+	    return false;
+	tenth = data[j++] - '0';
+    }
+    *i = j;
+    *tenths = days * 10 + tenth;
+    return true;
+}
+
+// @brief Function to read 1 - max_digits digits after any spaces, __DATE__ pads single digit days with one
+static bool explorir_parse_number(const uint8_t * data, uint16_t size, uint16_t * i, uint8_t max_digits, uint32_t * value) {
+    uint16_t j = *i;
+    while(j < size && data[j] == SPACE) {
+	j++;
+    }
+    uint32_t result = 0;
+    uint8_t digits = 0;
+    while(j < size && digits < max_digits && data[j] >= '0' && data[j] <= '9') {
+	result = result * 10 + (data[j] - '0');
+	digits++;
+	j++;
+    }
+    *i = j;
+    *value = result;
+    return digits > 0;
+}
+
+// @brief Function to step over an expected separator
+static bool explorir_parse_separator(const uint8_t * data, uint16_t size, uint16_t * i, uint8_t separator) {
+    if(*i >= size || data[*i] != separator)
+	return false;
+    (*i)++;
+    return true;
+}
+
+/*
+    @brief Function to read the firmware line of the 'Y' reply, "Y,Jan 30 2013,10:45:03,AL17"
+
+    @param[in] i Index of the 'Y'
+
+    @param[out] info Firmware fields, only written if the whole line is valid, the serial number is left alone
+
+    @ret true if the line has the build date, build time and version
+*/
+static bool explorir_parse_firmware(const uint8_t * data, uint16_t size, uint16_t i, explorir_info_t * info) {
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    // day, year, hour, minute and second, each with the separator in front of it, packed into YYYYMMDD and HHMMSS
+    static const struct {
+	uint16_t max;
+	uint16_t scale;
+	uint8_t separator;
+	uint8_t digits;
+	uint8_t time;
+    } fields[] = {
+	{31, 1, SPACE, 2, 0}, {9999, 10000, SPACE, 4, 0}, {23, 10000, ',', 2, 1}, {59, 100, ':', 2, 1}, {59, 1, ':', 2, 1}
+    };
+    uint32_t stamp[2] = {0, 0};
+    uint32_t value;
+
+    i++;
+    if(!explorir_parse_separator(data, size, &i, ',') || i + 3 > size)
+	return false;
+    for(uint8_t m = 0; m < 12; m++) {
+	if(memcmp(&data[i], &months[m * 3], 3) == 0)
+	    stamp[0] = (m + 1) * 100;
+    }
+    if(stamp[0] == 0)
+	return false;
+    i += 3;
+    for(uint8_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) {
+	// the number skips spaces by itself
+	if(fields[f].separator != SPACE && !explorir_parse_separator(data, size, &i, fields[f].separator))
+	    return false;
+	if(!explorir_parse_number(data, size, &i, fields[f].digits, &value) || value > fields[f].max)
+	    return false;
+	stamp[fields[f].time] += value * fields[f].scale;
+    }
+    if(!explorir_parse_separator(data, size, &i, ','))
+	return false;
+
+    // the version runs to the end of the line
+    uint16_t start = i;
+    while(i < size && data[i] > SPACE && data[i] < 0x7F) {
+	i++;
+    }
+    uint16_t length = i - start;
+    if(length == 0)
+	return false;
+    if(length > EXPLORIR_FIRMWARE_VERSION_SIZE - 1)
+	length = EXPLORIR_FIRMWARE_VERSION_SIZE - 1;
+    memcpy(info->firmware_version, &data[start], length);
+    memset(&info->firmware_version[length], 0, EXPLORIR_FIRMWARE_VERSION_SIZE - length);
+    info->firmware_date = stamp[0];
+    info->firmware_time = stamp[1];
+    return true;
+}
+
+/*
+    @brief Function to decode a measurement line of a known layout at fixed offsets, e.g. " Z ##### z #####"
+
+    @param[in] mask Fields of the layout, FILTERED_MASK and/or UNFILTERED_MASK
+
+    @ret true if the line matched the layout, otherwise it is left to the general parser, which also reports values
+	    above MAX_TWO_BYTE_VALUE as malformed
+*/
+static bool explorir_parse_measurement(const uint8_t * data, uint16_t size, uint8_t mask, explorir_sample_t * sample) {
+    uint8_t count = ((mask & FILTERED_MASK) != 0) + ((mask & UNFILTERED_MASK) != 0);
+    uint16_t end = count * EXPLORIR_MEASUREMENT_FIELD_SIZE;
+    if(count == 0 || size < end)
+	return false;
+    // the line has to end after the last field, the general parser would look at anything that follows
+    if(size > end && data[end] == '\r')
+	end++;
+    if(size > end && data[end] != TERMINATE)
+	return false;
+
+    uint32_t values[2];
+    uint8_t identifier = (mask & FILTERED_MASK) ? FILTERED_CO2_MEASUREMENT : UNFILTERED_CO2_MEASUREMENT;
+    for(uint8_t f = 0; f < count; f++, identifier = UNFILTERED_CO2_MEASUREMENT) {
+	const uint8_t * field = &data[f * EXPLORIR_MEASUREMENT_FIELD_SIZE];
+	if(field[0] != SPACE || field[1] != identifier || field[2] != SPACE)
+	    return false;
+	uint32_t value = 0;
+	for(uint8_t d = 3; d < EXPLORIR_MEASUREMENT_FIELD_SIZE; d++) {
+	    uint8_t digit = field[d] - '0';
+	    if(digit > 9)
+		return false;
+	    value = value * 10 + digit;
+	}
+	if(value > MAX_TWO_BYTE_VALUE)
+	    return false; // doesn't fit the sample
+	values[f] = value;
+    }
+
+    if(mask & FILTERED_MASK)
+	sample->filtered = values[0];
+    if(mask & UNFILTERED_MASK)
+	sample->unfiltered = values[count - 1];
+    sample->field_mask = mask;
+    return true;
+}
+
+// @brief how the parser decodes what follows a response identifier
+typedef enum {
+    EXPLORIR_DECODE_SKIP = 0, // not an identifier, e.g. a space or a stray byte
+    EXPLORIR_DECODE_VALUE, // "A #####", stored in a handler field, ends the line
+    EXPLORIR_DECODE_MEASUREMENT, // "Z #####", stored in the sample, more fields may follow
+    EXPLORIR_DECODE_OUTPUT_MASK, // "M #####"
+    EXPLORIR_DECODE_REGISTER, // "p # #"
+    EXPLORIR_DECODE_AUTO_ZERO, // "@ #.# #.#" or "@ 0"
+    EXPLORIR_DECODE_FIRMWARE, // "Y,Jan 30 2013,10:45:03,AL17"
+    EXPLORIR_DECODE_SERIAL_NUMBER, // "B ##### #####"
+    EXPLORIR_DECODE_UNRECOGNIZED // "?"
+} explorir_decode_t;
+
+// @brief decoding of one response identifier
+typedef struct {
+    uint16_t offset; // of the handler field a VALUE, or the sample field a MEASUREMENT, is stored in
+    uint8_t decode; // explorir_decode_t
+    uint8_t size; // bytes of that field
+    uint8_t mask; // FILTERED_MASK or UNFILTERED_MASK of a MEASUREMENT
+    uint16_t max; // largest valid value of a VALUE or MEASUREMENT, a larger one makes the line malformed
+} explorir_opcode_t;
+
+// @brief opcodes, an identifier maps to one through explorir_opcode_index
+enum {
+    EXPLORIR_OP_SKIP = 0,
+    EXPLORIR_OP_SCALING_FACTOR,
+    EXPLORIR_OP_FILTERED,
+    EXPLORIR_OP_UNFILTERED,
+    EXPLORIR_OP_MODE,
+    EXPLORIR_OP_DIGITAL_FILTER,
+    EXPLORIR_OP_ZERO_POINT,
+    EXPLORIR_OP_COMPENSATION,
+    EXPLORIR_OP_OUTPUT_MASK,
+    EXPLORIR_OP_REGISTER,
+    EXPLORIR_OP_AUTO_ZERO,
+    EXPLORIR_OP_FIRMWARE,
+    EXPLORIR_OP_SERIAL_NUMBER,
+    EXPLORIR_OP_UNRECOGNIZED,
+    EXPLORIR_OP_COUNT
+};
+
+#define EXPLORIR_HANDLER_FIELD(field) offsetof(explorir_handler_t, field), EXPLORIR_DECODE_VALUE, sizeof(((explorir_handler_t *)0)->field)
+#define EXPLORIR_SAMPLE_FIELD(field, mask) offsetof(explorir_sample_t, field), EXPLORIR_DECODE_MEASUREMENT, sizeof(((explorir_sample_t *)0)->field), mask
+
+static const explorir_opcode_t explorir_opcodes[EXPLORIR_OP_COUNT] = {
+    [EXPLORIR_OP_SKIP] = {0, EXPLORIR_DECODE_SKIP, 0, 0},
+    [EXPLORIR_OP_SCALING_FACTOR] = {EXPLORIR_HANDLER_FIELD(scaling_factor), 0, MAX_TWO_BYTE_VALUE},
+    [EXPLORIR_OP_FILTERED] = {EXPLORIR_SAMPLE_FIELD(filtered, FILTERED_MASK), MAX_TWO_BYTE_VALUE},
+    [EXPLORIR_OP_UNFILTERED] = {EXPLORIR_SAMPLE_FIELD(unfiltered, UNFILTERED_MASK), MAX_TWO_BYTE_VALUE},
+    [EXPLORIR_OP_MODE] = {EXPLORIR_HANDLER_FIELD(current_mode), 0, EXPLORIR_MODE_POLLING},
+    [EXPLORIR_OP_DIGITAL_FILTER] = {EXPLORIR_HANDLER_FIELD(digital_filter), 0, MAX_DIGITAL_FILTER},
+    [EXPLORIR_OP_ZERO_POINT] = {EXPLORIR_HANDLER_FIELD(zero_point), 0, MAX_TWO_BYTE_VALUE},
+    [EXPLORIR_OP_COMPENSATION] = {EXPLORIR_HANDLER_FIELD(pressure_and_concentration_compensation), 0, MAX_TWO_BYTE_VALUE},
+    [EXPLORIR_OP_OUTPUT_MASK] = {0, EXPLORIR_DECODE_OUTPUT_MASK, 0, 0},
+    [EXPLORIR_OP_REGISTER] = {0, EXPLORIR_DECODE_REGISTER, 0, 0},
+    [EXPLORIR_OP_AUTO_ZERO] = {0, EXPLORIR_DECODE_AUTO_ZERO, 0, 0},
+    [EXPLORIR_OP_FIRMWARE] = {0, EXPLORIR_DECODE_FIRMWARE, 0, 0},
+    [EXPLORIR_OP_SERIAL_NUMBER] = {0, EXPLORIR_DECODE_SERIAL_NUMBER, 0, 0},
+    [EXPLORIR_OP_UNRECOGNIZED] = {0, EXPLORIR_DECODE_UNRECOGNIZED, 0, 0},
+};
+
+// opcode of every 7-bit identifier, bytes above 0x7F are skipped
+static const uint8_t explorir_opcode_index[128] = {
+    [SCALING_FACTOR] = EXPLORIR_OP_SCALING_FACTOR,
+    [FILTERED_CO2_MEASUREMENT] = EXPLORIR_OP_FILTERED,
+    [UNFILTERED_CO2_MEASUREMENT] = EXPLORIR_OP_UNFILTERED,
+    [OPERATION_MODE] = EXPLORIR_OP_MODE,
+    [SET_DIGITAL_FILTER] = EXPLORIR_OP_DIGITAL_FILTER,
+    [GET_DIGITAL_FILTER] = EXPLORIR_OP_DIGITAL_FILTER,
+    [FINE_TUNE_ZERO_POINT] = EXPLORIR_OP_ZERO_POINT,
+    [SET_ZERO_POINT_USING_FRESH_AIR] = EXPLORIR_OP_ZERO_POINT,
+    [SET_ZERO_POINT_USING_KNOWN_GAS] = EXPLORIR_OP_ZERO_POINT,
+    [SET_ZERO_POINT_USING_NITROGEN] = EXPLORIR_OP_ZERO_POINT,
+    [MANUALLY_SET_ZERO_POINT] = EXPLORIR_OP_ZERO_POINT,
+    [SET_PRESSURE_AND_CONCENTRATION_COMPENSATION] = EXPLORIR_OP_COMPENSATION,
+    [GET_PRESSURE_AND_CONCENTRATION_COMPENSATION] = EXPLORIR_OP_COMPENSATION,
+    [SET_TYPE_AND_NUM_OF_DATA_OUTPUTS] = EXPLORIR_OP_OUTPUT_MASK,
+    [CO2_BGROUND_CONCENTRATION_REPLY] = EXPLORIR_OP_REGISTER,
+    [AUTO_ZERO] = EXPLORIR_OP_AUTO_ZERO,
+    [SENSOR_INFO] = EXPLORIR_OP_FIRMWARE,
+    [SENSOR_SERIAL_NUMBER] = EXPLORIR_OP_SERIAL_NUMBER,
+    [UNRECOGNIZED_CMD] = EXPLORIR_OP_UNRECOGNIZED,
+};
+
+// @brief Function to store a decoded value, at most the opcode's max, into the field the opcode names
+static void explorir_store(void * base, const explorir_opcode_t * opcode, uint32_t value) {
+    uint8_t * field = (uint8_t *)base + opcode->offset;
+    switch(opcode->size) {
+	case sizeof(uint8_t):
+	    *field = value;
+	    break;
+	case sizeof(uint16_t):
+	    *(uint16_t *)field = value;
+	    break;
+	default:
+	    *(uint32_t *)field = value;
+	    break;
+    }
+}
+
+/*
+    @brief Function for parsing a response from the ExplorIr sensor, never reads past size bytes
+
+    @param[in] data Response bytes, e.g. straight from the UART driver's buffer
+
+    @param[in] size Size, in bytes, of data
+
+    @note Updates the current_x variables and err_code, a malformed line leaves the current_x variables untouched
+
+    @note Calls explorir_on_sample, if set, once per line containing a CO2 measurement
+
+    @ret EXPLORIR_SUCCESS, EXPLORIR_ERR_MALFORMED_RESPONSE, EXPLORIR_ERR_UNRECOGNIZED_COMMAND for a '?' reply,
+	    or the previous err_code if the line held no known field
+*/
+explorir_retcode_t explorir_parse_response(const uint8_t * data, uint16_t size, explorir_handler_t * explorir_handler) {
     uint16_t i = 0;
-    while(explorir_handler->explorir_data[i] != TERMINATE) {
-	switch(explorir_handler->explorir_data[i]) {
-	    case SCALING_FACTOR:
-		uint8_t scaling_factor_data[5] = {0};
-		i += 2; // increment by 2 to move index to start of scaling factor
-		while(explorir_handler->explorir_data[i] == '0') {
-		    i++; // remove leading 0s
-		}
-		memcpy(scaling_factor_data, &explorir_handler->explorir_data[i], sizeof(explorir_handler->explorir_data[i]) * 5);
-		explorir_handler->scaling_factor = atoi(scaling_factor_data);
+    uint32_t value = 0;
+    explorir_sample_t sample = {0};
+#if EXPLORIR_FEATURE_STATS
+    if(explorir_handler->stats && size && data[0])
+	explorir_handler->stats->lines++; // a zeroed buffer is no line
+#endif
+    // streamed lines of the handler's layout skip the per-character dispatch
+    if(explorir_handler->output_mask && explorir_parse_measurement(data, size, explorir_handler->output_mask, &sample))
+	goto EndWhile;
+    while(i < size && data[i] != TERMINATE) {
+	const explorir_opcode_t * opcode = &explorir_opcodes[data[i] < sizeof(explorir_opcode_index) ? explorir_opcode_index[data[i]] : EXPLORIR_OP_SKIP];
+	switch(opcode->decode) {
+	    case EXPLORIR_DECODE_VALUE:
 #ifdef DEBUG_OUTPUT
-		NRF_LOG_INFO("Scaling Factor: %d ", explorir_handler->scaling_factor);
-		NRF_LOG_FLUSH();
+		NRF_LOG_INFO("Field %c: ", data[i]);
 #endif
-		goto EndWhile;
-	    case FILTERED_CO2_MEASUREMENT:
-		uint8_t filtered_co2_data[5] = {0};
-		i += 2;
-		while(explorir_handler->explorir_data[i] == '0') {
-		    i++; // remove leading 0s
-		}
-		memcpy(filtered_co2_data, &explorir_handler->explorir_data[i], sizeof(explorir_handler->explorir_data[i]) * 5);
-		explorir_handler->current_filtered_co2 = atoi(filtered_co2_data) * explorir_handler->scaling_factor;
+		if(!explorir_parse_field(data, size, &i, &value) || value > opcode->max)
+		    goto Malformed;
+		explorir_store(explorir_handler, opcode, value);
 #ifdef DEBUG_OUTPUT
-		NRF_LOG_INFO("Filtered CO2: %d ppm ", explorir_handler->current_filtered_co2);
+		NRF_LOG_INFO("%d ", value);
 		NRF_LOG_FLUSH();
-#endif	
-		i = 9;
+#endif
+		explorir_handler->err_code = EXPLORIR_SUCCESS;
+		goto EndWhile;
+	    case EXPLORIR_DECODE_MEASUREMENT:
+		// measurement lines can hold several fields, keep scanning after the value
+		if(!explorir_parse_field(data, size, &i, &value) || value > opcode->max)
+		    goto Malformed;
+		explorir_store(&sample, opcode, value);
+		sample.field_mask |= opcode->mask;
 		break;
-	    case UNFILTERED_CO2_MEASUREMENT:
-		uint8_t unfiltered_co2_data[5] = {0};
-		i += 2;
-		while(explorir_handler->explorir_data[i] == '0') {
-		    i++; // remove leading 0s
-		}
-		memcpy(unfiltered_co2_data, &explorir_handler->explorir_data[i], sizeof(explorir_handler->explorir_data[i]) * 5);
-		explorir_handler->current_unfiltered_co2 = atoi(unfiltered_co2_data) * explorir_handler->scaling_factor;
+	    case EXPLORIR_DECODE_OUTPUT_MASK:
+		if(!explorir_parse_field(data, size, &i, &value))
+		    goto Malformed;
+		// fields the driver doesn't decode leave the layout to the general parser
+		explorir_handler->output_mask = (value & ~(FILTERED_MASK | UNFILTERED_MASK)) ? 0 : value;
 #ifdef DEBUG_OUTPUT
-		NRF_LOG_INFO("Unfiltered CO2: %d ppm ", explorir_handler->current_unfiltered_co2);
+		NRF_LOG_INFO("Output Fields: %d ", value);
 		NRF_LOG_FLUSH();
-#endif	
+#endif
+		explorir_handler->err_code = EXPLORIR_SUCCESS;
 		goto EndWhile;
-	    case OPERATION_MODE:
-		uint8_t operation_mode_data[5] = {0};
-		i += 2;
-		while(explorir_handler->explorir_data[i] == '0') {
-		    i++; // remove leading 0s
-		}
-		memcpy(operation_mode_data, &explorir_handler->explorir_data[i], sizeof(explorir_handler->explorir_data[i]) * 5);
-		explorir_handler->current_mode = atoi(operation_mode_data);
+	    case EXPLORIR_DECODE_REGISTER:
+		// "p 8 #", the register and the byte written to it
+		if(!explorir_parse_field(data, size, &i, &value))
+		    goto Malformed;
+		if(explorir_handler->reply_register && value != explorir_handler->reply_register)
+		    goto Malformed; // answers a write to another register
+		i--; // the register's last digit stands in for the byte's field identifier
+		if(!explorir_parse_field(data, size, &i, &value) || value > 0xFF)
+		    goto Malformed;
+		explorir_handler->err_code = EXPLORIR_SUCCESS;
+		goto EndWhile;
+	    case EXPLORIR_DECODE_AUTO_ZERO: {
+		// "@ 1.0 8.0", or "@ 0" when disabled, the decimal points are not scaling factor fields
+		uint16_t initial;
+		uint16_t regular = 0;
+		i++;
+		if(!explorir_parse_tenths(data, size, &i, &initial))
+		    goto Malformed;
+		if(initial && !explorir_parse_tenths(data, size, &i, &regular))
+		    goto Malformed;
+		explorir_handler->auto_zero_initial = initial;
+		explorir_handler->auto_zero_regular = regular;
 #ifdef DEBUG_OUTPUT
-		NRF_LOG_INFO("Current Mode: %d ", explorir_handler->current_mode);
+		NRF_LOG_INFO("Auto-Zero Intervals: %d %d tenths of days ", explorir_handler->auto_zero_initial, explorir_handler->auto_zero_regular);
 		NRF_LOG_FLUSH();
-#endif	
+#endif
+		explorir_handler->err_code = EXPLORIR_SUCCESS;
 		goto EndWhile;
-	    case SET_DIGITAL_FILTER:
-	    case GET_DIGITAL_FILTER:
-		uint8_t digital_filter_data[5] = {0};
-		i += 2;
-		while(explorir_handler->explorir_data[i] == '0') {
-		    i++; // remove leading 0s
-		}
-		memcpy(digital_filter_data, &explorir_handler->explorir_data[i], sizeof(explorir_handler->explorir_data[i]) * 5);
-		explorir_handler->digital_filter = atoi(digital_filter_data);
+	    }
+	    case EXPLORIR_DECODE_FIRMWARE:
+		// free text firmware line, its letters are not field identifiers
+		if(!explorir_parse_firmware(data, size, i, &explorir_handler->info))
+		    goto Malformed;
 #ifdef DEBUG_OUTPUT
-		NRF_LOG_INFO("Digital Filter: %d ", explorir_handler->digital_filter);
+		NRF_LOG_INFO("Firmware: %s built %d %d ", explorir_handler->info.firmware_version, explorir_handler->info.firmware_date,
+			explorir_handler->info.firmware_time);
 		NRF_LOG_FLUSH();
-#endif	
+#endif
+		explorir_handler->err_code = EXPLORIR_SUCCESS;
 		goto EndWhile;
-	    case FINE_TUNE_ZERO_POINT:
-	    case SET_ZERO_POINT_USING_FRESH_AIR:
-	    case SET_ZERO_POINT_USING_KNOWN_GAS:
-	    case SET_ZERO_POINT_USING_NITROGEN:
-	    case MANUALLY_SET_ZERO_POINT:
-		uint8_t zero_point_data[5] = {0};
-		i += 2;
-		while(explorir_handler->explorir_data[i] == '0') {
-		    i++; // remove leading 0s
-		}
-		memcpy(zero_point_data, &explorir_handler->explorir_data[i], sizeof(explorir_handler->explorir_data[i]) * 5);
-		explorir_handler->zero_point = atoi(zero_point_data);
+	    case EXPLORIR_DECODE_SERIAL_NUMBER: {
+		// "B 00233 00000", second line of the 'Y' reply
+		uint32_t high;
+		if(!explorir_parse_field(data, size, &i, &high))
+		    goto Malformed;
+		i--; // the first field's last digit stands in for the second's identifier
+		if(!explorir_parse_field(data, size, &i, &value))
+		    goto Malformed;
+		explorir_handler->info.serial_number = (uint64_t)high * 100000 + value;
 #ifdef DEBUG_OUTPUT
-		NRF_LOG_INFO("Zero Point: %d ", explorir_handler->zero_point);
+		NRF_LOG_INFO("Serial Number: %05d %05d ", high, value);
 		NRF_LOG_FLUSH();
-#endif	
+#endif
+		explorir_handler->err_code = EXPLORIR_SUCCESS;
 		goto EndWhile;
-	    case SET_PRESSURE_AND_CONCENTRATION_COMPENSATION:
-	    case GET_PRESSURE_AND_CONCENTRATION_COMPENSATION:
-		uint8_t pcc_data[5] = {0};
-		i += 2;
-		while(explorir_handler->explorir_data[i] == '0') {
-		    i++; // remove leading 0s
-		}
-		memcpy(pcc_data, &explorir_handler->explorir_data[i], sizeof(explorir_handler->explorir_data[i]) * 5);
-		explorir_handler->pressure_and_concentration_compensation = atoi(pcc_data);
+	    }
+	    case EXPLORIR_DECODE_UNRECOGNIZED:
 #ifdef DEBUG_OUTPUT
-		NRF_LOG_INFO("Pressure and Concentration Compensation: %d ", explorir_handler->pressure_and_concentration_compensation);
+		NRF_LOG_INFO("Unrecognized Command");
 		NRF_LOG_FLUSH();
-#endif	
+#endif
+		explorir_handler->err_code = EXPLORIR_ERR_UNRECOGNIZED_COMMAND;
+#if EXPLORIR_FEATURE_STATS
+		if(explorir_handler->stats)
+		    explorir_handler->stats->unrecognized++;
+#endif
 		goto EndWhile;
-	    case SPACE:
-		i++;
-		break;
 	    default:
 #ifdef DEBUG_OUTPUT
-		NRF_LOG_INFO("%c", explorir_handler->explorir_data[i]);
-		NRF_LOG_FLUSH();
+		if(data[i] != SPACE) {
+		    NRF_LOG_INFO("%c", data[i]);
+		    NRF_LOG_FLUSH();
+		}
 #endif
 		i++;
 		break;
@@ -761,7 +1351,86 @@ void explorir_process_response(explorir_handler_t * explorir_handler) {
     NRF_LOG_INFO("");
     NRF_LOG_FLUSH();
 #endif
-    memset(explorir_handler->explorir_data, 0, sizeof(explorir_handler->explorir_data));
+    if(sample.field_mask) {
+	if(sample.field_mask & FILTERED_MASK) {
+	    explorir_handler->current_filtered_co2 = (uint32_t)sample.filtered * explorir_handler->scaling_factor;
+#ifdef DEBUG_OUTPUT
+	    NRF_LOG_INFO("Filtered CO2: %d ppm ", explorir_handler->current_filtered_co2);
+	    NRF_LOG_FLUSH();
+#endif
+	}
+	if(sample.field_mask & UNFILTERED_MASK) {
+	    explorir_handler->current_unfiltered_co2 = (uint32_t)sample.unfiltered * explorir_handler->scaling_factor;
+#ifdef DEBUG_OUTPUT
+	    NRF_LOG_INFO("Unfiltered CO2: %d ppm ", explorir_handler->current_unfiltered_co2);
+	    NRF_LOG_FLUSH();
+#endif
+	}
+	explorir_handler->err_code = EXPLORIR_SUCCESS;
+	explorir_handler->sample_count++;
+	explorir_handler->output_mask = sample.field_mask; // the next line likely has the same layout
+
+#if EXPLORIR_FEATURE_SAMPLE_HOOK
+	// hand the measurement to the sample pipeline
+	if(explorir_handler->explorir_on_sample) {
+	    sample.timestamp_ms = explorir_handler->explorir_get_time_ms ? explorir_handler->explorir_get_time_ms() : 0;
+	    sample.scaling_factor = explorir_handler->scaling_factor;
+	    sample.sensor_id = explorir_handler->sensor_id;
+	    explorir_handler->explorir_on_sample(&sample, explorir_handler->sample_context);
+	}
+#endif
+#if EXPLORIR_FEATURE_FLEET
+	// mirror the latest values into the fleet's arrays, where bulk readers find every sensor's side by side
+	explorir_fleet_t * fleet = explorir_handler->fleet;
+	if(fleet) {
+	    uint16_t slot = explorir_handler->fleet_slot;
+	    if(sample.field_mask & FILTERED_MASK)
+		fleet->filtered_co2[slot] = explorir_handler->current_filtered_co2;
+	    if(sample.field_mask & UNFILTERED_MASK)
+		fleet->unfiltered_co2[slot] = explorir_handler->current_unfiltered_co2;
+	    fleet->timestamps_ms[slot] = explorir_clock(explorir_handler);
+	    fleet->status[slot] = sample.field_mask;
+	}
+#endif
+    }
+    return explorir_handler->err_code;
+
+    Malformed:
+#ifdef DEBUG_OUTPUT
+    NRF_LOG_INFO("Malformed response");
+    NRF_LOG_FLUSH();
+#endif
+    explorir_handler->err_code = EXPLORIR_ERR_MALFORMED_RESPONSE;
+#if EXPLORIR_FEATURE_STATS
+    if(explorir_handler->stats)
+	explorir_handler->stats->parse_errors++;
+#endif
+#if EXPLORIR_FEATURE_FLEET
+    if(explorir_handler->fleet)
+	explorir_handler->fleet->status[explorir_handler->fleet_slot] |= EXPLORIR_FLEET_MALFORMED;
+#endif
+    return explorir_handler->err_code;
+}
+
+/*
+    @brief Function for processing the response from the ExplorIr sensor
+
+    @note The ExplorIr sensor responds in ASCII encoded messages
+
+    @note Updates the current_x variables and err_code
+
+    @note Calls explorir_on_sample, if set, once per line containing a CO2 measurement
+*/
+void explorir_process_response(explorir_handler_t * explorir_handler) {
+    if(explorir_handler->explorir_data == NULL)
+	return;
+    uint16_t size = explorir_handler->explorir_data_len;
+    if(size == 0) {
+	size = explorir_handler->explorir_data_size; // buffer filled without explorir_update_data(), bound by its size
+    }
+    explorir_parse_response(explorir_handler->explorir_data, size, explorir_handler);
+    memset(explorir_handler->explorir_data, 0, size);
+    explorir_handler->explorir_data_len = 0;
 }
 
 /*
@@ -772,9 +1441,24 @@ void explorir_process_response(explorir_handler_t * explorir_handler) {
     @param[in] size Size, in bytes, of the response
 
     @note call this function in your uart_event_handler when a complete response from the sensor has been recognized
+
+    @note Responses longer than explorir_data_size are truncated
+
+    @note Calls explorir_on_traffic, if set, with the response
 */
 void explorir_update_data(uint8_t * p_response, uint8_t size, explorir_handler_t * explorir_handler) {
+#if EXPLORIR_FEATURE_TRAFFIC_HOOK
+    if(explorir_handler->explorir_on_traffic) {
+	explorir_handler->explorir_on_traffic(EXPLORIR_RX, p_response, size, explorir_handler->sensor_id, explorir_handler->traffic_context);
+    }
+#endif
+    if(explorir_handler->explorir_data == NULL)
+	return;
+    if(size > explorir_handler->explorir_data_size) {
+	size = explorir_handler->explorir_data_size;
+    }
     memcpy(explorir_handler->explorir_data, p_response, size);
+    explorir_handler->explorir_data_len = size;
 }
 
 /*
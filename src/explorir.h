@@ -15,6 +15,7 @@
 #define EXPLORIR_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 //#define DEBUG_OUTPUT // comment this line out to turn off printf statements
 #ifdef DEBUG_OUTPUT
@@ -23,12 +24,49 @@
 #include "nrf_log_default_backends.h"
 #endif
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /* 
     Size of the uart receive and transmit buffer in bytes
     Use these to configure your UART protocol
+    UART_RX_BUF_SIZE is also the default size of a handler's receive buffer, see EXPLORIR_HANDLER_DEFINE
 */
+#ifndef UART_TX_BUF_SIZE
 #define UART_TX_BUF_SIZE 128
+#endif
+#ifndef UART_RX_BUF_SIZE
 #define UART_RX_BUF_SIZE 128
+#endif
+
+/*
+    Optional handler features, define to 0 to compile a feature and its handler fields out
+    EXPLORIR_FEATURE_SAMPLE_HOOK: explorir_on_sample and explorir_get_time_ms, needed by the sample pipeline
+    EXPLORIR_FEATURE_TRAFFIC_HOOK: explorir_on_traffic, needed by capture
+    EXPLORIR_FEATURE_RETRY: retry_config and explorir_delay_ms
+    EXPLORIR_FEATURE_ASYNC: explorir_submit, needed by explorir_async.h
+    EXPLORIR_FEATURE_STATS: stats, driver counters, needed by explorir_exporter.h
+    EXPLORIR_FEATURE_FLEET: fleet and fleet_slot, latest values of many sensors side by side, see explorir_fleet.h
+*/
+#ifndef EXPLORIR_FEATURE_SAMPLE_HOOK
+#define EXPLORIR_FEATURE_SAMPLE_HOOK 1
+#endif
+#ifndef EXPLORIR_FEATURE_TRAFFIC_HOOK
+#define EXPLORIR_FEATURE_TRAFFIC_HOOK 1
+#endif
+#ifndef EXPLORIR_FEATURE_RETRY
+#define EXPLORIR_FEATURE_RETRY 1
+#endif
+#ifndef EXPLORIR_FEATURE_ASYNC
+#define EXPLORIR_FEATURE_ASYNC 1
+#endif
+#ifndef EXPLORIR_FEATURE_STATS
+#define EXPLORIR_FEATURE_STATS 1
+#endif
+#ifndef EXPLORIR_FEATURE_FLEET
+#define EXPLORIR_FEATURE_FLEET 1
+#endif
 
 /*
     Set to the largest value that a 32 bit integer can represent, 
@@ -46,6 +84,7 @@
 #define OPERATION_MODE 'K'
 #define SET_TYPE_AND_NUM_OF_DATA_OUTPUTS 'M'
 #define SET_CO2_BGROUND_CONCENTRATION 'P'
+#define CO2_BGROUND_CONCENTRATION_REPLY 'p'
 #define GET_NUM_OF_OUTPUT_DATA_FIELDS 'Q'
 #define SET_PRESSURE_AND_CONCENTRATION_COMPENSATION 'S'
 #define GET_PRESSURE_AND_CONCENTRATION_COMPENSATION 's'
@@ -53,6 +92,7 @@
 #define MANUALLY_SET_ZERO_POINT 'u'
 #define SET_ZERO_POINT_USING_KNOWN_GAS 'X'
 #define SENSOR_INFO 'Y'
+#define SENSOR_SERIAL_NUMBER 'B'
 #define FILTERED_CO2_MEASUREMENT 'Z'
 #define UNFILTERED_CO2_MEASUREMENT 'z'
 #define AUTO_ZERO '@'
@@ -61,6 +101,17 @@
 #define SPACE ' '
 #define UNRECOGNIZED_CMD '?'
 
+// longest command, "X 4294967295\r\n" or "F 65535 65535\r\n" fits
+#define EXPLORIR_MAX_COMMAND 16
+
+// 'P' registers, two-byte words are written MSB first, the LSB register follows the MSB register
+#define AUTO_ZERO_CO2_MSB_REGISTER 8
+#define FRESH_AIR_CO2_MSB_REGISTER 10
+#define MAX_TWO_BYTE_VALUE 65535
+
+// longest auto-zero interval in tenths of days, "@ 999.9 999.9\r\n"
+#define MAX_AUTO_ZERO_INTERVAL 9999
+
 #define MAX_DIGITAL_FILTER 65365
 #define MIN_DIGITAL_FILTER 0
 #define DIGITAL_FILTER_DEFAULT 16
@@ -68,6 +119,9 @@
 #define FILTERED_MASK 4
 #define UNFILTERED_MASK 2
 
+// bytes of one measurement field, " Z #####", the sensor sends the fields of its 'M' mask from the highest bit down
+#define EXPLORIR_MEASUREMENT_FIELD_SIZE 8
+
 // @brief explorir operation modes
 typedef enum {
     EXPLORIR_MODE_COMMAND = 0,// sensor sleep mode, waiting for commands but no measurements taken
@@ -76,6 +130,16 @@ typedef enum {
     EXPLORIR_MODE_DEFAULT = EXPLORIR_MODE_COMMAND // default mode is command
 } explorir_mode_t;
 
+// @brief layout of a command's decimal arguments, see explorir_encode_command()
+typedef enum {
+    EXPLORIR_ARGS_NONE = 0, // "<id>\r\n"
+    EXPLORIR_ARGS_SINGLE, // "<id> <first>\r\n"
+    EXPLORIR_ARGS_DUAL, // "<id> <first> <second>\r\n"
+    EXPLORIR_ARGS_MSB, // "<id> <first> <second / 256>\r\n", register and high byte of a two-byte word
+    EXPLORIR_ARGS_LSB, // "<id> <first> <second % 256>\r\n", register and low byte of a two-byte word
+    EXPLORIR_ARGS_TENTHS // "<id> <first / 10>.<first % 10> <second / 10>.<second % 10>\r\n", e.g. auto-zero intervals
+} explorir_args_t;
+
 // @brief explorir return codes
 typedef enum {
     /*
@@ -92,23 +156,150 @@ typedef enum {
     */
     EXPLORIR_ERR_TIMEOUT,
     EXPLORIR_ERR_UNRECOGNIZED_COMMAND, // unrecognized command
-    EXPLORIR_ERR_INVALID_INPUT, // input invalid or outside of range
+    EXPLORIR_ERR_INVALID_INPUT, // input invalid or outside of range, or a blocking command on a handler without explorir_data
+    EXPLORIR_ERR_MALFORMED_RESPONSE, // response field without a valid value, e.g. corrupted on the line
+    EXPLORIR_ERR_BUSY, // command queue full, see explorir_async.h
     EXPLORIR_SUCCESS // message sent or response received successfully
 } explorir_retcode_t;
 
+// @brief retry policy for a command
+typedef struct {
+    uint8_t max_attempts; // total attempts including the first, 0 or 1 disables retries
+    uint16_t backoff_ms; // wait before the first retry
+    uint8_t backoff_multiplier; // each further retry waits this many times longer, 0 or 1 for a constant wait
+    uint16_t max_backoff_ms; // upper bound of the wait, 0 for no bound
+    bool retry_non_idempotent; // also retry calibration commands (F, G, U, X) and auto-zero start, normally never
+} explorir_retry_policy_t;
+
+// @brief policy override for one command
+typedef struct {
+    uint8_t command; // first byte of the command, e.g. OPERATION_MODE
+    explorir_retry_policy_t policy;
+} explorir_retry_rule_t;
+
+// @brief retry configuration, may be shared by every handler
+typedef struct {
+    explorir_retry_policy_t default_policy;
+    const explorir_retry_rule_t * rules; // optional per command overrides
+    uint8_t rule_count;
+} explorir_retry_config_t;
+
+// @brief direction of UART traffic passed to the traffic callback
+typedef enum {
+    EXPLORIR_RX = 0, // bytes received from the sensor
+    EXPLORIR_TX // bytes transmitted to the sensor
+} explorir_direction_t;
+
+// @brief one decoded measurement line, passed to the sample callback
 typedef struct {
-    uint8_t explorir_data[UART_RX_BUF_SIZE];
-    explorir_retcode_t err_code;
+    uint32_t timestamp_ms; // from explorir_get_time_ms, 0 if not set
+    uint16_t filtered; // raw filtered CO2, multiply by scaling_factor for ppm
+    uint16_t unfiltered; // raw unfiltered CO2, multiply by scaling_factor for ppm
     uint16_t scaling_factor;
+    uint8_t sensor_id;
+    uint8_t field_mask; // FILTERED_MASK and/or UNFILTERED_MASK, fields present in the line
+} explorir_sample_t;
+
+// buckets of the command latency histogram, upper bounds in explorir_stats_latency_bounds_ms
+#define EXPLORIR_STATS_LATENCY_BUCKETS 8
+
+// @brief driver counters of one handler, all wrap
+typedef struct {
+    uint32_t lines; // response lines parsed
+    uint32_t parse_errors; // lines with a malformed field
+    uint32_t unrecognized; // '?' replies
+    uint32_t timeouts; // command attempts without a reply
+    uint32_t commands; // command attempts transmitted, retries included
+    uint32_t latency_count; // replies timed, needs explorir_get_time_ms or the async queue
+    uint32_t latency_sum_ms;
+    uint32_t latency_buckets[EXPLORIR_STATS_LATENCY_BUCKETS]; // replies per latency bucket, not cumulative
+} explorir_stats_t;
+
+extern const uint16_t explorir_stats_latency_bounds_ms[EXPLORIR_STATS_LATENCY_BUCKETS];
+
+// fleet status bits, besides FILTERED_MASK and UNFILTERED_MASK of the last measurement line
+#define EXPLORIR_FLEET_MALFORMED 1 // a response was malformed since the last measurement line
+
+// @brief latest values of many handlers in parallel arrays, one slot per handler, see explorir_fleet.h
+typedef struct {
+    uint32_t * filtered_co2; // ppm
+    uint32_t * unfiltered_co2; // ppm
+    uint32_t * timestamps_ms; // of the last measurement line, from explorir_get_time_ms, 0 without a clock
+    uint8_t * status; // FILTERED_MASK, UNFILTERED_MASK and EXPLORIR_FLEET_* bits, 0 until the first line
+    uint16_t capacity; // elements of each array
+    uint16_t count; // slots handed out
+} explorir_fleet_t;
+
+// longest firmware version kept, with its terminating zero
+#define EXPLORIR_FIRMWARE_VERSION_SIZE 8
+
+// @brief firmware and serial number from the two lines of the 'Y' reply, all 0 until they are seen
+typedef struct {
+    uint64_t serial_number; // "B 00233 00000" is 23300000, both fields side by side
+    uint32_t firmware_date; // build date as YYYYMMDD, "Jan 30 2013" is 20130130
+    uint32_t firmware_time; // build time as HHMMSS, "10:45:03" is 104503
+    char firmware_version[EXPLORIR_FIRMWARE_VERSION_SIZE]; // e.g. "AL17", zero terminated, longer versions are cut
+} explorir_info_t;
+
+// @brief handler of one sensor, fields ordered by size so no padding is wasted
+typedef struct {
+    uint8_t * explorir_data; // receive buffer filled by explorir_update_data(), see EXPLORIR_HANDLER_DEFINE
+    void(*explorir_tx)(unsigned char *tx, uint8_t size); // must be initialized
+#if EXPLORIR_FEATURE_SAMPLE_HOOK
+    uint32_t(*explorir_get_time_ms)(void); // optional, millisecond clock used to timestamp samples
+    void(*explorir_on_sample)(const explorir_sample_t *sample, void *context); // optional, called for every measurement line
+    void *sample_context; // passed to explorir_on_sample
+#endif
+#if EXPLORIR_FEATURE_TRAFFIC_HOOK
+    void(*explorir_on_traffic)(explorir_direction_t direction, const uint8_t *data, uint8_t size, uint8_t sensor_id, void *context); // optional, sees every command and response, e.g. for capture
+    void *traffic_context; // passed to explorir_on_traffic
+#endif
+#if EXPLORIR_FEATURE_RETRY
+    const explorir_retry_config_t *retry_config; // optional, retries commands answered with '?', timeouts or malformed responses
+    void(*explorir_delay_ms)(uint32_t ms); // optional, used for retry backoff
+#endif
+#if EXPLORIR_FEATURE_ASYNC
+    explorir_retcode_t(*explorir_submit)(const unsigned char *msg, uint8_t size, void *context); // optional, queues commands instead of blocking, see explorir_async.h
+    void *submit_context; // passed to explorir_submit
+#endif
+#if EXPLORIR_FEATURE_STATS
+    explorir_stats_t *stats; // optional, counts lines, errors, timeouts and command latencies
+#endif
+    explorir_info_t info; // firmware and serial number, see explorir_request_sensor_info()
+#if EXPLORIR_FEATURE_FLEET
+    explorir_fleet_t *fleet; // optional, the parser mirrors the latest values into slot fleet_slot, after info so info stays 8 byte aligned on 32-bit targets
+#endif
     uint32_t current_filtered_co2;
     uint32_t current_unfiltered_co2;
-    uint32_t digital_filter;
     uint32_t zero_point;
-    uint32_t pressure_and_concentration_compensation;
-    explorir_mode_t current_mode;
-    void(*explorir_tx)(unsigned char *tx, uint8_t size); // must be initialized
+    uint32_t sample_count; // measurement lines decoded, wraps
+    uint16_t scaling_factor;
+    uint16_t digital_filter;
+    uint16_t pressure_and_concentration_compensation;
+    uint16_t auto_zero_initial; // tenths of days, 0 when auto-zeroing is disabled or the '@' reply wasn't seen yet
+    uint16_t auto_zero_regular; // tenths of days
+#if EXPLORIR_FEATURE_FLEET
+    uint16_t fleet_slot; // index into the fleet's arrays, see explorir_fleet_add()
+#endif
+    uint16_t explorir_data_size; // size, in bytes, of explorir_data, buffers of 256 bytes and more don't wrap
+    uint8_t explorir_data_len; // bytes of explorir_data written by explorir_update_data()
+    uint8_t err_code; // explorir_retcode_t of the last command
+    uint8_t current_mode; // explorir_mode_t
+    uint8_t sensor_id; // optional, user assigned id copied into each sample
+    uint8_t output_mask; // measurement fields the sensor sends, from the 'M' reply or the last measurement line, 0 if unknown
+    uint8_t reply_register; // register of the last 'P' command transmitted, its "p # #" reply must mirror it, 0 for other commands
 } explorir_handler_t;
 
+/*
+    Defines a handler together with its receive buffer
+    rx_size is the longest response kept, 32 bytes hold every response of the sensor
+
+    EXPLORIR_HANDLER_DEFINE(explorir, UART_RX_BUF_SIZE);
+*/
+#define EXPLORIR_HANDLER_DEFINE(name, rx_size) \
+    static uint8_t name##_explorir_data[rx_size]; \
+    explorir_handler_t name = {.explorir_data = name##_explorir_data, .explorir_data_size = (rx_size)}
+
 /*******************************[ High-Level Sensor Functions For General Use ]****************************************/
 
 /*
@@ -132,7 +323,7 @@ explorir_retcode_t explorir_request_filtered_co2(explorir_handler_t * explorir_h
 
 /*
     @Function to get integer value of most recent filtered co2 measurement
-    
+
     @ret 32-bit integer value
 */
 uint32_t explorir_get_filtered_co2(explorir_handler_t * explorir_handler);
@@ -151,14 +342,14 @@ explorir_retcode_t explorir_request_unfiltered_co2(explorir_handler_t * explorir
 
 /*
     @Function to get integer value of most recent unfiltered co2 measurement
-    
+
     @ret 32-bit integer value
 */
 uint32_t explorir_get_unfiltered_co2(explorir_handler_t * explorir_handler);
 
 /*
     @brief Function to request the scaling factor
-    
+
     @note Required to convert raw CO2 measurement to ppm
 
     @note Response: ". #####\r\n"
@@ -207,6 +398,8 @@ explorir_retcode_t explorir_request_digital_filter(explorir_handler_t * explorir
 
     @param[in] actual Actual gas concentration
 
+    @note Both values range 0 - 65535, scaled like the readings
+
     @note Response: "F #####\r\n"
 
     @ret ExplorIr return code, either SUCCESS or failure
@@ -268,7 +461,9 @@ explorir_retcode_t explorir_set_zero_point_using_known_co2(uint32_t co2_concentr
 	    MSB = Integer (Concentration/256)
 	    LSB = Concentration – (256*MSB)
 
-    @param[in] co2_concentration CO2 value to set
+    @param[in] co2_concentration CO2 value to set, 0 - 65535
+
+    @note Sends "P 8 #" then "P 9 #", stops at the first one that fails
 
     @note Response: "p 8 #\r\n"
 		    "p 9 ##\r\n"
@@ -287,7 +482,9 @@ explorir_retcode_t explorir_set_co2_for_auto_zeroing(uint32_t co2_concentration,
 	    MSB = Integer (Concentration/256)
 	    LSB = Concentration – (256*MSB)
 
-    @param[in] co2_concentration CO2 value to set
+    @param[in] co2_concentration CO2 value to set, 0 - 65535
+
+    @note Sends "P 10 #" then "P 11 #", stops at the first one that fails
 
     @note Response: "p 10 #\r\n"
 		    "p 11 ###\r\n"
@@ -314,6 +511,19 @@ explorir_retcode_t explorir_set_co2_for_zero_point_in_fresh_air(uint32_t co2_con
 */
 explorir_retcode_t explorir_set_auto_zero_intervals(uint8_t initial, uint8_t regular, explorir_handler_t * explorir_handler);
 
+/*
+    @brief Function to set the 'Initial Interval' and 'Regular Interval' for auto-zeroing events to a tenth of a day
+
+    @param[in] initial Initial interval in tenths of days, 0 - MAX_AUTO_ZERO_INTERVAL
+
+    @param[in] regular Regular interval in tenths of days, 0 - MAX_AUTO_ZERO_INTERVAL
+
+    @note Response: "@ #.# #.#\r\n", decoded into auto_zero_initial and auto_zero_regular
+
+    @ret ExplorIr return code, either SUCCESS or failure
+*/
+explorir_retcode_t explorir_set_auto_zero_intervals_tenths(uint16_t initial, uint16_t regular, explorir_handler_t * explorir_handler);
+
 /*
     @brief Function to disable auto-zeroing
 
@@ -333,7 +543,7 @@ explorir_retcode_t explorir_start_auto_zero(explorir_handler_t * explorir_handle
 /*
     @brief Function to determine auto zero configuration
 
-    @note Response: "@ #.# #.#\r\n"
+    @note Response: "@ #.# #.#\r\n", or "@ 0\r\n" when disabled, decoded into auto_zero_initial and auto_zero_regular
 
     @ret ExplorIr return code, either SUCCESS or failure
 */
@@ -400,9 +610,9 @@ explorir_retcode_t explorir_set_output_data_unfiltered(explorir_handler_t * expl
 explorir_retcode_t explorir_set_output_data_all(explorir_handler_t * explorir_handler);
 
 /*
-    @brief Function to request the number of output data fields
-    
-    @note Response: " Q #####\r\n"
+    @brief Function to request the latest measurement of every output data field
+
+    @note Response: the fields set with 'M', e.g. " Z ##### z #####\\r\\n", decoded like a streamed line
 
     @ret ExplorIr return code, either SUCCESS or failure
 */
@@ -414,16 +624,130 @@ explorir_retcode_t explorir_request_output_data_fields(explorir_handler_t * expl
     @note This command returns two lines split by a carriage return line feed and terminated by a carriage
 	    return line feed. This command requires that the sensor has been stopped (see ‘K’ command)
 
+    @note Response: "Y,Jan 30 2013,10:45:03,AL17\r\n B 00233 00000\r\n", decoded into info
+
     @ret ExplorIr return code, either SUCCESS or failure
 */
 explorir_retcode_t explorir_request_sensor_info(explorir_handler_t * explorir_handler);
 
+/*
+    @brief Function to find a sensor of a fleet by its serial number, e.g. to look up metadata cached across restarts
+
+    @param[in] handlers Handlers of the fleet, their info read with explorir_request_sensor_info()
+
+    @param[in] count Number of handlers
+
+    @ret Handler whose info.serial_number matches, NULL if none does
+*/
+explorir_handler_t * explorir_find_by_serial_number(explorir_handler_t * const * handlers, uint16_t count, uint64_t serial_number);
+
+/*
+    @brief Function to count a command reply in the latency histogram
+
+    @param[in] latency_ms Time from transmitting the command to parsing its reply
+*/
+void explorir_stats_add_latency(explorir_stats_t * stats, uint32_t latency_ms);
+
+/*
+    @brief Function to compile a command with decimal arguments, e.g. "A 16\r\n", "F 400 415\r\n" or "P 8 1\r\n"
+
+    @param[out] msg Command buffer, at least EXPLORIR_MAX_COMMAND bytes
+
+    @param[in] args Layout of the arguments, first and second are ignored where the layout has no use for them
+
+    @param[in] first Single argument, first of two, or the register of a split two-byte word
+
+    @param[in] second Second argument, or the two-byte word to split
+
+    @note Never allocates, the arguments of the dual and split layouts must not exceed 65535 and those of the tenths
+	    layout 9999 to fit EXPLORIR_MAX_COMMAND
+
+    @ret Size, in bytes, of the command, including the trailing "\r\n", or 0 without writing msg if an argument
+	    exceeds its limit
+*/
+uint8_t explorir_encode_command(unsigned char * msg, unsigned char identifier, explorir_args_t args, uint32_t first, uint32_t second);
+
+/*
+    @brief Function to get the identifier the reply to a command starts with
+
+    @param[in] cmd Command bytes as transmitted
+
+    @ret Reply identifier, or 0 if the reply has no fixed identifier (starting an auto-zero)
+*/
+uint8_t explorir_reply_identifier(const unsigned char * cmd);
+
+/*
+    @brief Function to get the register a 'P' command writes, its reply "p # #" mirrors it
+
+    @param[in] cmd Command bytes as transmitted
+
+    @ret Register, or 0 if the command is not a 'P' command
+*/
+uint8_t explorir_reply_register(const unsigned char * cmd);
+
+/*
+    @brief Function to check whether a command can be repeated without changing the outcome
+
+    @param[in] cmd Command bytes as transmitted
+
+    @ret false for commands that calibrate against the current gas (F, G, U, X) and for starting an auto-zero
+*/
+bool explorir_command_is_idempotent(const unsigned char * cmd);
+
+/*
+    @brief Function to decide whether a failed command should be sent again
+
+    @param[in] config Retry configuration, NULL disables retries
+
+    @param[in] cmd Command bytes as transmitted
+
+    @param[in] attempt Number of attempts made so far, starting at 1
+
+    @param[in] result Result of the last attempt
+
+    @param[out] delay_ms Time to wait before the next attempt
+
+    @note Only '?', timeout and malformed responses are retried, and commands that are not idempotent only
+	    when their policy sets retry_non_idempotent
+*/
+bool explorir_retry_should_retry(const explorir_retry_config_t * config, const unsigned char * cmd, uint8_t attempt,
+	explorir_retcode_t result, uint32_t * delay_ms);
+
+/*
+    @brief Function to transmit a command to the sensor, every command goes through here
+
+    @param[in] msg Command bytes, including the trailing "\r\n"
+
+    @param[in] size Size, in bytes, of the command
+
+    @note Calls explorir_on_traffic, if set, with the command
+*/
+void explorir_transmit(const unsigned char * msg, uint8_t size, explorir_handler_t * explorir_handler);
+
+/*
+    @brief Function for parsing a response from the ExplorIr sensor, never reads past size bytes
+
+    @param[in] data Response bytes, e.g. straight from the UART driver's buffer
+
+    @param[in] size Size, in bytes, of data
+
+    @note Updates the current_x variables and err_code, a malformed line leaves the current_x variables untouched
+
+    @note Calls explorir_on_sample, if set, once per line containing a CO2 measurement
+
+    @ret EXPLORIR_SUCCESS, EXPLORIR_ERR_MALFORMED_RESPONSE, EXPLORIR_ERR_UNRECOGNIZED_COMMAND for a '?' reply,
+	    or the previous err_code if the line held no known field
+*/
+explorir_retcode_t explorir_parse_response(const uint8_t * data, uint16_t size, explorir_handler_t * explorir_handler);
+
 /*
     @brief Function for processing the response from the ExplorIr sensor
 
     @note The ExplorIr sensor responds in ASCII encoded messages
 
     @note Updates the current_x variables and err_code
+
+    @note Calls explorir_on_sample, if set, once per line containing a CO2 measurement
 */
 void explorir_process_response(explorir_handler_t * explorir_handler);
 
@@ -435,6 +759,10 @@ void explorir_process_response(explorir_handler_t * explorir_handler);
     @param[in] size Size, in bytes, of the response
 
     @note call this function in your uart_event_handler when a complete response from the sensor has been recognized
+
+    @note Responses longer than explorir_data_size are truncated
+
+    @note Calls explorir_on_traffic, if set, with the response
 */
 void explorir_update_data(uint8_t * p_response, uint8_t size, explorir_handler_t * explorir_handler);
 
@@ -443,4 +771,8 @@ void explorir_update_data(uint8_t * p_response, uint8_t size, explorir_handler_t
 */
 void explorir_wait_for_response(explorir_handler_t * explorir_handler);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // EXPLORIR_H
\ No newline at end of file
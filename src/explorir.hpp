@@ -0,0 +1,407 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir.hpp
+
+  @Summary
+    C++17 header-only wrapper for the ExplorIr C driver
+
+  @Description
+    explorir::Sensor<Transport, Clock> owns an explorir_handler_t and talks to
+    the sensor through a transport and clock chosen at compile time, so the
+    TX/RX calls inline instead of going through explorir_tx. Commands return
+    a Result<T> holding either the value from the sensor's reply or the
+    explorir_retcode_t that went wrong, so err_code never has to be read.
+    Replies are still decoded by explorir_parse_response(), and the sample,
+    traffic and retry hooks of the handler keep working.
+
+    Transport policy, an instance owned by the sensor:
+	void write(const uint8_t * data, std::size_t size);
+	std::size_t read_line(uint8_t * buffer, std::size_t capacity); // one line including '\n', 0 on timeout
+
+    Clock policy, static like the std::chrono clocks:
+	static uint32_t now_ms();
+******************************************************************************/
+
+#ifndef EXPLORIR_HPP
+#define EXPLORIR_HPP
+
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include "explorir.h"
+
+namespace explorir {
+
+// @brief error half of a Result, wraps the code so it can't be mistaken for a value
+struct Error {
+    explorir_retcode_t code;
+};
+
+// @brief value from the sensor or the reason there is none
+template <typename T>
+class Result {
+public:
+    Result(T value) : value_(std::move(value)), code_(EXPLORIR_SUCCESS) {}
+    Result(Error error) : code_(error.code) { assert(error.code != EXPLORIR_SUCCESS); }
+
+    bool has_value() const noexcept { return value_.has_value(); }
+    explicit operator bool() const noexcept { return has_value(); }
+    explorir_retcode_t error() const noexcept { return code_; }
+
+    const T & value() const { assert(has_value()); return *value_; }
+    const T & operator*() const { return value(); }
+    const T * operator->() const { return &value(); }
+    T value_or(T fallback) const { return has_value() ? *value_ : fallback; }
+
+private:
+    std::optional<T> value_;
+    explorir_retcode_t code_;
+};
+
+// @brief result of a command that only reports success
+template <>
+class Result<void> {
+public:
+    Result() : code_(EXPLORIR_SUCCESS) {}
+    Result(Error error) : code_(error.code) { assert(error.code != EXPLORIR_SUCCESS); }
+
+    bool has_value() const noexcept { return code_ == EXPLORIR_SUCCESS; }
+    explicit operator bool() const noexcept { return has_value(); }
+    explorir_retcode_t error() const noexcept { return code_; }
+
+private:
+    explorir_retcode_t code_;
+};
+
+// @brief latest CO2 readings of a sensor, a field not in the last line keeps its previous value
+struct Reading {
+    uint32_t timestamp_ms;
+    uint32_t filtered_ppm;
+    uint32_t unfiltered_ppm;
+};
+
+// @brief default clock policy, milliseconds since an arbitrary start, wraps like the C clock hook
+struct SteadyClock {
+    static uint32_t now_ms() {
+	auto now = std::chrono::steady_clock::now().time_since_epoch();
+	return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+    }
+};
+
+// @brief ExplorIr sensor on a compile-time transport and clock
+template <typename Transport, typename Clock = SteadyClock>
+class Sensor {
+public:
+    // most lines skipped while waiting for a command's reply, e.g. measurement lines in streaming mode
+    static constexpr uint8_t max_unrelated_lines = 4;
+
+    template <typename... Args>
+    explicit Sensor(uint8_t sensor_id, Args &&... transport_args) : transport_(std::forward<Args>(transport_args)...) {
+	handler_.sensor_id = sensor_id;
+	handler_.explorir_tx = &Sensor::unused_tx;
+#if EXPLORIR_FEATURE_SAMPLE_HOOK
+	handler_.explorir_get_time_ms = &Clock::now_ms;
+#endif
+    }
+
+    // the passive C modules (aggregate, log, capture, fleet) keep pointers to the handler, so it never moves
+    Sensor(const Sensor &) = delete;
+    Sensor & operator=(const Sensor &) = delete;
+    Sensor(Sensor &&) = delete;
+    Sensor & operator=(Sensor &&) = delete;
+
+    /*
+	@brief handler for the passive C modules and hooks (explorir_on_sample, retry_config, ...)
+
+	@note It has no receive buffer, the C command functions and the modules sending them (watchdog, pressure,
+		autozero) fail on it with EXPLORIR_ERR_INVALID_INPUT, commands go through the sensor
+    */
+    explorir_handler_t & handler() noexcept { return handler_; }
+    const explorir_handler_t & handler() const noexcept { return handler_; }
+
+    Transport & transport() noexcept { return transport_; }
+
+    /*
+	@brief Initialization sequence, same steps as explorir_init()
+
+	@ret First error of the sequence, the remaining steps are skipped
+    */
+    Result<void> init() {
+	if(auto r = set_operation_mode(EXPLORIR_MODE_COMMAND); !r)
+	    return Error{r.error()};
+	if(auto r = request_sensor_info(); !r)
+	    return Error{r.error()};
+	if(auto r = request_scaling_factor(); !r)
+	    return Error{r.error()};
+	if(auto r = set_digital_filter(DIGITAL_FILTER_DEFAULT); !r)
+	    return Error{r.error()};
+	if(auto r = request_pressure_and_concentration_compensation(); !r)
+	    return Error{r.error()};
+	if(auto r = set_output_data(FILTERED_MASK | UNFILTERED_MASK); !r)
+	    return r;
+	if(auto r = set_operation_mode(EXPLORIR_MODE_DEFAULT); !r)
+	    return Error{r.error()};
+	handler_.current_filtered_co2 = 0;
+	handler_.current_unfiltered_co2 = 0;
+	return {};
+    }
+
+    // @brief filtered CO2 in ppm, "Z #####"
+    Result<uint32_t> request_filtered_co2() {
+	return command_value(simple(FILTERED_CO2_MEASUREMENT), FILTERED_CO2_MEASUREMENT, &explorir_handler_t::current_filtered_co2);
+    }
+
+    // @brief unfiltered CO2 in ppm, "z #####"
+    Result<uint32_t> request_unfiltered_co2() {
+	return command_value(simple(UNFILTERED_CO2_MEASUREMENT), UNFILTERED_CO2_MEASUREMENT, &explorir_handler_t::current_unfiltered_co2);
+    }
+
+    // @brief multiplier from raw CO2 to ppm, ". #####"
+    Result<uint16_t> request_scaling_factor() {
+	if(auto r = command(simple(SCALING_FACTOR), SCALING_FACTOR); !r)
+	    return Error{r.error()};
+	if(handler_.scaling_factor == 0)
+	    return Error{EXPLORIR_ERR_MALFORMED_RESPONSE};
+	return handler_.scaling_factor;
+    }
+
+    // @brief "Y", firmware and serial number from both lines of the reply, needs command mode
+    Result<explorir_info_t> request_sensor_info() {
+	if(auto r = command(simple(SENSOR_INFO), SENSOR_INFO, SENSOR_SERIAL_NUMBER); !r)
+	    return Error{r.error()};
+	return handler_.info;
+    }
+
+    // @brief "K #", returns the mode the sensor acknowledged
+    Result<explorir_mode_t> set_operation_mode(explorir_mode_t mode) {
+	if(mode != EXPLORIR_MODE_COMMAND && mode != EXPLORIR_MODE_STREAMING && mode != EXPLORIR_MODE_POLLING)
+	    return Error{EXPLORIR_ERR_INVALID_MODE};
+	if(auto r = command(with_argument(OPERATION_MODE, static_cast<uint32_t>(mode)), OPERATION_MODE); !r)
+	    return Error{r.error()};
+	return static_cast<explorir_mode_t>(handler_.current_mode);
+    }
+
+    // @brief "A #####", returns the filter value the sensor acknowledged
+    Result<uint16_t> set_digital_filter(uint16_t filter) {
+	if(filter > MAX_DIGITAL_FILTER)
+	    return Error{EXPLORIR_ERR_INVALID_INPUT};
+	return narrow<uint16_t>(command_value(with_argument(SET_DIGITAL_FILTER, filter), SET_DIGITAL_FILTER, &explorir_handler_t::digital_filter));
+    }
+
+    // @brief "a #####"
+    Result<uint16_t> request_digital_filter() {
+	return narrow<uint16_t>(command_value(simple(GET_DIGITAL_FILTER), GET_DIGITAL_FILTER, &explorir_handler_t::digital_filter));
+    }
+
+    // @brief "G", returns the new zero point
+    Result<uint32_t> set_zero_point_in_fresh_air() {
+	return command_value(simple(SET_ZERO_POINT_USING_FRESH_AIR), SET_ZERO_POINT_USING_FRESH_AIR, &explorir_handler_t::zero_point);
+    }
+
+    // @brief "U", returns the new zero point
+    Result<uint32_t> set_zero_point_in_nitrogen() {
+	return command_value(simple(SET_ZERO_POINT_USING_NITROGEN), SET_ZERO_POINT_USING_NITROGEN, &explorir_handler_t::zero_point);
+    }
+
+    // @brief "u #####", value scaled by the scaling factor
+    Result<uint32_t> set_zero_point_manually(uint32_t zero_point) {
+	return command_value(with_argument(MANUALLY_SET_ZERO_POINT, zero_point), MANUALLY_SET_ZERO_POINT, &explorir_handler_t::zero_point);
+    }
+
+    // @brief "X #####", value scaled by the scaling factor
+    Result<uint32_t> set_zero_point_using_known_co2(uint32_t co2_concentration) {
+	return command_value(with_argument(SET_ZERO_POINT_USING_KNOWN_GAS, co2_concentration), SET_ZERO_POINT_USING_KNOWN_GAS,
+		&explorir_handler_t::zero_point);
+    }
+
+    // @brief "F ##### #####", both values 0 - 65535 and scaled by the scaling factor
+    Result<uint32_t> set_zero_point_using_known_reading(uint32_t reported, uint32_t actual) {
+	if(reported > MAX_TWO_BYTE_VALUE || actual > MAX_TWO_BYTE_VALUE)
+	    return Error{EXPLORIR_ERR_INVALID_INPUT};
+	return command_value(encode(FINE_TUNE_ZERO_POINT, EXPLORIR_ARGS_DUAL, reported, actual), FINE_TUNE_ZERO_POINT,
+		&explorir_handler_t::zero_point);
+    }
+
+    // @brief "P 8 #" and "P 9 #", value 0 - 65535 and scaled by the scaling factor
+    Result<void> set_co2_for_auto_zeroing(uint32_t co2_concentration) {
+	return set_two_byte_parameter(AUTO_ZERO_CO2_MSB_REGISTER, co2_concentration);
+    }
+
+    // @brief "P 10 #" and "P 11 #", value 0 - 65535 and scaled by the scaling factor
+    Result<void> set_co2_for_zero_point_in_fresh_air(uint32_t co2_concentration) {
+	return set_two_byte_parameter(FRESH_AIR_CO2_MSB_REGISTER, co2_concentration);
+    }
+
+    // @brief "S #####"
+    Result<uint16_t> set_pressure_and_concentration_compensation(uint16_t value) {
+	return narrow<uint16_t>(command_value(with_argument(SET_PRESSURE_AND_CONCENTRATION_COMPENSATION, value),
+		SET_PRESSURE_AND_CONCENTRATION_COMPENSATION, &explorir_handler_t::pressure_and_concentration_compensation));
+    }
+
+    // @brief "s #####"
+    Result<uint16_t> request_pressure_and_concentration_compensation() {
+	return narrow<uint16_t>(command_value(simple(GET_PRESSURE_AND_CONCENTRATION_COMPENSATION), GET_PRESSURE_AND_CONCENTRATION_COMPENSATION,
+		&explorir_handler_t::pressure_and_concentration_compensation));
+    }
+
+    // @brief "M #####", mask of FILTERED_MASK and UNFILTERED_MASK
+    Result<void> set_output_data(uint8_t mask) {
+	if(mask == 0 || (mask & ~(FILTERED_MASK | UNFILTERED_MASK)))
+	    return Error{EXPLORIR_ERR_INVALID_INPUT};
+	return command(with_argument(SET_TYPE_AND_NUM_OF_DATA_OUTPUTS, mask), SET_TYPE_AND_NUM_OF_DATA_OUTPUTS);
+    }
+
+    // @brief "@ 0"
+    Result<void> disable_auto_zeroing() {
+	return command(with_argument(AUTO_ZERO, 0), AUTO_ZERO);
+    }
+
+    /*
+	@brief Reads one line in streaming or polling mode and decodes it into the handler
+
+	@ret The latest readings if the line held a measurement, nothing on timeout or for any other line
+    */
+    std::optional<Reading> poll() {
+	uint32_t count = handler_.sample_count;
+	if(receive() == 0 || handler_.sample_count == count)
+	    return std::nullopt;
+	return Reading{Clock::now_ms(), handler_.current_filtered_co2, handler_.current_unfiltered_co2};
+    }
+
+private:
+    using Message = std::array<uint8_t, EXPLORIR_MAX_COMMAND>;
+    struct Encoded {
+	Message bytes;
+	uint8_t size;
+    };
+
+    static void unused_tx(unsigned char *, uint8_t) {} // never called, explorir_command() fails without explorir_data
+
+    // @brief every command goes through the driver's explorir_encode_command()
+    static Encoded encode(uint8_t identifier, explorir_args_t args, uint32_t first = 0, uint32_t second = 0) {
+	Encoded encoded{};
+	encoded.size = explorir_encode_command(encoded.bytes.data(), identifier, args, first, second);
+	return encoded;
+    }
+
+    static Encoded simple(uint8_t identifier) {
+	return encode(identifier, EXPLORIR_ARGS_NONE);
+    }
+
+    static Encoded with_argument(uint8_t identifier, uint32_t value) {
+	return encode(identifier, EXPLORIR_ARGS_SINGLE, value);
+    }
+
+    // @brief writes a two-byte 'P' parameter, MSB register first
+    Result<void> set_two_byte_parameter(uint8_t msb_register, uint32_t value) {
+	if(value > MAX_TWO_BYTE_VALUE)
+	    return Error{EXPLORIR_ERR_INVALID_INPUT};
+	if(auto r = command(encode(SET_CO2_BGROUND_CONCENTRATION, EXPLORIR_ARGS_MSB, msb_register, value), CO2_BGROUND_CONCENTRATION_REPLY); !r)
+	    return r;
+	return command(encode(SET_CO2_BGROUND_CONCENTRATION, EXPLORIR_ARGS_LSB, msb_register + 1u, value), CO2_BGROUND_CONCENTRATION_REPLY);
+    }
+
+    template <typename T>
+    static Result<T> narrow(const Result<uint32_t> & r) {
+	if(!r)
+	    return Error{r.error()};
+	return static_cast<T>(*r);
+    }
+
+    // @brief reads and decodes one line, returns its size, 0 on timeout
+    std::size_t receive() {
+	std::size_t size = transport_.read_line(line_.data(), line_.size());
+	if(size == 0)
+	    return 0;
+#if EXPLORIR_FEATURE_TRAFFIC_HOOK
+	if(handler_.explorir_on_traffic) {
+	    handler_.explorir_on_traffic(EXPLORIR_RX, line_.data(), static_cast<uint8_t>(size), handler_.sensor_id, handler_.traffic_context);
+	}
+#endif
+	explorir_parse_response(line_.data(), static_cast<uint16_t>(size), &handler_);
+	return size;
+    }
+
+    // @brief first non-space byte of the last received line
+    uint8_t reply_identifier(std::size_t size) const {
+	for(std::size_t i = 0; i < size; i++) {
+	    if(line_[i] != SPACE)
+		return line_[i];
+	}
+	return 0;
+    }
+
+    // @brief one attempt: send, then wait for the line answering it, and for last_reply after it if set
+    explorir_retcode_t attempt(const Encoded & msg, uint8_t reply, uint8_t last_reply) {
+#if EXPLORIR_FEATURE_TRAFFIC_HOOK
+	if(handler_.explorir_on_traffic) {
+	    handler_.explorir_on_traffic(EXPLORIR_TX, msg.bytes.data(), msg.size, handler_.sensor_id, handler_.traffic_context);
+	}
+#endif
+	handler_.reply_register = explorir_reply_register(msg.bytes.data());
+	transport_.write(msg.bytes.data(), msg.size);
+	for(uint8_t line = 0; line <= max_unrelated_lines; ) {
+	    handler_.err_code = EXPLORIR_SUCCESS;
+	    std::size_t size = receive();
+	    if(size == 0)
+		return EXPLORIR_ERR_TIMEOUT;
+	    uint8_t identifier = reply_identifier(size);
+	    if(identifier != UNRECOGNIZED_CMD && identifier != reply) {
+		line++;
+		continue;
+	    }
+	    if(identifier == UNRECOGNIZED_CMD || handler_.err_code != EXPLORIR_SUCCESS || last_reply == 0)
+		return static_cast<explorir_retcode_t>(handler_.err_code);
+	    reply = last_reply; // e.g. the serial number line after 'Y'
+	    last_reply = 0;
+	}
+	return EXPLORIR_ERR_TIMEOUT; // only unrelated lines came back
+    }
+
+    // @brief sends a command, retrying as configured by the handler's retry_config, last_reply for two-line replies
+    Result<void> command(const Encoded & msg, uint8_t reply, uint8_t last_reply = 0) {
+	if(msg.size == 0) {
+	    handler_.err_code = EXPLORIR_ERR_INVALID_INPUT; // the encoder rejected an argument
+	    return Error{EXPLORIR_ERR_INVALID_INPUT};
+	}
+	uint32_t delay_ms = 0;
+	explorir_retcode_t result;
+	for(uint8_t n = 1; ; n++) {
+	    result = attempt(msg, reply, last_reply);
+#if EXPLORIR_FEATURE_RETRY
+	    if(!explorir_retry_should_retry(handler_.retry_config, msg.bytes.data(), n, result, &delay_ms))
+		break;
+	    if(delay_ms && handler_.explorir_delay_ms)
+		handler_.explorir_delay_ms(delay_ms);
+#else
+	    (void)delay_ms;
+	    break;
+#endif
+	}
+	handler_.err_code = result; // keep the C view consistent for code reading the handler
+	if(result != EXPLORIR_SUCCESS)
+	    return Error{result};
+	return {};
+    }
+
+    template <typename Field>
+    Result<uint32_t> command_value(const Encoded & msg, uint8_t reply, Field explorir_handler_t::*field) {
+	if(auto r = command(msg, reply); !r)
+	    return Error{r.error()};
+	return static_cast<uint32_t>(handler_.*field);
+    }
+
+    explorir_handler_t handler_{};
+    Transport transport_;
+    std::array<uint8_t, UART_RX_BUF_SIZE> line_{};
+};
+
+} // namespace explorir
+
+#endif // EXPLORIR_HPP
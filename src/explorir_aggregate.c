@@ -0,0 +1,129 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_aggregate.c
+
+  @Summary
+    Time-series downsampling stage for ExplorIr samples
+
+  @Description
+    Implements per sensor min/max/mean/last aggregation over fixed windows
+******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "explorir_aggregate.h"
+
+/*
+    @brief Function to emit a window, if it holds any samples, and reset it
+*/
+static void explorir_aggregate_close(explorir_aggregate_t * aggregate, explorir_aggregate_window_t * window) {
+    if(window->count > 0 && aggregate->emit) {
+	explorir_aggregate_record_t record;
+	record.window_start_ms = window->window_start_ms;
+	record.window_ms = window->window_ms;
+	record.min = window->min;
+	record.max = window->max;
+	record.mean = (uint32_t)(window->sum / window->count);
+	record.last = window->last;
+	record.count = window->count;
+	record.sensor_id = aggregate->sensor_id;
+	record.field = aggregate->field;
+	aggregate->emit(&record, aggregate->context);
+    }
+    window->count = 0;
+    window->sum = 0;
+}
+
+/*
+    @brief Function to initialize an aggregation stage
+
+    @param[in] windows_ms Window lengths in milliseconds, e.g. EXPLORIR_AGGREGATE_10_SEC
+
+    @param[in] num_windows Number of windows, up to EXPLORIR_AGGREGATE_MAX_WINDOWS
+
+    @param[in] field FILTERED_MASK or UNFILTERED_MASK
+
+    @param[in] emit Callback receiving each completed window
+
+    @param[in] context Passed to emit
+
+    @ret ExplorIr return code, EXPLORIR_ERR_INVALID_INPUT if the configuration is invalid
+*/
+explorir_retcode_t explorir_aggregate_init(explorir_aggregate_t * aggregate, const uint32_t * windows_ms, uint8_t num_windows, uint8_t field,
+	void(*emit)(const explorir_aggregate_record_t *record, void *context), void * context) {
+    if(num_windows == 0 || num_windows > EXPLORIR_AGGREGATE_MAX_WINDOWS)
+	return EXPLORIR_ERR_INVALID_INPUT;
+    if(field != FILTERED_MASK && field != UNFILTERED_MASK)
+	return EXPLORIR_ERR_INVALID_INPUT;
+
+    memset(aggregate, 0, sizeof(*aggregate));
+    for(uint8_t w = 0; w < num_windows; w++) {
+	if(windows_ms[w] == 0)
+	    return EXPLORIR_ERR_INVALID_INPUT;
+	aggregate->windows[w].window_ms = windows_ms[w];
+    }
+    aggregate->num_windows = num_windows;
+    aggregate->field = field;
+    aggregate->emit = emit;
+    aggregate->context = context;
+
+    return EXPLORIR_SUCCESS;
+}
+
+/*
+    @brief Function to add one sample to the aggregation stage
+
+    @note Samples not containing the configured field are ignored. Windows are closed when a sample
+	    arrives past their end, so empty windows are never emitted.
+*/
+void explorir_aggregate_add(explorir_aggregate_t * aggregate, const explorir_sample_t * sample) {
+    if(!(sample->field_mask & aggregate->field))
+	return;
+
+    uint16_t raw = (aggregate->field == FILTERED_MASK) ? sample->filtered : sample->unfiltered;
+    uint32_t ppm = (uint32_t)raw * sample->scaling_factor;
+    uint32_t now = sample->timestamp_ms;
+    aggregate->sensor_id = sample->sensor_id;
+
+    for(uint8_t w = 0; w < aggregate->num_windows; w++) {
+	explorir_aggregate_window_t * window = &aggregate->windows[w];
+	// a sample before the window start means the millisecond clock wrapped
+	if(window->count > 0 && (now < window->window_start_ms || now - window->window_start_ms >= window->window_ms)) {
+	    explorir_aggregate_close(aggregate, window);
+	}
+	if(window->count == 0) {
+	    window->window_start_ms = now - (now % window->window_ms); // align so sensors share window boundaries
+	    window->min = ppm;
+	    window->max = ppm;
+	}
+	if(ppm < window->min)
+	    window->min = ppm;
+	if(ppm > window->max)
+	    window->max = ppm;
+	window->last = ppm;
+	window->sum += ppm;
+	window->count++;
+    }
+}
+
+/*
+    @brief Sample callback adapter, assign to explorir_on_sample with the aggregate as sample_context
+
+    @note explorir_handler.explorir_on_sample = explorir_aggregate_on_sample;
+	    explorir_handler.sample_context = &aggregate;
+*/
+void explorir_aggregate_on_sample(const explorir_sample_t * sample, void * context) {
+    explorir_aggregate_add((explorir_aggregate_t *)context, sample);
+}
+
+/*
+    @brief Function to emit every partially filled window and start over, e.g. before shutdown
+*/
+void explorir_aggregate_flush(explorir_aggregate_t * aggregate) {
+    for(uint8_t w = 0; w < aggregate->num_windows; w++) {
+	explorir_aggregate_close(aggregate, &aggregate->windows[w]);
+    }
+}
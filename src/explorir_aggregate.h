@@ -0,0 +1,112 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_aggregate.h
+
+  @Summary
+    Time-series downsampling stage for ExplorIr samples
+
+  @Description
+    Maintains min/max/mean/last of the CO2 ppm over fixed time windows per
+    sensor, updated in O(1) per sample directly from the parser's sample
+    callback, and emits one compact record per completed window
+******************************************************************************/
+
+#ifndef EXPLORIR_AGGREGATE_H
+#define EXPLORIR_AGGREGATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "explorir.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// maximum number of windows tracked per sensor
+#define EXPLORIR_AGGREGATE_MAX_WINDOWS 4
+
+// common window lengths
+#define EXPLORIR_AGGREGATE_10_SEC 10000
+#define EXPLORIR_AGGREGATE_1_MIN 60000
+#define EXPLORIR_AGGREGATE_15_MIN 900000
+
+// @brief aggregate of one completed window, all values in ppm
+typedef struct {
+    uint32_t window_start_ms; // aligned to a multiple of window_ms
+    uint32_t window_ms;
+    uint32_t min;
+    uint32_t max;
+    uint32_t mean;
+    uint32_t last;
+    uint32_t count; // samples in the window
+    uint8_t sensor_id;
+    uint8_t field; // FILTERED_MASK or UNFILTERED_MASK
+} explorir_aggregate_record_t;
+
+// @brief running state of one window
+typedef struct {
+    uint32_t window_ms;
+    uint32_t window_start_ms;
+    uint32_t min;
+    uint32_t max;
+    uint32_t last;
+    uint64_t sum;
+    uint32_t count;
+} explorir_aggregate_window_t;
+
+// @brief aggregation stage for one sensor
+typedef struct {
+    explorir_aggregate_window_t windows[EXPLORIR_AGGREGATE_MAX_WINDOWS];
+    uint8_t num_windows;
+    uint8_t field; // which CO2 field to aggregate, FILTERED_MASK or UNFILTERED_MASK
+    uint8_t sensor_id;
+    void(*emit)(const explorir_aggregate_record_t *record, void *context); // called when a window completes
+    void *context; // passed to emit
+} explorir_aggregate_t;
+
+/*
+    @brief Function to initialize an aggregation stage
+
+    @param[in] windows_ms Window lengths in milliseconds, e.g. EXPLORIR_AGGREGATE_10_SEC
+
+    @param[in] num_windows Number of windows, up to EXPLORIR_AGGREGATE_MAX_WINDOWS
+
+    @param[in] field FILTERED_MASK or UNFILTERED_MASK
+
+    @param[in] emit Callback receiving each completed window
+
+    @param[in] context Passed to emit
+
+    @ret ExplorIr return code, EXPLORIR_ERR_INVALID_INPUT if the configuration is invalid
+*/
+explorir_retcode_t explorir_aggregate_init(explorir_aggregate_t * aggregate, const uint32_t * windows_ms, uint8_t num_windows, uint8_t field,
+	void(*emit)(const explorir_aggregate_record_t *record, void *context), void * context);
+
+/*
+    @brief Function to add one sample to the aggregation stage
+
+    @note Samples not containing the configured field are ignored. Windows are closed when a sample
+	    arrives past their end, so empty windows are never emitted.
+*/
+void explorir_aggregate_add(explorir_aggregate_t * aggregate, const explorir_sample_t * sample);
+
+/*
+    @brief Sample callback adapter, assign to explorir_on_sample with the aggregate as sample_context
+
+    @note explorir_handler.explorir_on_sample = explorir_aggregate_on_sample;
+	    explorir_handler.sample_context = &aggregate;
+*/
+void explorir_aggregate_on_sample(const explorir_sample_t * sample, void * context);
+
+/*
+    @brief Function to emit every partially filled window and start over, e.g. before shutdown
+*/
+void explorir_aggregate_flush(explorir_aggregate_t * aggregate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXPLORIR_AGGREGATE_H
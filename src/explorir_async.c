@@ -0,0 +1,384 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_async.c
+
+  @Summary
+    Non-blocking command queue for ExplorIr handlers
+
+  @Description
+    Implements the queue, reply matching, timeouts and retries
+******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "explorir_async.h"
+
+// @brief wrap-safe "now_ms >= due_ms"
+static bool explorir_async_due(uint32_t now_ms, uint32_t due_ms) {
+    return (int32_t)(now_ms - due_ms) >= 0;
+}
+
+static explorir_async_request_t * explorir_async_head(explorir_async_t * async) {
+    return &async->requests[async->head];
+}
+
+static void explorir_async_start(explorir_async_t * async);
+
+#if EXPLORIR_FEATURE_STATS
+// @brief counts the reply to the head request, latencies have the resolution of explorir_async_tick()
+static void explorir_async_count_reply(explorir_async_t * async) {
+    explorir_stats_t * stats = async->explorir_handler->stats;
+    if(stats)
+	explorir_stats_add_latency(stats, async->now_ms - explorir_async_head(async)->sent_ms);
+}
+#endif
+
+// @brief removes the head request and reports its result
+static void explorir_async_complete(explorir_async_t * async, explorir_retcode_t result) {
+    explorir_async_request_t * request = explorir_async_head(async);
+    explorir_async_callback_t callback = request->callback;
+    void *context = request->context;
+    async->head = (async->head + 1) % async->capacity;
+    async->count--;
+    async->explorir_handler->err_code = result;
+
+    // the callback may queue the next command, e.g. a resumed coroutine
+    if(callback)
+	callback(result, async->explorir_handler, context);
+    explorir_async_start(async);
+}
+
+// @brief retries the head request as configured by retry_config, or completes it with the error
+static void explorir_async_fail(explorir_async_t * async, explorir_retcode_t result) {
+    explorir_async_request_t * request = explorir_async_head(async);
+    uint32_t delay_ms = 0;
+#if EXPLORIR_FEATURE_RETRY
+    const explorir_retry_config_t * retry_config = async->explorir_handler->retry_config;
+#else
+    const explorir_retry_config_t * retry_config = NULL;
+#endif
+    if(!explorir_retry_should_retry(retry_config, request->msg, request->attempt, result, &delay_ms)) {
+	explorir_async_complete(async, result);
+	return;
+    }
+#ifdef DEBUG_OUTPUT
+    NRF_LOG_INFO("Retrying %c, attempt %d ", request->msg[0], request->attempt + 1);
+    NRF_LOG_FLUSH();
+#endif
+    request->sent = false;
+    request->due_ms = async->now_ms + delay_ms;
+    explorir_async_start(async);
+}
+
+// @brief transmits the head request, or finishes a delay, once it is due
+static void explorir_async_start(explorir_async_t * async) {
+    while(async->count) {
+	explorir_async_request_t * request = explorir_async_head(async);
+	if(request->size == 0) {
+	    // delay, counted from when it reaches the head of the queue
+	    if(!request->sent) {
+		request->sent = true;
+		request->due_ms += async->now_ms;
+	    }
+	    if(!explorir_async_due(async->now_ms, request->due_ms))
+		return;
+	    explorir_async_complete(async, EXPLORIR_SUCCESS); // starts the next request
+	    return;
+	}
+	if(request->sent || !explorir_async_due(async->now_ms, request->due_ms))
+	    return;
+
+	request->reply = explorir_reply_identifier(request->msg);
+	request->lines = request->msg[0] == SENSOR_INFO ? 2 : 1;
+	request->attempt++;
+	request->sent = true;
+	request->due_ms = async->now_ms + async->timeout_ms;
+	request->sent_ms = async->now_ms;
+#if EXPLORIR_FEATURE_STATS
+	if(async->explorir_handler->stats)
+	    async->explorir_handler->stats->commands++;
+#endif
+	if(async->tx) {
+	    explorir_handler_t * explorir_handler = async->explorir_handler;
+	    explorir_handler->reply_register = explorir_reply_register(request->msg); // explorir_transmit() does this otherwise
+#if EXPLORIR_FEATURE_TRAFFIC_HOOK
+	    if(explorir_handler->explorir_on_traffic) {
+		explorir_handler->explorir_on_traffic(EXPLORIR_TX, request->msg, request->size, explorir_handler->sensor_id, explorir_handler->traffic_context);
+	    }
+#endif
+	    async->tx(request->msg, request->size, async->tx_context);
+	} else {
+	    explorir_transmit(request->msg, request->size, async->explorir_handler);
+	}
+	return;
+    }
+}
+
+// @brief queues a request, takes the pending completion callback
+static explorir_retcode_t explorir_async_push(explorir_async_t * async, const unsigned char * msg, uint8_t size, uint32_t due_ms) {
+    explorir_async_callback_t callback = async->next_callback;
+    void *context = async->next_context;
+    async->next_callback = NULL;
+    async->next_context = NULL;
+    if(async->count == async->capacity || size > EXPLORIR_ASYNC_MAX_COMMAND)
+	return EXPLORIR_ERR_BUSY;
+
+    explorir_async_request_t * request = &async->requests[(async->head + async->count) % async->capacity];
+    memset(request, 0, sizeof(*request));
+    if(size)
+	memcpy(request->msg, msg, size);
+    request->size = size;
+    request->due_ms = due_ms;
+    request->callback = callback;
+    request->context = context;
+    async->count++;
+    explorir_async_start(async);
+    return EXPLORIR_SUCCESS;
+}
+
+// @brief explorir_submit hook, receives every command issued on the handler
+static explorir_retcode_t explorir_async_submit(const unsigned char * msg, uint8_t size, void *context) {
+    explorir_async_t * async = context;
+    if(size == 0)
+	return EXPLORIR_ERR_INVALID_INPUT;
+    return explorir_async_push(async, msg, size, async->now_ms);
+}
+
+// @brief completion of the first command of a pair, queues the second or completes the pair with the error
+static void explorir_async_pair_complete(explorir_retcode_t result, explorir_handler_t * explorir_handler, void *context) {
+    explorir_async_t * async = context;
+    explorir_async_request_t * pair = &async->pair;
+    uint8_t size = pair->size;
+    pair->size = 0;
+    if(result == EXPLORIR_SUCCESS) {
+	explorir_async_next(async, pair->callback, pair->context);
+	result = explorir_async_push(async, pair->msg, size, async->now_ms);
+	if(result == EXPLORIR_SUCCESS)
+	    return;
+    }
+    if(pair->callback)
+	pair->callback(result, explorir_handler, pair->context);
+}
+
+/*
+    @brief Function to attach a command queue to a handler, commands issued on the handler no longer block
+
+    @param[in] requests Storage for queued commands
+
+    @param[in] capacity Number of elements in requests
+
+    @param[in] timeout_ms Time allowed for a reply before the command is retried or fails with EXPLORIR_ERR_TIMEOUT
+*/
+void explorir_async_init(explorir_async_t * async, explorir_handler_t * explorir_handler, explorir_async_request_t * requests,
+	uint8_t capacity, uint32_t timeout_ms) {
+    memset(async, 0, sizeof(*async));
+    async->explorir_handler = explorir_handler;
+    async->requests = requests;
+    async->capacity = capacity;
+    async->timeout_ms = timeout_ms;
+#if EXPLORIR_FEATURE_SAMPLE_HOOK
+    if(explorir_handler->explorir_get_time_ms)
+	async->now_ms = explorir_handler->explorir_get_time_ms();
+#endif
+    explorir_handler->explorir_submit = explorir_async_submit;
+    explorir_handler->submit_context = async;
+}
+
+/*
+    @brief Function to detach the queue, the handler's commands block again
+
+    @note Queued commands are completed with EXPLORIR_ERR_TIMEOUT
+*/
+void explorir_async_deinit(explorir_async_t * async) {
+    async->explorir_handler->explorir_submit = NULL;
+    async->explorir_handler->submit_context = NULL;
+    while(async->count) {
+	explorir_async_request_t * request = explorir_async_head(async);
+	explorir_async_callback_t callback = request->callback;
+	void *context = request->context;
+	async->head = (async->head + 1) % async->capacity;
+	async->count--;
+	if(callback)
+	    callback(EXPLORIR_ERR_TIMEOUT, async->explorir_handler, context);
+    }
+}
+
+/*
+    @brief Function to find the queue attached to a handler
+
+    @ret The queue, or NULL if the handler's commands block or go to another explorir_submit hook
+*/
+explorir_async_t * explorir_async_of(const explorir_handler_t * explorir_handler) {
+    return explorir_handler->explorir_submit == explorir_async_submit ? explorir_handler->submit_context : NULL;
+}
+
+/*
+    @brief Function to set the completion callback of the next command issued on the handler
+
+    @note Cleared once a command is queued, a command issued without it completes silently
+*/
+void explorir_async_next(explorir_async_t * async, explorir_async_callback_t callback, void *context) {
+    async->next_callback = callback;
+    async->next_context = context;
+}
+
+/*
+    @brief Function to drop the completion callbacks given a context, e.g. before the context is freed
+
+    @param[in] context Context of the callbacks to drop, not NULL
+
+    @note The commands stay queued and complete silently, their replies are still parsed
+*/
+void explorir_async_forget(explorir_async_t * async, const void *context) {
+    if(context == NULL)
+	return; // callbacks without a context stay
+    for(uint8_t k = 0; k < async->count; k++) {
+	explorir_async_request_t * request = &async->requests[(async->head + k) % async->capacity];
+	if(request->context == context) {
+	    request->callback = NULL;
+	    request->context = NULL;
+	}
+    }
+    if(async->pair.context == context) {
+	async->pair.callback = NULL;
+	async->pair.context = NULL;
+    }
+    if(async->next_context == context)
+	explorir_async_next(async, NULL, NULL);
+}
+
+/*
+    @brief Function to queue two commands that stand or fall together, e.g. the MSB and LSB halves of a 'P' parameter
+
+    @param[in] first Command sent first, the second is only queued once it succeeds
+
+    @param[in] second Command sent after it
+
+    @note The callback set by explorir_async_next() is called once, with the result of the second command or
+	    the error of the first, one pair can be in flight at a time
+
+    @ret EXPLORIR_SUCCESS, EXPLORIR_ERR_INVALID_INPUT for an empty or too long command, or EXPLORIR_ERR_BUSY if the queue
+	    is full or another pair is in flight
+*/
+explorir_retcode_t explorir_async_submit_pair(explorir_async_t * async, const unsigned char * first, uint8_t first_size,
+	const unsigned char * second, uint8_t second_size) {
+    explorir_async_request_t * pair = &async->pair;
+    explorir_retcode_t result = EXPLORIR_SUCCESS;
+    if(first_size == 0 || second_size == 0 || second_size > EXPLORIR_ASYNC_MAX_COMMAND)
+	result = EXPLORIR_ERR_INVALID_INPUT;
+    else if(pair->size)
+	result = EXPLORIR_ERR_BUSY;
+    if(result != EXPLORIR_SUCCESS) {
+	explorir_async_next(async, NULL, NULL);
+	return result;
+    }
+
+    memcpy(pair->msg, second, second_size);
+    pair->size = second_size; // before the first is pushed, it may complete at once
+    pair->callback = async->next_callback;
+    pair->context = async->next_context;
+    explorir_async_next(async, explorir_async_pair_complete, async);
+    result = explorir_async_push(async, first, first_size, async->now_ms);
+    if(result != EXPLORIR_SUCCESS)
+	pair->size = 0;
+    return result;
+}
+
+/*
+    @brief Function to queue a pause, the following commands are held back until it has passed
+
+    @param[in] delay_ms Length of the pause, measured from when the commands ahead of it finish
+
+    @ret EXPLORIR_SUCCESS, or EXPLORIR_ERR_BUSY if the queue is full
+*/
+explorir_retcode_t explorir_async_delay(explorir_async_t * async, uint32_t delay_ms, explorir_async_callback_t callback, void *context) {
+    explorir_async_next(async, callback, context);
+    return explorir_async_push(async, NULL, 0, delay_ms);
+}
+
+/*
+    @brief Function to parse a received line and complete the command it answers
+
+    @param[in] data Line received from the sensor
+
+    @param[in] size Size, in bytes, of data
+
+    @note Measurement lines in streaming mode are parsed as usual and don't complete other commands
+*/
+void explorir_async_process(explorir_async_t * async, const uint8_t * data, uint16_t size) {
+    explorir_handler_t * explorir_handler = async->explorir_handler;
+    explorir_handler->err_code = EXPLORIR_SUCCESS; // a line without a known field is not an error
+    explorir_retcode_t result = explorir_parse_response(data, size, explorir_handler);
+
+    if(async->count == 0)
+	return;
+    explorir_async_request_t * request = explorir_async_head(async);
+    if(request->size == 0 || !request->sent)
+	return;
+
+    uint16_t i = 0;
+    while(i < size && data[i] == SPACE) {
+	i++;
+    }
+    if(i == size)
+	return;
+    uint8_t identifier = data[i];
+
+    if(identifier == UNRECOGNIZED_CMD) {
+#if EXPLORIR_FEATURE_STATS
+	explorir_async_count_reply(async);
+#endif
+	explorir_async_fail(async, EXPLORIR_ERR_UNRECOGNIZED_COMMAND);
+	return;
+    }
+    if(request->reply ? identifier != request->reply : (identifier == FILTERED_CO2_MEASUREMENT || identifier == UNFILTERED_CO2_MEASUREMENT))
+	return; // not the answer, e.g. a streaming measurement line
+#if EXPLORIR_FEATURE_STATS
+    if(result != EXPLORIR_SUCCESS || request->lines == 1)
+	explorir_async_count_reply(async); // the attempt ends here
+#endif
+    if(result != EXPLORIR_SUCCESS) {
+	explorir_async_fail(async, result);
+	return;
+    }
+    if(--request->lines == 0) {
+	explorir_async_complete(async, EXPLORIR_SUCCESS);
+	return;
+    }
+    // multi-line reply, the following lines have their own identifiers
+    request->reply = 0;
+    request->due_ms = async->now_ms + async->timeout_ms;
+}
+
+/*
+    @brief Function to advance time, handles reply timeouts, retry backoff and delays
+
+    @param[in] now_ms Current time in milliseconds, may wrap
+*/
+void explorir_async_tick(explorir_async_t * async, uint32_t now_ms) {
+    async->now_ms = now_ms;
+    if(async->count == 0)
+	return;
+    explorir_async_request_t * request = explorir_async_head(async);
+    if(request->size && request->sent && explorir_async_due(now_ms, request->due_ms)) {
+#if EXPLORIR_FEATURE_STATS
+	if(async->explorir_handler->stats)
+	    async->explorir_handler->stats->timeouts++;
+#endif
+	explorir_async_fail(async, EXPLORIR_ERR_TIMEOUT);
+	return;
+    }
+    explorir_async_start(async);
+}
+
+/*
+    @brief Function to check whether the queue is empty
+
+    @ret true if no command is queued or waiting for its reply
+*/
+bool explorir_async_idle(const explorir_async_t * async) {
+    return async->count == 0;
+}
@@ -0,0 +1,175 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_async.h
+
+  @Summary
+    Non-blocking command queue for ExplorIr handlers
+
+  @Description
+    Lets the explorir_request_* and explorir_set_* functions return at once
+    instead of waiting for the sensor. Once attached, every command issued on
+    the handler is queued, transmitted when the commands ahead of it are
+    answered, and completed through a callback when its reply is parsed or
+    its timeout runs out. Replies, '?' and timeouts are retried following
+    the handler's retry_config, like the blocking commands. Nothing blocks,
+    so one thread can drive many sensors, each with its own queue.
+
+    explorir_async_next(&async, done, context); // completion callback of the next command
+    if(explorir_set_digital_filter(32, &explorir) != EXPLORIR_SUCCESS)
+	; // invalid input or queue full, done will not be called
+
+    In the event loop, pass every received line to explorir_async_process()
+    instead of explorir_parse_response(), and call explorir_async_tick()
+    regularly for timeouts and backoff.
+******************************************************************************/
+
+#ifndef EXPLORIR_ASYNC_H
+#define EXPLORIR_ASYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "explorir.h"
+
+#if !EXPLORIR_FEATURE_ASYNC
+#error "explorir_async.h needs EXPLORIR_FEATURE_ASYNC"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// longest command kept in the queue
+#define EXPLORIR_ASYNC_MAX_COMMAND EXPLORIR_MAX_COMMAND
+
+// @brief called once when a queued command or delay finishes, result is EXPLORIR_SUCCESS or the error of the last attempt
+typedef void(*explorir_async_callback_t)(explorir_retcode_t result, explorir_handler_t *explorir_handler, void *context);
+
+// @brief one queued command
+typedef struct {
+    unsigned char msg[EXPLORIR_ASYNC_MAX_COMMAND];
+    uint8_t size; // 0 for a delay
+    uint8_t reply; // identifier of the reply, 0 for any line that is not a measurement
+    uint8_t lines; // lines still expected, the sensor info reply is two lines
+    uint8_t attempt;
+    bool sent; // transmitted, waiting for the reply
+    uint32_t due_ms; // reply deadline once sent, otherwise earliest time to transmit
+    uint32_t sent_ms; // time of the last transmission, for the latency statistics
+    explorir_async_callback_t callback;
+    void *context;
+} explorir_async_request_t;
+
+// @brief command queue of one handler, requests live in caller-provided storage
+typedef struct {
+    explorir_handler_t * explorir_handler;
+    explorir_async_request_t * requests;
+    uint8_t capacity;
+    uint8_t head;
+    uint8_t count;
+    uint32_t timeout_ms; // time allowed for a reply
+    uint32_t now_ms; // time of the last tick
+    explorir_async_callback_t next_callback; // given to the next queued command
+    void *next_context;
+    explorir_async_request_t pair; // second command of a pair with the pair's callback, queued once the first succeeds, size 0 if none
+    void(*tx)(const unsigned char *msg, uint8_t size, void *context); // optional, used instead of the handler's explorir_tx
+    void *tx_context; // passed to tx, e.g. the port of this handler when many share one thread
+} explorir_async_t;
+
+/*
+    @brief Function to attach a command queue to a handler, commands issued on the handler no longer block
+
+    @param[in] requests Storage for queued commands
+
+    @param[in] capacity Number of elements in requests
+
+    @param[in] timeout_ms Time allowed for a reply before the command is retried or fails with EXPLORIR_ERR_TIMEOUT
+*/
+void explorir_async_init(explorir_async_t * async, explorir_handler_t * explorir_handler, explorir_async_request_t * requests,
+	uint8_t capacity, uint32_t timeout_ms);
+
+/*
+    @brief Function to detach the queue, the handler's commands block again
+
+    @note Queued commands are completed with EXPLORIR_ERR_TIMEOUT
+*/
+void explorir_async_deinit(explorir_async_t * async);
+
+/*
+    @brief Function to find the queue attached to a handler
+
+    @ret The queue, or NULL if the handler's commands block or go to another explorir_submit hook
+*/
+explorir_async_t * explorir_async_of(const explorir_handler_t * explorir_handler);
+
+/*
+    @brief Function to set the completion callback of the next command issued on the handler
+
+    @note Cleared once a command is queued, a command issued without it completes silently
+*/
+void explorir_async_next(explorir_async_t * async, explorir_async_callback_t callback, void *context);
+
+/*
+    @brief Function to drop the completion callbacks given a context, e.g. before the context is freed
+
+    @param[in] context Context of the callbacks to drop, not NULL
+
+    @note The commands stay queued and complete silently, their replies are still parsed
+*/
+void explorir_async_forget(explorir_async_t * async, const void *context);
+
+/*
+    @brief Function to queue two commands that stand or fall together, e.g. the MSB and LSB halves of a 'P' parameter
+
+    @param[in] first Command sent first, the second is only queued once it succeeds
+
+    @param[in] second Command sent after it
+
+    @note The callback set by explorir_async_next() is called once, with the result of the second command or
+	    the error of the first, one pair can be in flight at a time
+
+    @ret EXPLORIR_SUCCESS, EXPLORIR_ERR_INVALID_INPUT for an empty or too long command, or EXPLORIR_ERR_BUSY if the queue
+	    is full or another pair is in flight
+*/
+explorir_retcode_t explorir_async_submit_pair(explorir_async_t * async, const unsigned char * first, uint8_t first_size,
+	const unsigned char * second, uint8_t second_size);
+
+/*
+    @brief Function to queue a pause, the following commands are held back until it has passed
+
+    @param[in] delay_ms Length of the pause, measured from when the commands ahead of it finish
+
+    @ret EXPLORIR_SUCCESS, or EXPLORIR_ERR_BUSY if the queue is full
+*/
+explorir_retcode_t explorir_async_delay(explorir_async_t * async, uint32_t delay_ms, explorir_async_callback_t callback, void *context);
+
+/*
+    @brief Function to parse a received line and complete the command it answers
+
+    @param[in] data Line received from the sensor
+
+    @param[in] size Size, in bytes, of data
+
+    @note Measurement lines in streaming mode are parsed as usual and don't complete other commands
+*/
+void explorir_async_process(explorir_async_t * async, const uint8_t * data, uint16_t size);
+
+/*
+    @brief Function to advance time, handles reply timeouts, retry backoff and delays
+
+    @param[in] now_ms Current time in milliseconds, may wrap
+*/
+void explorir_async_tick(explorir_async_t * async, uint32_t now_ms);
+
+/*
+    @brief Function to check whether the queue is empty
+
+    @ret true if no command is queued or waiting for its reply
+*/
+bool explorir_async_idle(const explorir_async_t * async);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXPLORIR_ASYNC_H
@@ -0,0 +1,145 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_autozero.c
+
+  @Summary
+    Fleet auto-zero scheduler for ExplorIr handlers
+
+  @Description
+    Implements the night and slot assignment and the due check
+******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "explorir_autozero.h"
+
+/*
+    @brief Function to initialize a scheduler
+
+    @param[in] sensors Storage for the fleet
+
+    @param[in] capacity Number of elements in sensors
+
+    @param[in] config Window, slot length, period and concurrency, copied
+
+    @ret EXPLORIR_SUCCESS, or EXPLORIR_ERR_INVALID_INPUT if the window holds no slot or the period or per_zone is 0
+*/
+explorir_retcode_t explorir_autozero_init(explorir_autozero_t * scheduler, explorir_autozero_sensor_t * sensors, uint16_t capacity,
+	const explorir_autozero_config_t * config) {
+    memset(scheduler, 0, sizeof(*scheduler));
+    if(config->slot_s == 0 || config->period_days == 0 || config->per_zone == 0 || config->window_start_s >= EXPLORIR_AUTOZERO_DAY_S
+	    || config->window_length_s > EXPLORIR_AUTOZERO_DAY_S || config->window_length_s < config->slot_s)
+	return EXPLORIR_ERR_INVALID_INPUT;
+
+    scheduler->config = *config;
+    scheduler->sensors = sensors;
+    scheduler->capacity = capacity;
+    uint32_t slots = config->window_length_s / config->slot_s;
+    scheduler->slots = slots > UINT16_MAX ? UINT16_MAX : slots;
+    return EXPLORIR_SUCCESS;
+}
+
+/*
+    @brief Function to add a sensor, it gets the earliest night and slot of its zone that isn't full
+
+    @param[in] zone Sensors of a zone, e.g. one room, are staggered against each other
+
+    @ret EXPLORIR_SUCCESS, or EXPLORIR_ERR_BUSY if the storage or every slot of the zone's period is taken
+*/
+explorir_retcode_t explorir_autozero_add(explorir_autozero_t * scheduler, explorir_handler_t * explorir_handler, uint16_t zone) {
+    if(scheduler->count == scheduler->capacity)
+	return EXPLORIR_ERR_BUSY;
+
+    uint32_t in_zone = 0;
+    for(uint16_t k = 0; k < scheduler->count; k++) {
+	if(scheduler->sensors[k].zone == zone)
+	    in_zone++;
+    }
+    // groups of per_zone sensors fill one slot of every night before the next slot, so each night stays light
+    uint32_t group = in_zone / scheduler->config.per_zone;
+    if(group / scheduler->config.period_days >= scheduler->slots)
+	return EXPLORIR_ERR_BUSY;
+
+    explorir_autozero_sensor_t * sensor = &scheduler->sensors[scheduler->count++];
+    memset(sensor, 0, sizeof(*sensor));
+    sensor->explorir_handler = explorir_handler;
+    sensor->zone = zone;
+    sensor->night = group % scheduler->config.period_days;
+    sensor->slot = group / scheduler->config.period_days;
+    sensor->last_result = EXPLORIR_SUCCESS;
+    sensor->last_window = EXPLORIR_AUTOZERO_NEVER;
+    return EXPLORIR_SUCCESS;
+}
+
+/*
+    @brief Function to start the auto-zeros that are due, call from the main loop
+
+    @param[in] now_s Local time in seconds since the epoch, the window is in local time
+
+    @note A sensor is due once during its slot, a slot missed entirely, e.g. while the host was down, waits
+	    for the sensor's next night so the zone stays staggered
+
+    @ret Number of auto-zeros started
+*/
+uint16_t explorir_autozero_poll(explorir_autozero_t * scheduler, uint32_t now_s) {
+    const explorir_autozero_config_t * config = &scheduler->config;
+    if(now_s < config->window_start_s)
+	return 0;
+
+    // windows are numbered by the day they open on, so one that runs past midnight keeps its number
+    uint32_t window = (now_s - config->window_start_s) / EXPLORIR_AUTOZERO_DAY_S;
+    uint32_t offset = (now_s - config->window_start_s) % EXPLORIR_AUTOZERO_DAY_S;
+    if(offset >= config->window_length_s)
+	return 0;
+
+    uint16_t night = window % config->period_days;
+    uint16_t started = 0;
+    for(uint16_t k = 0; k < scheduler->count; k++) {
+	explorir_autozero_sensor_t * sensor = &scheduler->sensors[k];
+	uint32_t slot_start = (uint32_t)sensor->slot * config->slot_s;
+	if(sensor->night != night || sensor->last_window == window || offset < slot_start || offset >= slot_start + config->slot_s)
+	    continue;
+
+	// one attempt per window, a sensor that didn't acknowledge is tried again on its next night
+	sensor->last_window = window;
+	sensor->last_result = explorir_start_auto_zero(sensor->explorir_handler);
+	scheduler->started++;
+	started++;
+	if(sensor->last_result != EXPLORIR_SUCCESS)
+	    scheduler->failed++;
+#ifdef DEBUG_OUTPUT
+	NRF_LOG_INFO("Auto-zero of sensor %d: %d ", sensor->explorir_handler->sensor_id, sensor->last_result);
+	NRF_LOG_FLUSH();
+#endif
+    }
+    return started;
+}
+
+/*
+    @brief Function to get when a sensor auto-zeros next
+
+    @param[in] index Sensor in order of explorir_autozero_add()
+
+    @param[in] now_s Local time in seconds since the epoch
+
+    @ret Local time in seconds of the next start, now_s if it is due
+*/
+uint32_t explorir_autozero_next(const explorir_autozero_t * scheduler, uint16_t index, uint32_t now_s) {
+    const explorir_autozero_config_t * config = &scheduler->config;
+    const explorir_autozero_sensor_t * sensor = &scheduler->sensors[index];
+    uint32_t window = now_s < config->window_start_s ? 0 : (now_s - config->window_start_s) / EXPLORIR_AUTOZERO_DAY_S;
+
+    // the sensor's night comes around within one period after the current window
+    for(uint32_t n = 0; n <= config->period_days; n++, window++) {
+	if(window % config->period_days != sensor->night || window == sensor->last_window)
+	    continue;
+	uint32_t start = config->window_start_s + window * EXPLORIR_AUTOZERO_DAY_S + (uint32_t)sensor->slot * config->slot_s;
+	if(start + config->slot_s <= now_s)
+	    continue; // the slot has passed
+	return start > now_s ? start : now_s;
+    }
+    return now_s; // not reached with a valid configuration
+}
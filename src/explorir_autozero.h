@@ -0,0 +1,122 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_autozero.h
+
+  @Summary
+    Fleet auto-zero scheduler for ExplorIr handlers
+
+  @Description
+    Starts the auto-zeros of many sensors from the host instead of leaving
+    them to each sensor's own interval timer, which runs from power-up and
+    lines up with nothing. Auto-zeros happen inside a daily unoccupied
+    window, e.g. 22:00 - 06:00, when the room is close to fresh air, and the
+    sensors of a zone are staggered: at most per_zone of them auto-zero in
+    the same slot, and consecutive groups go to different nights of the
+    period, so a zone never loses all of its readings at once.
+
+    explorir_disable_auto_zeroing(&explorir); // once per sensor, the scheduler takes over
+    explorir_autozero_init(&scheduler, sensors, 64, &config);
+    explorir_autozero_add(&scheduler, &explorir, zone);
+    ...
+    explorir_autozero_poll(&scheduler, local_time_s()); // main loop, local time in seconds
+******************************************************************************/
+
+#ifndef EXPLORIR_AUTOZERO_H
+#define EXPLORIR_AUTOZERO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "explorir.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EXPLORIR_AUTOZERO_DAY_S 86400u
+
+// last_window of a sensor that hasn't auto-zeroed yet
+#define EXPLORIR_AUTOZERO_NEVER UINT32_MAX
+
+// @brief when the fleet may auto-zero
+typedef struct {
+    uint32_t window_start_s; // second of the local day the unoccupied window opens, e.g. 22 * 3600
+    uint32_t window_length_s; // may run past midnight, at most a day
+    uint32_t slot_s; // time set aside for one auto-zero, the next group of the zone starts after it
+    uint16_t period_days; // each sensor auto-zeros once every period_days nights
+    uint8_t per_zone; // sensors of one zone auto-zeroing in the same slot
+} explorir_autozero_config_t;
+
+// @brief one sensor of the fleet
+typedef struct {
+    explorir_handler_t * explorir_handler;
+    uint32_t last_window; // window the last auto-zero was started in, EXPLORIR_AUTOZERO_NEVER if none
+    uint16_t zone; // sensors of a zone are staggered against each other
+    uint16_t night; // night of the period the sensor auto-zeros in, assigned by explorir_autozero_add()
+    uint16_t slot; // slot of that night's window
+    uint8_t last_result; // explorir_retcode_t of the last auto-zero start
+} explorir_autozero_sensor_t;
+
+// @brief auto-zero scheduler of a fleet, sensors live in caller-provided storage
+typedef struct {
+    explorir_autozero_config_t config;
+    explorir_autozero_sensor_t * sensors;
+    uint32_t started; // auto-zeros started
+    uint32_t failed; // auto-zero starts the sensor didn't acknowledge
+    uint16_t capacity;
+    uint16_t count;
+    uint16_t slots; // slots in one window
+} explorir_autozero_t;
+
+/*
+    @brief Function to initialize a scheduler
+
+    @param[in] sensors Storage for the fleet
+
+    @param[in] capacity Number of elements in sensors
+
+    @param[in] config Window, slot length, period and concurrency, copied
+
+    @ret EXPLORIR_SUCCESS, or EXPLORIR_ERR_INVALID_INPUT if the window holds no slot or the period or per_zone is 0
+*/
+explorir_retcode_t explorir_autozero_init(explorir_autozero_t * scheduler, explorir_autozero_sensor_t * sensors, uint16_t capacity,
+	const explorir_autozero_config_t * config);
+
+/*
+    @brief Function to add a sensor, it gets the earliest night and slot of its zone that isn't full
+
+    @param[in] zone Sensors of a zone, e.g. one room, are staggered against each other
+
+    @ret EXPLORIR_SUCCESS, or EXPLORIR_ERR_BUSY if the storage or every slot of the zone's period is taken
+*/
+explorir_retcode_t explorir_autozero_add(explorir_autozero_t * scheduler, explorir_handler_t * explorir_handler, uint16_t zone);
+
+/*
+    @brief Function to start the auto-zeros that are due, call from the main loop
+
+    @param[in] now_s Local time in seconds since the epoch, the window is in local time
+
+    @note A sensor is due once during its slot, a slot missed entirely, e.g. while the host was down, waits
+	    for the sensor's next night so the zone stays staggered
+
+    @ret Number of auto-zeros started
+*/
+uint16_t explorir_autozero_poll(explorir_autozero_t * scheduler, uint32_t now_s);
+
+/*
+    @brief Function to get when a sensor auto-zeros next
+
+    @param[in] index Sensor in order of explorir_autozero_add()
+
+    @param[in] now_s Local time in seconds since the epoch
+
+    @ret Local time in seconds of the next start, now_s if it is due
+*/
+uint32_t explorir_autozero_next(const explorir_autozero_t * scheduler, uint16_t index, uint32_t now_s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXPLORIR_AUTOZERO_H
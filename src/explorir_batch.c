@@ -0,0 +1,286 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_batch.c
+
+  @Summary
+    Batch decoding of many ExplorIr measurement lines at once
+
+  @Description
+    Implements the block-wise newline scan, the tag and field decoding and
+    the structure-of-arrays output
+******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "explorir_batch.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// bytes looked at per newline scan
+#define EXPLORIR_BATCH_BLOCK 16
+// a block's newline mask has one bit per byte, except on NEON where it has one per nibble
+#if !defined(__SSE2__) && defined(__ARM_NEON)
+#define EXPLORIR_BATCH_STRIDE_SHIFT 2
+#else
+#define EXPLORIR_BATCH_STRIDE_SHIFT 0
+#endif
+
+#define EXPLORIR_BATCH_TAG ':'
+#define EXPLORIR_BATCH_TIMESTAMP_SEPARATOR ','
+#define EXPLORIR_BATCH_MAX_TIMESTAMP_DIGITS 10
+#define EXPLORIR_BATCH_MAX_SENSOR_ID_DIGITS 3
+#define EXPLORIR_BATCH_MAX_FIELD_DIGITS 5
+
+// @brief Function to find the newlines of the next block, bit k << EXPLORIR_BATCH_STRIDE_SHIFT set for a '\n' at block[k]
+static uint64_t explorir_batch_newlines(const uint8_t * block, uint32_t remaining) {
+#if defined(__SSE2__)
+    if(remaining >= EXPLORIR_BATCH_BLOCK) {
+	__m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)block), _mm_set1_epi8(TERMINATE));
+	return (uint16_t)_mm_movemask_epi8(equal);
+    }
+#elif defined(__ARM_NEON)
+    if(remaining >= EXPLORIR_BATCH_BLOCK) {
+	uint8x16_t equal = vceqq_u8(vld1q_u8(block), vdupq_n_u8(TERMINATE));
+	// NEON has no movemask, narrowing every byte to a nibble packs the block into 64 bits, keep one bit of each
+	uint64_t nibbles = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(equal), 4)), 0);
+	return nibbles & 0x1111111111111111ull;
+    }
+#endif
+    uint64_t mask = 0;
+    uint32_t n = remaining < EXPLORIR_BATCH_BLOCK ? remaining : EXPLORIR_BATCH_BLOCK;
+    for(uint32_t k = 0; k < n; k++) {
+	if(block[k] == TERMINATE)
+	    mask |= (uint64_t)1 << (k << EXPLORIR_BATCH_STRIDE_SHIFT);
+    }
+    return mask;
+}
+
+// @brief Function to read a decimal number of 1 - max_digits digits at line[*i], *i is moved past them
+static bool explorir_batch_number(const uint8_t * line, uint32_t size, uint32_t * i, uint8_t max_digits, uint64_t * value) {
+    uint32_t j = *i;
+    uint64_t result = 0;
+    while(j < size && j - *i < max_digits && line[j] >= '0' && line[j] <= '9') {
+	result = result * 10 + (line[j] - '0');
+	j++;
+    }
+    if(j == *i)
+	return false;
+    *i = j;
+    *value = result;
+    return true;
+}
+
+// @brief Function to decode a field at the fixed offsets " Z #####", false if it has any other shape
+static bool explorir_batch_fixed_field(const uint8_t * field, uint8_t * mask, uint16_t * raw) {
+    if(field[1] == FILTERED_CO2_MEASUREMENT)
+	*mask = FILTERED_MASK;
+    else if(field[1] == UNFILTERED_CO2_MEASUREMENT)
+	*mask = UNFILTERED_MASK;
+    else
+	return false;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // the whole field in one word, the five digits are its top bytes
+    uint64_t word;
+    memcpy(&word, field, sizeof(word));
+    if((word & 0xFF00FF) != (SPACE | SPACE << 16))
+	return false;
+    // digits are 0x30 - 0x39, the only bytes whose high nibble is 3 before and after adding 6
+    if(((word & 0xF0F0F0F0F0000000ull) | ((word + 0x0606060606000000ull) & 0xF0F0F0F0F0000000ull) >> 4) != 0x3333333333000000ull)
+	return false;
+    // read as the eight digits "000#####", combine neighbouring digits, then pairs, then quads
+    uint64_t digits = word & 0x0F0F0F0F0F000000ull;
+    digits = digits * 10 + (digits >> 8);
+    digits = ((digits & 0x000000FF000000FFull) * (100 + (1000000ull << 32))
+	    + ((digits >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32))) >> 32;
+    uint32_t value = digits;
+#else
+    if(field[0] != SPACE || field[2] != SPACE)
+	return false;
+    uint32_t value = 0;
+    for(uint8_t d = 3; d < EXPLORIR_MEASUREMENT_FIELD_SIZE; d++) {
+	uint8_t digit = field[d] - '0';
+	if(digit > 9)
+	    return false;
+	value = value * 10 + digit;
+    }
+#endif
+    if(value > MAX_TWO_BYTE_VALUE)
+	return false;
+    *raw = value;
+    return true;
+}
+
+/*
+    @brief Function to strip an optional "sensor_id:" or "timestamp_ms,sensor_id:" tag
+
+    @param[in,out] i 0 on entry, index of the sensor's output on return
+
+    @ret false if the line starts with a malformed tag, true if it has a valid one or none
+*/
+static bool explorir_batch_tag(const uint8_t * line, uint32_t size, uint32_t * i, uint32_t * timestamp_ms, uint8_t * sensor_id) {
+    uint32_t j = 0;
+    uint64_t first;
+    uint64_t id;
+    // the sensor's own output never starts with a digit
+    if(!explorir_batch_number(line, size, &j, EXPLORIR_BATCH_MAX_TIMESTAMP_DIGITS, &first))
+	return true;
+    if(j < size && line[j] == EXPLORIR_BATCH_TIMESTAMP_SEPARATOR) {
+	j++;
+	if(first > UINT32_MAX || !explorir_batch_number(line, size, &j, EXPLORIR_BATCH_MAX_SENSOR_ID_DIGITS, &id))
+	    return false;
+	*timestamp_ms = first;
+    } else {
+	id = first;
+    }
+    if(j >= size || line[j] != EXPLORIR_BATCH_TAG || id > UINT8_MAX)
+	return false;
+    *sensor_id = id;
+    *i = j + 1;
+    return true;
+}
+
+/*
+    @brief Function to decode one line, without its '\n', into the batch
+
+    @ret false if its fields don't fit, the line is left for the next call
+*/
+static bool explorir_batch_line(explorir_batch_t * batch, const uint8_t * line, uint32_t size, uint32_t timestamp_ms, uint8_t sensor_id) {
+    if(size > 0 && line[size - 1] == '\r')
+	size--;
+    if(size == 0)
+	return true;
+
+    uint32_t i = 0;
+    if(!explorir_batch_tag(line, size, &i, &timestamp_ms, &sensor_id))
+	goto Malformed;
+
+    uint8_t count = 0;
+    uint8_t fields[EXPLORIR_BATCH_FIELDS_PER_LINE];
+    uint16_t raw[EXPLORIR_BATCH_FIELDS_PER_LINE];
+    // most lines are the fields at fixed offsets and nothing else, the general loop below handles the rest
+    uint32_t fixed = i;
+    while(count < EXPLORIR_BATCH_FIELDS_PER_LINE && size - fixed >= EXPLORIR_MEASUREMENT_FIELD_SIZE
+	    && explorir_batch_fixed_field(&line[fixed], &fields[count], &raw[count])) {
+	fixed += EXPLORIR_MEASUREMENT_FIELD_SIZE;
+	count++;
+    }
+    if(fixed == size && count > 0)
+	goto Store;
+
+    count = 0;
+    while(i < size) {
+	uint8_t identifier = line[i];
+	if(identifier == SPACE) {
+	    i++;
+	    continue;
+	}
+	if(identifier != FILTERED_CO2_MEASUREMENT && identifier != UNFILTERED_CO2_MEASUREMENT) {
+	    // a command reply or anything else that isn't a measurement line
+	    if(count > 0)
+		goto Malformed;
+	    break;
+	}
+	// " Z #####", same as explorir_process_response()
+	i++;
+	if(i >= size || line[i] != SPACE || count == EXPLORIR_BATCH_FIELDS_PER_LINE)
+	    goto Malformed;
+	while(i < size && line[i] == SPACE) {
+	    i++;
+	}
+	uint64_t value;
+	if(!explorir_batch_number(line, size, &i, EXPLORIR_BATCH_MAX_FIELD_DIGITS, &value) || value > MAX_TWO_BYTE_VALUE)
+	    goto Malformed;
+	fields[count] = identifier == FILTERED_CO2_MEASUREMENT ? FILTERED_MASK : UNFILTERED_MASK;
+	raw[count] = value;
+	count++;
+    }
+
+Store:
+    if(batch->count + count > batch->capacity)
+	return false;
+    for(uint8_t f = 0; f < count; f++) {
+	uint32_t k = batch->count + f;
+	batch->timestamps_ms[k] = timestamp_ms;
+	batch->sensor_ids[k] = sensor_id;
+	batch->fields[k] = fields[f];
+	batch->raw[k] = raw[f];
+    }
+    batch->count += count;
+    batch->lines++;
+    if(count == 0)
+	batch->skipped++;
+    return true;
+
+Malformed:
+    batch->lines++;
+    batch->malformed++;
+    return true;
+}
+
+/*
+    @brief Function to initialize a batch over caller-provided arrays
+
+    @param[in] capacity Number of elements in each array
+*/
+void explorir_batch_init(explorir_batch_t * batch, uint32_t * timestamps_ms, uint8_t * sensor_ids, uint8_t * fields,
+	uint16_t * raw, uint32_t capacity) {
+    memset(batch, 0, sizeof(*batch));
+    batch->timestamps_ms = timestamps_ms;
+    batch->sensor_ids = sensor_ids;
+    batch->fields = fields;
+    batch->raw = raw;
+    batch->capacity = capacity;
+}
+
+/*
+    @brief Function to empty the arrays once their rows have been consumed, the line counters are kept
+*/
+void explorir_batch_clear(explorir_batch_t * batch) {
+    batch->count = 0;
+}
+
+/*
+    @brief Function to decode every complete line of a buffer into the batch, in one pass
+
+    @param[in] data Lines, each ending in '\n', an optional '\r' before it is ignored
+
+    @param[in] size Number of bytes in data
+
+    @param[in] timestamp_ms Timestamp of untagged lines and of tags without one
+
+    @param[in] sensor_id Sensor id of untagged lines
+
+    @note Stops in front of the first line whose fields don't fit, call again after explorir_batch_clear()
+
+    @ret Number of bytes consumed, up to the end of the last line decoded, a partial last line is left over
+*/
+uint32_t explorir_parse_batch(explorir_batch_t * batch, const uint8_t * data, uint32_t size, uint32_t timestamp_ms,
+	uint8_t sensor_id) {
+    uint32_t start = 0; // first byte of the current line
+    uint32_t base = 0; // first byte of the block whose newlines are in mask
+    uint64_t mask = 0; // newlines of that block not reached yet
+    for(;;) {
+	while(mask == 0) {
+	    if(base >= size)
+		return start;
+	    mask = explorir_batch_newlines(&data[base], size - base);
+	    if(mask == 0)
+		base += EXPLORIR_BATCH_BLOCK;
+	}
+	uint32_t end = base + (__builtin_ctzll(mask) >> EXPLORIR_BATCH_STRIDE_SHIFT);
+	mask &= mask - 1;
+	if(mask == 0)
+	    base += EXPLORIR_BATCH_BLOCK;
+
+	if(!explorir_batch_line(batch, &data[start], end - start, timestamp_ms, sensor_id))
+	    return start;
+	start = end + 1;
+    }
+}
@@ -0,0 +1,100 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_batch.h
+
+  @Summary
+    Batch decoding of many ExplorIr measurement lines at once
+
+  @Description
+    For replay, backfill and gateways that read large chunks from many
+    ports, where one explorir_process_response() call per line per handler
+    costs more than the decoding itself. explorir_parse_batch() walks a
+    buffer of CRLF-delimited lines once, finding line ends 16 bytes at a
+    time with SSE2 or NEON where available, and writes every measurement
+    field into caller-provided arrays, one row per field:
+
+	timestamps_ms[k]  sensor_ids[k]  fields[k]  raw[k]
+
+    raw is the value as sent, multiply by the sensor's scaling factor for
+    ppm. Lines may carry a tag in front of the sensor's output, untagged
+    lines take the timestamp and sensor id passed in:
+
+	 Z 00412 z 00409\r\n		untagged
+	7: Z 00412 z 00409\r\n		sensor 7
+	123456,7: Z 00412 z 00409\r\n	sensor 7 at 123456 ms
+
+    Lines without measurement fields, e.g. command replies, are counted and
+    skipped, no handler state is touched.
+
+    explorir_batch_init(&batch, timestamps_ms, sensor_ids, fields, raw, 4096);
+    ...
+    used = explorir_parse_batch(&batch, chunk, size, now_ms(), port_sensor_id);
+    ... // batch.count rows, then explorir_batch_clear(&batch)
+    memmove(chunk, &chunk[used], size - used); // a partial last line, completed by the next read
+******************************************************************************/
+
+#ifndef EXPLORIR_BATCH_H
+#define EXPLORIR_BATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "explorir.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// most measurement fields on one line
+#define EXPLORIR_BATCH_FIELDS_PER_LINE 2
+
+// @brief structure-of-arrays output, the arrays live in caller-provided storage
+typedef struct {
+    uint32_t * timestamps_ms;
+    uint16_t * raw; // field value as sent, before the scaling factor
+    uint8_t * sensor_ids;
+    uint8_t * fields; // FILTERED_MASK or UNFILTERED_MASK
+    uint32_t capacity; // elements of each array
+    uint32_t count; // rows written
+    uint32_t lines; // non-empty lines decoded
+    uint32_t skipped; // lines without measurement fields
+    uint32_t malformed; // lines with a bad tag or a bad measurement field
+} explorir_batch_t;
+
+/*
+    @brief Function to initialize a batch over caller-provided arrays
+
+    @param[in] capacity Number of elements in each array
+*/
+void explorir_batch_init(explorir_batch_t * batch, uint32_t * timestamps_ms, uint8_t * sensor_ids, uint8_t * fields,
+	uint16_t * raw, uint32_t capacity);
+
+/*
+    @brief Function to empty the arrays once their rows have been consumed, the line counters are kept
+*/
+void explorir_batch_clear(explorir_batch_t * batch);
+
+/*
+    @brief Function to decode every complete line of a buffer into the batch, in one pass
+
+    @param[in] data Lines, each ending in '\n', an optional '\r' before it is ignored
+
+    @param[in] size Number of bytes in data
+
+    @param[in] timestamp_ms Timestamp of untagged lines and of tags without one
+
+    @param[in] sensor_id Sensor id of untagged lines
+
+    @note Stops in front of the first line whose fields don't fit, call again after explorir_batch_clear()
+
+    @ret Number of bytes consumed, up to the end of the last line decoded, a partial last line is left over
+*/
+uint32_t explorir_parse_batch(explorir_batch_t * batch, const uint8_t * data, uint32_t size, uint32_t timestamp_ms,
+	uint8_t sensor_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXPLORIR_BATCH_H
@@ -0,0 +1,267 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_calibrate.c
+
+  @Summary
+    Calibration of many ExplorIr sensors at once on their command queues
+
+  @Description
+    Implements the per-sensor calibration steps
+******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "explorir_calibrate.h"
+#include "explorir_watchdog.h"
+
+// @brief true once now_ms has reached deadline_ms, across wraps
+static bool explorir_calibrate_expired(uint32_t now_ms, uint32_t deadline_ms) {
+    return (int32_t)(now_ms - deadline_ms) >= 0;
+}
+
+// @brief completion callback of the commands a sensor's calibration queues
+static void explorir_calibrate_complete(explorir_retcode_t result, explorir_handler_t * explorir_handler, void * context) {
+    explorir_calibrate_sensor_t * sensor = context;
+    sensor->result = result;
+    sensor->pending = false;
+    (void)explorir_handler;
+}
+
+// @brief Function to move a sensor into a final state
+static void explorir_calibrate_finish(explorir_calibrate_t * calibrate, explorir_calibrate_sensor_t * sensor, explorir_calibrate_state_t state) {
+    sensor->state = state;
+    calibrate->finished++;
+#ifdef DEBUG_OUTPUT
+    NRF_LOG_INFO("Calibration of sensor %d: %d, zero point %d -> %d ", sensor->async->explorir_handler->sensor_id, state,
+	    sensor->zero_before, sensor->zero_after);
+    NRF_LOG_FLUSH();
+#endif
+}
+
+// @brief Function to give a sensor's next command the calibrator's completion callback, before it is issued
+static void explorir_calibrate_issue(const explorir_calibrate_config_t * config, explorir_calibrate_sensor_t * sensor, uint32_t now_ms) {
+    // pending before the command is issued, a transport answering from inside tx completes it right away
+    sensor->pending = true;
+    sensor->result = EXPLORIR_SUCCESS;
+    sensor->deadline_ms = now_ms + (config->command_timeout_ms ? config->command_timeout_ms : EXPLORIR_CALIBRATE_COMMAND_TIMEOUT_MS);
+    explorir_async_next(sensor->async, explorir_calibrate_complete, sensor);
+}
+
+/*
+    @brief Function to check that a sensor's command issued after explorir_calibrate_issue() was queued
+
+    @param[in] result What the explorir_* function returned
+
+    @ret true if the command was queued, it may already have completed
+*/
+static bool explorir_calibrate_queued(explorir_calibrate_sensor_t * sensor, explorir_retcode_t result) {
+    if(result != EXPLORIR_SUCCESS) {
+	// rejected before it was queued, e.g. invalid input or a full queue
+	explorir_async_next(sensor->async, NULL, NULL);
+	sensor->pending = false;
+	sensor->result = result;
+	return false;
+    }
+    return true;
+}
+
+/*
+    @brief Function to check whether a sensor's queued command has run out of time, its completion is taken as lost
+
+    @ret true if the command timed out, it is no longer pending and result is EXPLORIR_ERR_TIMEOUT
+*/
+static bool explorir_calibrate_lost(explorir_calibrate_sensor_t * sensor, uint32_t now_ms) {
+    if(!explorir_calibrate_expired(now_ms, sensor->deadline_ms))
+	return false;
+    explorir_async_forget(sensor->async, sensor); // a late completion must not count for the next step
+    sensor->pending = false;
+    sensor->result = EXPLORIR_ERR_TIMEOUT;
+    return true;
+}
+
+// @brief Function to queue the zero command of the configured method
+static explorir_retcode_t explorir_calibrate_zero(const explorir_calibrate_config_t * config, explorir_handler_t * explorir_handler) {
+    switch(config->method) {
+	case EXPLORIR_CALIBRATE_FRESH_AIR:
+	    return explorir_set_zero_point_in_fresh_air(explorir_handler);
+	case EXPLORIR_CALIBRATE_NITROGEN:
+	    return explorir_set_zero_point_in_nitrogen(explorir_handler);
+	case EXPLORIR_CALIBRATE_KNOWN_GAS:
+	    // the sensor takes the concentration in units of the scaling factor, like its readings
+	    if(explorir_handler->scaling_factor == 0)
+		return EXPLORIR_ERR_INVALID_INPUT;
+	    return explorir_set_zero_point_using_known_co2(config->reference_ppm / explorir_handler->scaling_factor, explorir_handler);
+	default:
+	    return EXPLORIR_ERR_INVALID_INPUT;
+    }
+}
+
+// @brief Function to restore the zero point from before the calibration, if it is known
+static void explorir_calibrate_roll_back(explorir_calibrate_t * calibrate, explorir_calibrate_sensor_t * sensor, uint32_t now_ms) {
+    if(sensor->zero_before == 0) {
+	explorir_calibrate_finish(calibrate, sensor, EXPLORIR_CALIBRATE_FAILED);
+	return;
+    }
+    explorir_calibrate_issue(&calibrate->config, sensor, now_ms);
+    if(!explorir_calibrate_queued(sensor, explorir_set_zero_point_manually(sensor->zero_before, sensor->async->explorir_handler))) {
+	explorir_calibrate_finish(calibrate, sensor, EXPLORIR_CALIBRATE_FAILED);
+	return;
+    }
+    sensor->state = EXPLORIR_CALIBRATE_ROLLING_BACK;
+}
+
+// @brief Function to take the handler's latest filtered reading into the detector, once per measurement line
+static void explorir_calibrate_sample(explorir_calibrate_sensor_t * sensor) {
+    explorir_handler_t * explorir_handler = sensor->async->explorir_handler;
+    if(explorir_handler->sample_count == sensor->last_sample_count)
+	return;
+    sensor->last_sample_count = explorir_handler->sample_count;
+    explorir_stability_push(&sensor->stability, explorir_handler->current_filtered_co2);
+}
+
+// @brief Function to forget the readings collected so far, readings already decoded are not taken
+static void explorir_calibrate_clear(explorir_calibrate_sensor_t * sensor) {
+    explorir_stability_reset(&sensor->stability);
+    sensor->last_sample_count = sensor->async->explorir_handler->sample_count;
+}
+
+/*
+    @brief Function to initialize a calibration run
+
+    @param[in] sensors Storage for the sensors
+
+    @param[in] capacity Number of elements in sensors
+
+    @param[in] config Procedure, copied
+
+    @ret EXPLORIR_SUCCESS, or EXPLORIR_ERR_INVALID_INPUT if window is out of range
+*/
+explorir_retcode_t explorir_calibrate_init(explorir_calibrate_t * calibrate, explorir_calibrate_sensor_t * sensors, uint16_t capacity,
+	const explorir_calibrate_config_t * config) {
+    memset(calibrate, 0, sizeof(*calibrate));
+    if(config->window < 2 || config->window > EXPLORIR_STABILITY_WINDOW)
+	return EXPLORIR_ERR_INVALID_INPUT;
+    calibrate->config = *config;
+    calibrate->sensors = sensors;
+    calibrate->capacity = capacity;
+    return EXPLORIR_SUCCESS;
+}
+
+/*
+    @brief Function to add a sensor by its command queue
+
+    @note Set the handler's zero_point beforehand if it is known from earlier records, it can't be read back
+	    from the sensor and a failed calibration is only rolled back when it is known
+
+    @ret EXPLORIR_SUCCESS, or EXPLORIR_ERR_BUSY if the storage is full
+*/
+explorir_retcode_t explorir_calibrate_add(explorir_calibrate_t * calibrate, explorir_async_t * async) {
+    if(calibrate->count == calibrate->capacity)
+	return EXPLORIR_ERR_BUSY;
+    explorir_calibrate_sensor_t * sensor = &calibrate->sensors[calibrate->count++];
+    memset(sensor, 0, sizeof(*sensor));
+    sensor->async = async;
+    sensor->state = EXPLORIR_CALIBRATE_IDLE;
+    const explorir_calibrate_config_t * config = &calibrate->config;
+    explorir_stability_init(&sensor->stability, config->window, config->stable_stddev_ppm, config->stable_slope_ppm_per_min,
+	    EXPLORIR_STREAMING_PERIOD_MS);
+    return EXPLORIR_SUCCESS;
+}
+
+/*
+    @brief Function to start calibrating every added sensor
+
+    @param[in] now_ms Current time in milliseconds, may wrap
+*/
+void explorir_calibrate_start(explorir_calibrate_t * calibrate, uint32_t now_ms) {
+    calibrate->finished = 0;
+    for(uint16_t k = 0; k < calibrate->count; k++) {
+	explorir_calibrate_sensor_t * sensor = &calibrate->sensors[k];
+	sensor->zero_before = sensor->async->explorir_handler->zero_point;
+	sensor->zero_after = 0;
+	sensor->verified_ppm = 0;
+	sensor->result = EXPLORIR_SUCCESS;
+	sensor->pending = false;
+	sensor->deadline_ms = now_ms + calibrate->config.stabilize_timeout_ms;
+	sensor->state = EXPLORIR_CALIBRATE_STABILIZING;
+	explorir_calibrate_clear(sensor);
+    }
+}
+
+/*
+    @brief Function to advance every sensor's calibration, call from the event loop
+
+    @param[in] now_ms Current time in milliseconds, may wrap
+
+    @ret true once every sensor has finished
+*/
+bool explorir_calibrate_poll(explorir_calibrate_t * calibrate, uint32_t now_ms) {
+    const explorir_calibrate_config_t * config = &calibrate->config;
+    for(uint16_t k = 0; k < calibrate->count; k++) {
+	explorir_calibrate_sensor_t * sensor = &calibrate->sensors[k];
+	explorir_handler_t * explorir_handler = sensor->async->explorir_handler;
+
+	switch(sensor->state) {
+	    case EXPLORIR_CALIBRATE_STABILIZING:
+		explorir_calibrate_sample(sensor);
+		if(explorir_stability_is_stable(&sensor->stability)) {
+		    explorir_calibrate_issue(config, sensor, now_ms);
+		    if(!explorir_calibrate_queued(sensor, explorir_calibrate_zero(config, explorir_handler))) {
+			explorir_calibrate_finish(calibrate, sensor, EXPLORIR_CALIBRATE_FAILED);
+			break;
+		    }
+		    sensor->state = EXPLORIR_CALIBRATE_ZEROING;
+		} else if(explorir_calibrate_expired(now_ms, sensor->deadline_ms)) {
+		    sensor->result = EXPLORIR_ERR_TIMEOUT;
+		    explorir_calibrate_finish(calibrate, sensor, EXPLORIR_CALIBRATE_FAILED);
+		}
+		break;
+	    case EXPLORIR_CALIBRATE_ZEROING:
+		if(sensor->pending && !explorir_calibrate_lost(sensor, now_ms))
+		    break;
+		if(sensor->result != EXPLORIR_SUCCESS) {
+		    // a timed out command may still have reached the sensor
+		    explorir_calibrate_roll_back(calibrate, sensor, now_ms);
+		    break;
+		}
+		sensor->zero_after = explorir_handler->zero_point;
+		sensor->deadline_ms = now_ms + config->settle_ms;
+		sensor->state = EXPLORIR_CALIBRATE_SETTLING;
+		break;
+	    case EXPLORIR_CALIBRATE_SETTLING:
+		if(!explorir_calibrate_expired(now_ms, sensor->deadline_ms))
+		    break;
+		explorir_calibrate_clear(sensor);
+		sensor->deadline_ms = now_ms + config->verify_timeout_ms;
+		sensor->state = EXPLORIR_CALIBRATE_VERIFYING;
+		break;
+	    case EXPLORIR_CALIBRATE_VERIFYING:
+		explorir_calibrate_sample(sensor);
+		if(sensor->stability.count == config->window) {
+		    uint32_t average = explorir_stability_mean(&sensor->stability);
+		    sensor->verified_ppm = average;
+		    uint32_t error = average > config->reference_ppm ? average - config->reference_ppm : config->reference_ppm - average;
+		    if(error <= config->tolerance_ppm)
+			explorir_calibrate_finish(calibrate, sensor, EXPLORIR_CALIBRATE_DONE);
+		    else
+			explorir_calibrate_roll_back(calibrate, sensor, now_ms); // result stays EXPLORIR_SUCCESS, verified_ppm tells why
+		} else if(explorir_calibrate_expired(now_ms, sensor->deadline_ms)) {
+		    sensor->result = EXPLORIR_ERR_TIMEOUT;
+		    explorir_calibrate_roll_back(calibrate, sensor, now_ms);
+		}
+		break;
+	    case EXPLORIR_CALIBRATE_ROLLING_BACK:
+		if(sensor->pending && !explorir_calibrate_lost(sensor, now_ms))
+		    break;
+		explorir_calibrate_finish(calibrate, sensor,
+			sensor->result == EXPLORIR_SUCCESS ? EXPLORIR_CALIBRATE_ROLLED_BACK : EXPLORIR_CALIBRATE_FAILED);
+		break;
+	    default:
+		break;
+	}
+    }
+    return calibrate->finished == calibrate->count;
+}
@@ -0,0 +1,146 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_calibrate.h
+
+  @Summary
+    Calibration of many ExplorIr sensors at once on their command queues
+
+  @Description
+    Runs the same zeroing procedure on every registered sensor concurrently,
+    each step a non-blocking command on the sensor's explorir_async_t:
+	1. wait until the sensor's readings are stable, by explorir_stability.h
+	2. zero in fresh air, in nitrogen or in a known gas (G, U or X)
+	3. let the readings settle, then check they average to the reference gas
+	4. on a failed check restore the previous zero point with 'u'
+    The zero point before and after is recorded per sensor. Sensors must be
+    streaming, their lines are handed to explorir_async_process() as usual
+    and the calibrator picks the readings up from the handler, so its
+    stability detector is separate from any on the sample hook.
+
+    explorir_calibrate_init(&calibrate, sensors, 200, &config);
+    explorir_calibrate_add(&calibrate, &async); // once per sensor
+    explorir_calibrate_start(&calibrate, now_ms());
+    while(!explorir_calibrate_poll(&calibrate, now_ms()))
+	; // the event loop keeps running the queues
+******************************************************************************/
+
+#ifndef EXPLORIR_CALIBRATE_H
+#define EXPLORIR_CALIBRATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "explorir.h"
+#include "explorir_async.h"
+#include "explorir_stability.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// default time allowed for a queued command including the queue's retries, after which its completion is taken as lost
+#define EXPLORIR_CALIBRATE_COMMAND_TIMEOUT_MS 10000
+
+// @brief gas the sensors sit in while they are zeroed
+typedef enum {
+    EXPLORIR_CALIBRATE_FRESH_AIR = 0, // 'G', reference_ppm is the fresh air level the sensors were set to, see the P commands
+    EXPLORIR_CALIBRATE_NITROGEN, // 'U', reference_ppm is 0
+    EXPLORIR_CALIBRATE_KNOWN_GAS // 'X', reference_ppm is the concentration of the gas
+} explorir_calibrate_method_t;
+
+// @brief calibration steps of one sensor
+typedef enum {
+    EXPLORIR_CALIBRATE_IDLE = 0, // not started
+    EXPLORIR_CALIBRATE_STABILIZING, // waiting for stable readings
+    EXPLORIR_CALIBRATE_ZEROING, // zero command queued, until command_timeout_ms
+    EXPLORIR_CALIBRATE_SETTLING, // waiting settle_ms after the zero command
+    EXPLORIR_CALIBRATE_VERIFYING, // collecting readings to check against reference_ppm
+    EXPLORIR_CALIBRATE_ROLLING_BACK, // 'u' with the previous zero point queued, until command_timeout_ms
+    EXPLORIR_CALIBRATE_DONE, // zeroed and verified
+    EXPLORIR_CALIBRATE_ROLLED_BACK, // zero command or verification failed, the previous zero point is restored
+    EXPLORIR_CALIBRATE_FAILED // failed, the zero point is unchanged or could not be restored, see result
+} explorir_calibrate_state_t;
+
+// @brief calibration procedure, shared by every sensor
+typedef struct {
+    explorir_calibrate_method_t method;
+    uint32_t reference_ppm; // concentration of the gas the sensors sit in
+    uint32_t stable_stddev_ppm; // readings are stable when the last window of them deviate at most this much
+    uint32_t stable_slope_ppm_per_min; // and drift at most this much, see explorir_stability.h
+    uint32_t tolerance_ppm; // largest difference between the verification average and reference_ppm
+    uint32_t stabilize_timeout_ms; // time allowed to become stable
+    uint32_t settle_ms; // wait after the zero command before verifying
+    uint32_t verify_timeout_ms; // time allowed to collect the verification readings
+    uint32_t command_timeout_ms; // time allowed for a queued zero or 'u' command to complete, 0 for EXPLORIR_CALIBRATE_COMMAND_TIMEOUT_MS
+    uint8_t window; // readings per check, 2 - EXPLORIR_STABILITY_WINDOW
+} explorir_calibrate_config_t;
+
+// @brief calibration of one sensor
+typedef struct {
+    explorir_async_t * async; // queue of the sensor's handler
+    uint32_t zero_before; // zero point when the calibration started, 0 if it was never read
+    uint32_t zero_after; // zero point reported by the zero command
+    uint32_t verified_ppm; // average of the verification readings
+    uint32_t deadline_ms; // end of the current step
+    uint32_t last_sample_count;
+    explorir_stability_t stability; // filtered readings of the current check
+    uint8_t state; // explorir_calibrate_state_t
+    uint8_t result; // explorir_retcode_t of the last command, EXPLORIR_ERR_TIMEOUT if a step or a command ran out of time
+    bool pending; // a command is queued and hasn't completed
+} explorir_calibrate_sensor_t;
+
+// @brief calibration of many sensors, sensors live in caller-provided storage
+typedef struct {
+    explorir_calibrate_config_t config;
+    explorir_calibrate_sensor_t * sensors;
+    uint16_t capacity;
+    uint16_t count;
+    uint16_t finished; // sensors in DONE, ROLLED_BACK or FAILED
+} explorir_calibrate_t;
+
+/*
+    @brief Function to initialize a calibration run
+
+    @param[in] sensors Storage for the sensors
+
+    @param[in] capacity Number of elements in sensors
+
+    @param[in] config Procedure, copied
+
+    @ret EXPLORIR_SUCCESS, or EXPLORIR_ERR_INVALID_INPUT if window is out of range
+*/
+explorir_retcode_t explorir_calibrate_init(explorir_calibrate_t * calibrate, explorir_calibrate_sensor_t * sensors, uint16_t capacity,
+	const explorir_calibrate_config_t * config);
+
+/*
+    @brief Function to add a sensor by its command queue
+
+    @note Set the handler's zero_point beforehand if it is known from earlier records, it can't be read back
+	    from the sensor and a failed calibration is only rolled back when it is known
+
+    @ret EXPLORIR_SUCCESS, or EXPLORIR_ERR_BUSY if the storage is full
+*/
+explorir_retcode_t explorir_calibrate_add(explorir_calibrate_t * calibrate, explorir_async_t * async);
+
+/*
+    @brief Function to start calibrating every added sensor
+
+    @param[in] now_ms Current time in milliseconds, may wrap
+*/
+void explorir_calibrate_start(explorir_calibrate_t * calibrate, uint32_t now_ms);
+
+/*
+    @brief Function to advance every sensor's calibration, call from the event loop
+
+    @param[in] now_ms Current time in milliseconds, may wrap
+
+    @ret true once every sensor has finished
+*/
+bool explorir_calibrate_poll(explorir_calibrate_t * calibrate, uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXPLORIR_CALIBRATE_H
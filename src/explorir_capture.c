@@ -0,0 +1,161 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_capture.c
+
+  @Summary
+    Raw UART capture and deterministic replay for ExplorIr handlers (POSIX hosts)
+
+  @Description
+    Implements the capture writer and the replay loop
+******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include "explorir_capture.h"
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/*
+    @brief Function to start a capture
+
+    @param[in] file Open, writable file, e.g. fopen(path, "wb")
+
+    @ret ExplorIr return code, EXPLORIR_ERR_INVALID_INPUT if the header cannot be written
+*/
+explorir_retcode_t explorir_capture_start(explorir_capture_t * capture, FILE * file) {
+    uint8_t header[EXPLORIR_CAPTURE_FILE_HEADER_SIZE] = {'E', 'X', 'C', 'P', EXPLORIR_CAPTURE_VERSION};
+    capture->file = file;
+    capture->start_us = monotonic_ns() / 1000;
+    capture->failed = false;
+    if(fwrite(header, 1, sizeof(header), file) != sizeof(header))
+	return EXPLORIR_ERR_INVALID_INPUT;
+    return EXPLORIR_SUCCESS;
+}
+
+/*
+    @brief Function to attach a capture to a handler
+
+    @note Sets explorir_on_traffic and traffic_context, the handler's sensor_id tags its records
+*/
+void explorir_capture_attach(explorir_capture_t * capture, explorir_handler_t * explorir_handler) {
+    explorir_handler->explorir_on_traffic = explorir_capture_on_traffic;
+    explorir_handler->traffic_context = capture;
+}
+
+/*
+    @brief Traffic callback adapter, appends one record to the capture in context
+
+    @note Each record is written by a single fwrite() with the stream locked, records of handlers on other
+	    threads never interleave. A short write latches failed.
+*/
+void explorir_capture_on_traffic(explorir_direction_t direction, const uint8_t * data, uint8_t size, uint8_t sensor_id, void * context) {
+    explorir_capture_t * capture = (explorir_capture_t *)context;
+    uint8_t record[EXPLORIR_CAPTURE_RECORD_HEADER_SIZE + UINT8_MAX];
+    size_t record_size = EXPLORIR_CAPTURE_RECORD_HEADER_SIZE + size;
+    record[8] = sensor_id;
+    record[9] = (uint8_t)direction;
+    record[10] = size;
+    memcpy(&record[EXPLORIR_CAPTURE_RECORD_HEADER_SIZE], data, size);
+
+    // the timestamp is taken under the lock as well, so they rise in file order
+    flockfile(capture->file);
+    if(!capture->failed) {
+	uint64_t timestamp_us = monotonic_ns() / 1000 - capture->start_us;
+	for(uint8_t b = 0; b < 8; b++) {
+	    record[b] = (uint8_t)(timestamp_us >> (8 * b));
+	}
+	// a partial record would misalign every record after it
+	if(fwrite(record, 1, record_size, capture->file) != record_size)
+	    capture->failed = true;
+    }
+    funlockfile(capture->file);
+}
+
+/*
+    @brief Function to sleep until a replay record is due
+*/
+static void explorir_replay_wait(uint64_t start_ns, uint64_t timestamp_us) {
+    uint64_t due_ns = start_ns + timestamp_us * 1000;
+    uint64_t now_ns = monotonic_ns();
+    if(due_ns <= now_ns)
+	return;
+    struct timespec ts;
+    ts.tv_sec = (time_t)((due_ns - now_ns) / 1000000000u);
+    ts.tv_nsec = (long)((due_ns - now_ns) % 1000000000u);
+    nanosleep(&ts, NULL);
+}
+
+/*
+    @brief Function to replay a capture held in memory through the driver
+
+    @param[in] data Capture file contents
+
+    @param[in] size Size, in bytes, of data
+
+    @param[in] handlers Handlers indexed by the sensor_id recorded in the capture, entries may be NULL
+
+    @param[in] handler_count Number of entries in handlers
+
+    @param[in] realtime true to reproduce the original timing, false to replay at maximum speed
+
+    @param[out] stats Replay results, may be NULL
+
+    @note Detach any capture from the handlers first, replayed responses go through explorir_update_data()
+
+    @ret ExplorIr return code, EXPLORIR_ERR_INVALID_INPUT if the capture is invalid or truncated
+*/
+explorir_retcode_t explorir_replay(const uint8_t * data, size_t size, explorir_handler_t ** handlers, uint16_t handler_count,
+	bool realtime, explorir_replay_stats_t * stats) {
+    explorir_replay_stats_t local;
+    if(stats == NULL)
+	stats = &local;
+    memset(stats, 0, sizeof(*stats));
+
+    if(size < EXPLORIR_CAPTURE_FILE_HEADER_SIZE || memcmp(data, "EXCP", 4) != 0 || data[4] != EXPLORIR_CAPTURE_VERSION)
+	return EXPLORIR_ERR_INVALID_INPUT;
+
+    uint64_t start_ns = monotonic_ns();
+    size_t pos = EXPLORIR_CAPTURE_FILE_HEADER_SIZE;
+    while(pos < size) {
+	if(size - pos < EXPLORIR_CAPTURE_RECORD_HEADER_SIZE)
+	    return EXPLORIR_ERR_INVALID_INPUT;
+	const uint8_t * header = &data[pos];
+	uint64_t timestamp_us = 0;
+	for(uint8_t b = 0; b < 8; b++) {
+	    timestamp_us |= (uint64_t)header[b] << (8 * b);
+	}
+	uint8_t sensor_id = header[8];
+	uint8_t direction = header[9];
+	uint8_t record_size = header[10];
+	pos += EXPLORIR_CAPTURE_RECORD_HEADER_SIZE;
+	if(size - pos < record_size)
+	    return EXPLORIR_ERR_INVALID_INPUT;
+
+	if(direction == EXPLORIR_TX) {
+	    stats->commands++;
+	} else if(sensor_id >= handler_count || handlers[sensor_id] == NULL || record_size > handlers[sensor_id]->explorir_data_size) {
+	    stats->skipped++;
+	} else {
+	    if(realtime)
+		explorir_replay_wait(start_ns, timestamp_us);
+	    explorir_handler_t * explorir_handler = handlers[sensor_id];
+	    explorir_update_data((uint8_t *)&data[pos], record_size, explorir_handler);
+	    explorir_process_response(explorir_handler);
+	    stats->responses++;
+	    stats->bytes += record_size;
+	}
+	pos += record_size;
+    }
+    stats->elapsed_ns = monotonic_ns() - start_ns;
+
+    return EXPLORIR_SUCCESS;
+}
@@ -0,0 +1,109 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_capture.h
+
+  @Summary
+    Raw UART capture and deterministic replay for ExplorIr handlers (POSIX hosts)
+
+  @Description
+    Records every command and response of one or more handlers with a
+    microsecond timestamp, and feeds a recording back through the driver
+    either with its original timing or as fast as possible. Maximum speed
+    replay doubles as a parser throughput benchmark on real traffic.
+
+    Capture file layout (little endian):
+
+	file header   "EXCP" | version u8 | reserved u8 u8 u8
+	record        timestamp_us u64 | sensor_id u8 | direction u8 | size u8 | size bytes
+******************************************************************************/
+
+#ifndef EXPLORIR_CAPTURE_H
+#define EXPLORIR_CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "explorir.h"
+
+#if !EXPLORIR_FEATURE_TRAFFIC_HOOK
+#error "explorir_capture.h needs EXPLORIR_FEATURE_TRAFFIC_HOOK"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EXPLORIR_CAPTURE_VERSION 1
+#define EXPLORIR_CAPTURE_FILE_HEADER_SIZE 8
+#define EXPLORIR_CAPTURE_RECORD_HEADER_SIZE 11
+
+// @brief capture sink, one can be shared by every handler on a gateway, also by handlers on different threads
+typedef struct {
+    FILE * file;
+    uint64_t start_us; // monotonic time the capture started
+    bool failed; // a record was cut short, nothing is written after it, the file replays up to the record before
+} explorir_capture_t;
+
+// @brief replay results
+typedef struct {
+    uint32_t responses; // RX records fed through explorir_process_response()
+    uint32_t commands; // TX records skipped, the driver regenerates its own commands
+    uint32_t skipped; // records for sensor ids without a handler, or larger than the receive buffer
+    uint64_t bytes; // RX bytes parsed
+    uint64_t elapsed_ns; // wall time spent replaying
+} explorir_replay_stats_t;
+
+/*
+    @brief Function to start a capture
+
+    @param[in] file Open, writable file, e.g. fopen(path, "wb")
+
+    @ret ExplorIr return code, EXPLORIR_ERR_INVALID_INPUT if the header cannot be written
+*/
+explorir_retcode_t explorir_capture_start(explorir_capture_t * capture, FILE * file);
+
+/*
+    @brief Function to attach a capture to a handler
+
+    @note Sets explorir_on_traffic and traffic_context, the handler's sensor_id tags its records
+*/
+void explorir_capture_attach(explorir_capture_t * capture, explorir_handler_t * explorir_handler);
+
+/*
+    @brief Traffic callback adapter, appends one record to the capture in context
+
+    @note Each record is written by a single fwrite() with the stream locked, records of handlers on other
+	    threads never interleave. A short write latches failed.
+*/
+void explorir_capture_on_traffic(explorir_direction_t direction, const uint8_t * data, uint8_t size, uint8_t sensor_id, void * context);
+
+/*
+    @brief Function to replay a capture held in memory through the driver
+
+    @param[in] data Capture file contents
+
+    @param[in] size Size, in bytes, of data
+
+    @param[in] handlers Handlers indexed by the sensor_id recorded in the capture, entries may be NULL
+
+    @param[in] handler_count Number of entries in handlers
+
+    @param[in] realtime true to reproduce the original timing, false to replay at maximum speed
+
+    @param[out] stats Replay results, may be NULL
+
+    @note Detach any capture from the handlers first, replayed responses go through explorir_update_data()
+
+    @ret ExplorIr return code, EXPLORIR_ERR_INVALID_INPUT if the capture is invalid or truncated
+*/
+explorir_retcode_t explorir_replay(const uint8_t * data, size_t size, explorir_handler_t ** handlers, uint16_t handler_count,
+	bool realtime, explorir_replay_stats_t * stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXPLORIR_CAPTURE_H
@@ -0,0 +1,416 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_coro.hpp
+
+  @Summary
+    C++20 coroutine API for ExplorIr sensor commands
+
+  @Description
+    Awaitable versions of the explorir_request_* and explorir_set_* commands
+    on top of the non-blocking queue in explorir_async.h. A coroutine that
+    co_awaits a command is suspended until the reply is parsed or the
+    command times out, so thousands of command sequences across sensors can
+    be in flight on one thread without callbacks:
+
+	explorir::Task<> calibrate(explorir::AsyncSensor<Port> & sensor) {
+	    co_await sensor.set_operation_mode(EXPLORIR_MODE_COMMAND);
+	    co_await sensor.set_zero_point_in_fresh_air();
+	    co_await sensor.sleep(2000);
+	    auto ppm = co_await sensor.request_filtered_co2();
+	}
+
+    The event loop passes received lines to AsyncSensor::process() and calls
+    AsyncSensor::tick() regularly. Commands are still encoded by the C
+    functions and replies decoded by explorir_parse_response().
+******************************************************************************/
+
+#ifndef EXPLORIR_CORO_HPP
+#define EXPLORIR_CORO_HPP
+
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <utility>
+#include "explorir.hpp"
+#include "explorir_async.h"
+
+namespace explorir {
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+// @brief resumes whoever awaited the task once it finishes
+struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+	auto continuation = handle.promise().continuation;
+	return continuation ? continuation : std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+};
+
+struct PromiseBase {
+    std::coroutine_handle<> continuation;
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() const noexcept { std::terminate(); }
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+    std::optional<T> value;
+    Task<T> get_return_object() noexcept;
+    void return_value(T v) { value = std::move(v); }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+    Task<void> get_return_object() noexcept;
+    void return_void() const noexcept {}
+};
+
+} // namespace detail
+
+// @brief lazily started coroutine, co_await it from another task or start() it from the event loop
+template <typename T>
+class [[nodiscard]] Task {
+public:
+    using promise_type = detail::Promise<T>;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) noexcept : handle_(handle) {}
+    Task(Task && other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    Task & operator=(Task && other) noexcept {
+	if(this != &other) {
+	    if(handle_)
+		handle_.destroy();
+	    handle_ = std::exchange(other.handle_, nullptr);
+	}
+	return *this;
+    }
+    Task(const Task &) = delete;
+    Task & operator=(const Task &) = delete;
+    ~Task() {
+	if(handle_)
+	    handle_.destroy();
+    }
+
+    // @brief runs the task up to its first suspension, for top-level tasks
+    void start() { handle_.resume(); }
+    bool done() const noexcept { return handle_.done(); }
+
+    // @brief value of a finished top-level task
+    template <typename U = T, typename = std::enable_if_t<!std::is_void_v<U>>>
+    const U & result() const { return *handle_.promise().value; }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+	handle_.promise().continuation = awaiting;
+	return handle_;
+    }
+    T await_resume() {
+	if constexpr(!std::is_void_v<T>)
+	    return std::move(*handle_.promise().value);
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle_;
+};
+
+template <typename T>
+Task<T> detail::Promise<T>::get_return_object() noexcept {
+    return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> detail::Promise<void>::get_return_object() noexcept {
+    return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+/*
+    @brief Awaitable command, Issue queues the command through a C function and Read fetches the value from the
+	    handler once the reply is parsed
+*/
+template <typename T, typename Issue, typename Read>
+class Command {
+public:
+    Command(explorir_async_t & async, Issue issue, Read read) : async_(async), issue_(std::move(issue)), read_(std::move(read)) {}
+    // the queue keeps a pointer to a queued command, a task destroyed while awaiting it must not be resumed
+    ~Command() {
+	if(queued_)
+	    explorir_async_forget(&async_, this);
+    }
+    Command(const Command &) = delete;
+    Command & operator=(const Command &) = delete;
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> awaiting) {
+	awaiting_ = awaiting;
+	suspending_ = true;
+	explorir_async_next(&async_, &Command::complete, this);
+	explorir_retcode_t queued = issue_(async_.explorir_handler);
+	suspending_ = false;
+	if(queued != EXPLORIR_SUCCESS) {
+	    // rejected before it was queued, e.g. invalid input or a full queue
+	    explorir_async_next(&async_, nullptr, nullptr);
+	    result_ = queued;
+	    return false;
+	}
+	queued_ = !completed_;
+	return !completed_; // a transport answering from inside write() completes it before it suspends
+    }
+
+    Result<T> await_resume() {
+	if(result_ != EXPLORIR_SUCCESS)
+	    return Error{result_};
+	if constexpr(std::is_void_v<T>)
+	    return {};
+	else
+	    return read_(*async_.explorir_handler);
+    }
+
+private:
+    static void complete(explorir_retcode_t result, explorir_handler_t *, void * context) {
+	auto * self = static_cast<Command *>(context);
+	self->result_ = result;
+	self->queued_ = false;
+	if(self->suspending_)
+	    self->completed_ = true; // still inside await_suspend(), which returns false to resume
+	else
+	    self->awaiting_.resume();
+    }
+
+    explorir_async_t & async_;
+    Issue issue_;
+    Read read_;
+    std::coroutine_handle<> awaiting_;
+    explorir_retcode_t result_ = EXPLORIR_SUCCESS;
+    bool suspending_ = false;
+    bool completed_ = false;
+    bool queued_ = false; // in the queue with this as the callback's context
+};
+
+// @brief awaitable pause in a sensor's command sequence
+class Sleep {
+public:
+    Sleep(explorir_async_t & async, uint32_t delay_ms) : async_(async), delay_ms_(delay_ms) {}
+    ~Sleep() {
+	if(queued_)
+	    explorir_async_forget(&async_, this);
+    }
+    Sleep(const Sleep &) = delete;
+    Sleep & operator=(const Sleep &) = delete;
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> awaiting) {
+	awaiting_ = awaiting;
+	suspending_ = true;
+	explorir_retcode_t queued = explorir_async_delay(&async_, delay_ms_, &Sleep::complete, this);
+	suspending_ = false;
+	if(queued != EXPLORIR_SUCCESS) {
+	    result_ = queued;
+	    return false;
+	}
+	queued_ = !completed_;
+	return !completed_; // a 0 ms sleep on an empty queue completes before it suspends
+    }
+    Result<void> await_resume() const {
+	if(result_ != EXPLORIR_SUCCESS)
+	    return Error{result_};
+	return {};
+    }
+
+private:
+    static void complete(explorir_retcode_t result, explorir_handler_t *, void * context) {
+	auto * self = static_cast<Sleep *>(context);
+	self->result_ = result;
+	self->queued_ = false;
+	if(self->suspending_)
+	    self->completed_ = true; // still inside await_suspend(), which returns false to resume
+	else
+	    self->awaiting_.resume();
+    }
+
+    explorir_async_t & async_;
+    uint32_t delay_ms_;
+    std::coroutine_handle<> awaiting_;
+    explorir_retcode_t result_ = EXPLORIR_SUCCESS;
+    bool suspending_ = false;
+    bool completed_ = false;
+    bool queued_ = false; // in the queue with this as the callback's context
+};
+
+/*
+    @brief ExplorIr sensor with awaitable commands on a transport chosen at compile time
+
+    @note Transport needs void write(const uint8_t * data, std::size_t size), received lines are handed to process()
+*/
+template <typename Transport, std::size_t Capacity = 8>
+class AsyncSensor {
+public:
+    template <typename... Args>
+    AsyncSensor(uint8_t sensor_id, uint32_t timeout_ms, Args &&... transport_args) : transport_(std::forward<Args>(transport_args)...) {
+	handler_.sensor_id = sensor_id;
+	handler_.explorir_tx = &AsyncSensor::unused_tx;
+	explorir_async_init(&async_, &handler_, requests_.data(), static_cast<uint8_t>(Capacity), timeout_ms);
+	async_.tx = &AsyncSensor::transmit;
+	async_.tx_context = this;
+    }
+    ~AsyncSensor() { explorir_async_deinit(&async_); }
+
+    // the queue and the C modules keep pointers into the sensor, so it never moves
+    AsyncSensor(const AsyncSensor &) = delete;
+    AsyncSensor & operator=(const AsyncSensor &) = delete;
+    AsyncSensor(AsyncSensor &&) = delete;
+    AsyncSensor & operator=(AsyncSensor &&) = delete;
+
+    explorir_handler_t & handler() noexcept { return handler_; }
+    Transport & transport() noexcept { return transport_; }
+
+    // @brief event loop side: a line received from this sensor
+    void process(const uint8_t * data, uint16_t size) { explorir_async_process(&async_, data, size); }
+    // @brief event loop side: timeouts, retry backoff and sleeps
+    void tick(uint32_t now_ms) { explorir_async_tick(&async_, now_ms); }
+    bool idle() const noexcept { return explorir_async_idle(&async_); }
+
+    auto sleep(uint32_t delay_ms) { return Sleep(async_, delay_ms); }
+
+    auto request_filtered_co2() {
+	return command<uint32_t>(explorir_request_filtered_co2, [](const explorir_handler_t & h) { return h.current_filtered_co2; });
+    }
+    auto request_unfiltered_co2() {
+	return command<uint32_t>(explorir_request_unfiltered_co2, [](const explorir_handler_t & h) { return h.current_unfiltered_co2; });
+    }
+    auto request_scaling_factor() {
+	return command<uint16_t>(explorir_request_scaling_factor, [](const explorir_handler_t & h) { return h.scaling_factor; });
+    }
+    auto set_operation_mode(explorir_mode_t mode) {
+	return command<explorir_mode_t>([mode](explorir_handler_t * h) { return explorir_set_operation_mode(mode, h); },
+		[](const explorir_handler_t & h) { return static_cast<explorir_mode_t>(h.current_mode); });
+    }
+    auto set_digital_filter(uint16_t filter) {
+	return command<uint16_t>([filter](explorir_handler_t * h) { return explorir_set_digital_filter(filter, h); }, digital_filter);
+    }
+    auto request_digital_filter() { return command<uint16_t>(explorir_request_digital_filter, digital_filter); }
+    auto set_zero_point_in_fresh_air() { return command<uint32_t>(explorir_set_zero_point_in_fresh_air, zero_point); }
+    auto set_zero_point_in_nitrogen() { return command<uint32_t>(explorir_set_zero_point_in_nitrogen, zero_point); }
+    auto set_zero_point_manually(uint32_t value) {
+	return command<uint32_t>([value](explorir_handler_t * h) { return explorir_set_zero_point_manually(value, h); }, zero_point);
+    }
+    auto set_zero_point_using_known_co2(uint32_t co2_concentration) {
+	return command<uint32_t>([co2_concentration](explorir_handler_t * h) {
+	    return explorir_set_zero_point_using_known_co2(co2_concentration, h); }, zero_point);
+    }
+    auto set_zero_point_using_known_reading(uint32_t reported, uint32_t actual) {
+	return command<uint32_t>([reported, actual](explorir_handler_t * h) {
+	    return explorir_set_zero_point_using_known_reading(reported, actual, h); }, zero_point);
+    }
+    // @brief "P 8 #" then "P 9 #", completes with the second reply
+    Task<Result<void>> set_co2_for_auto_zeroing(uint32_t co2_concentration) {
+	return set_two_byte_parameter(AUTO_ZERO_CO2_MSB_REGISTER, co2_concentration);
+    }
+    // @brief "P 10 #" then "P 11 #", completes with the second reply
+    Task<Result<void>> set_co2_for_zero_point_in_fresh_air(uint32_t co2_concentration) {
+	return set_two_byte_parameter(FRESH_AIR_CO2_MSB_REGISTER, co2_concentration);
+    }
+    auto set_pressure_and_concentration_compensation(uint16_t value) {
+	return command<uint16_t>([value](explorir_handler_t * h) { return explorir_set_pressure_and_concentration_compensation(value, h); },
+		compensation);
+    }
+    auto request_pressure_and_concentration_compensation() {
+	return command<uint16_t>(explorir_request_pressure_and_concetration_compensation, compensation);
+    }
+    auto set_output_data_filtered() { return command<void>(explorir_set_output_data_filtered, nothing); }
+    auto set_output_data_unfiltered() { return command<void>(explorir_set_output_data_unfiltered, nothing); }
+    auto set_output_data_all() { return command<void>(explorir_set_output_data_all, nothing); }
+    auto request_output_data_fields() { return command<void>(explorir_request_output_data_fields, nothing); }
+    auto request_sensor_info() {
+	return command<explorir_info_t>(explorir_request_sensor_info, [](const explorir_handler_t & h) { return h.info; });
+    }
+    auto request_auto_zero_config() { return command<void>(explorir_request_auto_zero_config, nothing); }
+    auto disable_auto_zeroing() { return command<void>(explorir_disable_auto_zeroing, nothing); }
+    auto start_auto_zero() { return command<void>(explorir_start_auto_zero, nothing); }
+    auto set_auto_zero_intervals(uint8_t initial, uint8_t regular) {
+	return command<void>([initial, regular](explorir_handler_t * h) { return explorir_set_auto_zero_intervals(initial, regular, h); },
+		nothing);
+    }
+    auto set_auto_zero_intervals_tenths(uint16_t initial, uint16_t regular) {
+	return command<void>([initial, regular](explorir_handler_t * h) {
+	    return explorir_set_auto_zero_intervals_tenths(initial, regular, h); }, nothing);
+    }
+
+    /*
+	@brief Initialization sequence, same steps as explorir_init()
+
+	@ret First error of the sequence, the remaining steps are skipped
+    */
+    Task<Result<void>> init() {
+	if(auto r = co_await set_operation_mode(EXPLORIR_MODE_COMMAND); !r)
+	    co_return Error{r.error()};
+	if(auto r = co_await request_sensor_info(); !r)
+	    co_return Error{r.error()};
+	if(auto r = co_await request_scaling_factor(); !r)
+	    co_return Error{r.error()};
+	if(auto r = co_await set_digital_filter(DIGITAL_FILTER_DEFAULT); !r)
+	    co_return Error{r.error()};
+	if(auto r = co_await request_pressure_and_concentration_compensation(); !r)
+	    co_return Error{r.error()};
+	if(auto r = co_await set_output_data_all(); !r)
+	    co_return r;
+	if(auto r = co_await set_operation_mode(EXPLORIR_MODE_DEFAULT); !r)
+	    co_return Error{r.error()};
+	handler_.current_filtered_co2 = 0;
+	handler_.current_unfiltered_co2 = 0;
+	co_return Result<void>();
+    }
+
+private:
+    static void unused_tx(unsigned char *, uint8_t) {} // every command goes through transport_
+
+    static void transmit(const unsigned char * msg, uint8_t size, void * context) {
+	static_cast<AsyncSensor *>(context)->transport_.write(msg, size);
+    }
+
+    // @brief one half of a two-byte 'P' parameter, queued as a command of its own so it can be awaited
+    auto parameter_byte(explorir_args_t half, uint8_t msb_register, uint32_t value) {
+	return command<void>([half, msb_register, value](explorir_handler_t * h) {
+	    unsigned char msg[EXPLORIR_MAX_COMMAND];
+	    uint8_t reg = half == EXPLORIR_ARGS_MSB ? msb_register : static_cast<uint8_t>(msb_register + 1);
+	    uint8_t size = explorir_encode_command(msg, SET_CO2_BGROUND_CONCENTRATION, half, reg, value);
+	    return h->explorir_submit(msg, size, h->submit_context); }, nothing);
+    }
+
+    Task<Result<void>> set_two_byte_parameter(uint8_t msb_register, uint32_t value) {
+	if(value > MAX_TWO_BYTE_VALUE)
+	    co_return Error{EXPLORIR_ERR_INVALID_INPUT};
+	if(auto r = co_await parameter_byte(EXPLORIR_ARGS_MSB, msb_register, value); !r)
+	    co_return r;
+	co_return co_await parameter_byte(EXPLORIR_ARGS_LSB, msb_register, value);
+    }
+
+    static uint16_t digital_filter(const explorir_handler_t & h) { return static_cast<uint16_t>(h.digital_filter); }
+    static uint32_t zero_point(const explorir_handler_t & h) { return h.zero_point; }
+    static uint16_t compensation(const explorir_handler_t & h) { return static_cast<uint16_t>(h.pressure_and_concentration_compensation); }
+    static int nothing(const explorir_handler_t &) { return 0; }
+
+    template <typename T, typename Issue, typename Read>
+    Command<T, Issue, Read> command(Issue issue, Read read) {
+	return Command<T, Issue, Read>(async_, std::move(issue), std::move(read));
+    }
+
+    explorir_handler_t handler_{};
+    explorir_async_t async_{};
+    std::array<explorir_async_request_t, Capacity> requests_{};
+    Transport transport_;
+};
+
+} // namespace explorir
+
+#endif // EXPLORIR_CORO_HPP
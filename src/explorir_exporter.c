@@ -0,0 +1,374 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_exporter.c
+
+  @Summary
+    OpenMetrics (Prometheus) exporter for ExplorIr handlers (POSIX hosts)
+
+  @Description
+    Implements the sequence locked snapshots, the OpenMetrics rendering and
+    a minimal single threaded HTTP server
+******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <poll.h>
+#include <sched.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "explorir_exporter.h"
+
+#define EXPLORIR_EXPORTER_PAGE_BASE 512
+#define EXPLORIR_EXPORTER_PAGE_PER_SENSOR 2560
+#define EXPLORIR_EXPORTER_REQUEST_SIZE 2048
+
+// @brief output of one render, counts the full length even when the page is too small
+typedef struct {
+    char * page;
+    size_t size;
+    size_t len;
+} explorir_exporter_text_t;
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void explorir_exporter_printf(explorir_exporter_text_t * text, const char * format, ...) {
+    va_list args;
+    va_start(args, format);
+    size_t left = text->len < text->size ? text->size - text->len : 0;
+    int written = vsnprintf(left ? text->page + text->len : NULL, left, format, args);
+    va_end(args);
+    if(written > 0)
+	text->len += (size_t)written;
+}
+
+// @brief copies a slot's snapshot, retries while the RX thread is writing it
+static void explorir_exporter_read(explorir_exporter_slot_t * slot, explorir_exporter_snapshot_t * snapshot) {
+    for(;;) {
+	uint32_t begin = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+	if(begin & 1) {
+	    sched_yield();
+	    continue;
+	}
+	memcpy(snapshot, &slot->snapshot, sizeof(*snapshot));
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if(__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == begin)
+	    return;
+    }
+}
+
+/*
+    @brief Function to initialize an exporter
+
+    @param[in] slots Storage for registered sensors
+
+    @param[in] capacity Number of elements in slots
+*/
+void explorir_exporter_init(explorir_exporter_t * exporter, explorir_exporter_slot_t * slots, uint16_t capacity) {
+    memset(exporter, 0, sizeof(*exporter));
+    memset(slots, 0, sizeof(*slots) * capacity);
+    exporter->slots = slots;
+    exporter->capacity = capacity;
+    exporter->listen_fd = -1;
+}
+
+/*
+    @brief Function to register a sensor, labeled with its sensor_id
+
+    @note Register every sensor before explorir_exporter_start()
+
+    @ret EXPLORIR_SUCCESS, or EXPLORIR_ERR_BUSY if every slot is taken
+*/
+explorir_retcode_t explorir_exporter_add(explorir_exporter_t * exporter, explorir_handler_t * explorir_handler) {
+    if(exporter->count == exporter->capacity)
+	return EXPLORIR_ERR_BUSY;
+    explorir_exporter_slot_t * slot = &exporter->slots[exporter->count++];
+    slot->explorir_handler = explorir_handler;
+    slot->snapshot.sensor_id = explorir_handler->sensor_id;
+    slot->snapshot.err_code = EXPLORIR_ERR_TIMEOUT; // nothing published yet
+    return EXPLORIR_SUCCESS;
+}
+
+/*
+    @brief Function to publish the current state of every registered handler
+
+    @note Call from the thread that parses the handlers' responses, never blocks
+*/
+void explorir_exporter_publish(explorir_exporter_t * exporter) {
+    for(uint16_t s = 0; s < exporter->count; s++) {
+	explorir_exporter_slot_t * slot = &exporter->slots[s];
+	const explorir_handler_t * explorir_handler = slot->explorir_handler;
+	uint32_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	slot->snapshot.filtered_ppm = explorir_handler->current_filtered_co2;
+	slot->snapshot.unfiltered_ppm = explorir_handler->current_unfiltered_co2;
+	slot->snapshot.sample_count = explorir_handler->sample_count;
+	slot->snapshot.err_code = explorir_handler->err_code;
+	slot->snapshot.current_mode = explorir_handler->current_mode;
+	slot->snapshot.sensor_id = explorir_handler->sensor_id;
+	slot->snapshot.has_stats = explorir_handler->stats != NULL;
+	if(explorir_handler->stats)
+	    slot->snapshot.stats = *explorir_handler->stats;
+
+	__atomic_store_n(&slot->sequence, sequence + 2, __ATOMIC_RELEASE);
+    }
+}
+
+// @brief one counter family over every sensor with stats, field is the offset of the counter in explorir_stats_t
+static void explorir_exporter_counter(explorir_exporter_t * exporter, explorir_exporter_text_t * text, const char * name,
+	const char * help, size_t field) {
+    explorir_exporter_printf(text, "# TYPE %s counter\n# HELP %s %s\n", name, name, help);
+    for(uint16_t s = 0; s < exporter->count; s++) {
+	const explorir_exporter_snapshot_t * snapshot = &exporter->slots[s].scraped;
+	if(snapshot->has_stats) {
+	    uint32_t value;
+	    memcpy(&value, (const uint8_t *)&snapshot->stats + field, sizeof(value));
+	    explorir_exporter_printf(text, "%s_total{sensor=\"%u\"} %u\n", name, snapshot->sensor_id, value);
+	}
+    }
+}
+
+/*
+    @brief Function to render the published state in OpenMetrics text format
+
+    @param[out] page Receives the text, always terminated
+
+    @ret Length of the full text, larger than or equal to size if it was truncated
+
+    @note Lines per second are measured from the last render that fit, a truncated one doesn't count as a scrape
+
+    @note Called by the server thread for every scrape, call it yourself only when the server isn't running
+*/
+size_t explorir_exporter_render(explorir_exporter_t * exporter, char * page, size_t size) {
+    explorir_exporter_text_t text = {.page = page, .size = size};
+    uint64_t now_ns = monotonic_ns();
+    if(size)
+	page[0] = '\0';
+
+    for(uint16_t s = 0; s < exporter->count; s++) {
+	explorir_exporter_read(&exporter->slots[s], &exporter->slots[s].scraped);
+    }
+
+    explorir_exporter_printf(&text, "# TYPE explorir_co2_ppm gauge\n# UNIT explorir_co2_ppm ppm\n"
+	    "# HELP explorir_co2_ppm Latest CO2 concentration\n");
+    for(uint16_t s = 0; s < exporter->count; s++) {
+	const explorir_exporter_snapshot_t * snapshot = &exporter->slots[s].scraped;
+	explorir_exporter_printf(&text, "explorir_co2_ppm{sensor=\"%u\",field=\"filtered\"} %u\n", snapshot->sensor_id, snapshot->filtered_ppm);
+	explorir_exporter_printf(&text, "explorir_co2_ppm{sensor=\"%u\",field=\"unfiltered\"} %u\n", snapshot->sensor_id, snapshot->unfiltered_ppm);
+    }
+    explorir_exporter_printf(&text, "# TYPE explorir_up gauge\n# HELP explorir_up 1 if the last command or line succeeded\n");
+    for(uint16_t s = 0; s < exporter->count; s++) {
+	const explorir_exporter_snapshot_t * snapshot = &exporter->slots[s].scraped;
+	explorir_exporter_printf(&text, "explorir_up{sensor=\"%u\"} %d\n", snapshot->sensor_id, snapshot->err_code == EXPLORIR_SUCCESS);
+    }
+    explorir_exporter_printf(&text, "# TYPE explorir_error_code gauge\n# HELP explorir_error_code explorir_retcode_t of the last command or line\n");
+    for(uint16_t s = 0; s < exporter->count; s++) {
+	const explorir_exporter_snapshot_t * snapshot = &exporter->slots[s].scraped;
+	explorir_exporter_printf(&text, "explorir_error_code{sensor=\"%u\"} %u\n", snapshot->sensor_id, snapshot->err_code);
+    }
+    explorir_exporter_printf(&text, "# TYPE explorir_mode gauge\n# HELP explorir_mode Operation mode, 0 command, 1 streaming, 2 polling\n");
+    for(uint16_t s = 0; s < exporter->count; s++) {
+	const explorir_exporter_snapshot_t * snapshot = &exporter->slots[s].scraped;
+	explorir_exporter_printf(&text, "explorir_mode{sensor=\"%u\"} %u\n", snapshot->sensor_id, snapshot->current_mode);
+    }
+    explorir_exporter_printf(&text, "# TYPE explorir_samples counter\n# HELP explorir_samples Measurement lines decoded\n");
+    for(uint16_t s = 0; s < exporter->count; s++) {
+	const explorir_exporter_snapshot_t * snapshot = &exporter->slots[s].scraped;
+	explorir_exporter_printf(&text, "explorir_samples_total{sensor=\"%u\"} %u\n", snapshot->sensor_id, snapshot->sample_count);
+    }
+
+    explorir_exporter_counter(exporter, &text, "explorir_lines", "Response lines parsed", offsetof(explorir_stats_t, lines));
+    explorir_exporter_counter(exporter, &text, "explorir_parse_errors", "Lines with a malformed field",
+	    offsetof(explorir_stats_t, parse_errors));
+    explorir_exporter_counter(exporter, &text, "explorir_unrecognized", "Commands answered with '?'",
+	    offsetof(explorir_stats_t, unrecognized));
+    explorir_exporter_counter(exporter, &text, "explorir_timeouts", "Command attempts without a reply",
+	    offsetof(explorir_stats_t, timeouts));
+    explorir_exporter_counter(exporter, &text, "explorir_commands", "Command attempts transmitted",
+	    offsetof(explorir_stats_t, commands));
+
+    explorir_exporter_printf(&text, "# TYPE explorir_lines_per_second gauge\n# HELP explorir_lines_per_second Lines parsed per second since the previous scrape\n");
+    for(uint16_t s = 0; s < exporter->count; s++) {
+	explorir_exporter_slot_t * slot = &exporter->slots[s];
+	const explorir_exporter_snapshot_t * snapshot = &slot->scraped;
+	if(!snapshot->has_stats)
+	    continue;
+	double rate = 0;
+	if(slot->last_scrape_ns && now_ns > slot->last_scrape_ns)
+	    rate = (uint32_t)(snapshot->stats.lines - slot->last_lines) * 1e9 / (double)(now_ns - slot->last_scrape_ns);
+	explorir_exporter_printf(&text, "explorir_lines_per_second{sensor=\"%u\"} %.3f\n", snapshot->sensor_id, rate);
+    }
+
+    explorir_exporter_printf(&text, "# TYPE explorir_command_latency_seconds histogram\n# UNIT explorir_command_latency_seconds seconds\n"
+	    "# HELP explorir_command_latency_seconds Time from transmitting a command to parsing its reply\n");
+    for(uint16_t s = 0; s < exporter->count; s++) {
+	const explorir_exporter_snapshot_t * snapshot = &exporter->slots[s].scraped;
+	if(!snapshot->has_stats)
+	    continue;
+	uint32_t cumulative = 0;
+	for(uint8_t b = 0; b < EXPLORIR_STATS_LATENCY_BUCKETS; b++) {
+	    cumulative += snapshot->stats.latency_buckets[b];
+	    if(b < EXPLORIR_STATS_LATENCY_BUCKETS - 1)
+		explorir_exporter_printf(&text, "explorir_command_latency_seconds_bucket{sensor=\"%u\",le=\"%g\"} %u\n", snapshot->sensor_id,
+			explorir_stats_latency_bounds_ms[b] / 1000.0, cumulative);
+	    else
+		explorir_exporter_printf(&text, "explorir_command_latency_seconds_bucket{sensor=\"%u\",le=\"+Inf\"} %u\n", snapshot->sensor_id,
+			cumulative);
+	}
+	explorir_exporter_printf(&text, "explorir_command_latency_seconds_sum{sensor=\"%u\"} %.3f\n", snapshot->sensor_id,
+		snapshot->stats.latency_sum_ms / 1000.0);
+	explorir_exporter_printf(&text, "explorir_command_latency_seconds_count{sensor=\"%u\"} %u\n", snapshot->sensor_id,
+		snapshot->stats.latency_count);
+    }
+    explorir_exporter_printf(&text, "# EOF\n");
+
+    if(text.len < size) {
+	// only now, so rendering again into a larger page measures the rate over the same interval
+	for(uint16_t s = 0; s < exporter->count; s++) {
+	    explorir_exporter_slot_t * slot = &exporter->slots[s];
+	    if(!slot->scraped.has_stats)
+		continue;
+	    slot->last_lines = slot->scraped.stats.lines;
+	    slot->last_scrape_ns = now_ns;
+	}
+    }
+    return text.len;
+}
+
+// @brief answers one HTTP request on a connected socket
+static void explorir_exporter_serve(explorir_exporter_t * exporter, int fd) {
+    char request[EXPLORIR_EXPORTER_REQUEST_SIZE];
+    size_t len = 0;
+    while(len < sizeof(request) - 1) {
+	struct pollfd pfd = {.fd = fd, .events = POLLIN};
+	if(poll(&pfd, 1, 1000) <= 0)
+	    return;
+	ssize_t received = recv(fd, request + len, sizeof(request) - 1 - len, 0);
+	if(received <= 0)
+	    return;
+	len += (size_t)received;
+	request[len] = '\0';
+	if(strstr(request, "\r\n\r\n") || strstr(request, "\n\n"))
+	    break;
+    }
+
+    char header[256];
+    const char * body = "";
+    size_t body_len = 0;
+    int header_len;
+    if(strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET /metrics?", 13) == 0) {
+	body_len = explorir_exporter_render(exporter, exporter->page, exporter->page_size);
+	if(body_len >= exporter->page_size) {
+	    // more sensors than expected, grow the page and render again
+	    char * page = realloc(exporter->page, body_len + 1);
+	    if(page) {
+		exporter->page = page;
+		exporter->page_size = body_len + 1;
+		body_len = explorir_exporter_render(exporter, exporter->page, exporter->page_size);
+	    }
+	    if(body_len >= exporter->page_size)
+		body_len = exporter->page_size - 1;
+	}
+	body = exporter->page;
+	exporter->scrapes++;
+	header_len = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\n"
+		"Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+		"Content-Length: %zu\r\nConnection: close\r\n\r\n", body_len);
+    } else {
+	body = "not found, see /metrics\n";
+	body_len = strlen(body);
+	header_len = snprintf(header, sizeof(header), "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\n"
+		"Content-Length: %zu\r\nConnection: close\r\n\r\n", body_len);
+    }
+    if(send(fd, header, (size_t)header_len, MSG_NOSIGNAL) != header_len)
+	return;
+    while(body_len) {
+	ssize_t sent = send(fd, body, body_len, MSG_NOSIGNAL);
+	if(sent <= 0)
+	    return;
+	body += sent;
+	body_len -= (size_t)sent;
+    }
+}
+
+static void * explorir_exporter_thread(void * context) {
+    explorir_exporter_t * exporter = context;
+    while(__atomic_load_n(&exporter->running, __ATOMIC_ACQUIRE)) {
+	struct pollfd pfd = {.fd = exporter->listen_fd, .events = POLLIN};
+	if(poll(&pfd, 1, 200) <= 0)
+	    continue; // wake up regularly to notice explorir_exporter_stop()
+	int fd = accept(exporter->listen_fd, NULL, NULL);
+	if(fd < 0)
+	    continue;
+	explorir_exporter_serve(exporter, fd);
+	close(fd);
+    }
+    return NULL;
+}
+
+/*
+    @brief Function to serve /metrics on 127.0.0.1 from a thread of its own
+
+    @param[in] port TCP port, 9464 is customary, 0 picks a free port stored in exporter->port
+
+    @ret EXPLORIR_SUCCESS, or EXPLORIR_ERR_INVALID_INPUT if the port can't be bound or the thread started
+*/
+explorir_retcode_t explorir_exporter_start(explorir_exporter_t * exporter, uint16_t port) {
+    exporter->page_size = EXPLORIR_EXPORTER_PAGE_BASE + (size_t)exporter->count * EXPLORIR_EXPORTER_PAGE_PER_SENSOR;
+    exporter->page = malloc(exporter->page_size);
+    exporter->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(exporter->page == NULL || exporter->listen_fd < 0)
+	goto Failed;
+
+    int reuse = 1;
+    setsockopt(exporter->listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t address_len = sizeof(address);
+    if(bind(exporter->listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(exporter->listen_fd, 8) != 0
+	    || getsockname(exporter->listen_fd, (struct sockaddr *)&address, &address_len) != 0)
+	goto Failed;
+    exporter->port = ntohs(address.sin_port);
+
+    __atomic_store_n(&exporter->running, true, __ATOMIC_RELEASE);
+    if(pthread_create(&exporter->thread, NULL, explorir_exporter_thread, exporter) != 0) {
+	__atomic_store_n(&exporter->running, false, __ATOMIC_RELEASE);
+	goto Failed;
+    }
+    return EXPLORIR_SUCCESS;
+
+    Failed:
+    if(exporter->listen_fd >= 0)
+	close(exporter->listen_fd);
+    exporter->listen_fd = -1;
+    free(exporter->page);
+    exporter->page = NULL;
+    return EXPLORIR_ERR_INVALID_INPUT;
+}
+
+/*
+    @brief Function to stop serving, waits for the server thread
+*/
+void explorir_exporter_stop(explorir_exporter_t * exporter) {
+    if(!__atomic_load_n(&exporter->running, __ATOMIC_ACQUIRE))
+	return;
+    __atomic_store_n(&exporter->running, false, __ATOMIC_RELEASE);
+    pthread_join(exporter->thread, NULL);
+    close(exporter->listen_fd);
+    exporter->listen_fd = -1;
+    free(exporter->page);
+    exporter->page = NULL;
+}
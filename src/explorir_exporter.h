@@ -0,0 +1,135 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_exporter.h
+
+  @Summary
+    OpenMetrics (Prometheus) exporter for ExplorIr handlers (POSIX hosts)
+
+  @Description
+    Serves every registered sensor's CO2 readings, health and driver
+    counters in OpenMetrics text format on a local HTTP endpoint,
+    http://127.0.0.1:<port>/metrics. The thread that owns the handlers
+    publishes their state into per-sensor snapshots guarded by a sequence
+    lock, the exporter's own thread renders scrapes from the snapshots, so a
+    scrape never blocks or slows the RX path.
+
+    explorir.stats = &explorir_stats; // optional, lines, errors, timeouts, latencies
+    explorir_exporter_init(&exporter, slots, 16);
+    explorir_exporter_add(&exporter, &explorir);
+    explorir_exporter_start(&exporter, 9464);
+    ...
+    explorir_exporter_publish(&exporter); // RX thread, e.g. after each batch of lines
+******************************************************************************/
+
+#ifndef EXPLORIR_EXPORTER_H
+#define EXPLORIR_EXPORTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "explorir.h"
+
+#if !EXPLORIR_FEATURE_STATS
+#error "explorir_exporter.h needs EXPLORIR_FEATURE_STATS"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// @brief state of one sensor as published by explorir_exporter_publish()
+typedef struct {
+    uint32_t filtered_ppm;
+    uint32_t unfiltered_ppm;
+    uint32_t sample_count;
+    uint8_t err_code;
+    uint8_t current_mode;
+    uint8_t sensor_id;
+    bool has_stats; // the handler had stats set
+    explorir_stats_t stats;
+} explorir_exporter_snapshot_t;
+
+// @brief one registered sensor
+typedef struct {
+    explorir_handler_t * explorir_handler;
+    uint32_t sequence; // odd while the snapshot is being written, accessed atomically
+    explorir_exporter_snapshot_t snapshot; // written by the RX thread
+    explorir_exporter_snapshot_t scraped; // copy taken by the scrape being rendered
+    uint32_t last_lines; // lines at the previous scrape, for lines per second
+    uint64_t last_scrape_ns;
+} explorir_exporter_slot_t;
+
+// @brief exporter of many sensors, slots live in caller-provided storage
+typedef struct {
+    explorir_exporter_slot_t * slots;
+    uint16_t capacity;
+    uint16_t count;
+    uint16_t port; // bound port, useful when started on port 0
+    int listen_fd;
+    bool running; // accessed atomically
+    pthread_t thread;
+    char * page; // render buffer of the server thread
+    size_t page_size;
+    uint32_t scrapes;
+} explorir_exporter_t;
+
+/*
+    @brief Function to initialize an exporter
+
+    @param[in] slots Storage for registered sensors
+
+    @param[in] capacity Number of elements in slots
+*/
+void explorir_exporter_init(explorir_exporter_t * exporter, explorir_exporter_slot_t * slots, uint16_t capacity);
+
+/*
+    @brief Function to register a sensor, labeled with its sensor_id
+
+    @note Register every sensor before explorir_exporter_start()
+
+    @ret EXPLORIR_SUCCESS, or EXPLORIR_ERR_BUSY if every slot is taken
+*/
+explorir_retcode_t explorir_exporter_add(explorir_exporter_t * exporter, explorir_handler_t * explorir_handler);
+
+/*
+    @brief Function to publish the current state of every registered handler
+
+    @note Call from the thread that parses the handlers' responses, never blocks
+*/
+void explorir_exporter_publish(explorir_exporter_t * exporter);
+
+/*
+    @brief Function to render the published state in OpenMetrics text format
+
+    @param[out] page Receives the text, always terminated
+
+    @ret Length of the full text, larger than or equal to size if it was truncated
+
+    @note Lines per second are measured from the last render that fit, a truncated one doesn't count as a scrape
+
+    @note Called by the server thread for every scrape, call it yourself only when the server isn't running
+*/
+size_t explorir_exporter_render(explorir_exporter_t * exporter, char * page, size_t size);
+
+/*
+    @brief Function to serve /metrics on 127.0.0.1 from a thread of its own
+
+    @param[in] port TCP port, 9464 is customary, 0 picks a free port stored in exporter->port
+
+    @ret EXPLORIR_SUCCESS, or EXPLORIR_ERR_INVALID_INPUT if the port can't be bound or the thread started
+*/
+explorir_retcode_t explorir_exporter_start(explorir_exporter_t * exporter, uint16_t port);
+
+/*
+    @brief Function to stop serving, waits for the server thread
+*/
+void explorir_exporter_stop(explorir_exporter_t * exporter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXPLORIR_EXPORTER_H
@@ -0,0 +1,184 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_filter.c
+
+  @Summary
+    Host-side emulation of the ExplorIr digital filter
+
+  @Description
+    Implements single filters and structure of arrays filter banks over
+    unfiltered ('z') samples
+******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "explorir_filter.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/*
+    @brief Function to convert a digital filter setting into its smoothing coefficient
+
+    @param[in] filter Digital filter value, 0 - 65365
+
+    @ret Coefficient applied to each new sample
+*/
+float explorir_filter_alpha(uint16_t filter) {
+    if(filter <= 1) {
+	return 1.0f; // no smoothing
+    }
+    return 1.0f / (float)filter;
+}
+
+/*
+    @brief Function to initialize a single filter
+
+    @param[in] filter Digital filter value, 0 - 65365
+*/
+void explorir_filter_init(explorir_filter_t * explorir_filter, uint16_t filter) {
+    explorir_filter->alpha = explorir_filter_alpha(filter);
+    explorir_filter->state = 0.0f;
+    explorir_filter->primed = false;
+}
+
+/*
+    @brief Function to push one unfiltered sample through the filter
+
+    @param[in] z Unfiltered sample in raw sensor units
+
+    @ret Filtered value in raw sensor units
+*/
+float explorir_filter_step(explorir_filter_t * explorir_filter, uint16_t z) {
+    float x = (float)z;
+    if(!explorir_filter->primed) {
+	explorir_filter->state = x; // seed with the first sample like the sensor does at power on
+	explorir_filter->primed = true;
+    } else {
+	explorir_filter->state += explorir_filter->alpha * (x - explorir_filter->state);
+    }
+    return explorir_filter->state;
+}
+
+/*
+    @brief Function to filter an array of unfiltered samples
+
+    @param[in] z Unfiltered samples
+
+    @param[out] out Filtered samples, may not alias z
+
+    @param[in] n Number of samples
+*/
+void explorir_filter_run(explorir_filter_t * explorir_filter, const uint16_t * z, float * out, uint32_t n) {
+    if(n == 0) {
+	return;
+    }
+    uint32_t i = 0;
+    if(!explorir_filter->primed) {
+	out[i] = explorir_filter_step(explorir_filter, z[i]);
+	i++;
+    }
+    // keep the recurrence in a register instead of going through the struct every sample
+    float alpha = explorir_filter->alpha;
+    float state = explorir_filter->state;
+    for(; i < n; i++) {
+	state += alpha * ((float)z[i] - state);
+	out[i] = state;
+    }
+    explorir_filter->state = state;
+}
+
+/*
+    @brief Function to initialize a filter bank
+
+    @param[in] filters Digital filter value for each member of the bank
+
+    @param[in] alpha Storage for count coefficients
+
+    @param[in] state Storage for count filter states
+
+    @param[in] count Number of filters in the bank
+
+    @note No memory is allocated, alpha and state must outlive the bank
+*/
+void explorir_filter_bank_init(explorir_filter_bank_t * bank, const uint16_t * filters, float * alpha, float * state, uint16_t count) {
+    bank->alpha = alpha;
+    bank->state = state;
+    bank->count = count;
+    bank->primed = false;
+    for(uint16_t k = 0; k < count; k++) {
+	alpha[k] = explorir_filter_alpha(filters[k]);
+	state[k] = 0.0f;
+    }
+}
+
+/*
+    @brief Function to advance every filter in the bank by one sample
+
+    @param[in] x Unfiltered sample
+
+    @param[out] out count filtered values
+*/
+static void explorir_filter_bank_step(explorir_filter_bank_t * bank, float x, float * out) {
+    float * state = bank->state;
+    const float * alpha = bank->alpha;
+    uint16_t k = 0;
+#if defined(__SSE2__)
+    __m128 vx = _mm_set1_ps(x);
+    for(; k + 4 <= bank->count; k += 4) {
+	__m128 vs = _mm_loadu_ps(&state[k]);
+	__m128 va = _mm_loadu_ps(&alpha[k]);
+	vs = _mm_add_ps(vs, _mm_mul_ps(va, _mm_sub_ps(vx, vs)));
+	_mm_storeu_ps(&state[k], vs);
+	_mm_storeu_ps(&out[k], vs);
+    }
+#elif defined(__ARM_NEON)
+    float32x4_t vx = vdupq_n_f32(x);
+    for(; k + 4 <= bank->count; k += 4) {
+	float32x4_t vs = vld1q_f32(&state[k]);
+	float32x4_t va = vld1q_f32(&alpha[k]);
+	vs = vmlaq_f32(vs, va, vsubq_f32(vx, vs));
+	vst1q_f32(&state[k], vs);
+	vst1q_f32(&out[k], vs);
+    }
+#endif
+    for(; k < bank->count; k++) {
+	state[k] += alpha[k] * (x - state[k]);
+	out[k] = state[k];
+    }
+}
+
+/*
+    @brief Function to run every filter in the bank over an array of unfiltered samples
+
+    @param[in] z Unfiltered samples
+
+    @param[in] n Number of samples
+
+    @param[out] out n * count filtered values, sample major: out[i * count + k] is filter k at sample i
+
+    @note The inner loop walks the filters, which are independent, so it is processed with SSE2 or NEON
+	    when available and falls back to scalar code otherwise
+*/
+void explorir_filter_bank_run(explorir_filter_bank_t * bank, const uint16_t * z, uint32_t n, float * out) {
+    if(n == 0 || bank->count == 0) {
+	return;
+    }
+    uint32_t i = 0;
+    if(!bank->primed) {
+	for(uint16_t k = 0; k < bank->count; k++) {
+	    bank->state[k] = (float)z[0];
+	    out[k] = bank->state[k];
+	}
+	bank->primed = true;
+	i++;
+    }
+    for(; i < n; i++) {
+	explorir_filter_bank_step(bank, (float)z[i], &out[(uint64_t)i * bank->count]);
+    }
+}
@@ -0,0 +1,120 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_filter.h
+
+  @Summary
+    Host-side emulation of the ExplorIr digital filter
+
+  @Description
+    Reproduces the smoothing applied on-device by the 'A' command on unfiltered
+    ('z') samples, so any filter setting can be derived offline from a stream
+    of unfiltered data without reconfiguring live sensors
+******************************************************************************/
+
+#ifndef EXPLORIR_FILTER_H
+#define EXPLORIR_FILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+    The sensor filter is a first order low pass (exponential moving average)
+    where the filter constant is the number of samples it averages over:
+
+	y[n] = y[n-1] + (z[n] - y[n-1]) / filter
+
+    A filter value of 0 or 1 disables smoothing. Outputs are in the same raw
+    units as the 'z' field, multiply by the scaling factor to get ppm.
+*/
+
+// @brief single filter state
+typedef struct {
+    float alpha; // 1 / filter
+    float state; // current filtered value
+    bool primed; // state has been seeded with the first sample
+} explorir_filter_t;
+
+// @brief bank of filters run in lock step over the same input, structure of arrays
+typedef struct {
+    float * alpha; // count coefficients, caller owned
+    float * state; // count filter states, caller owned
+    uint16_t count;
+    bool primed;
+} explorir_filter_bank_t;
+
+/*
+    @brief Function to convert a digital filter setting into its smoothing coefficient
+
+    @param[in] filter Digital filter value, 0 - 65365
+
+    @ret Coefficient applied to each new sample
+*/
+float explorir_filter_alpha(uint16_t filter);
+
+/*
+    @brief Function to initialize a single filter
+
+    @param[in] filter Digital filter value, 0 - 65365
+*/
+void explorir_filter_init(explorir_filter_t * explorir_filter, uint16_t filter);
+
+/*
+    @brief Function to push one unfiltered sample through the filter
+
+    @param[in] z Unfiltered sample in raw sensor units
+
+    @ret Filtered value in raw sensor units
+*/
+float explorir_filter_step(explorir_filter_t * explorir_filter, uint16_t z);
+
+/*
+    @brief Function to filter an array of unfiltered samples
+
+    @param[in] z Unfiltered samples
+
+    @param[out] out Filtered samples, may not alias z
+
+    @param[in] n Number of samples
+*/
+void explorir_filter_run(explorir_filter_t * explorir_filter, const uint16_t * z, float * out, uint32_t n);
+
+/*
+    @brief Function to initialize a filter bank
+
+    @param[in] filters Digital filter value for each member of the bank
+
+    @param[in] alpha Storage for count coefficients
+
+    @param[in] state Storage for count filter states
+
+    @param[in] count Number of filters in the bank
+
+    @note No memory is allocated, alpha and state must outlive the bank
+*/
+void explorir_filter_bank_init(explorir_filter_bank_t * bank, const uint16_t * filters, float * alpha, float * state, uint16_t count);
+
+/*
+    @brief Function to run every filter in the bank over an array of unfiltered samples
+
+    @param[in] z Unfiltered samples
+
+    @param[in] n Number of samples
+
+    @param[out] out n * count filtered values, sample major: out[i * count + k] is filter k at sample i
+
+    @note The inner loop walks the filters, which are independent, so it is processed with SSE2 or NEON
+	    when available and falls back to scalar code otherwise
+*/
+void explorir_filter_bank_run(explorir_filter_bank_t * bank, const uint16_t * z, uint32_t n, float * out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXPLORIR_FILTER_H
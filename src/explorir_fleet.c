@@ -0,0 +1,101 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_fleet.c
+
+  @Summary
+    Latest values of many ExplorIr sensors in parallel arrays
+
+  @Description
+    Implements slot assignment and the scans over every sensor, the parser
+    in explorir.c writes the slots
+******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "explorir_fleet.h"
+
+/*
+    @brief Function to initialize a fleet over caller-provided arrays, every slot starts out empty
+
+    @param[in] capacity Number of elements in each array
+*/
+void explorir_fleet_init(explorir_fleet_t * fleet, uint32_t * filtered_co2, uint32_t * unfiltered_co2, uint32_t * timestamps_ms,
+	uint8_t * status, uint16_t capacity) {
+    memset(fleet, 0, sizeof(*fleet));
+    fleet->filtered_co2 = filtered_co2;
+    fleet->unfiltered_co2 = unfiltered_co2;
+    fleet->timestamps_ms = timestamps_ms;
+    fleet->status = status;
+    fleet->capacity = capacity;
+    memset(filtered_co2, 0, capacity * sizeof(*filtered_co2));
+    memset(unfiltered_co2, 0, capacity * sizeof(*unfiltered_co2));
+    memset(timestamps_ms, 0, capacity * sizeof(*timestamps_ms));
+    memset(status, 0, capacity * sizeof(*status));
+}
+
+/*
+    @brief Function to give a handler the next slot, the parser keeps it up to date from then on
+
+    @note The slot starts out with the handler's current values, fleet_slot of the handler is its index
+
+    @ret EXPLORIR_SUCCESS, or EXPLORIR_ERR_BUSY if every slot is taken
+*/
+explorir_retcode_t explorir_fleet_add(explorir_fleet_t * fleet, explorir_handler_t * explorir_handler) {
+    if(fleet->count == fleet->capacity)
+	return EXPLORIR_ERR_BUSY;
+    uint16_t slot = fleet->count++;
+    fleet->filtered_co2[slot] = explorir_handler->current_filtered_co2;
+    fleet->unfiltered_co2[slot] = explorir_handler->current_unfiltered_co2;
+    fleet->timestamps_ms[slot] = 0;
+    fleet->status[slot] = 0;
+    explorir_handler->fleet_slot = slot;
+    explorir_handler->fleet = fleet;
+    return EXPLORIR_SUCCESS;
+}
+
+/*
+    @brief Function to find the sensors that have gone quiet
+
+    @param[in] now_ms Current time in milliseconds, same clock as explorir_get_time_ms, may wrap
+
+    @param[in] max_age_ms Oldest measurement line still counted as current
+
+    @param[out] slots Slots of the sensors without a measurement line in max_age_ms, or without any yet
+
+    @param[in] max_slots Number of elements in slots
+
+    @ret Number of slots written, at most max_slots
+*/
+uint16_t explorir_fleet_stale(const explorir_fleet_t * fleet, uint32_t now_ms, uint32_t max_age_ms, uint16_t * slots,
+	uint16_t max_slots) {
+    uint16_t found = 0;
+    for(uint16_t k = 0; k < fleet->count && found < max_slots; k++) {
+	// status is 0 until the first line, a malformed one alone doesn't make the sensor current
+	if((fleet->status[k] & (FILTERED_MASK | UNFILTERED_MASK)) == 0 || now_ms - fleet->timestamps_ms[k] > max_age_ms)
+	    slots[found++] = k;
+    }
+    return found;
+}
+
+/*
+    @brief Function to find the sensors whose filtered CO2 is above a threshold, e.g. zones to ventilate
+
+    @param[in] threshold_ppm Filtered CO2 in ppm
+
+    @param[out] slots Slots of the sensors above threshold_ppm
+
+    @param[in] max_slots Number of elements in slots
+
+    @ret Number of slots written, at most max_slots
+*/
+uint16_t explorir_fleet_above(const explorir_fleet_t * fleet, uint32_t threshold_ppm, uint16_t * slots, uint16_t max_slots) {
+    uint16_t found = 0;
+    for(uint16_t k = 0; k < fleet->count && found < max_slots; k++) {
+	if(fleet->filtered_co2[k] > threshold_ppm)
+	    slots[found++] = k;
+    }
+    return found;
+}
@@ -0,0 +1,90 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_fleet.h
+
+  @Summary
+    Latest values of many ExplorIr sensors in parallel arrays
+
+  @Description
+    With thousands of handlers, reading every sensor's current CO2 from its
+    handler touches a cache line of mostly cold fields (hooks, buffer
+    pointer, configuration) per sensor. A fleet keeps only the values that
+    dashboards and control loops scan, filtered and unfiltered ppm, time
+    and status, in one caller-provided array each, so a scan over all
+    sensors streams through consecutive cache lines. Each handler added to
+    the fleet gets a slot, and explorir_process_response() writes the slot
+    as it decodes a measurement line, next to the handler's own fields and
+    without taking the sample hook.
+
+    static uint32_t filtered[N], unfiltered[N], timestamps[N];
+    static uint8_t status[N];
+    explorir_fleet_init(&fleet, filtered, unfiltered, timestamps, status, N);
+    explorir_fleet_add(&fleet, &explorir); // once per handler, slots are handed out in order
+    ...
+    count = explorir_fleet_above(&fleet, 1000, slots, N); // sensors over 1000 ppm
+******************************************************************************/
+
+#ifndef EXPLORIR_FLEET_H
+#define EXPLORIR_FLEET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "explorir.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+    @brief Function to initialize a fleet over caller-provided arrays, every slot starts out empty
+
+    @param[in] capacity Number of elements in each array
+*/
+void explorir_fleet_init(explorir_fleet_t * fleet, uint32_t * filtered_co2, uint32_t * unfiltered_co2, uint32_t * timestamps_ms,
+	uint8_t * status, uint16_t capacity);
+
+/*
+    @brief Function to give a handler the next slot, the parser keeps it up to date from then on
+
+    @note The slot starts out with the handler's current values, fleet_slot of the handler is its index
+
+    @ret EXPLORIR_SUCCESS, or EXPLORIR_ERR_BUSY if every slot is taken
+*/
+explorir_retcode_t explorir_fleet_add(explorir_fleet_t * fleet, explorir_handler_t * explorir_handler);
+
+/*
+    @brief Function to find the sensors that have gone quiet
+
+    @param[in] now_ms Current time in milliseconds, same clock as explorir_get_time_ms, may wrap
+
+    @param[in] max_age_ms Oldest measurement line still counted as current
+
+    @param[out] slots Slots of the sensors without a measurement line in max_age_ms, or without any yet
+
+    @param[in] max_slots Number of elements in slots
+
+    @ret Number of slots written, at most max_slots
+*/
+uint16_t explorir_fleet_stale(const explorir_fleet_t * fleet, uint32_t now_ms, uint32_t max_age_ms, uint16_t * slots,
+	uint16_t max_slots);
+
+/*
+    @brief Function to find the sensors whose filtered CO2 is above a threshold, e.g. zones to ventilate
+
+    @param[in] threshold_ppm Filtered CO2 in ppm
+
+    @param[out] slots Slots of the sensors above threshold_ppm
+
+    @param[in] max_slots Number of elements in slots
+
+    @ret Number of slots written, at most max_slots
+*/
+uint16_t explorir_fleet_above(const explorir_fleet_t * fleet, uint32_t threshold_ppm, uint16_t * slots, uint16_t max_slots);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXPLORIR_FLEET_H
@@ -0,0 +1,205 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_framer.c
+
+  @Summary
+    CRLF line framing with resynchronization for ExplorIr UART streams
+
+  @Description
+    Implements byte-wise framing, response shape validation and recovery
+******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "explorir_framer.h"
+
+static bool is_digit(uint8_t c) {
+    return c >= '0' && c <= '9';
+}
+
+static bool is_alnum(uint8_t c) {
+    return is_digit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+// @brief identifiers of responses made of "<identifier> <digits>" fields
+static bool is_numeric_field(uint8_t c) {
+    switch(c) {
+	case FILTERED_CO2_MEASUREMENT:
+	case UNFILTERED_CO2_MEASUREMENT:
+	case SCALING_FACTOR:
+	case OPERATION_MODE:
+	case SET_DIGITAL_FILTER:
+	case GET_DIGITAL_FILTER:
+	case FINE_TUNE_ZERO_POINT:
+	case SET_ZERO_POINT_USING_FRESH_AIR:
+	case SET_ZERO_POINT_USING_NITROGEN:
+	case MANUALLY_SET_ZERO_POINT:
+	case SET_ZERO_POINT_USING_KNOWN_GAS:
+	case SET_PRESSURE_AND_CONCENTRATION_COMPENSATION:
+	case GET_PRESSURE_AND_CONCENTRATION_COMPENSATION:
+	case SET_TYPE_AND_NUM_OF_DATA_OUTPUTS:
+	case GET_NUM_OF_OUTPUT_DATA_FIELDS:
+	    return true;
+	default:
+	    return false;
+    }
+}
+
+// @brief identifiers of responses with their own layout, only checked for printable ASCII
+static bool is_free_form(uint8_t c) {
+    switch(c) {
+	case SENSOR_INFO:
+	case SENSOR_SERIAL_NUMBER: // second line of the sensor info response
+	case AUTO_ZERO:
+	case SET_CO2_BGROUND_CONCENTRATION:
+	case CO2_BGROUND_CONCENTRATION_REPLY:
+	case UNRECOGNIZED_CMD:
+	    return true;
+	default:
+	    return false;
+    }
+}
+
+/*
+    @brief Function to check that a line, without "\r\n", has the shape of an ExplorIr response
+
+    @note Measurement fields need exactly EXPLORIR_FRAMER_MEASUREMENT_DIGITS digits, other numeric responses
+	    1 - 5 digits, free form responses (Y, @, p, ?) must be printable ASCII
+*/
+bool explorir_frame_is_valid(const uint8_t * line, uint8_t size) {
+    uint8_t i = 0;
+    while(i < size && line[i] == SPACE) {
+	i++;
+    }
+    if(i == size)
+	return false;
+
+    if(is_free_form(line[i])) {
+	for(; i < size; i++) {
+	    if(line[i] < 0x20 || line[i] > 0x7E)
+		return false;
+	}
+	return true;
+    }
+
+    // one or more "<identifier> <digits>" fields separated by spaces
+    while(i < size) {
+	uint8_t identifier = line[i++];
+	if(!is_numeric_field(identifier))
+	    return false;
+	if(i == size || line[i] != SPACE)
+	    return false;
+	while(i < size && line[i] == SPACE) {
+	    i++;
+	}
+	uint8_t digits = 0;
+	while(i < size && is_digit(line[i])) {
+	    digits++;
+	    i++;
+	}
+	bool measurement = (identifier == FILTERED_CO2_MEASUREMENT || identifier == UNFILTERED_CO2_MEASUREMENT);
+	if(measurement ? digits != EXPLORIR_FRAMER_MEASUREMENT_DIGITS : (digits == 0 || digits > 5))
+	    return false;
+	if(i < size && line[i] != SPACE)
+	    return false;
+	while(i < size && line[i] == SPACE) {
+	    i++;
+	}
+    }
+    return true;
+}
+
+/*
+    @brief Function to initialize a framer
+*/
+void explorir_framer_init(explorir_framer_t * framer) {
+    memset(framer, 0, sizeof(*framer));
+}
+
+/*
+    @brief Function to feed one received byte, suitable for a UART RX interrupt
+
+    @ret EXPLORIR_FRAME_LINE when a valid line is ready, EXPLORIR_FRAME_ERROR when a line was discarded
+*/
+explorir_frame_status_t explorir_framer_feed(explorir_framer_t * framer, uint8_t byte) {
+    if(byte != TERMINATE) {
+	if(framer->len < EXPLORIR_FRAMER_MAX_LINE) {
+	    framer->line[framer->len++] = byte;
+	} else {
+	    framer->overflow = true; // lost a terminator, keep discarding until the next one
+	    framer->discarded_bytes++;
+	}
+	return EXPLORIR_FRAME_PENDING;
+    }
+
+    uint8_t len = framer->len;
+    framer->len = 0;
+    if(framer->overflow || len == 0 || framer->line[len - 1] != '\r') {
+	// overlong line, or a '\n' without its '\r'
+	framer->overflow = false;
+	framer->framing_errors++;
+	framer->discarded_bytes += len + 1u;
+	return EXPLORIR_FRAME_ERROR;
+    }
+    len--; // drop '\r'
+
+    if(explorir_frame_is_valid(framer->line, len)) {
+	framer->start = 0;
+	framer->valid_len = len;
+	framer->lines++;
+	return EXPLORIR_FRAME_LINE;
+    }
+
+    // a dropped "\r\n" glues a damaged line to the next good one, recover the good tail
+    for(uint8_t k = 1; k < len; k++) {
+	if(!is_alnum(framer->line[k - 1]) && is_alnum(framer->line[k]) && explorir_frame_is_valid(&framer->line[k], len - k)) {
+	    framer->start = k;
+	    framer->valid_len = len - k;
+	    framer->framing_errors++;
+	    framer->discarded_bytes += k;
+	    framer->lines++;
+	    return EXPLORIR_FRAME_LINE;
+	}
+    }
+
+    framer->framing_errors++;
+    framer->discarded_bytes += len + 2u;
+    return EXPLORIR_FRAME_ERROR;
+}
+
+/*
+    @brief Function to get the line completed by the last EXPLORIR_FRAME_LINE
+
+    @param[out] size Size, in bytes, of the line, "\r\n" not included
+
+    @ret Pointer to the line, valid until the next byte is fed
+*/
+const uint8_t * explorir_framer_line(const explorir_framer_t * framer, uint8_t * size) {
+    *size = framer->valid_len;
+    return &framer->line[framer->start];
+}
+
+/*
+    @brief Function to frame a chunk of received bytes and parse every valid line into the handler
+
+    @param[in] data Received bytes
+
+    @param[in] size Size, in bytes, of data
+
+    @ret Number of lines parsed
+*/
+uint16_t explorir_framer_process(explorir_framer_t * framer, const uint8_t * data, uint16_t size, explorir_handler_t * explorir_handler) {
+    uint16_t parsed = 0;
+    for(uint16_t i = 0; i < size; i++) {
+	if(explorir_framer_feed(framer, data[i]) == EXPLORIR_FRAME_LINE) {
+	    uint8_t line_size;
+	    const uint8_t * line = explorir_framer_line(framer, &line_size);
+	    explorir_parse_response(line, line_size, explorir_handler);
+	    parsed++;
+	}
+    }
+    return parsed;
+}
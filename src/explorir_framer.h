@@ -0,0 +1,101 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_framer.h
+
+  @Summary
+    CRLF line framing with resynchronization for ExplorIr UART streams
+
+  @Description
+    Turns a raw byte stream, possibly with dropped or corrupted bytes, into
+    validated response lines. Bytes are collected until "\r\n", each line is
+    checked for the shape of an ExplorIr response (identifier, space, digits)
+    and anything else is discarded and counted as a framing error. After an
+    error the framer is back in sync at the next "\r\n", and a good response
+    that was glued to the tail of a damaged one is still recovered.
+******************************************************************************/
+
+#ifndef EXPLORIR_FRAMER_H
+#define EXPLORIR_FRAMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "explorir.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// longest line kept, the sensor info line is the longest response at about 30 bytes
+#ifndef EXPLORIR_FRAMER_MAX_LINE
+#define EXPLORIR_FRAMER_MAX_LINE 64
+#endif
+
+// number of digits the sensor always sends in a CO2 measurement field
+#define EXPLORIR_FRAMER_MEASUREMENT_DIGITS 5
+
+// @brief result of feeding one byte
+typedef enum {
+    EXPLORIR_FRAME_PENDING = 0, // line not complete yet
+    EXPLORIR_FRAME_LINE, // a valid line is ready, see explorir_framer_line()
+    EXPLORIR_FRAME_ERROR // a line was discarded
+} explorir_frame_status_t;
+
+// @brief framer state and counters
+typedef struct {
+    uint8_t line[EXPLORIR_FRAMER_MAX_LINE];
+    uint8_t len; // bytes collected for the current line
+    uint8_t start; // offset of the valid line in line[] once EXPLORIR_FRAME_LINE is returned
+    uint8_t valid_len; // length of that line, without "\r\n"
+    bool overflow; // current line outgrew the buffer, discard until the next terminator
+    uint32_t lines; // valid lines delivered
+    uint32_t framing_errors; // lines discarded or repaired
+    uint32_t discarded_bytes;
+} explorir_framer_t;
+
+/*
+    @brief Function to initialize a framer
+*/
+void explorir_framer_init(explorir_framer_t * framer);
+
+/*
+    @brief Function to feed one received byte, suitable for a UART RX interrupt
+
+    @ret EXPLORIR_FRAME_LINE when a valid line is ready, EXPLORIR_FRAME_ERROR when a line was discarded
+*/
+explorir_frame_status_t explorir_framer_feed(explorir_framer_t * framer, uint8_t byte);
+
+/*
+    @brief Function to get the line completed by the last EXPLORIR_FRAME_LINE
+
+    @param[out] size Size, in bytes, of the line, "\r\n" not included
+
+    @ret Pointer to the line, valid until the next byte is fed
+*/
+const uint8_t * explorir_framer_line(const explorir_framer_t * framer, uint8_t * size);
+
+/*
+    @brief Function to frame a chunk of received bytes and parse every valid line into the handler
+
+    @param[in] data Received bytes
+
+    @param[in] size Size, in bytes, of data
+
+    @ret Number of lines parsed
+*/
+uint16_t explorir_framer_process(explorir_framer_t * framer, const uint8_t * data, uint16_t size, explorir_handler_t * explorir_handler);
+
+/*
+    @brief Function to check that a line, without "\r\n", has the shape of an ExplorIr response
+
+    @note Measurement fields need exactly EXPLORIR_FRAMER_MEASUREMENT_DIGITS digits, other numeric responses
+	    1 - 5 digits, free form responses (Y, @, p, ?) must be printable ASCII
+*/
+bool explorir_frame_is_valid(const uint8_t * line, uint8_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXPLORIR_FRAMER_H
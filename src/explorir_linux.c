@@ -0,0 +1,180 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_linux.c
+
+  @Summary
+    termios serial transport for ExplorIr sensors on Linux hosts
+
+  @Description
+    Implements the port setup, line reads with timeout and the blocking explorir_tx
+******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include "explorir_linux.h"
+
+// port of the handler attached with explorir_linux_attach(), explorir_tx has no context
+static explorir_linux_port_t * explorir_linux_attached;
+
+static uint64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+/*
+    @brief Function to open and configure a serial port, 9600 baud 8N1 raw
+
+    @param[in] path Device, e.g. "/dev/ttyUSB0", or the pty printed by explorir_sim
+
+    @param[in] timeout_ms Time allowed for a line in explorir_linux_read_line()
+
+    @ret EXPLORIR_SUCCESS, or EXPLORIR_ERR_INVALID_INPUT if the port can't be opened or configured
+*/
+explorir_retcode_t explorir_linux_open(explorir_linux_port_t * port, const char * path, uint32_t timeout_ms) {
+    memset(port, 0, sizeof(*port));
+    port->fd = open(path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if(port->fd < 0)
+	return EXPLORIR_ERR_INVALID_INPUT;
+    port->timeout_ms = timeout_ms;
+
+    struct termios tty;
+    if(tcgetattr(port->fd, &tty) != 0) {
+	explorir_linux_close(port);
+	return EXPLORIR_ERR_INVALID_INPUT;
+    }
+    cfmakeraw(&tty);
+    cfsetispeed(&tty, B9600);
+    cfsetospeed(&tty, B9600);
+    tty.c_cflag |= CLOCAL | CREAD;
+    tty.c_cflag &= ~(CSTOPB | CRTSCTS);
+    tty.c_cc[VMIN] = 0; // reads are gated by poll()
+    tty.c_cc[VTIME] = 0;
+    if(tcsetattr(port->fd, TCSANOW, &tty) != 0) {
+	explorir_linux_close(port);
+	return EXPLORIR_ERR_INVALID_INPUT;
+    }
+    tcflush(port->fd, TCIOFLUSH);
+    return EXPLORIR_SUCCESS;
+}
+
+/*
+    @brief Function to close a serial port, detaches its handler
+*/
+void explorir_linux_close(explorir_linux_port_t * port) {
+    if(explorir_linux_attached == port)
+	explorir_linux_attached = NULL;
+    if(port->fd >= 0)
+	close(port->fd);
+    port->fd = -1;
+    port->rx_len = 0;
+    port->explorir_handler = NULL;
+}
+
+/*
+    @brief Function to write a command
+
+    @ret true if every byte was written
+*/
+bool explorir_linux_write(explorir_linux_port_t * port, const uint8_t * data, size_t size) {
+    while(size) {
+	ssize_t written = write(port->fd, data, size);
+	if(written <= 0)
+	    return false;
+	data += written;
+	size -= written;
+    }
+    return true;
+}
+
+/*
+    @brief Function to read one line, including its "\r\n"
+
+    @param[out] buffer Receives the line, truncated to capacity
+
+    @ret Size of the line, 0 if no complete line arrived within timeout_ms
+*/
+size_t explorir_linux_read_line(explorir_linux_port_t * port, uint8_t * buffer, size_t capacity) {
+    uint64_t deadline = monotonic_ms() + port->timeout_ms;
+    for(;;) {
+	uint8_t * end = memchr(port->rx, TERMINATE, port->rx_len);
+	if(end) {
+	    size_t line = end - port->rx + 1;
+	    size_t size = line < capacity ? line : capacity;
+	    memcpy(buffer, port->rx, size);
+	    port->rx_len -= line;
+	    memmove(port->rx, port->rx + line, port->rx_len);
+	    return size;
+	}
+	if(port->rx_len == sizeof(port->rx))
+	    port->rx_len = 0; // no line fits, noise on the bus
+
+	uint64_t now = monotonic_ms();
+	if(now >= deadline)
+	    return 0;
+	struct pollfd pfd = {.fd = port->fd, .events = POLLIN};
+	if(poll(&pfd, 1, (int)(deadline - now)) <= 0)
+	    return 0;
+	ssize_t received = read(port->fd, port->rx + port->rx_len, sizeof(port->rx) - port->rx_len);
+	if(received <= 0)
+	    return 0;
+	port->rx_len += received;
+    }
+}
+
+// @brief explorir_tx of an attached handler, leaves the reply in explorir_data for explorir_command() to process
+static void explorir_linux_tx(unsigned char * tx, uint8_t size) {
+    explorir_linux_port_t * port = explorir_linux_attached;
+    if(port == NULL)
+	return;
+    explorir_handler_t * explorir_handler = port->explorir_handler;
+    uint8_t reply = explorir_reply_identifier(tx);
+    uint8_t lines = tx[0] == SENSOR_INFO ? 2 : 1;
+    uint8_t line[UART_RX_BUF_SIZE];
+
+    explorir_linux_write(port, tx, size);
+    for(;;) {
+	size_t line_size = explorir_linux_read_line(port, line, sizeof(line));
+	if(line_size == 0) {
+	    explorir_handler->err_code = EXPLORIR_ERR_TIMEOUT;
+	    return;
+	}
+	size_t i = 0;
+	while(i < line_size && line[i] == SPACE) {
+	    i++;
+	}
+	uint8_t identifier = i < line_size ? line[i] : 0;
+
+	explorir_update_data(line, line_size, explorir_handler);
+	if(identifier == UNRECOGNIZED_CMD)
+	    return;
+	bool answer = reply ? identifier == reply : (identifier != FILTERED_CO2_MEASUREMENT && identifier != UNFILTERED_CO2_MEASUREMENT);
+	if(answer && --lines == 0)
+	    return;
+	explorir_process_response(explorir_handler); // streaming line, or the first line of a two line reply
+	if(answer)
+	    reply = 0; // the following lines have their own identifiers
+    }
+}
+
+/*
+    @brief Function to let the blocking explorir_* functions of a handler talk through a port
+
+    @note Sets explorir_tx. It writes the command, then reads lines until the reply arrives, measurement lines
+	    received meanwhile are processed as usual and a missing reply sets err_code to EXPLORIR_ERR_TIMEOUT
+
+    @note explorir_tx takes no context, so one handler at a time can be attached in a process
+*/
+void explorir_linux_attach(explorir_linux_port_t * port, explorir_handler_t * explorir_handler) {
+    port->explorir_handler = explorir_handler;
+    explorir_handler->explorir_tx = explorir_linux_tx;
+    explorir_linux_attached = port;
+}
@@ -0,0 +1,91 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_linux.h
+
+  @Summary
+    termios serial transport for ExplorIr sensors on Linux hosts
+
+  @Description
+    Opens a serial port at 9600 8N1 raw and reads it line by line with a
+    timeout. explorir_linux_write()/explorir_linux_read_line() have the shape
+    of the C++ wrapper's Transport policy and of explorir_async_t's tx hook,
+    explorir_linux_attach() drives the blocking explorir_* functions of one
+    handler.
+
+    explorir_linux_open(&port, "/dev/ttyUSB0", 100);
+    explorir_linux_attach(&port, &explorir);
+    explorir_init(&explorir);
+******************************************************************************/
+
+#ifndef EXPLORIR_LINUX_H
+#define EXPLORIR_LINUX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "explorir.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EXPLORIR_LINUX_RX_SIZE 256
+
+// @brief one open serial port
+typedef struct {
+    int fd;
+    uint32_t timeout_ms; // time allowed for a line
+    uint8_t rx[EXPLORIR_LINUX_RX_SIZE]; // bytes read but not returned yet
+    uint16_t rx_len;
+    explorir_handler_t * explorir_handler; // set by explorir_linux_attach()
+} explorir_linux_port_t;
+
+/*
+    @brief Function to open and configure a serial port, 9600 baud 8N1 raw
+
+    @param[in] path Device, e.g. "/dev/ttyUSB0", or the pty printed by explorir_sim
+
+    @param[in] timeout_ms Time allowed for a line in explorir_linux_read_line()
+
+    @ret EXPLORIR_SUCCESS, or EXPLORIR_ERR_INVALID_INPUT if the port can't be opened or configured
+*/
+explorir_retcode_t explorir_linux_open(explorir_linux_port_t * port, const char * path, uint32_t timeout_ms);
+
+/*
+    @brief Function to close a serial port, detaches its handler
+*/
+void explorir_linux_close(explorir_linux_port_t * port);
+
+/*
+    @brief Function to write a command
+
+    @ret true if every byte was written
+*/
+bool explorir_linux_write(explorir_linux_port_t * port, const uint8_t * data, size_t size);
+
+/*
+    @brief Function to read one line, including its "\r\n"
+
+    @param[out] buffer Receives the line, truncated to capacity
+
+    @ret Size of the line, 0 if no complete line arrived within timeout_ms
+*/
+size_t explorir_linux_read_line(explorir_linux_port_t * port, uint8_t * buffer, size_t capacity);
+
+/*
+    @brief Function to let the blocking explorir_* functions of a handler talk through a port
+
+    @note Sets explorir_tx. It writes the command, then reads lines until the reply arrives, measurement lines
+	    received meanwhile are processed as usual and a missing reply sets err_code to EXPLORIR_ERR_TIMEOUT
+
+    @note explorir_tx takes no context, so one handler at a time can be attached in a process
+*/
+void explorir_linux_attach(explorir_linux_port_t * port, explorir_handler_t * explorir_handler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXPLORIR_LINUX_H
@@ -0,0 +1,358 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_log.c
+
+  @Summary
+    Compact binary sample log for ExplorIr sensors
+
+  @Description
+    Implements the delta/zigzag-varint encoded log writer and reader
+******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "explorir_log.h"
+
+#define FIELD_BITS (FILTERED_MASK | UNFILTERED_MASK)
+
+/*******************************[ Encoding Helpers ]****************************************/
+
+static uint8_t put_varint(uint8_t * out, uint32_t value) {
+    uint8_t n = 0;
+    while(value >= 0x80) {
+	out[n++] = (uint8_t)(value | 0x80);
+	value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+static bool get_varint(const uint8_t * data, size_t end, size_t * pos, uint32_t * value) {
+    uint32_t result = 0;
+    for(uint8_t shift = 0; shift < 35; shift += 7) {
+	if(*pos >= end)
+	    return false;
+	uint8_t byte = data[(*pos)++];
+	result |= (uint32_t)(byte & 0x7F) << shift;
+	if(!(byte & 0x80)) {
+	    *value = result;
+	    return true;
+	}
+    }
+    return false; // more than 5 bytes, corrupt
+}
+
+static uint32_t zigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static void put_u16(uint8_t * out, uint16_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+}
+
+static void put_u64(uint8_t * out, uint64_t value) {
+    for(uint8_t b = 0; b < 8; b++) {
+	out[b] = (uint8_t)(value >> (8 * b));
+    }
+}
+
+static uint16_t get_u16(const uint8_t * in) {
+    return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+static uint64_t get_u64(const uint8_t * in) {
+    uint64_t value = 0;
+    for(uint8_t b = 0; b < 8; b++) {
+	value |= (uint64_t)in[b] << (8 * b);
+    }
+    return value;
+}
+
+/*******************************[ Writer ]****************************************/
+
+/*
+    @brief Function to start a new block, resetting all delta state
+*/
+static void explorir_log_reset_block(explorir_log_writer_t * writer) {
+    writer->len = 0;
+    writer->count = 0;
+    writer->prev_delta = 0;
+    for(uint8_t s = 0; s < EXPLORIR_LOG_MAX_SENSORS; s++) {
+	writer->sensors[s].filtered = 0;
+	writer->sensors[s].unfiltered = 0;
+	writer->sensors[s].scaling_in_block = false;
+    }
+}
+
+/*
+    @brief Function to initialize a log writer
+
+    @param[in] block Storage for one block payload, typically a flash page minus EXPLORIR_LOG_BLOCK_HEADER_SIZE
+
+    @param[in] block_size Size of block in bytes, at least 2 * EXPLORIR_LOG_MAX_RECORD_SIZE
+
+    @param[in] write Output function, receives the file header and then whole blocks
+
+    @param[in] context Passed to write
+
+    @ret ExplorIr return code, EXPLORIR_ERR_INVALID_INPUT if block is too small
+*/
+explorir_retcode_t explorir_log_writer_init(explorir_log_writer_t * writer, uint8_t * block, uint16_t block_size,
+	void(*write)(const uint8_t *data, uint16_t size, void *context), void * context) {
+    if(block == NULL || write == NULL || block_size < 2 * EXPLORIR_LOG_MAX_RECORD_SIZE)
+	return EXPLORIR_ERR_INVALID_INPUT;
+
+    memset(writer, 0, sizeof(*writer));
+    writer->block = block;
+    writer->block_size = block_size;
+    writer->write = write;
+    writer->context = context;
+    explorir_log_reset_block(writer);
+
+    return EXPLORIR_SUCCESS;
+}
+
+/*
+    @brief Function to write out the block being built, call before closing the output
+*/
+void explorir_log_flush(explorir_log_writer_t * writer) {
+    if(!writer->header_written) {
+	uint8_t file_header[EXPLORIR_LOG_FILE_HEADER_SIZE] = {'E', 'X', 'L', 'G', EXPLORIR_LOG_VERSION, EXPLORIR_LOG_MAX_SENSORS};
+	put_u16(&file_header[6], writer->block_size);
+	writer->write(file_header, sizeof(file_header), writer->context);
+	writer->header_written = true;
+    }
+    if(writer->count == 0)
+	return;
+
+    uint8_t block_header[EXPLORIR_LOG_BLOCK_HEADER_SIZE] = {'E', 'B'};
+    put_u16(&block_header[2], writer->len);
+    put_u16(&block_header[4], writer->count);
+    put_u64(&block_header[8], writer->first_ts);
+    put_u64(&block_header[16], writer->prev_ts);
+    writer->write(block_header, sizeof(block_header), writer->context);
+    writer->write(writer->block, writer->len, writer->context);
+
+    explorir_log_reset_block(writer);
+}
+
+/*
+    @brief Function to append a sample to the log
+
+    @ret ExplorIr return code, EXPLORIR_ERR_INVALID_INPUT if the sensor id is not below EXPLORIR_LOG_MAX_SENSORS
+*/
+explorir_retcode_t explorir_log_write_sample(explorir_log_writer_t * writer, const explorir_sample_t * sample) {
+    uint8_t sensor_id = sample->sensor_id;
+    uint8_t mask = sample->field_mask & FIELD_BITS;
+    if(sensor_id >= EXPLORIR_LOG_MAX_SENSORS || mask == 0)
+	return EXPLORIR_ERR_INVALID_INPUT;
+
+    // extend the 32-bit millisecond clock, small steps backwards are clamped rather than treated as a wrap
+    uint32_t clock = sample->timestamp_ms;
+    if(clock < writer->last_clock && writer->last_clock - clock > 0x80000000u)
+	writer->clock_high++;
+    if(clock >= writer->last_clock || writer->last_clock - clock > 0x80000000u)
+	writer->last_clock = clock;
+    uint64_t ts = ((uint64_t)writer->clock_high << 32) | writer->last_clock;
+    if(writer->count > 0 && ts < writer->prev_ts)
+	ts = writer->prev_ts;
+
+    // start a new block when this record might not fit or the delta would not fit in 32 bits
+    if(writer->count > 0 && (writer->len + 2 * EXPLORIR_LOG_MAX_RECORD_SIZE > writer->block_size || ts - writer->prev_ts > UINT32_MAX)) {
+	explorir_log_flush(writer);
+    }
+    if(writer->count == 0) {
+	writer->first_ts = ts;
+	writer->prev_ts = ts;
+    }
+
+    explorir_log_sensor_state_t * state = &writer->sensors[sensor_id];
+    uint8_t * out = &writer->block[writer->len];
+    uint8_t n = 0;
+    uint8_t id_bits = (sensor_id < EXPLORIR_LOG_SENSOR_ESCAPE) ? sensor_id : EXPLORIR_LOG_SENSOR_ESCAPE;
+
+    // scaling factor record whenever it changes, and once per block so blocks decode on their own
+    if(!state->scaling_in_block || state->scaling_factor != sample->scaling_factor) {
+	out[n++] = (uint8_t)(id_bits << 3);
+	if(id_bits == EXPLORIR_LOG_SENSOR_ESCAPE)
+	    out[n++] = sensor_id;
+	n += put_varint(&out[n], sample->scaling_factor);
+	state->scaling_factor = sample->scaling_factor;
+	state->scaling_in_block = true;
+	writer->count++;
+    }
+
+    uint32_t delta = (uint32_t)(ts - writer->prev_ts);
+    bool repeat = (delta == writer->prev_delta);
+    out[n++] = (uint8_t)((id_bits << 3) | mask | (repeat ? EXPLORIR_LOG_TS_REPEAT : 0));
+    if(id_bits == EXPLORIR_LOG_SENSOR_ESCAPE)
+	out[n++] = sensor_id;
+    if(!repeat)
+	n += put_varint(&out[n], delta);
+    if(mask & FILTERED_MASK) {
+	n += put_varint(&out[n], zigzag((int32_t)sample->filtered - state->filtered));
+	state->filtered = sample->filtered;
+    }
+    if(mask & UNFILTERED_MASK) {
+	n += put_varint(&out[n], zigzag((int32_t)sample->unfiltered - state->unfiltered));
+	state->unfiltered = sample->unfiltered;
+    }
+
+    writer->len += n;
+    writer->count++;
+    writer->prev_ts = ts;
+    writer->prev_delta = delta;
+
+    return EXPLORIR_SUCCESS;
+}
+
+/*
+    @brief Sample callback adapter, assign to explorir_on_sample with the writer as sample_context
+*/
+void explorir_log_on_sample(const explorir_sample_t * sample, void * context) {
+    explorir_log_write_sample((explorir_log_writer_t *)context, sample);
+}
+
+/*******************************[ Reader ]****************************************/
+
+/*
+    @brief Function to decode the block header at a file offset
+
+    @ret ExplorIr return code, EXPLORIR_ERR_INVALID_INPUT if there is no valid block at offset
+*/
+explorir_retcode_t explorir_log_read_block_header(const uint8_t * data, size_t size, size_t offset, explorir_log_block_header_t * header) {
+    if(offset > size || size - offset < EXPLORIR_LOG_BLOCK_HEADER_SIZE)
+	return EXPLORIR_ERR_INVALID_INPUT;
+    const uint8_t * in = &data[offset];
+    if(in[0] != 'E' || in[1] != 'B')
+	return EXPLORIR_ERR_INVALID_INPUT;
+
+    header->payload_len = get_u16(&in[2]);
+    header->record_count = get_u16(&in[4]);
+    header->first_ts = get_u64(&in[8]);
+    header->last_ts = get_u64(&in[16]);
+    if(size - offset - EXPLORIR_LOG_BLOCK_HEADER_SIZE < header->payload_len)
+	return EXPLORIR_ERR_INVALID_INPUT; // truncated block
+
+    return EXPLORIR_SUCCESS;
+}
+
+/*
+    @brief Function to initialize a reader over a complete log
+
+    @ret ExplorIr return code, EXPLORIR_ERR_INVALID_INPUT if the file header is invalid
+*/
+explorir_retcode_t explorir_log_reader_init(explorir_log_reader_t * reader, const uint8_t * data, size_t size) {
+    memset(reader, 0, sizeof(*reader));
+    if(size < EXPLORIR_LOG_FILE_HEADER_SIZE || memcmp(data, "EXLG", 4) != 0 || data[4] != EXPLORIR_LOG_VERSION)
+	return EXPLORIR_ERR_INVALID_INPUT;
+    if(data[5] > EXPLORIR_LOG_MAX_SENSORS)
+	return EXPLORIR_ERR_INVALID_INPUT; // written with more sensors than this build can track
+
+    reader->data = data;
+    reader->size = size;
+    reader->max_sensors = data[5];
+    reader->block_size = get_u16(&data[6]);
+    reader->pos = EXPLORIR_LOG_FILE_HEADER_SIZE;
+    reader->block_end = reader->pos;
+
+    return EXPLORIR_SUCCESS;
+}
+
+/*
+    @brief Function to position the reader at the start of the block at offset
+
+    @note Offsets come from walking block headers, see explorir_log_read_block_header()
+*/
+explorir_retcode_t explorir_log_reader_seek(explorir_log_reader_t * reader, size_t offset) {
+    explorir_log_block_header_t header;
+    if(explorir_log_read_block_header(reader->data, reader->size, offset, &header) != EXPLORIR_SUCCESS)
+	return EXPLORIR_ERR_INVALID_INPUT;
+
+    reader->pos = offset + EXPLORIR_LOG_BLOCK_HEADER_SIZE;
+    reader->block_end = reader->pos + header.payload_len;
+    reader->remaining = header.record_count;
+    reader->ts = header.first_ts;
+    reader->prev_delta = 0;
+    memset(reader->sensors, 0, sizeof(reader->sensors));
+
+    return EXPLORIR_SUCCESS;
+}
+
+/*
+    @brief Function to decode the next record
+
+    @ret true if a record was decoded, false at the end of the log or on corrupt data
+*/
+bool explorir_log_reader_next(explorir_log_reader_t * reader, explorir_log_record_t * record) {
+    for(;;) {
+	if(reader->remaining == 0) {
+	    if(reader->block_end >= reader->size)
+		return false; // end of log
+	    if(explorir_log_reader_seek(reader, reader->block_end) != EXPLORIR_SUCCESS)
+		return false;
+	    continue;
+	}
+
+	const uint8_t * data = reader->data;
+	size_t end = reader->block_end;
+	size_t pos = reader->pos;
+	if(pos >= end)
+	    return false;
+	uint8_t header = data[pos++];
+	uint8_t sensor_id = header >> 3;
+	uint8_t mask = header & FIELD_BITS;
+	if(sensor_id == EXPLORIR_LOG_SENSOR_ESCAPE) {
+	    if(pos >= end)
+		return false;
+	    sensor_id = data[pos++];
+	}
+	if(sensor_id >= reader->max_sensors)
+	    return false;
+	explorir_log_sensor_state_t * state = &reader->sensors[sensor_id];
+	uint32_t value;
+	reader->remaining--;
+
+	if(mask == 0) {
+	    // scaling factor record, not returned to the caller
+	    if(!get_varint(data, end, &pos, &value))
+		return false;
+	    state->scaling_factor = (uint16_t)value;
+	    reader->pos = pos;
+	    continue;
+	}
+
+	if(!(header & EXPLORIR_LOG_TS_REPEAT)) {
+	    if(!get_varint(data, end, &pos, &reader->prev_delta))
+		return false;
+	}
+	reader->ts += reader->prev_delta;
+	if(mask & FILTERED_MASK) {
+	    if(!get_varint(data, end, &pos, &value))
+		return false;
+	    state->filtered = (uint16_t)(state->filtered + unzigzag(value));
+	}
+	if(mask & UNFILTERED_MASK) {
+	    if(!get_varint(data, end, &pos, &value))
+		return false;
+	    state->unfiltered = (uint16_t)(state->unfiltered + unzigzag(value));
+	}
+	reader->pos = pos;
+
+	record->timestamp_ms = reader->ts;
+	record->filtered = state->filtered;
+	record->unfiltered = state->unfiltered;
+	record->scaling_factor = state->scaling_factor;
+	record->sensor_id = sensor_id;
+	record->field_mask = mask;
+	return true;
+    }
+}
@@ -0,0 +1,179 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_log.h
+
+  @Summary
+    Compact binary sample log for ExplorIr sensors
+
+  @Description
+    Streaming writer, attached to the parser's sample callback, and reader for
+    a delta encoded binary record format. A steady two field stream costs about
+    3 bytes per line instead of the 17 byte ASCII " Z ##### z #####\r\n".
+
+    File layout (all multi-byte integers little endian):
+
+	file header   "EXLG" | version u8 | max_sensors u8 | block_size u16
+	block header  'E' 'B' | payload_len u16 | record_count u16 | reserved u16 | first_ts u64 | last_ts u64
+	payload       records
+
+    Record layout:
+
+	header u8     sensor_id << 3 | field_mask | TS_REPEAT
+			sensor ids >= 31 store 31 here followed by a sensor id byte
+	scaling       field_mask == 0: varint scaling factor, applies to later records of that sensor
+	sample        field_mask != 0: varint timestamp delta (omitted if TS_REPEAT), then a zigzag
+			varint delta per present field, filtered first, against the sensor's previous value
+
+    Delta state is reset at every block boundary, so each block can be decoded
+    on its own. This is what lets readers seek straight to a block by timestamp.
+******************************************************************************/
+
+#ifndef EXPLORIR_LOG_H
+#define EXPLORIR_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "explorir.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// highest sensor id + 1 accepted by the log, each sensor costs 8 bytes of writer and reader state
+#ifndef EXPLORIR_LOG_MAX_SENSORS
+#define EXPLORIR_LOG_MAX_SENSORS 16
+#endif
+
+#define EXPLORIR_LOG_VERSION 1
+#define EXPLORIR_LOG_FILE_HEADER_SIZE 8
+#define EXPLORIR_LOG_BLOCK_HEADER_SIZE 24
+#define EXPLORIR_LOG_MAX_RECORD_SIZE 13 // header, sensor id, timestamp varint, two field varints
+#define EXPLORIR_LOG_TS_REPEAT 1 // record header flag, timestamp delta equals the previous one
+#define EXPLORIR_LOG_SENSOR_ESCAPE 31 // record header sensor id value meaning a sensor id byte follows
+
+// @brief one decoded log record
+typedef struct {
+    uint64_t timestamp_ms; // wrap-extended milliseconds
+    uint16_t filtered; // raw, valid if FILTERED_MASK set in field_mask
+    uint16_t unfiltered; // raw, valid if UNFILTERED_MASK set in field_mask
+    uint16_t scaling_factor;
+    uint8_t sensor_id;
+    uint8_t field_mask;
+} explorir_log_record_t;
+
+// @brief decoded block header
+typedef struct {
+    uint16_t payload_len;
+    uint16_t record_count;
+    uint64_t first_ts;
+    uint64_t last_ts;
+} explorir_log_block_header_t;
+
+// @brief per sensor delta state, shared by the writer and the reader
+typedef struct {
+    uint16_t filtered;
+    uint16_t unfiltered;
+    uint16_t scaling_factor;
+    bool scaling_in_block; // scaling factor already written in the current block
+} explorir_log_sensor_state_t;
+
+// @brief streaming writer
+typedef struct {
+    uint8_t * block; // block_size bytes of caller storage holding the payload being built
+    uint16_t block_size;
+    uint16_t len; // payload bytes used
+    uint16_t count; // records in the block
+    uint64_t first_ts;
+    uint64_t prev_ts;
+    uint32_t prev_delta;
+    uint32_t last_clock; // last 32-bit timestamp seen, to extend it past wrap
+    uint32_t clock_high;
+    bool header_written;
+    explorir_log_sensor_state_t sensors[EXPLORIR_LOG_MAX_SENSORS];
+    void(*write)(const uint8_t *data, uint16_t size, void *context); // must be initialized, e.g. fwrite or a flash page writer
+    void *context; // passed to write
+} explorir_log_writer_t;
+
+// @brief reader over a complete log held in memory (RAM, flash or an mmapped file)
+typedef struct {
+    const uint8_t * data;
+    size_t size;
+    size_t pos; // offset of the next byte to decode
+    size_t block_end; // offset one past the current block's payload
+    uint16_t block_size;
+    uint8_t max_sensors;
+    uint16_t remaining; // records left in the current block
+    uint64_t ts;
+    uint32_t prev_delta;
+    explorir_log_sensor_state_t sensors[EXPLORIR_LOG_MAX_SENSORS];
+} explorir_log_reader_t;
+
+/*
+    @brief Function to initialize a log writer
+
+    @param[in] block Storage for one block payload, typically a flash page minus EXPLORIR_LOG_BLOCK_HEADER_SIZE
+
+    @param[in] block_size Size of block in bytes, at least 2 * EXPLORIR_LOG_MAX_RECORD_SIZE
+
+    @param[in] write Output function, receives the file header and then whole blocks
+
+    @param[in] context Passed to write
+
+    @ret ExplorIr return code, EXPLORIR_ERR_INVALID_INPUT if block is too small
+*/
+explorir_retcode_t explorir_log_writer_init(explorir_log_writer_t * writer, uint8_t * block, uint16_t block_size,
+	void(*write)(const uint8_t *data, uint16_t size, void *context), void * context);
+
+/*
+    @brief Function to append a sample to the log
+
+    @ret ExplorIr return code, EXPLORIR_ERR_INVALID_INPUT if the sensor id is not below EXPLORIR_LOG_MAX_SENSORS
+*/
+explorir_retcode_t explorir_log_write_sample(explorir_log_writer_t * writer, const explorir_sample_t * sample);
+
+/*
+    @brief Sample callback adapter, assign to explorir_on_sample with the writer as sample_context
+*/
+void explorir_log_on_sample(const explorir_sample_t * sample, void * context);
+
+/*
+    @brief Function to write out the block being built, call before closing the output
+*/
+void explorir_log_flush(explorir_log_writer_t * writer);
+
+/*
+    @brief Function to decode the block header at a file offset
+
+    @ret ExplorIr return code, EXPLORIR_ERR_INVALID_INPUT if there is no valid block at offset
+*/
+explorir_retcode_t explorir_log_read_block_header(const uint8_t * data, size_t size, size_t offset, explorir_log_block_header_t * header);
+
+/*
+    @brief Function to initialize a reader over a complete log
+
+    @ret ExplorIr return code, EXPLORIR_ERR_INVALID_INPUT if the file header is invalid
+*/
+explorir_retcode_t explorir_log_reader_init(explorir_log_reader_t * reader, const uint8_t * data, size_t size);
+
+/*
+    @brief Function to position the reader at the start of the block at offset
+
+    @note Offsets come from walking block headers, see explorir_log_read_block_header()
+*/
+explorir_retcode_t explorir_log_reader_seek(explorir_log_reader_t * reader, size_t offset);
+
+/*
+    @brief Function to decode the next record
+
+    @ret true if a record was decoded, false at the end of the log or on corrupt data
+*/
+bool explorir_log_reader_next(explorir_log_reader_t * reader, explorir_log_record_t * record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXPLORIR_LOG_H
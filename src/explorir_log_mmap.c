@@ -0,0 +1,154 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_log_mmap.c
+
+  @Summary
+    Memory-mapped reader for ExplorIr binary sample logs (POSIX hosts)
+
+  @Description
+    Implements file mapping, the block index and range iteration
+******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "explorir_log_mmap.h"
+
+/*
+    @brief Function to map a log file and build its block index
+
+    @param[in] path Path of the log file
+
+    @note Only block headers are touched while indexing, payloads are paged in on demand
+
+    @ret ExplorIr return code, EXPLORIR_ERR_INVALID_INPUT if the file cannot be mapped or is not a log
+*/
+explorir_retcode_t explorir_log_file_open(explorir_log_file_t * file, const char * path) {
+    memset(file, 0, sizeof(*file));
+
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+	return EXPLORIR_ERR_INVALID_INPUT;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < EXPLORIR_LOG_FILE_HEADER_SIZE) {
+	close(fd);
+	return EXPLORIR_ERR_INVALID_INPUT;
+    }
+    void * map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file referenced
+    if(map == MAP_FAILED)
+	return EXPLORIR_ERR_INVALID_INPUT;
+    file->data = map;
+    file->size = (size_t)st.st_size;
+
+    explorir_log_reader_t reader;
+    if(explorir_log_reader_init(&reader, file->data, file->size) != EXPLORIR_SUCCESS) {
+	explorir_log_file_close(file);
+	return EXPLORIR_ERR_INVALID_INPUT;
+    }
+
+    // walk the block headers, a truncated tail (e.g. a logger that lost power) ends the index
+    size_t capacity = 0;
+    size_t offset = EXPLORIR_LOG_FILE_HEADER_SIZE;
+    explorir_log_block_header_t header;
+    while(explorir_log_read_block_header(file->data, file->size, offset, &header) == EXPLORIR_SUCCESS) {
+	if(file->block_count == capacity) {
+	    capacity = capacity ? capacity * 2 : 256;
+	    explorir_log_index_entry_t * grown = realloc(file->index, capacity * sizeof(*grown));
+	    if(grown == NULL) {
+		explorir_log_file_close(file);
+		return EXPLORIR_ERR_INVALID_INPUT;
+	    }
+	    file->index = grown;
+	}
+	explorir_log_index_entry_t * entry = &file->index[file->block_count++];
+	entry->first_ts = header.first_ts;
+	entry->last_ts = header.last_ts;
+	entry->offset = offset;
+	offset += EXPLORIR_LOG_BLOCK_HEADER_SIZE + header.payload_len;
+    }
+
+    madvise((void *)file->data, file->size, MADV_SEQUENTIAL); // scans read forward
+    return EXPLORIR_SUCCESS;
+}
+
+/*
+    @brief Function to unmap a log file and free its index
+*/
+void explorir_log_file_close(explorir_log_file_t * file) {
+    if(file->data)
+	munmap((void *)file->data, file->size);
+    free(file->index);
+    memset(file, 0, sizeof(*file));
+}
+
+/*
+    @brief Function to find the first block that may hold records at or after a timestamp
+
+    @ret Index into file->index, block_count if every block ends before timestamp_ms
+*/
+size_t explorir_log_file_find_block(const explorir_log_file_t * file, uint64_t timestamp_ms) {
+    // blocks are written in time order, so last_ts is non-decreasing
+    size_t lo = 0;
+    size_t hi = file->block_count;
+    while(lo < hi) {
+	size_t mid = lo + (hi - lo) / 2;
+	if(file->index[mid].last_ts < timestamp_ms)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return lo;
+}
+
+/*
+    @brief Function to start iterating the records of a sensor in [start_ms, end_ms)
+
+    @param[in] sensor_id Sensor to return, or EXPLORIR_LOG_ANY_SENSOR
+
+    @ret ExplorIr return code, either SUCCESS or failure
+*/
+explorir_retcode_t explorir_log_range_init(explorir_log_range_t * range, const explorir_log_file_t * file, int16_t sensor_id, uint64_t start_ms, uint64_t end_ms) {
+    memset(range, 0, sizeof(*range));
+    range->sensor_id = sensor_id;
+    range->start_ms = start_ms;
+    range->end_ms = end_ms;
+
+    if(explorir_log_reader_init(&range->reader, file->data, file->size) != EXPLORIR_SUCCESS)
+	return EXPLORIR_ERR_INVALID_INPUT;
+
+    size_t block = explorir_log_file_find_block(file, start_ms);
+    if(block == file->block_count || file->index[block].first_ts >= end_ms) {
+	range->done = true;
+	return EXPLORIR_SUCCESS;
+    }
+    return explorir_log_reader_seek(&range->reader, file->index[block].offset);
+}
+
+/*
+    @brief Function to get the next record in the range
+
+    @ret true if a record was returned, false once the range is exhausted
+*/
+bool explorir_log_range_next(explorir_log_range_t * range, explorir_log_record_t * record) {
+    while(!range->done) {
+	if(!explorir_log_reader_next(&range->reader, record))
+	    break;
+	if(record->timestamp_ms >= range->end_ms)
+	    break;
+	if(record->timestamp_ms < range->start_ms)
+	    continue;
+	if(range->sensor_id != EXPLORIR_LOG_ANY_SENSOR && record->sensor_id != range->sensor_id)
+	    continue;
+	return true;
+    }
+    range->done = true;
+    return false;
+}
@@ -0,0 +1,98 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_log_mmap.h
+
+  @Summary
+    Memory-mapped reader for ExplorIr binary sample logs (POSIX hosts)
+
+  @Description
+    Maps a log file written by explorir_log.h, indexes its blocks by timestamp
+    and iterates records for a sensor and time range without copying the file.
+    Range queries binary search the index and start decoding at the first
+    block that can contain matching records.
+******************************************************************************/
+
+#ifndef EXPLORIR_LOG_MMAP_H
+#define EXPLORIR_LOG_MMAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "explorir_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EXPLORIR_LOG_ANY_SENSOR -1
+
+// @brief block index entry
+typedef struct {
+    uint64_t first_ts;
+    uint64_t last_ts;
+    size_t offset; // file offset of the block header
+} explorir_log_index_entry_t;
+
+// @brief mapped log file
+typedef struct {
+    const uint8_t * data;
+    size_t size;
+    explorir_log_index_entry_t * index; // one entry per block, in file order
+    size_t block_count;
+} explorir_log_file_t;
+
+// @brief iterator over the records of one sensor in [start_ms, end_ms)
+typedef struct {
+    explorir_log_reader_t reader;
+    int16_t sensor_id; // EXPLORIR_LOG_ANY_SENSOR for all sensors
+    uint64_t start_ms;
+    uint64_t end_ms;
+    bool done;
+} explorir_log_range_t;
+
+/*
+    @brief Function to map a log file and build its block index
+
+    @param[in] path Path of the log file
+
+    @note Only block headers are touched while indexing, payloads are paged in on demand
+
+    @ret ExplorIr return code, EXPLORIR_ERR_INVALID_INPUT if the file cannot be mapped or is not a log
+*/
+explorir_retcode_t explorir_log_file_open(explorir_log_file_t * file, const char * path);
+
+/*
+    @brief Function to unmap a log file and free its index
+*/
+void explorir_log_file_close(explorir_log_file_t * file);
+
+/*
+    @brief Function to find the first block that may hold records at or after a timestamp
+
+    @ret Index into file->index, block_count if every block ends before timestamp_ms
+*/
+size_t explorir_log_file_find_block(const explorir_log_file_t * file, uint64_t timestamp_ms);
+
+/*
+    @brief Function to start iterating the records of a sensor in [start_ms, end_ms)
+
+    @param[in] sensor_id Sensor to return, or EXPLORIR_LOG_ANY_SENSOR
+
+    @ret ExplorIr return code, either SUCCESS or failure
+*/
+explorir_retcode_t explorir_log_range_init(explorir_log_range_t * range, const explorir_log_file_t * file, int16_t sensor_id, uint64_t start_ms, uint64_t end_ms);
+
+/*
+    @brief Function to get the next record in the range
+
+    @ret true if a record was returned, false once the range is exhausted
+*/
+bool explorir_log_range_next(explorir_log_range_t * range, explorir_log_record_t * record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXPLORIR_LOG_MMAP_H
@@ -0,0 +1,135 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_pressure.c
+
+  @Summary
+    Pressure compensation of ExplorIr readings from a barometer
+
+  @Description
+    Implements the compensation formula, the rate limited updates and the
+    host-side correction
+******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "explorir_pressure.h"
+
+// the datasheet's 0.14% per mbar is 0.0014% per Pa, applied to EXPLORIR_PRESSURE_UNITY
+#define EXPLORIR_PRESSURE_PER_PA_SCALE 1000000
+#define EXPLORIR_PRESSURE_PER_PA 14
+
+/*
+    @brief Function to convert a pressure into the sensor's compensation value
+
+    @param[in] pressure_pa Barometric pressure in Pa
+
+    @note 8192 + ((1013 - mbar) x 0.14 / 100) x 8192, from the sensor's datasheet
+
+    @ret Compensation value for 'S', limited to 0 - 65535
+*/
+uint16_t explorir_pressure_compensation(uint32_t pressure_pa) {
+    int64_t offset = ((int64_t)EXPLORIR_PRESSURE_REFERENCE_PA - pressure_pa) * EXPLORIR_PRESSURE_UNITY * EXPLORIR_PRESSURE_PER_PA;
+    // round to nearest either side of the reference
+    offset += offset < 0 ? -EXPLORIR_PRESSURE_PER_PA_SCALE / 2 : EXPLORIR_PRESSURE_PER_PA_SCALE / 2;
+    int64_t value = EXPLORIR_PRESSURE_UNITY + offset / EXPLORIR_PRESSURE_PER_PA_SCALE;
+    if(value < 0)
+	return 0;
+    if(value > MAX_TWO_BYTE_VALUE)
+	return MAX_TWO_BYTE_VALUE;
+    return value;
+}
+
+/*
+    @brief Function to initialize sensor-side compensation
+
+    @param[in] threshold_pa Least pressure change that is sent to the sensor
+
+    @param[in] min_interval_ms Least time between two 'S' commands
+*/
+void explorir_pressure_init(explorir_pressure_t * pressure, explorir_handler_t * explorir_handler, uint32_t threshold_pa, uint32_t min_interval_ms) {
+    memset(pressure, 0, sizeof(*pressure));
+    pressure->explorir_handler = explorir_handler;
+    pressure->min_interval_ms = min_interval_ms;
+    // the compensation value is linear in pressure, so a pressure step is the same value step anywhere
+    uint16_t threshold = explorir_pressure_compensation(EXPLORIR_PRESSURE_REFERENCE_PA - (threshold_pa > EXPLORIR_PRESSURE_REFERENCE_PA
+	    ? EXPLORIR_PRESSURE_REFERENCE_PA : threshold_pa)) - EXPLORIR_PRESSURE_UNITY;
+    pressure->threshold = threshold ? threshold : 1;
+    pressure->target = EXPLORIR_PRESSURE_UNITY;
+}
+
+/*
+    @brief Function to take a barometer reading and update the sensor if needed
+
+    @param[in] pressure_pa Barometric pressure in Pa
+
+    @param[in] now_ms Current time in milliseconds, may wrap
+
+    @note The sensor is updated when its compensation value, pressure_and_concentration_compensation of the handler,
+	    differs from the pressure's by threshold or more, and min_interval_ms has passed since the last update
+
+    @ret EXPLORIR_SUCCESS if nothing was sent, otherwise what explorir_set_pressure_and_concentration_compensation() returned
+*/
+explorir_retcode_t explorir_pressure_update(explorir_pressure_t * pressure, uint32_t pressure_pa, uint32_t now_ms) {
+    explorir_handler_t * explorir_handler = pressure->explorir_handler;
+    pressure->target = explorir_pressure_compensation(pressure_pa);
+
+    // 0 until the sensor has reported its value, send the first one right away
+    uint16_t applied = explorir_handler->pressure_and_concentration_compensation;
+    uint16_t change = applied > pressure->target ? applied - pressure->target : pressure->target - applied;
+    if(applied != 0 && change < pressure->threshold)
+	return EXPLORIR_SUCCESS;
+    if(pressure->updated && now_ms - pressure->last_update_ms < pressure->min_interval_ms)
+	return EXPLORIR_SUCCESS;
+
+    pressure->updated = true;
+    pressure->last_update_ms = now_ms;
+    pressure->updates++;
+    explorir_retcode_t result = explorir_set_pressure_and_concentration_compensation(pressure->target, explorir_handler);
+    if(result != EXPLORIR_SUCCESS)
+	pressure->failures++;
+#ifdef DEBUG_OUTPUT
+    NRF_LOG_INFO("Pressure %d Pa, compensation %d -> %d: %d ", pressure_pa, applied, pressure->target, result);
+    NRF_LOG_FLUSH();
+#endif
+    return result;
+}
+
+/*
+    @brief Function to correct one reading on the host
+
+    @param[in] ppm Reading taken with the compensation value applied
+
+    @param[in] pressure_pa Barometric pressure when the reading was taken
+
+    @param[in] applied Compensation value the sensor had, EXPLORIR_PRESSURE_UNITY if it was never set
+
+    @ret Corrected reading in ppm
+*/
+uint32_t explorir_pressure_correct(uint32_t ppm, uint32_t pressure_pa, uint16_t applied) {
+    if(applied == 0)
+	return ppm;
+    // the sensor scaled the reading by applied / 8192, rescale it by the value it should have had
+    return ((uint64_t)ppm * explorir_pressure_compensation(pressure_pa) + applied / 2) / applied;
+}
+
+/*
+    @brief Function to correct many readings on the host, in place
+
+    @param[in,out] ppm Readings taken with the compensation value applied
+
+    @param[in] pressure_pa Barometric pressure of each reading
+
+    @param[in] count Number of readings
+
+    @param[in] applied Compensation value the sensor had, EXPLORIR_PRESSURE_UNITY if it was never set
+*/
+void explorir_pressure_correct_batch(uint32_t * ppm, const uint32_t * pressure_pa, uint32_t count, uint16_t applied) {
+    if(applied == 0)
+	return;
+    for(uint32_t k = 0; k < count; k++) {
+	ppm[k] = ((uint64_t)ppm[k] * explorir_pressure_compensation(pressure_pa[k]) + applied / 2) / applied;
+    }
+}
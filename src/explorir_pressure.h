@@ -0,0 +1,118 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_pressure.h
+
+  @Summary
+    Pressure compensation of ExplorIr readings from a barometer
+
+  @Description
+    The sensor is calibrated at 1013 mbar and reads low below it, high above
+    it. The 'S' value corrects this, but where pressure varies, e.g. in HVAC
+    ducts, a static value is only right some of the time. This module turns
+    barometer readings into compensation values, either:
+	- on the sensor, sending 'S' only when the value moved by more than a
+	  threshold and at most once per interval, so the bus isn't flooded
+	  with commands on every barometer reading
+	- on the host, correcting readings already taken in batch, e.g. logged
+	  samples together with the pressure logged next to them
+
+    explorir_pressure_init(&pressure, &explorir, 50, 60000); // 0.5 mbar, once a minute at most
+    ...
+    explorir_pressure_update(&pressure, barometer_pa(), now_ms()); // on every barometer reading
+******************************************************************************/
+
+#ifndef EXPLORIR_PRESSURE_H
+#define EXPLORIR_PRESSURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "explorir.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// pressure the sensor is calibrated at
+#define EXPLORIR_PRESSURE_REFERENCE_PA 101300
+// compensation value that leaves readings unchanged
+#define EXPLORIR_PRESSURE_UNITY 8192
+
+// @brief sensor-side compensation of one sensor
+typedef struct {
+    explorir_handler_t * explorir_handler;
+    uint32_t min_interval_ms; // least time between two 'S' commands
+    uint32_t last_update_ms; // when the last 'S' command was sent
+    uint32_t updates; // 'S' commands sent
+    uint32_t failures; // 'S' commands that failed
+    uint16_t threshold; // least change of the compensation value that is sent
+    uint16_t target; // compensation value of the latest pressure
+    bool updated; // an 'S' command was sent, last_update_ms is valid
+} explorir_pressure_t;
+
+/*
+    @brief Function to convert a pressure into the sensor's compensation value
+
+    @param[in] pressure_pa Barometric pressure in Pa
+
+    @note 8192 + ((1013 - mbar) x 0.14 / 100) x 8192, from the sensor's datasheet
+
+    @ret Compensation value for 'S', limited to 0 - 65535
+*/
+uint16_t explorir_pressure_compensation(uint32_t pressure_pa);
+
+/*
+    @brief Function to initialize sensor-side compensation
+
+    @param[in] threshold_pa Least pressure change that is sent to the sensor
+
+    @param[in] min_interval_ms Least time between two 'S' commands
+*/
+void explorir_pressure_init(explorir_pressure_t * pressure, explorir_handler_t * explorir_handler, uint32_t threshold_pa, uint32_t min_interval_ms);
+
+/*
+    @brief Function to take a barometer reading and update the sensor if needed
+
+    @param[in] pressure_pa Barometric pressure in Pa
+
+    @param[in] now_ms Current time in milliseconds, may wrap
+
+    @note The sensor is updated when its compensation value, pressure_and_concentration_compensation of the handler,
+	    differs from the pressure's by threshold or more, and min_interval_ms has passed since the last update
+
+    @ret EXPLORIR_SUCCESS if nothing was sent, otherwise what explorir_set_pressure_and_concentration_compensation() returned
+*/
+explorir_retcode_t explorir_pressure_update(explorir_pressure_t * pressure, uint32_t pressure_pa, uint32_t now_ms);
+
+/*
+    @brief Function to correct one reading on the host
+
+    @param[in] ppm Reading taken with the compensation value applied
+
+    @param[in] pressure_pa Barometric pressure when the reading was taken
+
+    @param[in] applied Compensation value the sensor had, EXPLORIR_PRESSURE_UNITY if it was never set
+
+    @ret Corrected reading in ppm
+*/
+uint32_t explorir_pressure_correct(uint32_t ppm, uint32_t pressure_pa, uint16_t applied);
+
+/*
+    @brief Function to correct many readings on the host, in place
+
+    @param[in,out] ppm Readings taken with the compensation value applied
+
+    @param[in] pressure_pa Barometric pressure of each reading
+
+    @param[in] count Number of readings
+
+    @param[in] applied Compensation value the sensor had, EXPLORIR_PRESSURE_UNITY if it was never set
+*/
+void explorir_pressure_correct_batch(uint32_t * ppm, const uint32_t * pressure_pa, uint32_t count, uint16_t applied);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXPLORIR_PRESSURE_H
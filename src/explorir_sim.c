@@ -0,0 +1,263 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_sim.c
+
+  @Summary
+    Simulated ExplorIr sensor for host builds, benchmarks and bring-up
+
+  @Description
+    Implements the command replies, the measurement model and streaming
+******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "explorir_sim.h"
+
+#define EXPLORIR_SIM_PERIOD_MS 500
+#define EXPLORIR_SIM_LINE_SIZE 48
+
+// @brief xorshift32, deterministic for a given seed
+static uint32_t explorir_sim_random(explorir_sim_t * sim) {
+    uint32_t x = sim->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim->seed = x;
+    return x;
+}
+
+static void explorir_sim_send(explorir_sim_t * sim, const char * line, int size) {
+    if(size <= 0)
+	return;
+    if(size > EXPLORIR_SIM_LINE_SIZE - 1)
+	size = EXPLORIR_SIM_LINE_SIZE - 1;
+    sim->lines++;
+    if(sim->output)
+	sim->output((const uint8_t *)line, (uint8_t)size, sim->context);
+}
+
+// @brief takes a measurement, raw field values are ppm divided by the scaling factor
+static void explorir_sim_measure(explorir_sim_t * sim) {
+    int32_t ppm = (int32_t)sim->co2_ppm;
+    if(sim->noise_ppm)
+	ppm += (int32_t)(explorir_sim_random(sim) % (2u * sim->noise_ppm + 1)) - sim->noise_ppm;
+    if(ppm < 0)
+	ppm = 0;
+    uint32_t raw = (uint32_t)ppm / (sim->scaling_factor ? sim->scaling_factor : 1);
+    if(raw > 99999)
+	raw = 99999;
+    sim->unfiltered = raw > UINT16_MAX ? UINT16_MAX : raw;
+    sim->filtered = (uint16_t)(explorir_filter_step(&sim->filter, sim->unfiltered) + 0.5f);
+}
+
+// @brief sends the measurement fields enabled by 'M', e.g. " Z 00040 z 00041\r\n"
+static void explorir_sim_send_measurement(explorir_sim_t * sim) {
+    char line[EXPLORIR_SIM_LINE_SIZE];
+    int size = 0;
+    if(sim->output_fields & FILTERED_MASK)
+	size += snprintf(line + size, sizeof(line) - size, " Z %05u", sim->filtered);
+    if(sim->output_fields & UNFILTERED_MASK)
+	size += snprintf(line + size, sizeof(line) - size, " z %05u", sim->unfiltered);
+    size += snprintf(line + size, sizeof(line) - size, "\r\n");
+    explorir_sim_send(sim, line, size);
+}
+
+// @brief reads the decimal argument after the identifier
+static bool explorir_sim_argument(const uint8_t * cmd, uint16_t size, uint16_t * i, uint32_t * value) {
+    while(*i < size && cmd[*i] == SPACE) {
+	(*i)++;
+    }
+    if(*i == size || cmd[*i] < '0' || cmd[*i] > '9')
+	return false;
+    uint32_t result = 0;
+    while(*i < size && cmd[*i] >= '0' && cmd[*i] <= '9') {
+	result = result * 10 + (cmd[*i] - '0');
+	(*i)++;
+    }
+    *value = result;
+    return true;
+}
+
+// @brief reads an auto-zero interval in days, "1.0" or "8", as tenths of days
+static bool explorir_sim_days(const uint8_t * cmd, uint16_t size, uint16_t * i, uint16_t * tenths) {
+    uint32_t days = 0;
+    uint32_t tenth = 0;
+    if(!explorir_sim_argument(cmd, size, i, &days))
+	return false;
+    if(*i < size && cmd[*i] == '.') {
+	(*i)++;
+	if(!explorir_sim_argument(cmd, size, i, &tenth))
+	    return false;
+    }
+    if(days > MAX_AUTO_ZERO_INTERVAL / 10 || tenth > 9)
+	return false;
+    *tenths = days * 10 + tenth;
+    return true;
+}
+
+/*
+    @brief Function to power up a simulated sensor, in streaming mode with both measurement fields enabled
+
+    @param[in] co2_ppm Initial concentration
+
+    @param[in] output Receives every line the sensor sends
+*/
+void explorir_sim_init(explorir_sim_t * sim, uint32_t co2_ppm, explorir_sim_output_t output, void * context) {
+    memset(sim, 0, sizeof(*sim));
+    sim->co2_ppm = co2_ppm;
+    sim->scaling_factor = EXPLORIR_SIM_SCALING_FACTOR;
+    sim->digital_filter = DIGITAL_FILTER_DEFAULT;
+    sim->compensation = 8192;
+    sim->output_fields = FILTERED_MASK | UNFILTERED_MASK;
+    sim->zero_point = EXPLORIR_SIM_ZERO_POINT;
+    sim->mode = EXPLORIR_MODE_STREAMING;
+    sim->auto_zero_initial = 10;
+    sim->auto_zero_regular = 80;
+    sim->seed = 0x2545f491;
+    sim->output = output;
+    sim->context = context;
+    explorir_filter_init(&sim->filter, sim->digital_filter);
+    explorir_sim_measure(sim);
+}
+
+/*
+    @brief Function to hand the simulated sensor one command, the reply is sent through output at once
+
+    @param[in] cmd Command bytes, with or without the trailing "\r\n"
+*/
+void explorir_sim_command(explorir_sim_t * sim, const uint8_t * cmd, uint16_t size) {
+    char line[EXPLORIR_SIM_LINE_SIZE];
+    int reply = 0;
+    uint16_t i = 1;
+    uint32_t value = 0;
+
+    while(size && (cmd[size-1] == TERMINATE || cmd[size-1] == '\r')) {
+	size--;
+    }
+    sim->commands++;
+    if(size == 0 || (sim->error_percent && explorir_sim_random(sim) % 100 < sim->error_percent))
+	goto Unrecognized;
+
+    switch(cmd[0]) {
+	case OPERATION_MODE:
+	    if(!explorir_sim_argument(cmd, size, &i, &value) || value > EXPLORIR_MODE_POLLING)
+		goto Unrecognized;
+	    sim->mode = value;
+	    reply = snprintf(line, sizeof(line), "K %05u\r\n", sim->mode);
+	    break;
+	case SCALING_FACTOR:
+	    reply = snprintf(line, sizeof(line), ". %05u\r\n", sim->scaling_factor);
+	    break;
+	case FILTERED_CO2_MEASUREMENT:
+	    reply = snprintf(line, sizeof(line), " Z %05u\r\n", sim->filtered);
+	    break;
+	case UNFILTERED_CO2_MEASUREMENT:
+	    reply = snprintf(line, sizeof(line), " z %05u\r\n", sim->unfiltered);
+	    break;
+	case GET_NUM_OF_OUTPUT_DATA_FIELDS:
+	    explorir_sim_send_measurement(sim);
+	    return;
+	case SET_DIGITAL_FILTER:
+	    if(!explorir_sim_argument(cmd, size, &i, &value) || value > MAX_DIGITAL_FILTER)
+		goto Unrecognized;
+	    sim->digital_filter = value;
+	    sim->filter.alpha = explorir_filter_alpha(sim->digital_filter); // keeps the filtered value
+	    reply = snprintf(line, sizeof(line), "A %05u\r\n", sim->digital_filter);
+	    break;
+	case GET_DIGITAL_FILTER:
+	    reply = snprintf(line, sizeof(line), "a %05u\r\n", sim->digital_filter);
+	    break;
+	case SET_TYPE_AND_NUM_OF_DATA_OUTPUTS:
+	    if(!explorir_sim_argument(cmd, size, &i, &value) || value > UINT16_MAX)
+		goto Unrecognized;
+	    sim->output_fields = value;
+	    reply = snprintf(line, sizeof(line), "M %05u\r\n", sim->output_fields);
+	    break;
+	case SET_PRESSURE_AND_CONCENTRATION_COMPENSATION:
+	    if(!explorir_sim_argument(cmd, size, &i, &value) || value > UINT16_MAX)
+		goto Unrecognized;
+	    sim->compensation = value;
+	    reply = snprintf(line, sizeof(line), "S %05u\r\n", sim->compensation);
+	    break;
+	case GET_PRESSURE_AND_CONCENTRATION_COMPENSATION:
+	    reply = snprintf(line, sizeof(line), "s %05u\r\n", sim->compensation);
+	    break;
+	case SET_ZERO_POINT_USING_FRESH_AIR:
+	case SET_ZERO_POINT_USING_NITROGEN:
+	    reply = snprintf(line, sizeof(line), "%c %05u\r\n", cmd[0], sim->zero_point);
+	    break;
+	case FINE_TUNE_ZERO_POINT:
+	case SET_ZERO_POINT_USING_KNOWN_GAS:
+	case MANUALLY_SET_ZERO_POINT:
+	    if(!explorir_sim_argument(cmd, size, &i, &value))
+		goto Unrecognized;
+	    if(cmd[0] == MANUALLY_SET_ZERO_POINT)
+		sim->zero_point = value;
+	    reply = snprintf(line, sizeof(line), "%c %05u\r\n", cmd[0], sim->zero_point);
+	    break;
+	case SET_CO2_BGROUND_CONCENTRATION:
+	    // "P 8 #" / "P 9 #" and friends, mirrored as "p ..."
+	    reply = snprintf(line, sizeof(line), "p%.*s\r\n", (int)(size - 1), (const char *)cmd + 1);
+	    break;
+	case AUTO_ZERO:
+	    if(size > 1) {
+		uint16_t initial = 0;
+		uint16_t regular = 0;
+		if(!explorir_sim_days(cmd, size, &i, &initial))
+		    goto Unrecognized;
+		if(initial && !explorir_sim_days(cmd, size, &i, &regular))
+		    goto Unrecognized;
+		sim->auto_zero_initial = initial;
+		sim->auto_zero_regular = regular;
+	    }
+	    if(sim->auto_zero_initial == 0)
+		reply = snprintf(line, sizeof(line), "@ 0\r\n");
+	    else
+		reply = snprintf(line, sizeof(line), "@ %u.%u %u.%u\r\n", sim->auto_zero_initial / 10, sim->auto_zero_initial % 10,
+			sim->auto_zero_regular / 10, sim->auto_zero_regular % 10);
+	    break;
+	case '6': // "65222", start auto-zero
+	    if(size != 5 || memcmp(cmd, "65222", 5) != 0)
+		goto Unrecognized;
+	    reply = snprintf(line, sizeof(line), "65222\r\n");
+	    break;
+	case SENSOR_INFO:
+	    explorir_sim_send(sim, "Y,Jan 30 2013,10:45:03,AL17\r\n", 29);
+	    reply = snprintf(line, sizeof(line), " B 00233 00000\r\n");
+	    break;
+	default:
+	    goto Unrecognized;
+    }
+    explorir_sim_send(sim, line, reply);
+    return;
+
+    Unrecognized:
+    explorir_sim_send(sim, "?\r\n", 3);
+}
+
+/*
+    @brief Function to advance time, takes a measurement every 500 ms and streams it in streaming mode
+
+    @param[in] now_ms Current time in milliseconds, may wrap
+*/
+void explorir_sim_tick(explorir_sim_t * sim, uint32_t now_ms) {
+    if(!sim->started) {
+	sim->started = true;
+	sim->next_measurement_ms = now_ms + EXPLORIR_SIM_PERIOD_MS;
+	return;
+    }
+    if((int32_t)(now_ms - sim->next_measurement_ms) >= 10 * EXPLORIR_SIM_PERIOD_MS)
+	sim->next_measurement_ms = now_ms; // long gap, don't replay every missed period
+    while((int32_t)(now_ms - sim->next_measurement_ms) >= 0) {
+	sim->next_measurement_ms += EXPLORIR_SIM_PERIOD_MS;
+	if(sim->mode == EXPLORIR_MODE_COMMAND)
+	    continue; // sleeping, no measurements taken
+	explorir_sim_measure(sim);
+	if(sim->mode == EXPLORIR_MODE_STREAMING)
+	    explorir_sim_send_measurement(sim);
+    }
+}
@@ -0,0 +1,92 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_sim.h
+
+  @Summary
+    Simulated ExplorIr sensor for host builds, benchmarks and bring-up
+
+  @Description
+    Answers the ASCII commands the driver sends like a sensor would and
+    streams measurement lines every 500 ms in streaming mode. Readings follow
+    co2_ppm, which can be changed at any time, with optional noise, and the
+    filtered field runs through the sensor's digital filter. error_percent
+    answers a share of the commands with '?' to exercise retries.
+
+    explorir_sim_init(&sim, 420, to_driver, &explorir);
+    explorir_sim_command(&sim, cmd, cmd_size); // from the handler's explorir_tx
+    explorir_sim_tick(&sim, now_ms()); // measurements and streaming
+******************************************************************************/
+
+#ifndef EXPLORIR_SIM_H
+#define EXPLORIR_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "explorir.h"
+#include "explorir_filter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EXPLORIR_SIM_SCALING_FACTOR 10
+#define EXPLORIR_SIM_ZERO_POINT 32950
+
+// @brief receives every line the simulated sensor sends, including "\r\n"
+typedef void(*explorir_sim_output_t)(const uint8_t * line, uint8_t size, void * context);
+
+// @brief simulated sensor state
+typedef struct {
+    uint32_t co2_ppm; // concentration the sensor sees
+    uint16_t noise_ppm; // peak random noise on each reading
+    uint8_t error_percent; // share of commands answered with '?'
+    uint16_t scaling_factor;
+    uint16_t digital_filter;
+    uint16_t compensation; // 'S' value
+    uint16_t output_fields; // 'M' mask
+    uint32_t zero_point;
+    uint8_t mode; // explorir_mode_t
+    uint16_t auto_zero_initial; // tenths of days, 0 when auto-zeroing is disabled
+    uint16_t auto_zero_regular;
+    uint16_t filtered; // latest raw field values
+    uint16_t unfiltered;
+    explorir_filter_t filter;
+    bool started;
+    uint32_t next_measurement_ms;
+    uint32_t seed;
+    uint32_t commands; // commands received
+    uint32_t lines; // lines sent
+    explorir_sim_output_t output;
+    void * context;
+} explorir_sim_t;
+
+/*
+    @brief Function to power up a simulated sensor, in streaming mode with both measurement fields enabled
+
+    @param[in] co2_ppm Initial concentration
+
+    @param[in] output Receives every line the sensor sends
+*/
+void explorir_sim_init(explorir_sim_t * sim, uint32_t co2_ppm, explorir_sim_output_t output, void * context);
+
+/*
+    @brief Function to hand the simulated sensor one command, the reply is sent through output at once
+
+    @param[in] cmd Command bytes, with or without the trailing "\r\n"
+*/
+void explorir_sim_command(explorir_sim_t * sim, const uint8_t * cmd, uint16_t size);
+
+/*
+    @brief Function to advance time, takes a measurement every 500 ms and streams it in streaming mode
+
+    @param[in] now_ms Current time in milliseconds, may wrap
+*/
+void explorir_sim_tick(explorir_sim_t * sim, uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXPLORIR_SIM_H
@@ -0,0 +1,176 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_stability.c
+
+  @Summary
+    Online stability detector for ExplorIr readings
+
+  @Description
+    Implements the rolling sums and the variance and trend checks
+******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "explorir_stability.h"
+
+// @brief Function to check the full window against both limits
+static bool explorir_stability_check(const explorir_stability_t * stability) {
+    if(stability->count < stability->window)
+	return false;
+    if(explorir_stability_variance(stability) > (uint64_t)stability->max_stddev_ppm * stability->max_stddev_ppm)
+	return false;
+    int32_t slope = explorir_stability_slope(stability);
+    return (uint32_t)(slope < 0 ? -(int64_t)slope : slope) <= stability->max_slope_ppm_per_min;
+}
+
+/*
+    @brief Function to initialize a stability detector
+
+    @param[in] window Readings looked at, 2 - EXPLORIR_STABILITY_WINDOW, the detector is unstable until it is full
+
+    @param[in] max_stddev_ppm Largest standard deviation of stable readings
+
+    @param[in] max_slope_ppm_per_min Largest rise or fall of stable readings, as the least squares trend of the window
+
+    @param[in] period_ms Time between readings, EXPLORIR_STREAMING_PERIOD_MS of explorir_watchdog.h in streaming mode
+
+    @ret EXPLORIR_SUCCESS, or EXPLORIR_ERR_INVALID_INPUT if window or period_ms is out of range
+*/
+explorir_retcode_t explorir_stability_init(explorir_stability_t * stability, uint8_t window, uint32_t max_stddev_ppm,
+	uint32_t max_slope_ppm_per_min, uint32_t period_ms) {
+    memset(stability, 0, sizeof(*stability));
+    if(window < 2 || window > EXPLORIR_STABILITY_WINDOW || period_ms == 0)
+	return EXPLORIR_ERR_INVALID_INPUT;
+    stability->window = window;
+    stability->max_stddev_ppm = max_stddev_ppm;
+    stability->max_slope_ppm_per_min = max_slope_ppm_per_min;
+    stability->period_ms = period_ms;
+    return EXPLORIR_SUCCESS;
+}
+
+/*
+    @brief Function to forget every reading, e.g. after a mode change or a zero command
+*/
+void explorir_stability_reset(explorir_stability_t * stability) {
+    if(stability->stable)
+	stability->changes++;
+    stability->sum = 0;
+    stability->sum_squares = 0;
+    stability->sum_weighted = 0;
+    stability->count = 0;
+    stability->head = 0;
+    stability->stable = false;
+}
+
+/*
+    @brief Function to add a reading, O(1)
+
+    @param[in] ppm CO2 reading in ppm
+
+    @ret true if the readings are stable after this one
+*/
+bool explorir_stability_push(explorir_stability_t * stability, uint32_t ppm) {
+    uint64_t reading = ppm;
+    if(stability->count < stability->window) {
+	stability->sum_weighted += stability->count * reading;
+	stability->count++;
+    } else {
+	// the ring is window long, so once full the next position holds the oldest reading
+	uint64_t oldest = stability->readings[stability->head];
+	stability->sum -= oldest;
+	stability->sum_squares -= oldest * oldest;
+	// the oldest weighed 0, every other reading moves one position towards it
+	stability->sum_weighted -= stability->sum;
+	stability->sum_weighted += (stability->window - 1u) * reading;
+    }
+    stability->sum += reading;
+    stability->sum_squares += reading * reading;
+    stability->readings[stability->head] = ppm;
+    stability->head = (stability->head + 1) % stability->window;
+
+    bool stable = explorir_stability_check(stability);
+    if(stable != stability->stable) {
+	stability->stable = stable;
+	stability->changes++;
+#ifdef DEBUG_OUTPUT
+	NRF_LOG_INFO("Readings %s at %d ppm ", stable ? "stable" : "unstable", explorir_stability_mean(stability));
+	NRF_LOG_FLUSH();
+#endif
+    }
+    return stable;
+}
+
+/*
+    @brief Function to add a decoded measurement, the filtered field if present, otherwise the unfiltered one
+*/
+void explorir_stability_add(explorir_stability_t * stability, const explorir_sample_t * sample) {
+    if(sample->field_mask & FILTERED_MASK)
+	explorir_stability_push(stability, (uint32_t)sample->filtered * sample->scaling_factor);
+    else if(sample->field_mask & UNFILTERED_MASK)
+	explorir_stability_push(stability, (uint32_t)sample->unfiltered * sample->scaling_factor);
+}
+
+/*
+    @brief Sample callback adapter, assign to explorir_on_sample with the detector as sample_context
+
+    @note explorir_handler.explorir_on_sample = explorir_stability_on_sample;
+*/
+void explorir_stability_on_sample(const explorir_sample_t * sample, void * context) {
+    explorir_stability_add((explorir_stability_t *)context, sample);
+}
+
+/*
+    @brief Function to check whether the readings are stable
+
+    @ret true if the window is full and within both limits
+*/
+bool explorir_stability_is_stable(const explorir_stability_t * stability) {
+    return stability->stable;
+}
+
+/*
+    @brief Function to get the average of the readings in the window
+
+    @ret Average in ppm, 0 with no readings
+*/
+uint32_t explorir_stability_mean(const explorir_stability_t * stability) {
+    if(stability->count == 0)
+	return 0;
+    return stability->sum / stability->count;
+}
+
+/*
+    @brief Function to get the variance of the readings in the window
+
+    @ret Variance in ppm squared, 0 with fewer than two readings
+*/
+uint64_t explorir_stability_variance(const explorir_stability_t * stability) {
+    uint64_t n = stability->count;
+    if(n < 2)
+	return 0;
+    // n * sum of squares - sum^2 is n^2 times the population variance, never negative
+    return (n * stability->sum_squares - stability->sum * stability->sum) / (n * n);
+}
+
+/*
+    @brief Function to get the least squares trend of the readings in the window
+
+    @ret Trend in ppm per minute, positive while rising, 0 with fewer than two readings
+*/
+int32_t explorir_stability_slope(const explorir_stability_t * stability) {
+    int64_t n = stability->count;
+    if(n < 2)
+	return 0;
+    // positions run 0 .. n-1, their sum is n(n-1)/2 and n times their sum of squares less its square is n^2(n^2-1)/12
+    int64_t numerator = n * (int64_t)stability->sum_weighted - n * (n - 1) / 2 * (int64_t)stability->sum;
+    int64_t denominator = n * n * (n * n - 1) / 12 * stability->period_ms;
+    int64_t slope = numerator * 60000 / denominator;
+    if(slope > INT32_MAX)
+	return INT32_MAX;
+    if(slope < INT32_MIN)
+	return INT32_MIN;
+    return slope;
+}
@@ -0,0 +1,131 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_stability.h
+
+  @Summary
+    Online stability detector for ExplorIr readings
+
+  @Description
+    Tells when a sensor's readings have settled, after power-on, a mode
+    change or a calibration, so callers can gate calibration, duty cycles
+    and the first published value on measured stability instead of a fixed
+    worst-case wait. Over a rolling window of readings it keeps running sums
+    updated in O(1) per reading, and calls the readings stable while both
+    their standard deviation and their least squares trend stay within
+    limits. Integer math only, no square roots.
+
+    explorir_stability_init(&stability, 16, 10, 20, EXPLORIR_STREAMING_PERIOD_MS);
+    explorir.explorir_on_sample = explorir_stability_on_sample;
+    explorir.sample_context = &stability;
+    ...
+    if(explorir_stability_is_stable(&stability))
+	; // settled
+******************************************************************************/
+
+#ifndef EXPLORIR_STABILITY_H
+#define EXPLORIR_STABILITY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "explorir.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// most readings in the rolling window
+#define EXPLORIR_STABILITY_WINDOW 32
+
+// @brief stability detector of one sensor
+typedef struct {
+    uint32_t readings[EXPLORIR_STABILITY_WINDOW]; // ring of the latest readings in ppm
+    uint64_t sum; // of the readings in the window
+    uint64_t sum_squares;
+    uint64_t sum_weighted; // of each reading times its position in the window, oldest at 0
+    uint32_t max_stddev_ppm; // largest standard deviation of stable readings
+    uint32_t max_slope_ppm_per_min; // largest trend of stable readings, up or down
+    uint32_t period_ms; // time between readings, converts the trend per reading into a trend per minute
+    uint32_t changes; // times the detector went from unstable to stable or back
+    uint8_t window; // readings looked at, 2 - EXPLORIR_STABILITY_WINDOW
+    uint8_t count; // readings in the window
+    uint8_t head; // position of the next reading in the ring
+    bool stable;
+} explorir_stability_t;
+
+/*
+    @brief Function to initialize a stability detector
+
+    @param[in] window Readings looked at, 2 - EXPLORIR_STABILITY_WINDOW, the detector is unstable until it is full
+
+    @param[in] max_stddev_ppm Largest standard deviation of stable readings
+
+    @param[in] max_slope_ppm_per_min Largest rise or fall of stable readings, as the least squares trend of the window
+
+    @param[in] period_ms Time between readings, EXPLORIR_STREAMING_PERIOD_MS of explorir_watchdog.h in streaming mode
+
+    @ret EXPLORIR_SUCCESS, or EXPLORIR_ERR_INVALID_INPUT if window or period_ms is out of range
+*/
+explorir_retcode_t explorir_stability_init(explorir_stability_t * stability, uint8_t window, uint32_t max_stddev_ppm,
+	uint32_t max_slope_ppm_per_min, uint32_t period_ms);
+
+/*
+    @brief Function to forget every reading, e.g. after a mode change or a zero command
+*/
+void explorir_stability_reset(explorir_stability_t * stability);
+
+/*
+    @brief Function to add a reading, O(1)
+
+    @param[in] ppm CO2 reading in ppm
+
+    @ret true if the readings are stable after this one
+*/
+bool explorir_stability_push(explorir_stability_t * stability, uint32_t ppm);
+
+/*
+    @brief Function to add a decoded measurement, the filtered field if present, otherwise the unfiltered one
+*/
+void explorir_stability_add(explorir_stability_t * stability, const explorir_sample_t * sample);
+
+/*
+    @brief Sample callback adapter, assign to explorir_on_sample with the detector as sample_context
+
+    @note explorir_handler.explorir_on_sample = explorir_stability_on_sample;
+*/
+void explorir_stability_on_sample(const explorir_sample_t * sample, void * context);
+
+/*
+    @brief Function to check whether the readings are stable
+
+    @ret true if the window is full and within both limits
+*/
+bool explorir_stability_is_stable(const explorir_stability_t * stability);
+
+/*
+    @brief Function to get the average of the readings in the window
+
+    @ret Average in ppm, 0 with no readings
+*/
+uint32_t explorir_stability_mean(const explorir_stability_t * stability);
+
+/*
+    @brief Function to get the variance of the readings in the window
+
+    @ret Variance in ppm squared, 0 with fewer than two readings
+*/
+uint64_t explorir_stability_variance(const explorir_stability_t * stability);
+
+/*
+    @brief Function to get the least squares trend of the readings in the window
+
+    @ret Trend in ppm per minute, positive while rising, 0 with fewer than two readings
+*/
+int32_t explorir_stability_slope(const explorir_stability_t * stability);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXPLORIR_STABILITY_H
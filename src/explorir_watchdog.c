@@ -0,0 +1,195 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_watchdog.c
+
+  @Summary
+    Streaming health watchdog and automatic reconnect for ExplorIr handlers
+
+  @Description
+    Implements staleness detection and the recovery sequence
+******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "explorir_watchdog.h"
+#if EXPLORIR_FEATURE_ASYNC
+#include "explorir_async.h"
+#endif
+
+/*
+    @brief Function to initialize a watchdog for a streaming handler
+
+    @param[in] period_ms Expected time between measurement lines, EXPLORIR_STREAMING_PERIOD_MS in streaming mode
+
+    @param[in] missed_periods Periods without a line before the handler is flagged stale
+
+    @param[in] backoff_ms Wait after the first failed recovery, doubled after each further failure
+
+    @param[in] max_backoff_ms Upper bound of the wait between recoveries
+
+    @param[in] now_ms Current time, the watchdog starts counting from here
+*/
+void explorir_watchdog_init(explorir_watchdog_t * watchdog, explorir_handler_t * explorir_handler, uint32_t period_ms, uint8_t missed_periods,
+	uint32_t backoff_ms, uint32_t max_backoff_ms, uint32_t now_ms) {
+    memset(watchdog, 0, sizeof(*watchdog));
+    watchdog->explorir_handler = explorir_handler;
+    watchdog->period_ms = period_ms;
+    watchdog->missed_periods = missed_periods ? missed_periods : 1;
+    watchdog->backoff_ms = backoff_ms;
+    watchdog->max_backoff_ms = max_backoff_ms;
+    watchdog->state = EXPLORIR_WATCHDOG_OK;
+    watchdog->last_sample_count = explorir_handler->sample_count;
+    watchdog->last_seen_ms = now_ms;
+    watchdog->current_backoff_ms = backoff_ms;
+}
+
+#if EXPLORIR_FEATURE_ASYNC
+// @brief steps of a queued recovery
+enum {
+    EXPLORIR_WATCHDOG_STEP_NONE = 0,
+    EXPLORIR_WATCHDOG_STEP_STOP, // K 0 queued
+    EXPLORIR_WATCHDOG_STEP_SCALING_FACTOR, // '.' queued
+    EXPLORIR_WATCHDOG_STEP_START // K 1 queued
+};
+
+static void explorir_watchdog_step(explorir_retcode_t result, explorir_handler_t * explorir_handler, void * context);
+
+// @brief Function to queue one recovery step with the watchdog's completion callback
+static bool explorir_watchdog_queue(explorir_watchdog_t * watchdog, explorir_async_t * async, uint8_t step) {
+    explorir_handler_t * explorir_handler = watchdog->explorir_handler;
+    explorir_retcode_t result;
+    watchdog->recovery_step = step;
+    explorir_async_next(async, explorir_watchdog_step, watchdog);
+    if(step == EXPLORIR_WATCHDOG_STEP_SCALING_FACTOR)
+	result = explorir_request_scaling_factor(explorir_handler);
+    else
+	result = explorir_set_operation_mode(step == EXPLORIR_WATCHDOG_STEP_STOP ? EXPLORIR_MODE_COMMAND : EXPLORIR_MODE_STREAMING,
+		explorir_handler);
+    if(result != EXPLORIR_SUCCESS)
+	watchdog->recovery_step = EXPLORIR_WATCHDOG_STEP_NONE;
+    return result == EXPLORIR_SUCCESS;
+}
+
+/*
+    @brief Completion callback of each queued recovery step, queues the next one
+
+    @note A failed step ends the sequence, the watchdog stays stale and tries again after its backoff
+*/
+static void explorir_watchdog_step(explorir_retcode_t result, explorir_handler_t * explorir_handler, void * context) {
+    explorir_watchdog_t * watchdog = context;
+    explorir_async_t * async = explorir_async_of(explorir_handler);
+    uint8_t step = watchdog->recovery_step;
+    watchdog->recovery_step = EXPLORIR_WATCHDOG_STEP_NONE;
+
+    bool queued = false;
+    if(step == EXPLORIR_WATCHDOG_STEP_STOP && result == EXPLORIR_SUCCESS && async) {
+	// the scaling factor can only be read while the sensor is stopped
+	watchdog->previous_scaling_factor = explorir_handler->scaling_factor;
+	explorir_handler->scaling_factor = 0;
+	queued = explorir_watchdog_queue(watchdog, async, EXPLORIR_WATCHDOG_STEP_SCALING_FACTOR);
+	if(!queued)
+	    explorir_handler->scaling_factor = watchdog->previous_scaling_factor;
+    } else if(step == EXPLORIR_WATCHDOG_STEP_SCALING_FACTOR) {
+	if(result != EXPLORIR_SUCCESS || explorir_handler->scaling_factor == 0)
+	    explorir_handler->scaling_factor = watchdog->previous_scaling_factor;
+	else if(async)
+	    queued = explorir_watchdog_queue(watchdog, async, EXPLORIR_WATCHDOG_STEP_START);
+    } else if(step == EXPLORIR_WATCHDOG_STEP_START && result == EXPLORIR_SUCCESS) {
+	return; // recovering until the next measurement line
+    }
+    if(!queued)
+	watchdog->state = EXPLORIR_WATCHDOG_STALE;
+}
+#endif
+
+/*
+    @brief Function to bring a silent sensor back into streaming mode
+
+    @ret true if every step of the sequence was acknowledged, or for a queued handler if the first step was queued
+*/
+static bool explorir_watchdog_recover(explorir_watchdog_t * watchdog) {
+    explorir_handler_t * explorir_handler = watchdog->explorir_handler;
+    watchdog->recovery_attempts++;
+
+    if(watchdog->reopen_transport && !watchdog->reopen_transport(explorir_handler, watchdog->context))
+	return false;
+
+#if EXPLORIR_FEATURE_ASYNC
+    if(explorir_handler->explorir_submit) {
+	// queued commands return before their reply, each step is queued from the completion of the one before
+	explorir_async_t * async = explorir_async_of(explorir_handler);
+	return async && explorir_watchdog_queue(watchdog, async, EXPLORIR_WATCHDOG_STEP_STOP);
+    }
+#endif
+
+    // the scaling factor can only be read while the sensor is stopped
+    if(explorir_set_operation_mode(EXPLORIR_MODE_COMMAND, explorir_handler) != EXPLORIR_SUCCESS)
+	return false;
+    uint16_t previous_scaling_factor = explorir_handler->scaling_factor;
+    explorir_handler->scaling_factor = 0;
+    if(explorir_request_scaling_factor(explorir_handler) != EXPLORIR_SUCCESS || explorir_handler->scaling_factor == 0) {
+	explorir_handler->scaling_factor = previous_scaling_factor;
+	return false;
+    }
+    return explorir_set_operation_mode(EXPLORIR_MODE_STREAMING, explorir_handler) == EXPLORIR_SUCCESS;
+}
+
+/*
+    @brief Function to check the handler and run recovery when due, call from the main loop
+
+    @param[in] now_ms Current time in milliseconds, may wrap
+
+    @ret Watchdog state after the check
+*/
+explorir_watchdog_state_t explorir_watchdog_poll(explorir_watchdog_t * watchdog, uint32_t now_ms) {
+    explorir_handler_t * explorir_handler = watchdog->explorir_handler;
+
+    if(explorir_handler->sample_count != watchdog->last_sample_count) {
+	// fresh data, healthy again
+	watchdog->last_sample_count = explorir_handler->sample_count;
+	watchdog->last_seen_ms = now_ms;
+	watchdog->state = EXPLORIR_WATCHDOG_OK;
+	watchdog->current_backoff_ms = watchdog->backoff_ms;
+	return watchdog->state;
+    }
+
+    if(watchdog->state == EXPLORIR_WATCHDOG_OK) {
+	if(now_ms - watchdog->last_seen_ms < watchdog->period_ms * watchdog->missed_periods)
+	    return watchdog->state;
+#ifdef DEBUG_OUTPUT
+	NRF_LOG_INFO("ExplorIR %d stale", explorir_handler->sensor_id);
+	NRF_LOG_FLUSH();
+#endif
+	watchdog->state = EXPLORIR_WATCHDOG_STALE;
+	watchdog->stale_events++;
+	watchdog->next_attempt_ms = now_ms;
+	explorir_handler->err_code = EXPLORIR_ERR_TIMEOUT;
+    }
+
+    // wrap-safe "now_ms >= next_attempt_ms", and never while a queued recovery is still running
+    if((int32_t)(now_ms - watchdog->next_attempt_ms) < 0 || watchdog->recovery_step)
+	return watchdog->state;
+
+    bool sent = explorir_watchdog_recover(watchdog);
+    watchdog->state = sent ? EXPLORIR_WATCHDOG_RECOVERING : EXPLORIR_WATCHDOG_STALE;
+    // a recovery counts as failed until a measurement line shows up, so the wait grows either way
+    watchdog->next_attempt_ms = now_ms + (sent ? watchdog->period_ms * watchdog->missed_periods : 0) + watchdog->current_backoff_ms;
+    watchdog->current_backoff_ms *= 2;
+    if(watchdog->current_backoff_ms > watchdog->max_backoff_ms)
+	watchdog->current_backoff_ms = watchdog->max_backoff_ms;
+    explorir_handler->err_code = EXPLORIR_ERR_TIMEOUT; // readings stay stale until a new line arrives
+
+    return watchdog->state;
+}
+
+/*
+    @brief Function to check whether the handler's readings are stale
+
+    @ret true while no fresh measurement line has arrived since the handler was flagged stale
+*/
+bool explorir_watchdog_is_stale(const explorir_watchdog_t * watchdog) {
+    return watchdog->state != EXPLORIR_WATCHDOG_OK;
+}
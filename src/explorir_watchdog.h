@@ -0,0 +1,101 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_watchdog.h
+
+  @Summary
+    Streaming health watchdog and automatic reconnect for ExplorIr handlers
+
+  @Description
+    Expects a measurement line every streaming period. When none arrives for
+    a configurable number of periods the handler is flagged stale (err_code
+    is set to EXPLORIR_ERR_TIMEOUT) and a recovery sequence is run with
+    exponential backoff: reopen the transport, stop the sensor, revalidate
+    the scaling factor and restart streaming. The handler is healthy again
+    as soon as the next measurement line is decoded.
+
+    With an explorir_async.h queue attached the same steps are queued one
+    at a time, each from the completion callback of the one before, so the
+    poll never blocks. Handlers whose explorir_submit is another hook are
+    not recovered, their commands can't be followed.
+******************************************************************************/
+
+#ifndef EXPLORIR_WATCHDOG_H
+#define EXPLORIR_WATCHDOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "explorir.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// streaming period of the sensor, it outputs two measurement lines per second
+#define EXPLORIR_STREAMING_PERIOD_MS 500
+
+// @brief watchdog states
+typedef enum {
+    EXPLORIR_WATCHDOG_OK = 0, // measurement lines arriving
+    EXPLORIR_WATCHDOG_STALE, // no measurement line for too long, recovery pending
+    EXPLORIR_WATCHDOG_RECOVERING // recovery sequence sent, waiting for the next measurement line
+} explorir_watchdog_state_t;
+
+// @brief watchdog for one streaming handler
+typedef struct {
+    explorir_handler_t * explorir_handler;
+    uint32_t period_ms; // expected time between measurement lines
+    uint8_t missed_periods; // periods without a line before the handler is stale
+    uint32_t backoff_ms; // wait after the first failed recovery
+    uint32_t max_backoff_ms; // upper bound of the wait between recoveries
+    bool(*reopen_transport)(explorir_handler_t *explorir_handler, void *context); // optional, e.g. reopen the serial port
+    void *context; // passed to reopen_transport
+    explorir_watchdog_state_t state;
+    uint32_t last_sample_count;
+    uint32_t last_seen_ms; // time the last measurement line was noticed
+    uint32_t next_attempt_ms;
+    uint32_t current_backoff_ms;
+    uint32_t stale_events; // times the handler went stale
+    uint32_t recovery_attempts;
+    uint16_t previous_scaling_factor; // restored if the queued scaling factor request fails
+    uint8_t recovery_step; // command of the queued recovery waiting for its reply, 0 if none
+} explorir_watchdog_t;
+
+/*
+    @brief Function to initialize a watchdog for a streaming handler
+
+    @param[in] period_ms Expected time between measurement lines, EXPLORIR_STREAMING_PERIOD_MS in streaming mode
+
+    @param[in] missed_periods Periods without a line before the handler is flagged stale
+
+    @param[in] backoff_ms Wait after the first failed recovery, doubled after each further failure
+
+    @param[in] max_backoff_ms Upper bound of the wait between recoveries
+
+    @param[in] now_ms Current time, the watchdog starts counting from here
+*/
+void explorir_watchdog_init(explorir_watchdog_t * watchdog, explorir_handler_t * explorir_handler, uint32_t period_ms, uint8_t missed_periods,
+	uint32_t backoff_ms, uint32_t max_backoff_ms, uint32_t now_ms);
+
+/*
+    @brief Function to check the handler and run recovery when due, call from the main loop
+
+    @param[in] now_ms Current time in milliseconds, may wrap
+
+    @ret Watchdog state after the check
+*/
+explorir_watchdog_state_t explorir_watchdog_poll(explorir_watchdog_t * watchdog, uint32_t now_ms);
+
+/*
+    @brief Function to check whether the handler's readings are stale
+
+    @ret true while no fresh measurement line has arrived since the handler was flagged stale
+*/
+bool explorir_watchdog_is_stale(const explorir_watchdog_t * watchdog);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXPLORIR_WATCHDOG_H
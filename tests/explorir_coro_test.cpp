@@ -0,0 +1,266 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_coro_test.cpp
+
+  @Summary
+    Tests of the C++20 coroutine wrapper in explorir_coro.hpp, run by ctest
+
+  @Description
+    Drives explorir::AsyncSensor tasks on a loopback transport, answering
+    either later from the test's event loop or from inside write(), with the
+    time advanced by hand. Covers command sequences, timeouts, sleeps, the
+    two-byte parameters and tasks destroyed while they wait on the queue.
+    Same CHECK() and exit code as explorir_test.c.
+******************************************************************************/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include "explorir_coro.hpp"
+
+extern "C" {
+volatile bool explorir_complete_uart_rx;
+}
+
+static unsigned failures;
+static unsigned checks;
+
+#define CHECK(expression) do { \
+	checks++; \
+	if(!(expression)) { \
+	    failures++; \
+	    std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expression); \
+	} \
+    } while(0)
+
+// @brief answers like a sensor in command mode, from inside write() if synchronous, else when the test delivers
+struct LoopbackTransport {
+    std::function<void(const uint8_t *, uint16_t)> process; // the sensor's process()
+    std::deque<std::string> rx;
+    std::string sent; // every command written, concatenated
+    unsigned writes = 0;
+    unsigned drop = 0; // commands left unanswered, to time out
+    char fail = 0; // command answered with '?'
+    bool synchronous = false;
+
+    void write(const uint8_t * data, std::size_t size) {
+	std::string command(reinterpret_cast<const char *>(data), size);
+	sent += command;
+	writes++;
+	if(drop) {
+	    drop--;
+	    return;
+	}
+	if(command[0] == fail) {
+	    rx.push_back("?\r\n");
+	} else {
+	    switch(command[0]) {
+		case OPERATION_MODE:
+		    rx.push_back("K 0000" + command.substr(2, 1) + "\r\n");
+		    break;
+		case SENSOR_INFO:
+		    rx.push_back("Y,Jan 30 2013,10:45:03,AL17\r\n");
+		    rx.push_back(" B 00233 00000\r\n");
+		    break;
+		case SCALING_FACTOR:
+		    rx.push_back(". 00010\r\n");
+		    break;
+		case SET_DIGITAL_FILTER:
+		    rx.push_back("A 00016\r\n");
+		    break;
+		case GET_PRESSURE_AND_CONCENTRATION_COMPENSATION:
+		    rx.push_back("s 08192\r\n");
+		    break;
+		case SET_TYPE_AND_NUM_OF_DATA_OUTPUTS:
+		    rx.push_back("M 00006\r\n");
+		    break;
+		case FILTERED_CO2_MEASUREMENT:
+		    rx.push_back(" Z 00042\r\n");
+		    break;
+		case SET_CO2_BGROUND_CONCENTRATION:
+		    rx.push_back(" p" + command.substr(1));
+		    break;
+		default:
+		    break;
+	    }
+	}
+	if(synchronous)
+	    deliver();
+    }
+
+    // @brief the event loop side, hands the queued lines to the sensor
+    void deliver() {
+	while(!rx.empty()) {
+	    std::string line = rx.front();
+	    rx.pop_front();
+	    process(reinterpret_cast<const uint8_t *>(line.data()), static_cast<uint16_t>(line.size()));
+	}
+    }
+};
+
+using TestSensor = explorir::AsyncSensor<LoopbackTransport, 4>;
+
+// @brief sensor whose transport feeds its replies back to it
+struct Loopback {
+    TestSensor sensor{5, 100};
+
+    Loopback() {
+	sensor.transport().process = [this](const uint8_t * data, uint16_t size) { sensor.process(data, size); };
+    }
+    LoopbackTransport & transport() { return sensor.transport(); }
+
+    // @brief runs the event loop until the task finishes or the queue has nothing left to do
+    template <typename Task>
+    void run(Task & task) {
+	for(int k = 0; k < 16 && !task.done(); k++) {
+	    transport().deliver();
+	}
+    }
+};
+
+static explorir::Task<uint32_t> read_twice(TestSensor & sensor, unsigned & steps) {
+    auto first = co_await sensor.request_filtered_co2();
+    steps++;
+    auto second = co_await sensor.request_filtered_co2();
+    steps++;
+    co_return first.value_or(0) + second.value_or(0);
+}
+
+static explorir::Task<explorir_retcode_t> sleep_then_read(TestSensor & sensor, unsigned & steps) {
+    if(auto r = co_await sensor.sleep(100); !r)
+	co_return r.error();
+    steps++;
+    auto z = co_await sensor.request_filtered_co2();
+    steps++;
+    co_return z.error();
+}
+
+static explorir::Task<explorir_retcode_t> set_parameter(TestSensor & sensor, unsigned & steps) {
+    auto r = co_await sensor.set_co2_for_auto_zeroing(400);
+    steps++;
+    co_return r.error();
+}
+
+static void test_init() {
+    for(bool synchronous : {false, true}) {
+	Loopback loop;
+	loop.transport().synchronous = synchronous;
+	auto task = loop.sensor.init();
+	task.start();
+	loop.run(task);
+	CHECK(task.done() && task.result());
+	CHECK(loop.transport().sent == "K 0\r\nY\r\n.\r\nA 16\r\ns\r\nM 6\r\nK 0\r\n");
+	CHECK(loop.sensor.handler().info.serial_number == 23300000 && loop.sensor.handler().scaling_factor == 10);
+	CHECK(loop.sensor.idle());
+    }
+}
+
+static void test_commands() {
+    Loopback loop;
+    loop.sensor.handler().scaling_factor = 10;
+    unsigned steps = 0;
+    auto task = read_twice(loop.sensor, steps);
+    task.start();
+    CHECK(steps == 0 && loop.transport().writes == 1);
+    loop.run(task);
+    CHECK(task.done() && task.result() == 840 && steps == 2);
+
+    // '?' resumes the task with the error
+    loop.transport().fail = FILTERED_CO2_MEASUREMENT;
+    auto failed = read_twice(loop.sensor, steps);
+    failed.start();
+    loop.run(failed);
+    CHECK(failed.done() && failed.result() == 0 && steps == 4);
+    loop.transport().fail = 0;
+
+    auto parameter = set_parameter(loop.sensor, steps);
+    parameter.start();
+    loop.run(parameter);
+    CHECK(parameter.done() && parameter.result() == EXPLORIR_SUCCESS && steps == 5);
+    CHECK(loop.transport().sent.find("P 8 1\r\nP 9 144\r\n") != std::string::npos);
+
+    // no reply to P 8, P 9 is not sent
+    unsigned writes = loop.transport().writes;
+    loop.transport().drop = 1;
+    auto lost = set_parameter(loop.sensor, steps);
+    lost.start();
+    loop.sensor.tick(100);
+    CHECK(lost.done() && lost.result() == EXPLORIR_ERR_TIMEOUT && loop.transport().writes == writes + 1);
+}
+
+static void test_sleep() {
+    for(bool synchronous : {false, true}) {
+	Loopback loop;
+	loop.transport().synchronous = synchronous;
+	unsigned steps = 0;
+	loop.sensor.tick(1000);
+	auto task = sleep_then_read(loop.sensor, steps);
+	task.start();
+	loop.sensor.tick(1099);
+	CHECK(steps == 0 && loop.transport().writes == 0);
+	loop.sensor.tick(1100);
+	loop.run(task);
+	CHECK(task.done() && task.result() == EXPLORIR_SUCCESS && steps == 2);
+    }
+}
+
+// @brief the queue still holds a command of a task that is gone, the timeout, the reply or the sensor's destructor must not resume it
+static void test_destroyed_task() {
+    unsigned steps = 0;
+    {
+	Loopback loop;
+	loop.transport().drop = 1;
+	auto task = std::make_unique<explorir::Task<uint32_t>>(read_twice(loop.sensor, steps));
+	task->start();
+	CHECK(!loop.sensor.idle());
+	task.reset();
+	loop.sensor.tick(100);
+	CHECK(loop.sensor.idle() && steps == 0);
+
+	// the queue still works for other tasks
+	auto next = read_twice(loop.sensor, steps);
+	next.start();
+	loop.run(next);
+	CHECK(next.done() && steps == 2);
+    }
+    {
+	// the reply arrives after the task is gone, P 9 is never sent
+	Loopback loop;
+	steps = 0;
+	auto task = std::make_unique<explorir::Task<explorir_retcode_t>>(set_parameter(loop.sensor, steps));
+	task->start();
+	task.reset();
+	loop.transport().deliver();
+	CHECK(loop.sensor.idle() && steps == 0 && loop.transport().sent == "P 8 1\r\n");
+    }
+    {
+	// a sleep and a queued command, both still waiting when the sensor is destroyed
+	Loopback loop;
+	steps = 0;
+	auto sleeping = std::make_unique<explorir::Task<explorir_retcode_t>>(sleep_then_read(loop.sensor, steps));
+	sleeping->start();
+	loop.transport().drop = 1;
+	auto reading = std::make_unique<explorir::Task<uint32_t>>(read_twice(loop.sensor, steps));
+	reading->start();
+	sleeping.reset();
+	reading.reset();
+	CHECK(!loop.sensor.idle());
+    } // ~AsyncSensor completes both with EXPLORIR_ERR_TIMEOUT
+    CHECK(steps == 0);
+}
+
+int main() {
+    test_init();
+    test_commands();
+    test_sleep();
+    test_destroyed_task();
+    std::printf("%u checks, %u failed\n", checks, failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,211 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_hpp_test.cpp
+
+  @Summary
+    Tests of the C++17 wrapper in explorir.hpp, run by ctest
+
+  @Description
+    Instantiates explorir::Sensor on a scripted transport and a fixed clock,
+    so template errors show up in the build and the command, retry and
+    multi-line reply handling is checked without a sensor. Same CHECK() and
+    exit code as explorir_test.c.
+******************************************************************************/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include "explorir.hpp"
+
+extern "C" {
+volatile bool explorir_complete_uart_rx;
+}
+
+static unsigned failures;
+static unsigned checks;
+
+#define CHECK(expression) do { \
+	checks++; \
+	if(!(expression)) { \
+	    failures++; \
+	    std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expression); \
+	} \
+    } while(0)
+
+// @brief answers like a sensor in command mode, lines queued by the test come first
+struct ScriptedTransport {
+    std::deque<std::string> rx;
+    std::string last; // last command written
+    unsigned writes = 0;
+    unsigned drop = 0; // commands left unanswered, to time out
+
+    void write(const uint8_t * data, std::size_t size) {
+	last.assign(reinterpret_cast<const char *>(data), size);
+	writes++;
+	if(drop) {
+	    drop--;
+	    return;
+	}
+	char reply[32];
+	switch(last[0]) {
+	    case OPERATION_MODE:
+		std::snprintf(reply, sizeof(reply), "K %05d\r\n", last[2] - '0');
+		rx.push_back(" Z 00040 z 00041\r\n"); // still streaming until the reply
+		rx.push_back(reply);
+		break;
+	    case SENSOR_INFO:
+		rx.push_back("Y,Jan 30 2013,10:45:03,AL17\r\n");
+		rx.push_back(" B 00233 00000\r\n");
+		break;
+	    case SCALING_FACTOR:
+		rx.push_back(". 00010\r\n");
+		break;
+	    case SET_DIGITAL_FILTER:
+	    case SET_PRESSURE_AND_CONCENTRATION_COMPENSATION:
+	    case MANUALLY_SET_ZERO_POINT:
+		std::snprintf(reply, sizeof(reply), "%c %05ld\r\n", last[0], std::strtol(last.c_str() + 2, nullptr, 10) % 100000);
+		rx.push_back(reply);
+		break;
+	    case GET_PRESSURE_AND_CONCENTRATION_COMPENSATION:
+		rx.push_back("s 08192\r\n");
+		break;
+	    case SET_TYPE_AND_NUM_OF_DATA_OUTPUTS:
+		rx.push_back("M 00006\r\n");
+		break;
+	    case FILTERED_CO2_MEASUREMENT:
+		rx.push_back(" Z 00042\r\n");
+		break;
+	    case SET_ZERO_POINT_USING_FRESH_AIR:
+		rx.push_back("?\r\n");
+		break;
+	    case SET_CO2_BGROUND_CONCENTRATION:
+		rx.push_back(" p" + last.substr(1));
+		break;
+	    default:
+		break;
+	}
+    }
+
+    std::size_t read_line(uint8_t * buffer, std::size_t capacity) {
+	if(rx.empty())
+	    return 0;
+	std::string line = rx.front();
+	rx.pop_front();
+	std::size_t size = line.size() < capacity ? line.size() : capacity;
+	std::memcpy(buffer, line.data(), size);
+	return size;
+    }
+};
+
+struct FixedClock {
+    static uint32_t now_ms() { return 1234; }
+};
+
+using TestSensor = explorir::Sensor<ScriptedTransport, FixedClock>;
+
+static void test_result() {
+    explorir::Result<uint32_t> value(420u);
+    CHECK(value && *value == 420 && value.error() == EXPLORIR_SUCCESS);
+    explorir::Result<uint32_t> error(explorir::Error{EXPLORIR_ERR_TIMEOUT});
+    CHECK(!error && error.error() == EXPLORIR_ERR_TIMEOUT && error.value_or(7) == 7);
+    explorir::Result<void> done;
+    CHECK(done.has_value());
+}
+
+static void test_init() {
+    TestSensor sensor(3);
+    auto r = sensor.init();
+    CHECK(r && sensor.transport().last == "K 0\r\n" && sensor.handler().current_mode == EXPLORIR_MODE_DEFAULT);
+    CHECK(sensor.handler().scaling_factor == 10 && sensor.handler().digital_filter == DIGITAL_FILTER_DEFAULT);
+    CHECK(sensor.handler().info.serial_number == 23300000);
+    CHECK(std::strcmp(sensor.handler().info.firmware_version, "AL17") == 0);
+    CHECK(sensor.handler().current_filtered_co2 == 0 && sensor.handler().sensor_id == 3);
+}
+
+static void test_commands() {
+    TestSensor sensor(1);
+    sensor.handler().scaling_factor = 10;
+
+    auto z = sensor.request_filtered_co2();
+    CHECK(z && *z == 420 && sensor.transport().last == "Z\r\n");
+    auto filter = sensor.set_digital_filter(32);
+    CHECK(filter && *filter == 32 && sensor.transport().last == "A 32\r\n");
+    CHECK(sensor.set_digital_filter(MAX_DIGITAL_FILTER + 1).error() == EXPLORIR_ERR_INVALID_INPUT);
+    auto mode = sensor.set_operation_mode(EXPLORIR_MODE_POLLING); // the measurement line in front is skipped
+    CHECK(mode && *mode == EXPLORIR_MODE_POLLING);
+    CHECK(sensor.set_operation_mode(static_cast<explorir_mode_t>(7)).error() == EXPLORIR_ERR_INVALID_MODE);
+
+    auto info = sensor.request_sensor_info();
+    CHECK(info && info->serial_number == 23300000 && info->firmware_date == 20130130);
+
+    CHECK(sensor.set_zero_point_in_fresh_air().error() == EXPLORIR_ERR_UNRECOGNIZED_COMMAND);
+    auto parameter = sensor.set_co2_for_auto_zeroing(400);
+    CHECK(parameter && sensor.transport().last == "P 9 144\r\n");
+    CHECK(sensor.set_co2_for_zero_point_in_fresh_air(MAX_TWO_BYTE_VALUE + 1).error() == EXPLORIR_ERR_INVALID_INPUT);
+    CHECK(sensor.set_output_data(FILTERED_MASK | UNFILTERED_MASK) && sensor.transport().last == "M 6\r\n");
+    CHECK(sensor.set_output_data(0).error() == EXPLORIR_ERR_INVALID_INPUT);
+
+    // only unrelated lines, then nothing
+    sensor.transport().drop = 1;
+    for(uint8_t k = 0; k <= TestSensor::max_unrelated_lines; k++) {
+	sensor.transport().rx.push_back(" Z 00400 z 00398\r\n");
+    }
+    CHECK(sensor.request_scaling_factor().error() == EXPLORIR_ERR_TIMEOUT);
+
+    // the handler has no receive buffer, C commands on it fail instead of reporting a reply they never read
+    sensor.transport().rx.clear();
+    unsigned writes = sensor.transport().writes;
+    CHECK(explorir_request_scaling_factor(&sensor.handler()) == EXPLORIR_ERR_INVALID_INPUT);
+    CHECK(sensor.transport().writes == writes);
+}
+
+static void test_poll() {
+    TestSensor sensor(2);
+    sensor.handler().scaling_factor = 10;
+    CHECK(!sensor.poll()); // timeout
+    sensor.transport().rx.push_back("K 00001\r\n");
+    CHECK(!sensor.poll()); // not a measurement
+    sensor.transport().rx.push_back(" Z 00400 z 00398\r\n");
+    auto reading = sensor.poll();
+    CHECK(reading && reading->timestamp_ms == 1234 && reading->filtered_ppm == 4000 && reading->unfiltered_ppm == 3980);
+}
+
+#if EXPLORIR_FEATURE_RETRY
+static uint32_t waited_ms;
+
+static void test_delay(uint32_t ms) {
+    waited_ms += ms;
+}
+
+static void test_retry() {
+    static const explorir_retry_config_t retry = {{3, 10, 2, 0, false}, nullptr, 0};
+    TestSensor sensor(4);
+    sensor.handler().retry_config = &retry;
+    sensor.handler().explorir_delay_ms = test_delay;
+    sensor.transport().drop = 2;
+    auto scaling = sensor.request_scaling_factor();
+    CHECK(scaling && *scaling == 10 && sensor.transport().writes == 3 && waited_ms == 30);
+
+    // calibration commands are not repeated
+    unsigned writes = sensor.transport().writes;
+    CHECK(sensor.set_zero_point_in_fresh_air().error() == EXPLORIR_ERR_UNRECOGNIZED_COMMAND);
+    CHECK(sensor.transport().writes == writes + 1);
+}
+#endif
+
+int main() {
+    test_result();
+    test_init();
+    test_commands();
+    test_poll();
+#if EXPLORIR_FEATURE_RETRY
+    test_retry();
+#endif
+    std::printf("%u checks, %u failed\n", checks, failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
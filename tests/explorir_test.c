@@ -0,0 +1,1261 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_test.c
+
+  @Summary
+    Unit tests of the ExplorIr driver, run by ctest
+
+  @Description
+    One executable, no framework: every test_ function checks one module
+    with CHECK(), which reports the failing expression and keeps going. The
+    exit code is the number of failed checks. Parts that need a feature or a
+    POSIX host are compiled only where CMake builds the module they test.
+******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "explorir.h"
+#include "explorir_framer.h"
+#include "explorir_filter.h"
+#include "explorir_aggregate.h"
+#include "explorir_watchdog.h"
+#include "explorir_autozero.h"
+#include "explorir_log.h"
+#include "explorir_batch.h"
+#include "explorir_stability.h"
+#include "explorir_pressure.h"
+#if EXPLORIR_FEATURE_ASYNC
+#include "explorir_async.h"
+#if EXPLORIR_FEATURE_FLEET
+#include "explorir_fleet.h"
+#endif
+#include "explorir_calibrate.h"
+#endif
+#if EXPLORIR_TEST_LOG_MMAP
+#include <unistd.h>
+#include "explorir_log_mmap.h"
+#endif
+#if EXPLORIR_TEST_CAPTURE
+#include "explorir_capture.h"
+#endif
+#if EXPLORIR_TEST_EXPORTER
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "explorir_exporter.h"
+#endif
+
+volatile bool explorir_complete_uart_rx;
+
+static unsigned failures;
+static unsigned checks;
+
+#define CHECK(expression) do { \
+	checks++; \
+	if(!(expression)) { \
+	    failures++; \
+	    fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expression); \
+	} \
+    } while(0)
+
+// @brief parses one zero terminated line into the handler
+static explorir_retcode_t parse(explorir_handler_t * explorir_handler, const char * line) {
+    return explorir_parse_response((const uint8_t *)line, strlen(line), explorir_handler);
+}
+
+// @brief encodes a command and compares it with the expected text
+static bool encodes(unsigned char identifier, explorir_args_t args, uint32_t first, uint32_t second, const char * expected) {
+    unsigned char msg[EXPLORIR_MAX_COMMAND];
+    uint8_t size = explorir_encode_command(msg, identifier, args, first, second);
+    return size == strlen(expected) && memcmp(msg, expected, size) == 0;
+}
+
+static void test_encode_command(void) {
+    CHECK(encodes(FILTERED_CO2_MEASUREMENT, EXPLORIR_ARGS_NONE, 0, 0, "Z\r\n"));
+    CHECK(encodes(SET_DIGITAL_FILTER, EXPLORIR_ARGS_SINGLE, 16, 0, "A 16\r\n"));
+    CHECK(encodes(OPERATION_MODE, EXPLORIR_ARGS_SINGLE, 0, 0, "K 0\r\n"));
+    CHECK(encodes(MANUALLY_SET_ZERO_POINT, EXPLORIR_ARGS_SINGLE, 123456, 0, "u 123456\r\n"));
+    CHECK(encodes(FINE_TUNE_ZERO_POINT, EXPLORIR_ARGS_DUAL, 400, 415, "F 400 415\r\n"));
+    CHECK(encodes(FINE_TUNE_ZERO_POINT, EXPLORIR_ARGS_DUAL, 65535, 65535, "F 65535 65535\r\n"));
+    // 400 is 0x0190, high byte 1 and low byte 144
+    CHECK(encodes(SET_CO2_BGROUND_CONCENTRATION, EXPLORIR_ARGS_MSB, AUTO_ZERO_CO2_MSB_REGISTER, 400, "P 8 1\r\n"));
+    CHECK(encodes(SET_CO2_BGROUND_CONCENTRATION, EXPLORIR_ARGS_LSB, AUTO_ZERO_CO2_MSB_REGISTER + 1, 400, "P 9 144\r\n"));
+    CHECK(encodes(AUTO_ZERO, EXPLORIR_ARGS_TENTHS, 10, 80, "@ 1.0 8.0\r\n"));
+    CHECK(encodes(AUTO_ZERO, EXPLORIR_ARGS_TENTHS, 5, 9999, "@ 0.5 999.9\r\n"));
+    // arguments that would overflow EXPLORIR_MAX_COMMAND encode to nothing
+    CHECK(encodes(FINE_TUNE_ZERO_POINT, EXPLORIR_ARGS_DUAL, 4000000000u, 415, ""));
+    CHECK(encodes(SET_CO2_BGROUND_CONCENTRATION, EXPLORIR_ARGS_LSB, AUTO_ZERO_CO2_MSB_REGISTER + 1, 65536, ""));
+    CHECK(encodes(AUTO_ZERO, EXPLORIR_ARGS_TENTHS, 10000, 80, ""));
+    CHECK(encodes(MANUALLY_SET_ZERO_POINT, EXPLORIR_ARGS_SINGLE, UINT32_MAX, 0, "u 4294967295\r\n"));
+}
+
+// @brief |a - b| within a rounding error of the filter arithmetic
+static bool test_near(float a, float b) {
+    return a - b < 0.001f && b - a < 0.001f;
+}
+
+#define TEST_FILTER_SAMPLES 20
+#define TEST_FILTER_BANK 6 // one SIMD group and a scalar tail
+
+static void test_filter(void) {
+    CHECK(explorir_filter_alpha(0) == 1.0f && explorir_filter_alpha(1) == 1.0f && explorir_filter_alpha(4) == 0.25f);
+
+    // seeded with the first sample, then a quarter of the way to each new one
+    explorir_filter_t filter;
+    explorir_filter_init(&filter, 4);
+    CHECK(explorir_filter_step(&filter, 400) == 400.0f);
+    CHECK(explorir_filter_step(&filter, 800) == 500.0f);
+    CHECK(explorir_filter_step(&filter, 500) == 500.0f);
+    explorir_filter_init(&filter, 1);
+    explorir_filter_step(&filter, 400);
+    CHECK(explorir_filter_step(&filter, 800) == 800.0f); // no smoothing
+
+    uint16_t z[TEST_FILTER_SAMPLES];
+    for(uint16_t i = 0; i < TEST_FILTER_SAMPLES; i++) {
+	z[i] = 400 + (i % 3) * 50 + (i >= 10) * 300; // noise, then a step
+    }
+
+    // run and the bank give what stepping each filter gives, also when resumed halfway
+    static const uint16_t settings[TEST_FILTER_BANK] = {0, 2, 4, 16, 32, 64};
+    float alpha[TEST_FILTER_BANK];
+    float state[TEST_FILTER_BANK];
+    float banked[TEST_FILTER_SAMPLES * TEST_FILTER_BANK];
+    explorir_filter_bank_t bank;
+    explorir_filter_bank_init(&bank, settings, alpha, state, TEST_FILTER_BANK);
+    explorir_filter_bank_run(&bank, z, TEST_FILTER_SAMPLES / 2, banked);
+    explorir_filter_bank_run(&bank, &z[TEST_FILTER_SAMPLES / 2], TEST_FILTER_SAMPLES / 2, &banked[TEST_FILTER_SAMPLES / 2 * TEST_FILTER_BANK]);
+    bool same = true;
+    for(uint16_t k = 0; k < TEST_FILTER_BANK; k++) {
+	explorir_filter_t stepped;
+	explorir_filter_t run;
+	float out[TEST_FILTER_SAMPLES];
+	explorir_filter_init(&stepped, settings[k]);
+	explorir_filter_init(&run, settings[k]);
+	explorir_filter_run(&run, z, out, 3);
+	explorir_filter_run(&run, &z[3], &out[3], TEST_FILTER_SAMPLES - 3);
+	for(uint16_t i = 0; i < TEST_FILTER_SAMPLES; i++) {
+	    float expected = explorir_filter_step(&stepped, z[i]);
+	    same = same && test_near(out[i], expected) && test_near(banked[i * TEST_FILTER_BANK + k], expected);
+	}
+    }
+    CHECK(same);
+    CHECK(banked[(TEST_FILTER_SAMPLES - 1) * TEST_FILTER_BANK] == z[TEST_FILTER_SAMPLES - 1]); // filter 0 passes samples through
+}
+
+typedef struct {
+    explorir_aggregate_record_t records[8];
+    uint8_t count;
+} test_aggregate_records_t;
+
+static void test_aggregate_emit(const explorir_aggregate_record_t * record, void * context) {
+    test_aggregate_records_t * emitted = context;
+    if(emitted->count < 8)
+	emitted->records[emitted->count] = *record;
+    emitted->count++;
+}
+
+// @brief adds one unfiltered reading, scaled by 10
+static void test_aggregate_sample(explorir_aggregate_t * aggregate, uint32_t timestamp_ms, uint16_t unfiltered, uint8_t field_mask) {
+    explorir_sample_t sample = {.timestamp_ms = timestamp_ms, .filtered = 1, .unfiltered = unfiltered, .scaling_factor = 10,
+	.sensor_id = 3, .field_mask = field_mask};
+    explorir_aggregate_add(aggregate, &sample);
+}
+
+static void test_aggregate(void) {
+    static const uint32_t windows_ms[] = {EXPLORIR_AGGREGATE_10_SEC, EXPLORIR_AGGREGATE_1_MIN};
+    explorir_aggregate_t aggregate;
+    test_aggregate_records_t emitted = {0};
+    CHECK(explorir_aggregate_init(&aggregate, windows_ms, 0, UNFILTERED_MASK, test_aggregate_emit, &emitted) == EXPLORIR_ERR_INVALID_INPUT);
+    CHECK(explorir_aggregate_init(&aggregate, windows_ms, 2, FILTERED_MASK | UNFILTERED_MASK, test_aggregate_emit, &emitted) == EXPLORIR_ERR_INVALID_INPUT);
+    CHECK(explorir_aggregate_init(&aggregate, windows_ms, 2, UNFILTERED_MASK, test_aggregate_emit, &emitted) == EXPLORIR_SUCCESS);
+
+    test_aggregate_sample(&aggregate, 1000, 40, FILTERED_MASK | UNFILTERED_MASK);
+    test_aggregate_sample(&aggregate, 4000, 60, UNFILTERED_MASK);
+    test_aggregate_sample(&aggregate, 5000, 99, FILTERED_MASK); // without the field, ignored
+    test_aggregate_sample(&aggregate, 9999, 50, UNFILTERED_MASK);
+    CHECK(emitted.count == 0);
+
+    // the first sample past the end closes the window, the window holds the samples before it
+    test_aggregate_sample(&aggregate, 10000, 45, UNFILTERED_MASK);
+    const explorir_aggregate_record_t * record = &emitted.records[0];
+    CHECK(emitted.count == 1 && record->window_start_ms == 0 && record->window_ms == EXPLORIR_AGGREGATE_10_SEC);
+    CHECK(record->min == 400 && record->max == 600 && record->mean == 500 && record->last == 500 && record->count == 3);
+    CHECK(record->sensor_id == 3 && record->field == UNFILTERED_MASK);
+
+    // a gap of several windows emits each window once, not the empty ones in between
+    test_aggregate_sample(&aggregate, 65000, 41, UNFILTERED_MASK);
+    CHECK(emitted.count == 3);
+    record = &emitted.records[1];
+    CHECK(record->window_start_ms == 10000 && record->count == 1 && record->mean == 450);
+    record = &emitted.records[2];
+    CHECK(record->window_start_ms == 0 && record->window_ms == EXPLORIR_AGGREGATE_1_MIN && record->count == 4);
+    CHECK(record->min == 400 && record->max == 600 && record->mean == 487 && record->last == 450);
+
+    // flush emits the partial windows, aligned to their length
+    explorir_aggregate_flush(&aggregate);
+    CHECK(emitted.count == 5);
+    CHECK(emitted.records[3].window_start_ms == 60000 && emitted.records[3].window_ms == EXPLORIR_AGGREGATE_10_SEC);
+    CHECK(emitted.records[4].window_start_ms == 60000 && emitted.records[4].last == 410);
+    explorir_aggregate_flush(&aggregate);
+    CHECK(emitted.count == 5);
+}
+
+// @brief a receive buffer of 256 bytes or more keeps its size
+static void test_receive_buffer(void) {
+    EXPLORIR_HANDLER_DEFINE(explorir, 300);
+    explorir.scaling_factor = 1;
+    CHECK(explorir.explorir_data_size == 300);
+    uint8_t line[64];
+    memset(line, SPACE, sizeof(line));
+    memcpy(&line[sizeof(line) - 10], " Z 00412\r\n", 10);
+    explorir_update_data(line, sizeof(line), &explorir);
+    CHECK(explorir.explorir_data_len == sizeof(line));
+    explorir_process_response(&explorir);
+    CHECK(explorir.err_code == EXPLORIR_SUCCESS && explorir.current_filtered_co2 == 412);
+}
+
+static void test_parse_response(void) {
+    explorir_handler_t explorir = {0};
+
+    // values go through the opcode table into their handler fields
+    CHECK(parse(&explorir, ". 00010\r\n") == EXPLORIR_SUCCESS);
+    CHECK(explorir.scaling_factor == 10);
+    CHECK(parse(&explorir, "A 00032\r\n") == EXPLORIR_SUCCESS && explorir.digital_filter == 32);
+    CHECK(parse(&explorir, "a 16\r\n") == EXPLORIR_SUCCESS && explorir.digital_filter == 16);
+    CHECK(parse(&explorir, "K 00001\r\n") == EXPLORIR_SUCCESS && explorir.current_mode == EXPLORIR_MODE_STREAMING);
+    CHECK(parse(&explorir, "s 08192\r\n") == EXPLORIR_SUCCESS && explorir.pressure_and_concentration_compensation == 8192);
+    CHECK(parse(&explorir, "G 33000\r\n") == EXPLORIR_SUCCESS && explorir.zero_point == 33000);
+    CHECK(parse(&explorir, " Z 00412 z 00409\r\n") == EXPLORIR_SUCCESS);
+    CHECK(explorir.current_filtered_co2 == 4120 && explorir.current_unfiltered_co2 == 4090);
+    CHECK(explorir.sample_count == 1);
+
+    // the layout from 'M' selects the fixed-offset path, other layouts still go through the general parser
+    CHECK(parse(&explorir, "M 00004\r\n") == EXPLORIR_SUCCESS && explorir.output_mask == FILTERED_MASK);
+    CHECK(parse(&explorir, " Z 00420\r\n") == EXPLORIR_SUCCESS && explorir.current_filtered_co2 == 4200);
+    CHECK(explorir.output_mask == FILTERED_MASK);
+    CHECK(parse(&explorir, " Z 00430 z 00431\r\n") == EXPLORIR_SUCCESS);
+    CHECK(explorir.current_filtered_co2 == 4300 && explorir.current_unfiltered_co2 == 4310);
+    CHECK(explorir.output_mask == (FILTERED_MASK | UNFILTERED_MASK));
+    CHECK(parse(&explorir, " Z 440 z 441\r\n") == EXPLORIR_SUCCESS); // not the fixed layout
+    CHECK(explorir.current_filtered_co2 == 4400 && explorir.current_unfiltered_co2 == 4410);
+    CHECK(parse(&explorir, "M 00070\r\n") == EXPLORIR_SUCCESS && explorir.output_mask == 0); // fields the driver doesn't decode
+    CHECK(explorir.sample_count == 4);
+
+    // the two lines of the 'Y' reply
+    CHECK(parse(&explorir, "Y,Jan 30 2013,10:45:03,AL17\r\n") == EXPLORIR_SUCCESS);
+    CHECK(explorir.info.firmware_date == 20130130 && explorir.info.firmware_time == 104503);
+    CHECK(strcmp(explorir.info.firmware_version, "AL17") == 0);
+    CHECK(parse(&explorir, " B 00233 00000\r\n") == EXPLORIR_SUCCESS && explorir.info.serial_number == 23300000);
+    CHECK(explorir.digital_filter == 16 && explorir.zero_point == 33000); // their letters are not field identifiers
+
+    CHECK(parse(&explorir, "@ 1.0 8.0\r\n") == EXPLORIR_SUCCESS);
+    CHECK(explorir.auto_zero_initial == 10 && explorir.auto_zero_regular == 80);
+    CHECK(parse(&explorir, "@ 0\r\n") == EXPLORIR_SUCCESS);
+    CHECK(explorir.auto_zero_initial == 0 && explorir.auto_zero_regular == 0);
+    CHECK(parse(&explorir, " p 8 1\r\n") == EXPLORIR_SUCCESS);
+    CHECK(parse(&explorir, "?\r\n") == EXPLORIR_ERR_UNRECOGNIZED_COMMAND);
+
+    // malformed lines leave the stored values untouched
+    CHECK(parse(&explorir, " Z 004a2 z 00409\r\n") == EXPLORIR_ERR_MALFORMED_RESPONSE);
+    CHECK(explorir.current_filtered_co2 == 4400 && explorir.current_unfiltered_co2 == 4410);
+    CHECK(parse(&explorir, " Z 00412 z\r\n") == EXPLORIR_ERR_MALFORMED_RESPONSE);
+    CHECK(parse(&explorir, "A \r\n") == EXPLORIR_ERR_MALFORMED_RESPONSE && explorir.digital_filter == 16);
+    CHECK(parse(&explorir, " p 8 300\r\n") == EXPLORIR_ERR_MALFORMED_RESPONSE);
+    explorir.reply_register = AUTO_ZERO_CO2_MSB_REGISTER; // "P 8 1" was sent
+    CHECK(parse(&explorir, " p 9 1\r\n") == EXPLORIR_ERR_MALFORMED_RESPONSE);
+    CHECK(parse(&explorir, " p 8 1\r\n") == EXPLORIR_SUCCESS);
+    explorir.reply_register = 0;
+    CHECK(parse(&explorir, "@ 1.x\r\n") == EXPLORIR_ERR_MALFORMED_RESPONSE && explorir.auto_zero_initial == 0);
+    CHECK(explorir.sample_count == 4);
+
+    // a sixth digit or a measurement beyond 16 bits is not cut off, on both measurement paths
+    CHECK(parse(&explorir, "u 123456\r\n") == EXPLORIR_ERR_MALFORMED_RESPONSE && explorir.zero_point == 33000);
+    CHECK(parse(&explorir, " Z 004120 z 00409\r\n") == EXPLORIR_ERR_MALFORMED_RESPONSE);
+    CHECK(parse(&explorir, " Z 70000 z 00409\r\n") == EXPLORIR_ERR_MALFORMED_RESPONSE);
+    CHECK(parse(&explorir, "M 00006\r\n") == EXPLORIR_SUCCESS && explorir.output_mask == (FILTERED_MASK | UNFILTERED_MASK));
+    CHECK(parse(&explorir, " Z 00412 z 99999\r\n") == EXPLORIR_ERR_MALFORMED_RESPONSE);
+    CHECK(parse(&explorir, " Z 65535 z 00409\r\n") == EXPLORIR_SUCCESS && explorir.current_filtered_co2 == 655350);
+    CHECK(explorir.sample_count == 5);
+
+    // values beyond what the field holds are malformed, not truncated
+    CHECK(parse(&explorir, "s 99999\r\n") == EXPLORIR_ERR_MALFORMED_RESPONSE && explorir.pressure_and_concentration_compensation == 8192);
+    CHECK(parse(&explorir, ". 70000\r\n") == EXPLORIR_ERR_MALFORMED_RESPONSE && explorir.scaling_factor == 10);
+    CHECK(parse(&explorir, "K 00007\r\n") == EXPLORIR_ERR_MALFORMED_RESPONSE && explorir.current_mode == EXPLORIR_MODE_STREAMING);
+    CHECK(parse(&explorir, "G 65536\r\n") == EXPLORIR_ERR_MALFORMED_RESPONSE && explorir.zero_point == 33000);
+    explorir.output_mask = 0;
+    CHECK(parse(&explorir, " Z 99999 z 99999\r\n") == EXPLORIR_ERR_MALFORMED_RESPONSE);
+    CHECK(explorir.current_filtered_co2 == 655350 && explorir.sample_count == 5);
+    CHECK(parse(&explorir, "K 00002\r\n") == EXPLORIR_SUCCESS && explorir.current_mode == EXPLORIR_MODE_POLLING);
+
+    // size bounds the line, no terminator needed, not even after a fifth digit
+    CHECK(explorir_parse_response((const uint8_t *)"A 00064", 7, &explorir) == EXPLORIR_SUCCESS);
+    CHECK(explorir.digital_filter == 64);
+    CHECK(explorir_parse_response((const uint8_t *)"A 00064", 2, &explorir) == EXPLORIR_ERR_MALFORMED_RESPONSE);
+    CHECK(explorir.digital_filter == 64);
+}
+
+#if EXPLORIR_FEATURE_FLEET
+#define TEST_FLEET_SENSORS 3
+
+#if EXPLORIR_FEATURE_SAMPLE_HOOK
+static uint32_t test_fleet_now_ms;
+
+static uint32_t test_fleet_clock(void) {
+    return test_fleet_now_ms;
+}
+#endif
+
+static void test_fleet(void) {
+    uint32_t filtered[TEST_FLEET_SENSORS], unfiltered[TEST_FLEET_SENSORS], timestamps[TEST_FLEET_SENSORS];
+    uint8_t status[TEST_FLEET_SENSORS];
+    uint16_t slots[TEST_FLEET_SENSORS];
+    explorir_handler_t handlers[TEST_FLEET_SENSORS + 1] = {{0}};
+    explorir_fleet_t fleet;
+    filtered[0] = 1;
+    explorir_fleet_init(&fleet, filtered, unfiltered, timestamps, status, TEST_FLEET_SENSORS);
+    CHECK(fleet.count == 0 && filtered[0] == 0);
+
+    // slots are handed out in order and start with the handler's values
+    handlers[1].current_filtered_co2 = 450;
+    for(uint8_t k = 0; k < TEST_FLEET_SENSORS + 1; k++) {
+	handlers[k].scaling_factor = 1;
+#if EXPLORIR_FEATURE_SAMPLE_HOOK
+	handlers[k].explorir_get_time_ms = test_fleet_clock;
+#endif
+	CHECK(explorir_fleet_add(&fleet, &handlers[k]) == (k < TEST_FLEET_SENSORS ? EXPLORIR_SUCCESS : EXPLORIR_ERR_BUSY));
+    }
+    CHECK(handlers[2].fleet_slot == 2 && handlers[2].fleet == &fleet && handlers[TEST_FLEET_SENSORS].fleet == NULL);
+    CHECK(filtered[1] == 450 && status[1] == 0);
+
+    // every sensor is stale until its first measurement line
+    CHECK(explorir_fleet_stale(&fleet, 0, 1000, slots, TEST_FLEET_SENSORS) == 3);
+    CHECK(explorir_fleet_stale(&fleet, 0, 1000, slots, 2) == 2 && slots[1] == 1);
+
+    // the parser mirrors each measurement line into the handler's slot, a line with one field keeps the other
+#if EXPLORIR_FEATURE_SAMPLE_HOOK
+    test_fleet_now_ms = 1000;
+#endif
+    CHECK(parse(&handlers[0], " Z 00412 z 00409\r\n") == EXPLORIR_SUCCESS);
+    CHECK(filtered[0] == 412 && unfiltered[0] == 409 && status[0] == (FILTERED_MASK | UNFILTERED_MASK));
+    CHECK(parse(&handlers[2], " Z 01200 z 01190\r\n") == EXPLORIR_SUCCESS);
+#if EXPLORIR_FEATURE_SAMPLE_HOOK
+    test_fleet_now_ms = 1500;
+#endif
+    CHECK(parse(&handlers[0], " Z 00420\r\n") == EXPLORIR_SUCCESS);
+    CHECK(filtered[0] == 420 && unfiltered[0] == 409 && status[0] == FILTERED_MASK);
+    CHECK(filtered[1] == 450 && filtered[2] == 1200 && unfiltered[2] == 1190);
+
+    // a malformed response is flagged until the next measurement line, but doesn't make a sensor current
+    CHECK(parse(&handlers[1], " Z 004a2 z 00409\r\n") == EXPLORIR_ERR_MALFORMED_RESPONSE);
+    CHECK(status[1] == EXPLORIR_FLEET_MALFORMED && filtered[1] == 450);
+    CHECK(parse(&handlers[2], " Z 01300 z\r\n") == EXPLORIR_ERR_MALFORMED_RESPONSE);
+    CHECK(status[2] == (FILTERED_MASK | UNFILTERED_MASK | EXPLORIR_FLEET_MALFORMED) && filtered[2] == 1200);
+
+    // only the filtered value counts against the threshold
+    CHECK(explorir_fleet_above(&fleet, 420, slots, TEST_FLEET_SENSORS) == 2 && slots[0] == 1 && slots[1] == 2);
+    CHECK(explorir_fleet_above(&fleet, 419, slots, 1) == 1 && slots[0] == 0);
+    CHECK(explorir_fleet_above(&fleet, 1200, slots, TEST_FLEET_SENSORS) == 0);
+
+#if EXPLORIR_FEATURE_SAMPLE_HOOK
+    CHECK(timestamps[0] == 1500 && timestamps[2] == 1000);
+    CHECK(explorir_fleet_stale(&fleet, 2000, 1000, slots, TEST_FLEET_SENSORS) == 1 && slots[0] == 1);
+    CHECK(explorir_fleet_stale(&fleet, 2001, 1000, slots, TEST_FLEET_SENSORS) == 2 && slots[1] == 2);
+    // the clock wraps
+    timestamps[0] = UINT32_MAX - 99;
+    CHECK(explorir_fleet_stale(&fleet, 400, 1000, slots, TEST_FLEET_SENSORS) == 2 && slots[0] == 1 && slots[1] == 2);
+#else
+    CHECK(timestamps[0] == 0);
+#endif
+}
+#endif
+
+static void test_framer(void) {
+    explorir_handler_t explorir = {.scaling_factor = 1};
+    explorir_framer_t framer;
+    explorir_framer_init(&framer);
+
+    // noise and a line cut short by a dropped "\r\n", the framer resyncs on the next terminator
+    const char noise[] = "\x01\xff Z 004\r\n Z 00412 z 00409\r\n Z 00400 z 00401";
+    CHECK(explorir_framer_process(&framer, (const uint8_t *)noise, sizeof(noise) - 1, &explorir) == 1);
+    CHECK(explorir.current_filtered_co2 == 412 && explorir.current_unfiltered_co2 == 409);
+    CHECK(framer.framing_errors == 1);
+    const char rest[] = "\r\nK 00001\r\n";
+    CHECK(explorir_framer_process(&framer, (const uint8_t *)rest, sizeof(rest) - 1, &explorir) == 2);
+    CHECK(explorir.current_filtered_co2 == 400 && explorir.current_mode == EXPLORIR_MODE_STREAMING);
+    CHECK(framer.lines == 3);
+
+    // a line longer than the buffer is discarded whole
+    explorir_framer_init(&framer);
+    uint16_t lines = 0;
+    for(uint16_t k = 0; k < 2 * EXPLORIR_FRAMER_MAX_LINE; k++) {
+	lines += explorir_framer_feed(&framer, 'Z') == EXPLORIR_FRAME_LINE;
+    }
+    const char after[] = "\r\n. 00010\r\n";
+    for(uint8_t k = 0; k < sizeof(after) - 1; k++) {
+	lines += explorir_framer_feed(&framer, after[k]) == EXPLORIR_FRAME_LINE;
+    }
+    uint8_t size;
+    const uint8_t * line = explorir_framer_line(&framer, &size);
+    CHECK(lines == 1 && size == 7 && memcmp(line, ". 00010", 7) == 0);
+
+    CHECK(explorir_frame_is_valid((const uint8_t *)" Z 00412 z 00409", 16));
+    CHECK(!explorir_frame_is_valid((const uint8_t *)" Z 0412 z 00409", 15));
+    CHECK(explorir_frame_is_valid((const uint8_t *)"Y,Jan 30 2013,10:45:03,AL17", 27));
+    CHECK(explorir_frame_is_valid((const uint8_t *)" B 00233 00000", 14));
+}
+
+#define TEST_LOG_SIZE 4096
+#define TEST_LOG_SAMPLES 300
+
+typedef struct {
+    uint8_t data[TEST_LOG_SIZE];
+    size_t size;
+} test_log_t;
+
+static void test_log_write(const uint8_t * data, uint16_t size, void * context) {
+    test_log_t * log = context;
+    if(log->size + size <= sizeof(log->data))
+	memcpy(&log->data[log->size], data, size);
+    log->size += size;
+}
+
+// @brief sample k of the test stream, two sensors sharing timestamps that step unevenly, so the deltas vary
+static explorir_sample_t test_log_sample(uint16_t k) {
+    explorir_sample_t sample = {
+	.timestamp_ms = 1000 + k / 2 * 2000 + (k / 2 % 7 == 0 ? 3 : 0),
+	.filtered = 400 + (k * 37) % 90,
+	.unfiltered = 390 + (k * 53) % 120,
+	.scaling_factor = 10,
+	.sensor_id = k % 2 ? 12 : 3,
+	.field_mask = k % 5 == 0 ? FILTERED_MASK : FILTERED_MASK | UNFILTERED_MASK,
+    };
+    return sample;
+}
+
+static void test_log(void) {
+    static test_log_t log;
+    uint8_t block[64];
+    explorir_log_writer_t writer;
+    CHECK(explorir_log_writer_init(&writer, block, 8, test_log_write, &log) == EXPLORIR_ERR_INVALID_INPUT);
+    CHECK(explorir_log_writer_init(&writer, block, sizeof(block), test_log_write, &log) == EXPLORIR_SUCCESS);
+    for(uint16_t k = 0; k < TEST_LOG_SAMPLES; k++) {
+	explorir_sample_t sample = test_log_sample(k);
+	CHECK(explorir_log_write_sample(&writer, &sample) == EXPLORIR_SUCCESS);
+    }
+    explorir_log_flush(&writer);
+    CHECK(log.size <= sizeof(log.data));
+
+    // small blocks, so the stream spans many of them and the delta state restarts at each
+    size_t blocks = 0;
+    explorir_log_block_header_t header;
+    for(size_t offset = EXPLORIR_LOG_FILE_HEADER_SIZE;
+	    explorir_log_read_block_header(log.data, log.size, offset, &header) == EXPLORIR_SUCCESS;
+	    offset += EXPLORIR_LOG_BLOCK_HEADER_SIZE + header.payload_len) {
+	blocks++;
+    }
+    CHECK(blocks > 10);
+
+    explorir_log_reader_t reader;
+    explorir_log_record_t record;
+    CHECK(explorir_log_reader_init(&reader, log.data, log.size) == EXPLORIR_SUCCESS);
+    uint16_t count = 0;
+    bool same = true;
+    while(explorir_log_reader_next(&reader, &record)) {
+	explorir_sample_t sample = test_log_sample(count);
+	same = same && record.timestamp_ms == sample.timestamp_ms && record.sensor_id == sample.sensor_id
+		&& record.field_mask == sample.field_mask && record.filtered == sample.filtered
+		&& record.scaling_factor == sample.scaling_factor
+		&& (!(sample.field_mask & UNFILTERED_MASK) || record.unfiltered == sample.unfiltered);
+	count++;
+    }
+    CHECK(count == TEST_LOG_SAMPLES && same);
+
+    CHECK(explorir_log_reader_init(&reader, log.data, 4) == EXPLORIR_ERR_INVALID_INPUT);
+}
+
+#if EXPLORIR_TEST_LOG_MMAP
+// @brief writes the test stream to a temporary file in small blocks, path receives its name
+static bool test_log_file(char * path) {
+    static test_log_t log;
+    uint8_t block[64];
+    explorir_log_writer_t writer;
+    log.size = 0;
+    explorir_log_writer_init(&writer, block, sizeof(block), test_log_write, &log);
+    for(uint16_t k = 0; k < TEST_LOG_SAMPLES; k++) {
+	explorir_sample_t sample = test_log_sample(k);
+	explorir_log_write_sample(&writer, &sample);
+    }
+    explorir_log_flush(&writer);
+
+    int fd = mkstemp(path);
+    if(fd < 0)
+	return false;
+    bool written = write(fd, log.data, log.size) == (ssize_t)log.size;
+    close(fd);
+    return written;
+}
+
+// @brief counts the records of a range, false in same if one is outside it
+static uint16_t test_log_range_count(explorir_log_range_t * range, int16_t sensor_id, uint64_t start_ms, uint64_t end_ms, bool * same) {
+    explorir_log_record_t record;
+    uint16_t count = 0;
+    uint64_t previous_ms = 0;
+    while(explorir_log_range_next(range, &record)) {
+	*same = *same && (sensor_id == EXPLORIR_LOG_ANY_SENSOR || record.sensor_id == sensor_id)
+		&& record.timestamp_ms >= start_ms && record.timestamp_ms < end_ms && record.timestamp_ms >= previous_ms;
+	previous_ms = record.timestamp_ms;
+	count++;
+    }
+    return count;
+}
+
+static void test_log_mmap(void) {
+    explorir_log_file_t file;
+    CHECK(explorir_log_file_open(&file, "/nonexistent/explorir.log") == EXPLORIR_ERR_INVALID_INPUT);
+    char path[] = "/tmp/explorir_test_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0 && write(fd, "not a log file", 14) == 14);
+    close(fd);
+    CHECK(explorir_log_file_open(&file, path) == EXPLORIR_ERR_INVALID_INPUT);
+    unlink(path);
+
+    strcpy(path, "/tmp/explorir_test_XXXXXX");
+    CHECK(test_log_file(path));
+    CHECK(explorir_log_file_open(&file, path) == EXPLORIR_SUCCESS);
+    CHECK(file.block_count > 10);
+    bool ordered = true;
+    for(size_t k = 0; k < file.block_count; k++) {
+	ordered = ordered && file.index[k].first_ts <= file.index[k].last_ts;
+	if(k > 0)
+	    ordered = ordered && file.index[k].offset > file.index[k - 1].offset && file.index[k].first_ts >= file.index[k - 1].last_ts;
+    }
+    CHECK(ordered);
+    CHECK(explorir_log_file_find_block(&file, 0) == 0);
+    CHECK(explorir_log_file_find_block(&file, file.index[file.block_count - 1].last_ts + 1) == file.block_count);
+
+    // seek to the middle of the stream, the range starts decoding at the block holding start_ms
+    uint64_t start_ms = test_log_sample(TEST_LOG_SAMPLES / 2).timestamp_ms;
+    uint64_t end_ms = test_log_sample(TEST_LOG_SAMPLES - 40).timestamp_ms;
+    size_t first = explorir_log_file_find_block(&file, start_ms);
+    CHECK(first > 0 && first < file.block_count && file.index[first].last_ts >= start_ms);
+    CHECK(file.index[first - 1].last_ts < start_ms);
+
+    explorir_log_range_t range;
+    CHECK(explorir_log_range_init(&range, &file, 12, start_ms, end_ms) == EXPLORIR_SUCCESS);
+    uint16_t expected = 0;
+    for(uint16_t k = 0; k < TEST_LOG_SAMPLES; k++) {
+	explorir_sample_t sample = test_log_sample(k);
+	expected += sample.sensor_id == 12 && sample.timestamp_ms >= start_ms && sample.timestamp_ms < end_ms;
+    }
+    bool same = true;
+    CHECK(expected > 0 && test_log_range_count(&range, 12, start_ms, end_ms, &same) == expected && same);
+
+    // every sensor over the whole file, then ranges that hold nothing
+    CHECK(explorir_log_range_init(&range, &file, EXPLORIR_LOG_ANY_SENSOR, 0, UINT64_MAX) == EXPLORIR_SUCCESS);
+    CHECK(test_log_range_count(&range, EXPLORIR_LOG_ANY_SENSOR, 0, UINT64_MAX, &same) == TEST_LOG_SAMPLES && same);
+    CHECK(explorir_log_range_init(&range, &file, 12, start_ms, start_ms) == EXPLORIR_SUCCESS);
+    CHECK(test_log_range_count(&range, 12, start_ms, start_ms, &same) == 0);
+    CHECK(explorir_log_range_init(&range, &file, 5, 0, UINT64_MAX) == EXPLORIR_SUCCESS);
+    CHECK(test_log_range_count(&range, 5, 0, UINT64_MAX, &same) == 0);
+    start_ms = file.index[file.block_count - 1].last_ts + 1;
+    CHECK(explorir_log_range_init(&range, &file, EXPLORIR_LOG_ANY_SENSOR, start_ms, UINT64_MAX) == EXPLORIR_SUCCESS);
+    CHECK(test_log_range_count(&range, EXPLORIR_LOG_ANY_SENSOR, start_ms, UINT64_MAX, &same) == 0);
+    explorir_log_file_close(&file);
+    unlink(path);
+}
+#endif
+
+#define TEST_BATCH_CAPACITY 8
+
+static void test_batch(void) {
+    uint32_t timestamps_ms[TEST_BATCH_CAPACITY];
+    uint8_t sensor_ids[TEST_BATCH_CAPACITY];
+    uint8_t fields[TEST_BATCH_CAPACITY];
+    uint16_t raw[TEST_BATCH_CAPACITY];
+    explorir_batch_t batch;
+    explorir_batch_init(&batch, timestamps_ms, sensor_ids, fields, raw, TEST_BATCH_CAPACITY);
+
+    // a read that ends in the middle of a line leaves it for the next one
+    const char chunk[] = " Z 00412 z 00409\r\n7: Z 413\r\nK 00001\r\n123456,9: Z 00414 z 0";
+    uint32_t used = explorir_parse_batch(&batch, (const uint8_t *)chunk, sizeof(chunk) - 1, 1000, 1);
+    CHECK(used == strlen(" Z 00412 z 00409\r\n7: Z 413\r\nK 00001\r\n"));
+    CHECK(batch.count == 3 && batch.lines == 3 && batch.skipped == 1 && batch.malformed == 0);
+    CHECK(raw[0] == 412 && fields[0] == FILTERED_MASK && sensor_ids[0] == 1 && timestamps_ms[0] == 1000);
+    CHECK(raw[1] == 409 && fields[1] == UNFILTERED_MASK);
+    CHECK(raw[2] == 413 && sensor_ids[2] == 7 && timestamps_ms[2] == 1000);
+
+    char next[64];
+    size_t left = sizeof(chunk) - 1 - used;
+    memcpy(next, &chunk[used], left);
+    memcpy(&next[left], "0415\r\n7x Z 1\r\n", 14);
+    used = explorir_parse_batch(&batch, (const uint8_t *)next, left + 14, 2000, 1);
+    CHECK(used == left + 14);
+    CHECK(batch.count == 5 && batch.malformed == 1);
+    CHECK(raw[3] == 414 && raw[4] == 415 && sensor_ids[4] == 9 && timestamps_ms[4] == 123456);
+
+    // a line whose fields don't fit stops the batch in front of it
+    const char full[] = " Z 00001 z 00002\r\n Z 00003 z 00004\r\n";
+    used = explorir_parse_batch(&batch, (const uint8_t *)full, sizeof(full) - 1, 3000, 1);
+    CHECK(used == 18 && batch.count == 7);
+    explorir_batch_clear(&batch);
+    used = explorir_parse_batch(&batch, (const uint8_t *)&full[used], sizeof(full) - 1 - used, 3000, 1);
+    CHECK(used == 18 && batch.count == 2 && raw[0] == 3 && raw[1] == 4);
+
+    // out of range lines are malformed here as in explorir_parse_response()
+    const char large[] = " Z 99999 z 99999\r\n Z 123456\r\n";
+    used = explorir_parse_batch(&batch, (const uint8_t *)large, sizeof(large) - 1, 4000, 1);
+    CHECK(used == sizeof(large) - 1 && batch.count == 2 && batch.malformed == 3);
+}
+
+#if EXPLORIR_TEST_CAPTURE
+// @brief records one zero terminated line of traffic
+static void test_capture_line(explorir_capture_t * capture, explorir_direction_t direction, uint8_t sensor_id, const char * line) {
+    explorir_capture_on_traffic(direction, (const uint8_t *)line, strlen(line), sensor_id, capture);
+}
+
+static void test_capture(void) {
+    FILE * file = tmpfile();
+    CHECK(file != NULL);
+    if(file == NULL)
+	return;
+    explorir_capture_t capture;
+    CHECK(explorir_capture_start(&capture, file) == EXPLORIR_SUCCESS);
+    test_capture_line(&capture, EXPLORIR_TX, 0, ".\r\n");
+    test_capture_line(&capture, EXPLORIR_RX, 0, ". 00010\r\n");
+    test_capture_line(&capture, EXPLORIR_RX, 1, " Z 00500 z 00501\r\n");
+    test_capture_line(&capture, EXPLORIR_RX, 0, " Z 00412 z 00409\r\n");
+    test_capture_line(&capture, EXPLORIR_RX, 7, " Z 00999\r\n"); // no handler
+    CHECK(!capture.failed);
+
+    uint8_t data[256];
+    long size = ftell(file);
+    rewind(file);
+    CHECK(size > 0 && size <= (long)sizeof(data) && fread(data, 1, size, file) == (size_t)size);
+    fclose(file);
+
+    // the records come back in order, each to the handler of its sensor id
+    EXPLORIR_HANDLER_DEFINE(first, 32);
+    EXPLORIR_HANDLER_DEFINE(second, 32);
+    first.scaling_factor = 1;
+    second.scaling_factor = 1;
+    explorir_handler_t * handlers[] = {&first, &second};
+    explorir_replay_stats_t stats;
+    CHECK(explorir_replay(data, size, handlers, 2, false, &stats) == EXPLORIR_SUCCESS);
+    CHECK(stats.commands == 1 && stats.responses == 3 && stats.skipped == 1);
+    CHECK(first.scaling_factor == 10 && first.current_filtered_co2 == 4120 && first.current_unfiltered_co2 == 4090);
+    CHECK(second.current_filtered_co2 == 500 && second.current_unfiltered_co2 == 501);
+
+    // a record cut off at the end of the file
+    CHECK(explorir_replay(data, size - 1, handlers, 2, false, NULL) == EXPLORIR_ERR_INVALID_INPUT);
+
+    // a failed write latches, nothing follows a partial record
+    file = fopen("/dev/null", "rb");
+    CHECK(file != NULL);
+    if(file == NULL)
+	return;
+    capture = (explorir_capture_t){.file = file};
+    test_capture_line(&capture, EXPLORIR_RX, 0, ". 00010\r\n");
+    CHECK(capture.failed);
+    fclose(file);
+}
+#endif
+
+#if EXPLORIR_TEST_EXPORTER
+// @brief publisher thread, the readings and the line counter of the handler always hold the same value
+typedef struct {
+    explorir_exporter_t * exporter;
+    explorir_handler_t * explorir_handler;
+    bool stop; // accessed atomically
+} test_publisher_t;
+
+static void * test_exporter_publish(void * context) {
+    test_publisher_t * publisher = context;
+    for(uint32_t k = 0; !__atomic_load_n(&publisher->stop, __ATOMIC_ACQUIRE); k++) {
+	publisher->explorir_handler->current_filtered_co2 = k;
+	publisher->explorir_handler->current_unfiltered_co2 = k;
+	publisher->explorir_handler->stats->lines = k;
+	explorir_exporter_publish(publisher->exporter);
+    }
+    return NULL;
+}
+
+// @brief value of the first sample in page starting with prefix, -1 if there is none
+static long test_exporter_value(const char * page, const char * prefix) {
+    const char * sample = strstr(page, prefix);
+    return sample ? strtol(sample + strlen(prefix), NULL, 10) : -1;
+}
+
+// @brief sends one GET request to the exporter, the response is received into response
+static bool test_exporter_get(uint16_t port, const char * path, char * response, size_t size) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    if(fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+	if(fd >= 0)
+	    close(fd);
+	return false;
+    }
+    char request[64];
+    int len = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\n\r\n", path);
+    bool sent = send(fd, request, (size_t)len, 0) == len;
+    size_t received = 0;
+    ssize_t n;
+    while(sent && received < size - 1 && (n = recv(fd, response + received, size - 1 - received, 0)) > 0) {
+	received += (size_t)n;
+    }
+    response[received] = '\0';
+    close(fd);
+    return sent && received > 0;
+}
+
+static void test_exporter(void) {
+    static char page[4096];
+    explorir_exporter_slot_t slots[2];
+    explorir_exporter_t exporter;
+    explorir_stats_t stats = {.lines = 7, .parse_errors = 1, .commands = 3};
+    explorir_handler_t with_stats = {.sensor_id = 1, .stats = &stats};
+    explorir_handler_t without_stats = {.sensor_id = 2};
+    explorir_exporter_init(&exporter, slots, 2);
+    CHECK(explorir_exporter_add(&exporter, &with_stats) == EXPLORIR_SUCCESS);
+    CHECK(explorir_exporter_add(&exporter, &without_stats) == EXPLORIR_SUCCESS);
+    CHECK(explorir_exporter_add(&exporter, &without_stats) == EXPLORIR_ERR_BUSY);
+
+    // nothing published yet, the sensors are down
+    size_t len = explorir_exporter_render(&exporter, page, sizeof(page));
+    CHECK(len < sizeof(page) && test_exporter_value(page, "explorir_up{sensor=\"1\"} ") == 0);
+
+    with_stats.current_filtered_co2 = 4120;
+    with_stats.current_unfiltered_co2 = 4090;
+    with_stats.sample_count = 12;
+    with_stats.current_mode = EXPLORIR_MODE_STREAMING;
+    with_stats.err_code = EXPLORIR_SUCCESS;
+    explorir_stats_add_latency(&stats, 15);
+    explorir_stats_add_latency(&stats, 700);
+    without_stats.err_code = EXPLORIR_ERR_MALFORMED_RESPONSE;
+    explorir_exporter_publish(&exporter);
+    len = explorir_exporter_render(&exporter, page, sizeof(page));
+    CHECK(len < sizeof(page) && strlen(page) == len);
+    CHECK(test_exporter_value(page, "explorir_co2_ppm{sensor=\"1\",field=\"filtered\"} ") == 4120);
+    CHECK(test_exporter_value(page, "explorir_co2_ppm{sensor=\"1\",field=\"unfiltered\"} ") == 4090);
+    CHECK(test_exporter_value(page, "explorir_up{sensor=\"1\"} ") == 1 && test_exporter_value(page, "explorir_up{sensor=\"2\"} ") == 0);
+    CHECK(test_exporter_value(page, "explorir_error_code{sensor=\"2\"} ") == EXPLORIR_ERR_MALFORMED_RESPONSE);
+    CHECK(test_exporter_value(page, "explorir_mode{sensor=\"1\"} ") == EXPLORIR_MODE_STREAMING);
+    CHECK(test_exporter_value(page, "explorir_samples_total{sensor=\"1\"} ") == 12);
+    CHECK(test_exporter_value(page, "explorir_lines_total{sensor=\"1\"} ") == 7);
+    CHECK(test_exporter_value(page, "explorir_parse_errors_total{sensor=\"1\"} ") == 1);
+    CHECK(test_exporter_value(page, "explorir_lines_total{sensor=\"2\"} ") == -1); // counters only for handlers with stats
+
+    // OpenMetrics: each family announced once, cumulative histogram buckets, terminated by # EOF
+    const char * counter = strstr(page, "# TYPE explorir_lines counter\n");
+    CHECK(counter && strstr(counter + 1, "# TYPE explorir_lines counter\n") == NULL);
+    CHECK(test_exporter_value(page, "explorir_command_latency_seconds_bucket{sensor=\"1\",le=\"0.01\"} ") == 0);
+    CHECK(test_exporter_value(page, "explorir_command_latency_seconds_bucket{sensor=\"1\",le=\"0.02\"} ") == 1);
+    CHECK(test_exporter_value(page, "explorir_command_latency_seconds_bucket{sensor=\"1\",le=\"0.5\"} ") == 1);
+    CHECK(test_exporter_value(page, "explorir_command_latency_seconds_bucket{sensor=\"1\",le=\"+Inf\"} ") == 2);
+    CHECK(test_exporter_value(page, "explorir_command_latency_seconds_count{sensor=\"1\"} ") == 2);
+    CHECK(strstr(page, "explorir_command_latency_seconds_sum{sensor=\"1\"} 0.715\n") != NULL);
+    CHECK(len >= 6 && strcmp(page + len - 6, "# EOF\n") == 0);
+
+    // a page too small is truncated and terminated, the full length is returned
+    char small[64];
+    CHECK(explorir_exporter_render(&exporter, small, sizeof(small)) == len && strlen(small) == sizeof(small) - 1);
+
+    // a render never sees a half written snapshot, every value is from the same publish
+    with_stats.current_unfiltered_co2 = with_stats.current_filtered_co2;
+    stats.lines = with_stats.current_filtered_co2;
+    explorir_exporter_publish(&exporter);
+    test_publisher_t publisher = {&exporter, &with_stats, false};
+    pthread_t thread;
+    CHECK(pthread_create(&thread, NULL, test_exporter_publish, &publisher) == 0);
+    bool consistent = true;
+    for(uint16_t k = 0; k < 2000; k++) {
+	explorir_exporter_render(&exporter, page, sizeof(page));
+	long filtered = test_exporter_value(page, "explorir_co2_ppm{sensor=\"1\",field=\"filtered\"} ");
+	consistent = consistent && filtered == test_exporter_value(page, "explorir_co2_ppm{sensor=\"1\",field=\"unfiltered\"} ")
+		&& filtered == test_exporter_value(page, "explorir_lines_total{sensor=\"1\"} ");
+    }
+    __atomic_store_n(&publisher.stop, true, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+    CHECK(consistent);
+
+    // served on a free port of the loopback interface
+    CHECK(explorir_exporter_start(&exporter, 0) == EXPLORIR_SUCCESS && exporter.port != 0);
+    CHECK(test_exporter_get(exporter.port, "/metrics", page, sizeof(page)));
+    CHECK(strncmp(page, "HTTP/1.1 200 OK\r\n", 17) == 0 && strstr(page, "application/openmetrics-text") != NULL);
+    CHECK(strlen(page) >= 6 && strcmp(page + strlen(page) - 6, "# EOF\n") == 0);
+    CHECK(test_exporter_get(exporter.port, "/", page, sizeof(page)) && strncmp(page, "HTTP/1.1 404", 12) == 0);
+    explorir_exporter_stop(&exporter);
+    CHECK(exporter.scrapes == 1 && exporter.listen_fd < 0);
+}
+#endif
+
+#if EXPLORIR_FEATURE_ASYNC
+typedef struct {
+    char sent[8][EXPLORIR_MAX_COMMAND + 1];
+    uint8_t count;
+} test_port_t;
+
+typedef struct {
+    explorir_retcode_t result;
+    uint8_t calls;
+} test_done_t;
+
+static void test_async_tx(const unsigned char * msg, uint8_t size, void * context) {
+    test_port_t * port = context;
+    if(port->count < 8) {
+	memcpy(port->sent[port->count], msg, size);
+	port->sent[port->count][size] = '\0';
+    }
+    port->count++;
+}
+
+static void test_async_done(explorir_retcode_t result, explorir_handler_t * explorir_handler, void * context) {
+    (void)explorir_handler;
+    test_done_t * done = context;
+    done->result = result;
+    done->calls++;
+}
+
+// @brief hands one zero terminated line to the queue
+static void test_async_line(explorir_async_t * async, const char * line) {
+    explorir_async_process(async, (const uint8_t *)line, strlen(line));
+}
+
+static void test_async(void) {
+    explorir_handler_t explorir = {0};
+    explorir_async_request_t requests[4];
+    explorir_async_t async;
+    test_port_t port = {0};
+    test_done_t done = {0};
+    explorir_async_init(&async, &explorir, requests, 4, 100);
+    async.tx = test_async_tx;
+    async.tx_context = &port;
+    CHECK(explorir_async_of(&explorir) == &async);
+
+    // the 'Y' reply completes after its second line, measurement lines in between don't count
+    explorir_async_next(&async, test_async_done, &done);
+    CHECK(explorir_request_sensor_info(&explorir) == EXPLORIR_SUCCESS);
+    CHECK(port.count == 1 && strcmp(port.sent[0], "Y\r\n") == 0);
+    test_async_line(&async, "Y,Jan 30 2013,10:45:03,AL17\r\n");
+    CHECK(done.calls == 0);
+    test_async_line(&async, " Z 00412 z 00409\r\n");
+    CHECK(done.calls == 0);
+    test_async_line(&async, " B 00233 00000\r\n");
+    CHECK(done.calls == 1 && done.result == EXPLORIR_SUCCESS);
+    CHECK(explorir.info.serial_number == 23300000 && strcmp(explorir.info.firmware_version, "AL17") == 0);
+    CHECK(explorir_async_idle(&async));
+
+    // without retries a missing reply fails once the timeout has passed
+    done = (test_done_t){0};
+    explorir_async_tick(&async, 1000);
+    explorir_async_next(&async, test_async_done, &done);
+    CHECK(explorir_request_scaling_factor(&explorir) == EXPLORIR_SUCCESS);
+    explorir_async_tick(&async, 1099);
+    CHECK(done.calls == 0);
+    explorir_async_tick(&async, 1100);
+    CHECK(done.calls == 1 && done.result == EXPLORIR_ERR_TIMEOUT && port.count == 2);
+
+#if EXPLORIR_FEATURE_RETRY
+    // '?' and a timeout are retried after the backoff, the third attempt is answered
+    static const explorir_retry_config_t retry = {.default_policy = {.max_attempts = 3, .backoff_ms = 10, .backoff_multiplier = 2}};
+    explorir.retry_config = &retry;
+    done = (test_done_t){0};
+    explorir_async_next(&async, test_async_done, &done);
+    CHECK(explorir_set_digital_filter(32, &explorir) == EXPLORIR_SUCCESS);
+    CHECK(port.count == 3 && strcmp(port.sent[2], "A 32\r\n") == 0);
+    test_async_line(&async, "?\r\n");
+    CHECK(done.calls == 0 && port.count == 3);
+    explorir_async_tick(&async, 1109);
+    CHECK(port.count == 3);
+    explorir_async_tick(&async, 1110);
+    CHECK(port.count == 4 && strcmp(port.sent[3], "A 32\r\n") == 0);
+    explorir_async_tick(&async, 1210); // timed out, the second retry waits twice as long
+    CHECK(port.count == 4);
+    explorir_async_tick(&async, 1230);
+    CHECK(port.count == 5);
+    test_async_line(&async, "A 00032\r\n");
+    CHECK(done.calls == 1 && done.result == EXPLORIR_SUCCESS && explorir.digital_filter == 32);
+
+    // calibration commands are never repeated by default
+    done = (test_done_t){0};
+    explorir_async_next(&async, test_async_done, &done);
+    CHECK(explorir_set_zero_point_in_fresh_air(&explorir) == EXPLORIR_SUCCESS);
+    test_async_line(&async, "?\r\n");
+    CHECK(done.calls == 1 && done.result == EXPLORIR_ERR_UNRECOGNIZED_COMMAND && port.count == 6);
+    explorir.retry_config = NULL;
+#endif
+
+    // the LSB of a two-byte parameter is queued once the MSB is answered, the pair completes once
+    port = (test_port_t){0};
+    done = (test_done_t){0};
+    explorir_async_next(&async, test_async_done, &done);
+    CHECK(explorir_set_co2_for_auto_zeroing(400, &explorir) == EXPLORIR_SUCCESS);
+    CHECK(port.count == 1 && strcmp(port.sent[0], "P 8 1\r\n") == 0);
+    test_async_line(&async, " p 8 1\r\n");
+    CHECK(done.calls == 0 && port.count == 2 && strcmp(port.sent[1], "P 9 144\r\n") == 0);
+    test_async_line(&async, " p 9 144\r\n");
+    CHECK(done.calls == 1 && done.result == EXPLORIR_SUCCESS && explorir_async_idle(&async));
+
+    // a failed MSB stops the pair, P 9 is never sent
+    done = (test_done_t){0};
+    explorir_async_next(&async, test_async_done, &done);
+    CHECK(explorir_set_co2_for_zero_point_in_fresh_air(400, &explorir) == EXPLORIR_SUCCESS);
+    CHECK(port.count == 3 && strcmp(port.sent[2], "P 10 1\r\n") == 0);
+    test_async_line(&async, "?\r\n");
+    CHECK(done.calls == 1 && done.result == EXPLORIR_ERR_UNRECOGNIZED_COMMAND && port.count == 3);
+    CHECK(explorir_async_idle(&async));
+
+    // a reply mirroring another register fails the pair
+    done = (test_done_t){0};
+    explorir_async_next(&async, test_async_done, &done);
+    CHECK(explorir_set_co2_for_auto_zeroing(400, &explorir) == EXPLORIR_SUCCESS);
+    test_async_line(&async, " p 9 1\r\n");
+    CHECK(done.calls == 1 && done.result == EXPLORIR_ERR_MALFORMED_RESPONSE && port.count == 4);
+
+    // a full queue rejects the command without calling back
+    for(uint8_t k = 0; k < 4; k++) {
+	CHECK(explorir_async_delay(&async, 1000, NULL, NULL) == EXPLORIR_SUCCESS);
+    }
+    done = (test_done_t){0};
+    explorir_async_next(&async, test_async_done, &done);
+    CHECK(explorir_request_scaling_factor(&explorir) == EXPLORIR_ERR_BUSY && done.calls == 0);
+
+    explorir_async_deinit(&async);
+    CHECK(explorir_async_of(&explorir) == NULL);
+    // without a queue or a receive buffer commands fail instead of waiting for nothing
+    CHECK(explorir_request_scaling_factor(&explorir) == EXPLORIR_ERR_INVALID_INPUT);
+}
+
+// @brief transport answering every command from inside tx with reply, or not at all
+typedef struct {
+    explorir_async_t * async;
+    const char * reply;
+    uint8_t count;
+} test_loopback_t;
+
+static void test_loopback_tx(const unsigned char * msg, uint8_t size, void * context) {
+    test_loopback_t * loopback = context;
+    (void)msg;
+    (void)size;
+    loopback->count++;
+    if(loopback->reply)
+	test_async_line(loopback->async, loopback->reply);
+}
+
+// @brief streams a reading and polls the calibration, which takes one reading per poll
+static bool test_calibrate_line(explorir_calibrate_t * calibrate, explorir_async_t * async, const char * line, uint32_t now_ms) {
+    test_async_line(async, line);
+    return explorir_calibrate_poll(calibrate, now_ms);
+}
+
+static void test_calibrate(void) {
+    static const explorir_calibrate_config_t config = {
+	.method = EXPLORIR_CALIBRATE_FRESH_AIR, .reference_ppm = 400, .stable_stddev_ppm = 10, .stable_slope_ppm_per_min = 1000,
+	.tolerance_ppm = 30, .stabilize_timeout_ms = 60000, .settle_ms = 1000, .verify_timeout_ms = 60000,
+	.command_timeout_ms = 5000, .window = 4,
+    };
+    explorir_handler_t explorir = {.scaling_factor = 1};
+    explorir_async_request_t requests[4];
+    explorir_async_t async;
+    explorir_calibrate_sensor_t sensors[1];
+    explorir_calibrate_t calibrate;
+    explorir_async_init(&async, &explorir, requests, 4, 60000);
+    test_loopback_t loopback = {&async, "G 32950\r\n", 0};
+    async.tx = test_loopback_tx;
+    async.tx_context = &loopback;
+    CHECK(explorir_calibrate_init(&calibrate, sensors, 1, &config) == EXPLORIR_SUCCESS);
+    CHECK(explorir_calibrate_add(&calibrate, &async) == EXPLORIR_SUCCESS);
+    CHECK(explorir_calibrate_add(&calibrate, &async) == EXPLORIR_ERR_BUSY);
+
+    // the zero command completes inside tx, before the calibrator's call returns
+    explorir.zero_point = 32000;
+    explorir_calibrate_start(&calibrate, 0);
+    for(uint8_t k = 0; k < 4; k++) {
+	test_calibrate_line(&calibrate, &async, " Z 00400 z 00400\r\n", 100);
+    }
+    CHECK(loopback.count == 1 && sensors[0].state == EXPLORIR_CALIBRATE_ZEROING);
+    CHECK(!explorir_calibrate_poll(&calibrate, 200) && sensors[0].state == EXPLORIR_CALIBRATE_SETTLING);
+    CHECK(sensors[0].zero_before == 32000 && sensors[0].zero_after == 32950);
+    CHECK(!explorir_calibrate_poll(&calibrate, 1200) && sensors[0].state == EXPLORIR_CALIBRATE_VERIFYING);
+    bool finished = false;
+    for(uint8_t k = 0; k < 4; k++) {
+	finished = test_calibrate_line(&calibrate, &async, k % 2 ? " Z 00402 z 00402\r\n" : " Z 00398 z 00398\r\n", 1300);
+    }
+    CHECK(finished);
+    CHECK(sensors[0].state == EXPLORIR_CALIBRATE_DONE && sensors[0].verified_ppm == 400 && sensors[0].result == EXPLORIR_SUCCESS);
+
+    // a lost completion times out the zero command, and then the 'u' restoring the zero point
+    loopback = (test_loopback_t){&async, NULL, 0};
+    explorir_calibrate_start(&calibrate, 10000);
+    for(uint8_t k = 0; k < 4; k++) {
+	test_calibrate_line(&calibrate, &async, " Z 00400 z 00400\r\n", 10000);
+    }
+    CHECK(loopback.count == 1 && sensors[0].state == EXPLORIR_CALIBRATE_ZEROING);
+    CHECK(!explorir_calibrate_poll(&calibrate, 14999) && sensors[0].state == EXPLORIR_CALIBRATE_ZEROING);
+    CHECK(!explorir_calibrate_poll(&calibrate, 15000) && sensors[0].state == EXPLORIR_CALIBRATE_ROLLING_BACK);
+    CHECK(sensors[0].zero_before == 32950 && sensors[0].pending);
+    CHECK(explorir_calibrate_poll(&calibrate, 20000));
+    CHECK(sensors[0].state == EXPLORIR_CALIBRATE_FAILED && sensors[0].result == EXPLORIR_ERR_TIMEOUT);
+    // the late completions are not reported to the finished calibration
+    explorir_async_tick(&async, 200000);
+    explorir_async_tick(&async, 400000);
+    CHECK(explorir_async_idle(&async) && !sensors[0].pending && sensors[0].result == EXPLORIR_ERR_TIMEOUT);
+
+    // a rejected zero command fails at once instead of waiting for a completion that never comes
+    explorir.scaling_factor = 0;
+    static const explorir_calibrate_config_t known_gas = {
+	.method = EXPLORIR_CALIBRATE_KNOWN_GAS, .reference_ppm = 400, .stable_stddev_ppm = 10, .stable_slope_ppm_per_min = 1000,
+	.tolerance_ppm = 30, .stabilize_timeout_ms = 60000, .window = 4,
+    };
+    CHECK(explorir_calibrate_init(&calibrate, sensors, 1, &known_gas) == EXPLORIR_SUCCESS);
+    CHECK(explorir_calibrate_add(&calibrate, &async) == EXPLORIR_SUCCESS);
+    explorir_calibrate_start(&calibrate, 0);
+    for(uint8_t k = 0; k < 4; k++) {
+	finished = test_calibrate_line(&calibrate, &async, " Z 00400 z 00400\r\n", 100);
+    }
+    CHECK(finished);
+    CHECK(sensors[0].state == EXPLORIR_CALIBRATE_FAILED && sensors[0].result == EXPLORIR_ERR_INVALID_INPUT && !sensors[0].pending);
+    explorir_async_deinit(&async);
+}
+#endif
+
+// @brief transport reopen hook that fails, counting its calls
+static bool test_watchdog_reopen(explorir_handler_t * explorir_handler, void * context) {
+    (void)explorir_handler;
+    (*(uint8_t *)context)++;
+    return false;
+}
+
+static void test_watchdog(void) {
+    // without a receive buffer every recovery fails at once, the backoff doubles up to its bound
+    explorir_handler_t explorir = {.scaling_factor = 10};
+    explorir_watchdog_t watchdog;
+    explorir_watchdog_init(&watchdog, &explorir, EXPLORIR_STREAMING_PERIOD_MS, 3, 1000, 4000, 0);
+    CHECK(explorir_watchdog_poll(&watchdog, 1499) == EXPLORIR_WATCHDOG_OK && !explorir_watchdog_is_stale(&watchdog));
+    CHECK(explorir_watchdog_poll(&watchdog, 1500) == EXPLORIR_WATCHDOG_STALE && explorir_watchdog_is_stale(&watchdog));
+    CHECK(watchdog.stale_events == 1 && watchdog.recovery_attempts == 1 && explorir.err_code == EXPLORIR_ERR_TIMEOUT);
+    CHECK(explorir.scaling_factor == 10);
+    explorir_watchdog_poll(&watchdog, 2499);
+    CHECK(watchdog.recovery_attempts == 1);
+    explorir_watchdog_poll(&watchdog, 2500);
+    explorir_watchdog_poll(&watchdog, 4499);
+    CHECK(watchdog.recovery_attempts == 2);
+    explorir_watchdog_poll(&watchdog, 4500);
+    explorir_watchdog_poll(&watchdog, 8500);
+    explorir_watchdog_poll(&watchdog, 12499);
+    CHECK(watchdog.recovery_attempts == 4);
+    explorir_watchdog_poll(&watchdog, 12500);
+    CHECK(watchdog.recovery_attempts == 5 && watchdog.stale_events == 1);
+
+    // a failed reopen ends the attempt before any command
+    uint8_t reopened = 0;
+    watchdog.reopen_transport = test_watchdog_reopen;
+    watchdog.context = &reopened;
+    explorir_watchdog_poll(&watchdog, 16500);
+    CHECK(reopened == 1 && watchdog.recovery_attempts == 6);
+    watchdog.reopen_transport = NULL;
+
+    // the next measurement line makes it healthy, the backoff starts over
+    CHECK(parse(&explorir, " Z 00412 z 00409\r\n") == EXPLORIR_SUCCESS);
+    CHECK(explorir_watchdog_poll(&watchdog, 17000) == EXPLORIR_WATCHDOG_OK && watchdog.current_backoff_ms == 1000);
+    CHECK(explorir_watchdog_poll(&watchdog, 18499) == EXPLORIR_WATCHDOG_OK);
+
+#if EXPLORIR_FEATURE_ASYNC
+    // with a queue each step is queued from the completion of the one before
+    explorir_async_request_t requests[4];
+    explorir_async_t async;
+    test_port_t port = {0};
+    explorir_async_init(&async, &explorir, requests, 4, 1000);
+    async.tx = test_async_tx;
+    async.tx_context = &port;
+    CHECK(explorir_watchdog_poll(&watchdog, 18500) == EXPLORIR_WATCHDOG_RECOVERING && watchdog.stale_events == 2);
+    CHECK(port.count == 1 && strcmp(port.sent[0], "K 0\r\n") == 0);
+    test_async_line(&async, "K 00000\r\n");
+    CHECK(port.count == 2 && strcmp(port.sent[1], ".\r\n") == 0);
+    explorir_watchdog_poll(&watchdog, 30000); // no new attempt while a step is queued
+    CHECK(port.count == 2);
+    test_async_line(&async, ". 00005\r\n");
+    CHECK(explorir.scaling_factor == 5 && port.count == 3 && strcmp(port.sent[2], "K 1\r\n") == 0);
+    test_async_line(&async, "K 00001\r\n");
+    CHECK(explorir_async_idle(&async) && watchdog.state == EXPLORIR_WATCHDOG_RECOVERING);
+    test_async_line(&async, " Z 00080 z 00081\r\n");
+    CHECK(explorir_watchdog_poll(&watchdog, 30100) == EXPLORIR_WATCHDOG_OK);
+
+    // a failed scaling factor request keeps the previous one and leaves the handler stale
+    CHECK(explorir_watchdog_poll(&watchdog, 31600) == EXPLORIR_WATCHDOG_RECOVERING && port.count == 4);
+    test_async_line(&async, "K 00000\r\n");
+    test_async_line(&async, "?\r\n");
+    CHECK(explorir.scaling_factor == 5 && watchdog.state == EXPLORIR_WATCHDOG_STALE && port.count == 5);
+    CHECK(explorir_async_idle(&async));
+    explorir_async_deinit(&async);
+#endif
+}
+
+#define TEST_AUTOZERO_WINDOW_S (22 * 3600) // 22:00 - 06:00
+#define TEST_AUTOZERO_SENSORS 6
+
+static void test_autozero(void) {
+    explorir_autozero_config_t config = {.window_start_s = TEST_AUTOZERO_WINDOW_S, .window_length_s = 8 * 3600, .slot_s = 3600,
+	.period_days = 2, .per_zone = 2};
+    explorir_autozero_sensor_t sensors[TEST_AUTOZERO_SENSORS];
+    explorir_autozero_t scheduler;
+    explorir_autozero_config_t invalid = config;
+    invalid.slot_s = 0;
+    CHECK(explorir_autozero_init(&scheduler, sensors, TEST_AUTOZERO_SENSORS, &invalid) == EXPLORIR_ERR_INVALID_INPUT);
+    invalid = config;
+    invalid.window_length_s = 1800; // shorter than a slot
+    CHECK(explorir_autozero_init(&scheduler, sensors, TEST_AUTOZERO_SENSORS, &invalid) == EXPLORIR_ERR_INVALID_INPUT);
+    CHECK(explorir_autozero_init(&scheduler, sensors, TEST_AUTOZERO_SENSORS, &config) == EXPLORIR_SUCCESS && scheduler.slots == 8);
+
+    // pairs of zone 0 take the first slot of night 0, then of night 1, then the second slot of night 0
+    explorir_handler_t handlers[TEST_AUTOZERO_SENSORS] = {{0}};
+    for(uint8_t k = 0; k < TEST_AUTOZERO_SENSORS - 1; k++) {
+	CHECK(explorir_autozero_add(&scheduler, &handlers[k], 0) == EXPLORIR_SUCCESS);
+    }
+    CHECK(explorir_autozero_add(&scheduler, &handlers[TEST_AUTOZERO_SENSORS - 1], 1) == EXPLORIR_SUCCESS);
+    CHECK(explorir_autozero_add(&scheduler, &handlers[0], 1) == EXPLORIR_ERR_BUSY); // storage full
+    CHECK(sensors[1].night == 0 && sensors[1].slot == 0 && sensors[2].night == 1 && sensors[3].night == 1);
+    CHECK(sensors[4].night == 0 && sensors[4].slot == 1 && sensors[5].night == 0 && sensors[5].slot == 0);
+    CHECK(explorir_autozero_next(&scheduler, 4, 0) == TEST_AUTOZERO_WINDOW_S + 3600);
+    CHECK(explorir_autozero_next(&scheduler, 2, 0) == TEST_AUTOZERO_WINDOW_S + EXPLORIR_AUTOZERO_DAY_S);
+
+#if EXPLORIR_FEATURE_ASYNC
+    // a queued start is acknowledged once queued, the others have no receive buffer and fail
+    explorir_async_request_t requests[2];
+    explorir_async_t async;
+    test_port_t port = {0};
+    explorir_async_init(&async, &handlers[0], requests, 2, 1000);
+    async.tx = test_async_tx;
+    async.tx_context = &port;
+#endif
+
+    // once per window, in the sensor's slot only
+    CHECK(explorir_autozero_poll(&scheduler, TEST_AUTOZERO_WINDOW_S - 1) == 0);
+    CHECK(explorir_autozero_poll(&scheduler, TEST_AUTOZERO_WINDOW_S) == 3);
+    CHECK(explorir_autozero_poll(&scheduler, TEST_AUTOZERO_WINDOW_S + 100) == 0);
+    CHECK(sensors[0].last_window == 0 && sensors[2].last_window == EXPLORIR_AUTOZERO_NEVER);
+    CHECK(explorir_autozero_poll(&scheduler, TEST_AUTOZERO_WINDOW_S + 3600) == 1 && sensors[4].last_window == 0);
+    CHECK(explorir_autozero_poll(&scheduler, TEST_AUTOZERO_WINDOW_S + 7 * 3600) == 0); // 05:00, past midnight, no sensor
+    CHECK(scheduler.started == 4);
+#if EXPLORIR_FEATURE_ASYNC
+    CHECK(port.count == 1 && strcmp(port.sent[0], "65222\r\n") == 0);
+    CHECK(sensors[0].last_result == EXPLORIR_SUCCESS && scheduler.failed == 3);
+    explorir_async_deinit(&async);
+#else
+    CHECK(scheduler.failed == 4);
+#endif
+    CHECK(sensors[1].last_result == EXPLORIR_ERR_INVALID_INPUT);
+    CHECK(explorir_autozero_next(&scheduler, 0, TEST_AUTOZERO_WINDOW_S + 100) == TEST_AUTOZERO_WINDOW_S + 2 * EXPLORIR_AUTOZERO_DAY_S);
+
+    // the next night belongs to the other pair
+    uint32_t night_1 = TEST_AUTOZERO_WINDOW_S + EXPLORIR_AUTOZERO_DAY_S;
+    CHECK(explorir_autozero_poll(&scheduler, night_1) == 2 && sensors[2].last_window == 1 && sensors[3].last_window == 1);
+
+    // slots missed while the host was down wait for the sensor's next night
+    uint32_t night_2 = TEST_AUTOZERO_WINDOW_S + 2 * EXPLORIR_AUTOZERO_DAY_S;
+    CHECK(explorir_autozero_poll(&scheduler, night_2 + 2 * 3600) == 0);
+    CHECK(explorir_autozero_next(&scheduler, 4, night_2 + 2 * 3600) == night_2 + 2 * EXPLORIR_AUTOZERO_DAY_S + 3600);
+    CHECK(explorir_autozero_next(&scheduler, 4, night_2 + 3600 + 10) == night_2 + 3600 + 10); // due now
+
+    // a full zone is rejected, other zones still fit
+    config.window_length_s = config.slot_s;
+    config.period_days = 1;
+    config.per_zone = 1;
+    CHECK(explorir_autozero_init(&scheduler, sensors, TEST_AUTOZERO_SENSORS, &config) == EXPLORIR_SUCCESS);
+    CHECK(explorir_autozero_add(&scheduler, &handlers[0], 0) == EXPLORIR_SUCCESS);
+    CHECK(explorir_autozero_add(&scheduler, &handlers[1], 0) == EXPLORIR_ERR_BUSY);
+    CHECK(explorir_autozero_add(&scheduler, &handlers[1], 1) == EXPLORIR_SUCCESS);
+}
+
+static void test_stability(void) {
+    explorir_stability_t stability;
+    CHECK(explorir_stability_init(&stability, 1, 10, 20, 2000) == EXPLORIR_ERR_INVALID_INPUT);
+    CHECK(explorir_stability_init(&stability, 8, 10, 20, 0) == EXPLORIR_ERR_INVALID_INPUT);
+    CHECK(explorir_stability_init(&stability, 8, 10, 20, 2000) == EXPLORIR_SUCCESS);
+
+    // 2 ppm per reading every 2 s is 60 ppm per minute
+    for(uint32_t k = 0; k < 20; k++) {
+	explorir_stability_push(&stability, 400 + 2 * k);
+    }
+    CHECK(explorir_stability_slope(&stability) == 60);
+    CHECK(explorir_stability_mean(&stability) == 400 + 2 * 12 + 7);
+    // positions 0 - 7 have a variance of 5.25, the readings 4 times that
+    CHECK(explorir_stability_variance(&stability) == 21);
+    CHECK(!explorir_stability_is_stable(&stability));
+
+    // falling readings give a negative slope
+    explorir_stability_reset(&stability);
+    for(uint32_t k = 0; k < 8; k++) {
+	explorir_stability_push(&stability, 800 - 5 * k);
+    }
+    CHECK(explorir_stability_slope(&stability) == -150);
+
+    // noise around a flat level is stable within the limits
+    explorir_stability_reset(&stability);
+    CHECK(explorir_stability_variance(&stability) == 0 && explorir_stability_slope(&stability) == 0);
+    bool stable = false;
+    for(uint32_t k = 0; k < 8; k++) {
+	stable = explorir_stability_push(&stability, k % 2 ? 402 : 398);
+    }
+    CHECK(explorir_stability_variance(&stability) == 4);
+    CHECK(explorir_stability_mean(&stability) == 400);
+    CHECK(stable && explorir_stability_is_stable(&stability));
+    CHECK(!explorir_stability_push(&stability, 500));
+}
+
+static void test_pressure(void) {
+    // 8192 + ((1013 - mbar) x 0.14 / 100) x 8192
+    CHECK(explorir_pressure_compensation(EXPLORIR_PRESSURE_REFERENCE_PA) == EXPLORIR_PRESSURE_UNITY);
+    CHECK(explorir_pressure_compensation(91300) == 9339); // 8192 + 1146.88
+    CHECK(explorir_pressure_compensation(111300) == 7045); // 8192 - 1146.88
+    CHECK(explorir_pressure_compensation(101250) == 8198); // 0.5 mbar, 5.73
+    CHECK(explorir_pressure_compensation(0) == 19810);
+    CHECK(explorir_pressure_compensation(800000) == 0);
+
+    CHECK(explorir_pressure_correct(400, EXPLORIR_PRESSURE_REFERENCE_PA, EXPLORIR_PRESSURE_UNITY) == 400);
+    CHECK(explorir_pressure_correct(400, 91300, EXPLORIR_PRESSURE_UNITY) == 456);
+    CHECK(explorir_pressure_correct(400, 91300, 0) == 400);
+    uint32_t ppm[3] = {400, 400, 1000};
+    const uint32_t pressure_pa[3] = {EXPLORIR_PRESSURE_REFERENCE_PA, 91300, 111300};
+    explorir_pressure_correct_batch(ppm, pressure_pa, 3, EXPLORIR_PRESSURE_UNITY);
+    CHECK(ppm[0] == 400 && ppm[1] == 456 && ppm[2] == 860);
+}
+
+int main(void) {
+    test_encode_command();
+    test_parse_response();
+    test_receive_buffer();
+#if EXPLORIR_FEATURE_FLEET
+    test_fleet();
+#endif
+    test_framer();
+    test_filter();
+    test_aggregate();
+    test_log();
+#if EXPLORIR_TEST_LOG_MMAP
+    test_log_mmap();
+#endif
+    test_batch();
+#if EXPLORIR_TEST_CAPTURE
+    test_capture();
+#endif
+#if EXPLORIR_TEST_EXPORTER
+    test_exporter();
+#endif
+#if EXPLORIR_FEATURE_ASYNC
+    test_async();
+    test_calibrate();
+#endif
+    test_watchdog();
+    test_autozero();
+    test_stability();
+    test_pressure();
+    printf("%u checks, %u failed\n", checks, failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,141 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_bench.c
+
+  @Summary
+    Host microbenchmarks for the ExplorIr driver hot paths
+
+  @Description
+    Usage: explorir_bench [iterations]
+
+    Times the response parser, the framer, batch decoding, command encoding and a full
+    command round trip against the simulated sensor, and prints the cost per
+    operation. Build with the CMake Release configuration (EXPLORIR_NATIVE,
+    EXPLORIR_LTO) to compare optimizations.
+******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include "explorir.h"
+#include "explorir_framer.h"
+#include "explorir_batch.h"
+#include "explorir_sim.h"
+
+volatile bool explorir_complete_uart_rx;
+
+#define BENCH_STREAM_SIZE 65536
+
+static explorir_handler_t bench_handler;
+static uint8_t bench_rx[32];
+static explorir_sim_t bench_sim;
+static explorir_framer_t bench_framer;
+static uint8_t bench_stream[BENCH_STREAM_SIZE];
+static uint16_t bench_stream_size;
+static explorir_batch_t bench_batch;
+static uint32_t bench_batch_timestamps[BENCH_STREAM_SIZE / 8];
+static uint16_t bench_batch_raw[BENCH_STREAM_SIZE / 8];
+static uint8_t bench_batch_sensor_ids[BENCH_STREAM_SIZE / 8];
+static uint8_t bench_batch_fields[BENCH_STREAM_SIZE / 8];
+
+static const uint8_t bench_streaming_line[] = " Z 00400 z 00398\r\n";
+static const uint8_t bench_reply_line[] = ". 00010\r\n";
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void bench_tx_none(unsigned char * tx, uint8_t size) {
+    (void)tx;
+    (void)size;
+}
+
+static void bench_tx_sim(unsigned char * tx, uint8_t size) {
+    explorir_sim_command(&bench_sim, tx, size);
+}
+
+static void bench_sim_output(const uint8_t * line, uint8_t size, void * context) {
+    explorir_update_data((uint8_t *)line, size, context);
+}
+
+static void bench_parse_streaming(void) {
+    explorir_parse_response(bench_streaming_line, sizeof(bench_streaming_line) - 1, &bench_handler);
+}
+
+static void bench_parse_reply(void) {
+    explorir_parse_response(bench_reply_line, sizeof(bench_reply_line) - 1, &bench_handler);
+}
+
+static void bench_framer_stream(void) {
+    explorir_framer_process(&bench_framer, bench_stream, bench_stream_size, &bench_handler);
+}
+
+static void bench_parse_batch(void) {
+    explorir_batch_clear(&bench_batch);
+    explorir_parse_batch(&bench_batch, bench_stream, bench_stream_size, 0, 1);
+}
+
+static void bench_command(void) {
+    explorir_set_digital_filter(32, &bench_handler);
+}
+
+// @brief runs fn iterations times, ops is the number of lines or commands one call handles
+static void bench_run(const char * name, void(*fn)(void), uint32_t iterations, uint32_t ops) {
+    for(uint32_t i = 0; i < iterations / 100 + 1; i++) {
+	fn(); // warm up
+    }
+    uint64_t start = monotonic_ns();
+    for(uint32_t i = 0; i < iterations; i++) {
+	fn();
+    }
+    double ns = (double)(monotonic_ns() - start) / ((double)iterations * ops);
+    printf("%-20s %9.1f ns/op %9.2f Mop/s\n", name, ns, 1e3 / ns);
+}
+
+int main(int argc, char ** argv) {
+    uint32_t iterations = argc > 1 ? strtoul(argv[1], NULL, 10) : 5000000;
+    if(iterations == 0)
+	iterations = 1;
+
+    bench_handler.scaling_factor = 10;
+    bench_handler.explorir_tx = bench_tx_none;
+    bench_run("parse streaming", bench_parse_streaming, iterations, 1);
+    bench_run("parse reply", bench_parse_reply, iterations, 1);
+
+    uint32_t lines = 0;
+    while(bench_stream_size + sizeof(bench_streaming_line) - 1 <= BENCH_STREAM_SIZE) {
+	memcpy(bench_stream + bench_stream_size, bench_streaming_line, sizeof(bench_streaming_line) - 1);
+	bench_stream_size += sizeof(bench_streaming_line) - 1;
+	lines++;
+    }
+    explorir_framer_init(&bench_framer);
+    bench_run("framer stream", bench_framer_stream, iterations / lines + 1, lines);
+    // every line holds two fields of 8 bytes
+    explorir_batch_init(&bench_batch, bench_batch_timestamps, bench_batch_sensor_ids, bench_batch_fields, bench_batch_raw,
+	    BENCH_STREAM_SIZE / 8);
+    bench_run("parse batch", bench_parse_batch, iterations / lines + 1, lines);
+    if(bench_batch.count != lines * 2) {
+	fprintf(stderr, "parse batch decoded %u of %u fields\n", bench_batch.count, lines * 2);
+	return 1;
+    }
+
+    bench_run("encode command", bench_command, iterations, 1);
+
+    bench_handler.explorir_data = bench_rx;
+    bench_handler.explorir_data_size = sizeof(bench_rx);
+    bench_handler.explorir_tx = bench_tx_sim;
+    explorir_sim_init(&bench_sim, 420, bench_sim_output, &bench_handler);
+    bench_run("round trip (sim)", bench_command, iterations / 10 + 1, 1);
+    if(bench_handler.err_code != EXPLORIR_SUCCESS || bench_handler.digital_filter != 32) {
+	fprintf(stderr, "round trip failed, err_code %d\n", bench_handler.err_code);
+	return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_replay.c
+
+  @Summary
+    Replays an ExplorIr UART capture through the driver
+
+  @Description
+    Usage: explorir_replay <capture file> [--realtime]
+
+    Feeds every recorded response back through explorir_process_response(),
+    one handler per recorded sensor id, then prints the final readings and
+    the parser throughput. Without --realtime the capture is replayed at
+    maximum speed, which makes this a parser benchmark on real traffic.
+******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "explorir.h"
+#include "explorir_capture.h"
+
+volatile bool explorir_complete_uart_rx;
+
+static explorir_handler_t explorir_handlers[256];
+static explorir_handler_t * explorir_handler_table[256];
+static uint8_t explorir_rx_buffers[256][UART_RX_BUF_SIZE];
+
+static void replay_tx(unsigned char * tx, uint8_t size) {
+    (void)tx; // responses come from the capture, commands go nowhere
+    (void)size;
+}
+
+int main(int argc, char ** argv) {
+    if(argc < 2) {
+	fprintf(stderr, "usage: %s <capture file> [--realtime]\n", argv[0]);
+	return 2;
+    }
+    bool realtime = (argc > 2 && strcmp(argv[2], "--realtime") == 0);
+
+    FILE * file = fopen(argv[1], "rb");
+    if(file == NULL) {
+	perror(argv[1]);
+	return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t * data = malloc(size > 0 ? (size_t)size : 1);
+    if(data == NULL || fread(data, 1, (size_t)size, file) != (size_t)size) {
+	fprintf(stderr, "%s: read failed\n", argv[1]);
+	fclose(file);
+	free(data);
+	return 1;
+    }
+    fclose(file);
+
+    for(uint16_t s = 0; s < 256; s++) {
+	explorir_handlers[s].explorir_tx = replay_tx;
+	explorir_handlers[s].explorir_data = explorir_rx_buffers[s];
+	explorir_handlers[s].explorir_data_size = UART_RX_BUF_SIZE;
+	explorir_handlers[s].sensor_id = (uint8_t)s;
+	explorir_handlers[s].scaling_factor = 1; // until the capture's '.' response is replayed
+	explorir_handler_table[s] = &explorir_handlers[s];
+    }
+
+    explorir_replay_stats_t stats;
+    explorir_retcode_t ret = explorir_replay(data, (size_t)size, explorir_handler_table, 256, realtime, &stats);
+    free(data);
+    if(ret != EXPLORIR_SUCCESS) {
+	fprintf(stderr, "%s: invalid or truncated capture\n", argv[1]);
+	return 1;
+    }
+
+    double seconds = stats.elapsed_ns / 1e9;
+    printf("responses %u, commands %u, skipped %u, bytes %llu\n", stats.responses, stats.commands, stats.skipped,
+	    (unsigned long long)stats.bytes);
+    if(seconds > 0) {
+	printf("%.3f s, %.0f lines/s, %.1f MB/s\n", seconds, stats.responses / seconds, stats.bytes / seconds / 1e6);
+    }
+    for(uint16_t s = 0; s < 256; s++) {
+	explorir_handler_t * h = &explorir_handlers[s];
+	if(h->current_filtered_co2 || h->current_unfiltered_co2) {
+	    printf("sensor %u: filtered %u ppm, unfiltered %u ppm\n", s, h->current_filtered_co2, h->current_unfiltered_co2);
+	}
+    }
+    return 0;
+}
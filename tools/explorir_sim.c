@@ -0,0 +1,107 @@
+/* ****************************************************************************/
+/** ExplorIr CO2 Sensor Function Library
+
+  @File Name
+    explorir_sim.c
+
+  @Summary
+    Serves a simulated ExplorIr sensor on a pseudo terminal
+
+  @Description
+    Usage: explorir_sim [--ppm N] [--noise N] [--errors PERCENT]
+
+    Prints the path of the pseudo terminal, then answers commands on it and
+    streams measurements like a sensor on a USB-serial adapter would, until
+    interrupted. Point explorir_linux_open() or any serial tool at the path.
+******************************************************************************/
+
+#define _XOPEN_SOURCE 600 // posix_openpt()
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include "explorir_sim.h"
+
+static volatile sig_atomic_t explorir_sim_running = 1;
+
+static void explorir_sim_stop(int signal) {
+    (void)signal;
+    explorir_sim_running = 0;
+}
+
+static uint32_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u);
+}
+
+static void explorir_sim_write(const uint8_t * line, uint8_t size, void * context) {
+    int fd = *(int *)context;
+    (void)!write(fd, line, size); // nobody has the terminal open, the line is lost like on a real bus
+}
+
+int main(int argc, char ** argv) {
+    uint32_t ppm = 420;
+    uint16_t noise = 0;
+    uint8_t errors = 0;
+    for(int i = 1; i < argc; i++) {
+	if(strcmp(argv[i], "--ppm") == 0 && i + 1 < argc) {
+	    ppm = strtoul(argv[++i], NULL, 10);
+	} else if(strcmp(argv[i], "--noise") == 0 && i + 1 < argc) {
+	    noise = strtoul(argv[++i], NULL, 10);
+	} else if(strcmp(argv[i], "--errors") == 0 && i + 1 < argc) {
+	    errors = strtoul(argv[++i], NULL, 10);
+	} else {
+	    fprintf(stderr, "usage: %s [--ppm N] [--noise N] [--errors PERCENT]\n", argv[0]);
+	    return 2;
+	}
+    }
+
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if(fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+	perror("posix_openpt");
+	return 1;
+    }
+    printf("%s\n", ptsname(fd));
+    fflush(stdout);
+
+    signal(SIGINT, explorir_sim_stop);
+    signal(SIGTERM, explorir_sim_stop);
+
+    explorir_sim_t sim;
+    explorir_sim_init(&sim, ppm, explorir_sim_write, &fd);
+    sim.noise_ppm = noise;
+    sim.error_percent = errors;
+
+    uint8_t cmd[64];
+    uint16_t cmd_size = 0;
+    while(explorir_sim_running) {
+	struct pollfd pfd = {.fd = fd, .events = POLLIN};
+	if(poll(&pfd, 1, 10) > 0 && (pfd.revents & POLLIN)) {
+	    uint8_t chunk[64];
+	    ssize_t received = read(fd, chunk, sizeof(chunk));
+	    for(ssize_t i = 0; i < received; i++) {
+		if(cmd_size < sizeof(cmd))
+		    cmd[cmd_size++] = chunk[i];
+		if(chunk[i] == TERMINATE) {
+		    explorir_sim_command(&sim, cmd, cmd_size);
+		    cmd_size = 0;
+		}
+	    }
+	} else if(pfd.revents & POLLHUP) {
+	    usleep(10000); // no client has the terminal open
+	}
+	explorir_sim_tick(&sim, monotonic_ms());
+    }
+
+    fprintf(stderr, "commands %u, lines %u\n", sim.commands, sim.lines);
+    close(fd);
+    return 0;
+}